@@ -33,6 +33,7 @@
 
 #include "CanIf.h"
 #include "rtos_utils.h"
+#include "Clock.h"
 
 /* --------------------- Definitions and static variables ------------------ */
 //Example Configuration
@@ -64,7 +65,7 @@ ErrorCodes Can_Rx(CanMessage *msg)
         msg->Dlc = rx_msg.data_length_code;
         msg->Id = rx_msg.identifier;
         memcpy(msg->Frame, rx_msg.data, rx_msg.data_length_code);
-        msg->Timestamp = GetTime_ms();
+        msg->Timestamp = Clock_GetTime_us();
         return ERROR_OK;
     }
     return ERROR_DATA_EMPTY;
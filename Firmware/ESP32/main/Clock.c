@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * @brief   Clock domain of the device. esp_timer is used as monotonic time base,
+ *          offset to Unix time is taken from SNTP.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <sys/time.h>
+#include "Clock.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
+#include "esp_log.h"
+
+// -- Private Definitions -------------------------------
+#define TAG "Clock.c"
+
+#define CLOCK_SNTP_SERVER           "pool.ntp.org"
+#define CLOCK_SNTP_INTERVAL_MS      (15 * 60 * 1000) //Re-anchor every 15 minutes to compensate drift of crystal
+
+// -- Private Variables ---------------------------------
+static portMUX_TYPE clock_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t  clock_offset_us = 0;     //Unix time - esp_timer
+static uint64_t clock_last_us = 0;       //Last returned time, used to keep time monotonic
+static uint32_t clock_synchronized = 0;
+
+static void clock_sntp_sync(struct timeval *tv)
+{
+  Clock_SetUnixTime((uint32_t)tv->tv_sec, (uint32_t)tv->tv_usec);
+}
+
+/*-----------------------------------------------------------------------------------*/
+
+void Clock_Init(void)
+{
+  sntp_setoperatingmode(SNTP_OPMODE_POLL);
+  sntp_setservername(0, CLOCK_SNTP_SERVER);
+  sntp_set_time_sync_notification_cb(clock_sntp_sync);
+  sntp_set_sync_interval(CLOCK_SNTP_INTERVAL_MS);
+  sntp_init();
+}
+
+uint64_t Clock_GetTime_us(void)
+{
+  uint64_t now;
+  portENTER_CRITICAL_SAFE(&clock_lock);
+  now = (uint64_t)(esp_timer_get_time() + clock_offset_us);
+  //Re-anchor can move offset backwards. Hold time until monotonic timer catches up.
+  if(now < clock_last_us)
+  {
+    now = clock_last_us;
+  }
+  clock_last_us = now;
+  portEXIT_CRITICAL_SAFE(&clock_lock);
+  return now;
+}
+
+void Clock_SetUnixTime(uint32_t sec, uint32_t us)
+{
+  int64_t offset = (int64_t)sec * 1000000 + us - esp_timer_get_time();
+  int64_t drift;
+  uint32_t synchronized;
+
+  portENTER_CRITICAL_SAFE(&clock_lock);
+  drift = offset - clock_offset_us;
+  synchronized = clock_synchronized;
+  clock_offset_us = offset;
+  clock_synchronized = 1;
+  portEXIT_CRITICAL_SAFE(&clock_lock);
+
+  if(synchronized != 0)
+  {
+    ESP_LOGI(TAG, "Clock re-anchored, drift %d us", (int)drift);
+  }
+  else
+  {
+    ESP_LOGI(TAG, "Clock synchronized to Unix time %u", (unsigned int)sec);
+  }
+}
+
+uint32_t Clock_IsSynchronized(void)
+{
+  return clock_synchronized;
+}
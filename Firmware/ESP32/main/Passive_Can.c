@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * @brief   Routing of CAN messages into passive transport protocols.
+ *          Every protocol claims CAN IDs it expects, so message is passed only
+ *          into one parser instead of trying all of them.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************  
+ */ 
+#include "string.h"
+#include "Passive_Can.h"
+#include <esp_log.h>
+
+// -- Private defintions
+#define PASSIVE_CAN_STANDARD_IDS    0x800   //Standard IDs are routed by table, index of parser + 1 (0 = not claimed)
+#define PASSIVE_CAN_MAX_PARSERS     8
+#define PASSIVE_CAN_MAX_RANGES      16      //Claimed ranges of extended IDs
+
+typedef struct
+{
+    uint32_t First;
+    uint32_t Last;
+    uint8_t  Parser;    //Index of parser + 1
+} Passive_Can_Range;
+
+#define TAG "Passive_Can.c"
+
+// -- Private variables
+static Passive_Can_Parser passive_can_parsers[PASSIVE_CAN_MAX_PARSERS];
+static uint8_t passive_can_standard[PASSIVE_CAN_STANDARD_IDS];
+static Passive_Can_Range passive_can_ranges[PASSIVE_CAN_MAX_RANGES];
+static uint32_t passive_can_rangesCount;
+
+/**
+ * @param add Add parser if it is not known yet
+ * @retval Index of parser + 1, 0 if parser is not known or there is no space for another parser
+ */
+static uint8_t Passive_Can_Index(Passive_Can_Parser parser, bool add)
+{
+    int i;
+    for (i = 0; i < PASSIVE_CAN_MAX_PARSERS; i++)
+    {
+        if (passive_can_parsers[i] == parser)
+        {
+            return i + 1;
+        }
+        if (passive_can_parsers[i] == NULL)
+        {
+            if (!add)
+            {
+                return 0;
+            }
+            passive_can_parsers[i] = parser;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool Passive_Can_Claim(uint32_t first, uint32_t last, Passive_Can_Parser parser)
+{
+    uint32_t id;
+    bool result = true;
+    uint8_t index = Passive_Can_Index(parser, true);
+    if (index == 0)
+    {
+        ESP_LOGW(TAG, "Too many passive CAN parsers\n");
+        return false;
+    }
+    //Standard IDs
+    for (id = first; id <= last && id < PASSIVE_CAN_STANDARD_IDS; id++)
+    {
+        if (passive_can_standard[id] == 0)
+        {
+            passive_can_standard[id] = index;
+        }
+        else if (passive_can_standard[id] != index)
+        {
+            result = false;
+        }
+    }
+    //Extended IDs
+    if (last >= PASSIVE_CAN_STANDARD_IDS)
+    {
+        if (passive_can_rangesCount >= PASSIVE_CAN_MAX_RANGES)
+        {
+            ESP_LOGW(TAG, "Too many claimed ranges of CAN IDs\n");
+            return false;
+        }
+        passive_can_ranges[passive_can_rangesCount].First = first < PASSIVE_CAN_STANDARD_IDS ? PASSIVE_CAN_STANDARD_IDS : first;
+        passive_can_ranges[passive_can_rangesCount].Last = last;
+        passive_can_ranges[passive_can_rangesCount].Parser = index;
+        passive_can_rangesCount++;
+    }
+    if (!result)
+    {
+        ESP_LOGW(TAG, "CAN IDs %x ~ %x are partially claimed by other parser\n", first, last);
+    }
+    return result;
+}
+
+void Passive_Can_Release(uint32_t first, uint32_t last, Passive_Can_Parser parser)
+{
+    uint32_t id;
+    uint32_t i;
+    uint8_t index = Passive_Can_Index(parser, false);
+    if (index == 0)
+    {
+        return;
+    }
+    for (id = first; id <= last && id < PASSIVE_CAN_STANDARD_IDS; id++)
+    {
+        if (passive_can_standard[id] == index)
+        {
+            passive_can_standard[id] = 0;
+        }
+    }
+    for (i = 0; i < passive_can_rangesCount; )
+    {
+        Passive_Can_Range* range = &passive_can_ranges[i];
+        if (range->Parser == index && range->First >= first && range->Last <= last)
+        {
+            //Keep array without holes, order of ranges does not matter
+            *range = passive_can_ranges[--passive_can_rangesCount];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+bool Passive_Can_Parse(CanMessage cmsg)
+{
+    uint32_t i;
+    uint8_t index = 0;
+    if (cmsg.Id < PASSIVE_CAN_STANDARD_IDS)
+    {
+        index = passive_can_standard[cmsg.Id];
+    }
+    else
+    {
+        for (i = 0; i < passive_can_rangesCount; i++)
+        {
+            if (cmsg.Id >= passive_can_ranges[i].First && cmsg.Id <= passive_can_ranges[i].Last)
+            {
+                index = passive_can_ranges[i].Parser;
+                break;
+            }
+        }
+    }
+    if (index == 0)
+    {
+        return false;
+    }
+    return passive_can_parsers[index - 1](cmsg);
+}
@@ -0,0 +1,32 @@
+/*******************************************************************************
+ * @brief   Routing of CAN messages into passive transport protocols
+ ******************************************************************************
+ * @attention
+ ******************************************************************************  
+ */ 
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "CanIf.h"
+
+/**
+ * @brief Parser of transport protocol, returns true if message was processed
+*/
+typedef bool (*Passive_Can_Parser)(CanMessage cmsg);
+
+/**
+ * @brief Route CAN IDs first ~ last into parser. IDs already claimed by other parser are kept.
+ * @retval False if some ID is claimed by other parser or there is no space left for parser or range
+*/
+bool Passive_Can_Claim(uint32_t first, uint32_t last, Passive_Can_Parser parser);
+
+/**
+ * @brief Stop routing CAN IDs first ~ last into parser
+*/
+void Passive_Can_Release(uint32_t first, uint32_t last, Passive_Can_Parser parser);
+
+/**
+ * @brief Pass CAN message into parser which has claimed its ID
+ * @retval True if successfuly processed
+*/
+bool Passive_Can_Parse(CanMessage cmsg);
@@ -7,18 +7,26 @@
 
 #include <esp_log.h>
 #include "Passive_Iso15765.h"
+#include "Passive_Can.h"
 #include "Task_Tcp_Wireshark_Raw.h"
 
 // -- Private definitions
 #define TAG "Passive_Iso15765.c"
 
 // -- Private variables
+#define ISO15765_FRAME_LENGTH   4096  //Longer datagrams are sent in segments of this size
+#define ISO15765_FF_DL_MAX_12   0xFFF //Longer FF_DL is coded by escape sequence (FF_DL = 0 + 32 bit length)
+#define ISO15765_COMMENT_LENGTH 32
 static uint32_t valid_CanIds[] = {0x700, 0x7E0, 0x7E8, 0x7E1, 0x7E9 };
 static uint32_t valid_CanIds_Count = 5;
-static uint8_t  iso15765_frame[4096];
+static uint8_t  iso15765_frame[ISO15765_FRAME_LENGTH];
 static uint32_t iso15765_frame_position = 0;
 static uint32_t iso15765_frame_expectedLength = 0;
 static uint32_t iso15765_frame_expectedSN;
+static bool     iso15765_frame_snGap;
+static uint32_t iso15765_frame_segment;       //Segment of datagram in buffer, 0 if datagram fits into buffer
+static uint32_t iso15765_frame_segmentCount;
+static char     iso15765_comment[ISO15765_COMMENT_LENGTH];
 
 bool Passive_Iso15765_Contains(uint32_t id)
 {
@@ -34,11 +42,58 @@ bool Passive_Iso15765_Contains(uint32_t id)
 }
 void Passive_Iso15765_VerifyPreviousDatagram()
 {
-    if (iso15765_frame_position != 0)
+    if (iso15765_frame_expectedLength != 0)
     {
         ESP_LOGW(TAG, "We are trying to process another datagram, even that we still have datagram with length 0x%x bytes in buffer", iso15765_frame_position);
         ESP_LOGW(TAG, "Datagram is still missing 0x%x bytes to be complete", iso15765_frame_expectedLength);        
-        iso15765_frame_position = 0;
+    }
+    iso15765_frame_position = 0;
+    iso15765_frame_expectedLength = 0;
+    iso15765_frame_segment = 0;
+}
+
+/**
+ * @brief Send content of buffer as datagram or as one segment of datagram longer than buffer
+*/
+static void Passive_Iso15765_Send(CanMessage* cmsg)
+{
+    const char* comment = NULL;
+    if (iso15765_frame_segment != 0)
+    {
+        snprintf(iso15765_comment, sizeof(iso15765_comment), "segment %u/%u%s", (unsigned int)iso15765_frame_segment, (unsigned int)iso15765_frame_segmentCount, iso15765_frame_snGap ? ", SN gap" : "");
+        comment = iso15765_comment;
+        iso15765_frame_segment++;
+    }
+    else if (iso15765_frame_snGap)
+    {
+        comment = "SN gap";
+    }
+    Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(iso15765_frame, iso15765_frame_position, cmsg->Id, cmsg->Timestamp, Raw_ISO15765, comment);
+    iso15765_frame_position = 0;
+    iso15765_frame_snGap = false;
+}
+
+/**
+ * @brief Copy data of First Frame or Consecutive Frame into buffer, never more than expected length
+*/
+static void Passive_Iso15765_Append(CanMessage* cmsg, int offset)
+{
+    int i;
+    for (i = offset; i < cmsg->Dlc && iso15765_frame_expectedLength != 0; i++)
+    {
+        if (iso15765_frame_position == ISO15765_FRAME_LENGTH)
+        {
+            //Buffer is full, stream it out as segment
+            Passive_Iso15765_Send(cmsg);
+        }
+        iso15765_frame[iso15765_frame_position] = cmsg->Frame[i];
+        iso15765_frame_position++;
+        iso15765_frame_expectedLength--;
+    }
+    if (iso15765_frame_expectedLength == 0)
+    {
+        Passive_Iso15765_Send(cmsg);
+        iso15765_frame_segment = 0;
     }
 }
 
@@ -47,7 +102,7 @@ void Passive_Iso15765_SingleFrame(CanMessage cmsg)
     int i;
     Passive_Iso15765_VerifyPreviousDatagram();
     int length = cmsg.Frame[0] & 0xF;
-    if (length > cmsg.Dlc - 1)
+    if (length == 0 || length > cmsg.Dlc - 1)
     {
         return;
     }
@@ -63,29 +118,52 @@ void Passive_Iso15765_SingleFrame(CanMessage cmsg)
 
 void Passive_Iso15765_FirstFrame(CanMessage cmsg)
 {
-    int i;
+    int offset = 2;
+    uint32_t length;
     Passive_Iso15765_VerifyPreviousDatagram();
-    iso15765_frame_expectedLength = ((cmsg.Frame[0] & 0xF) << 8) | cmsg.Frame[1];
-    iso15765_frame_expectedSN = 1; //Always starting on 1
-    for (i = 2; i < cmsg.Dlc; i++)
+    if (cmsg.Dlc < 8)
     {
-        iso15765_frame[iso15765_frame_position] = cmsg.Frame[i];
-        iso15765_frame_position++;
-        iso15765_frame_expectedLength--;
-
-        if (iso15765_frame_expectedLength == 0)
+        //First Frame uses always whole CAN frame
+        ESP_LOGE(TAG, "First Frame with DLC %d", cmsg.Dlc);
+        return;
+    }
+    length = ((cmsg.Frame[0] & 0xF) << 8) | cmsg.Frame[1];
+    if (length == 0)
+    {
+        //Escape sequence, FF_DL is 32 bit big endian value
+        length = ((uint32_t)cmsg.Frame[2] << 24) | ((uint32_t)cmsg.Frame[3] << 16) | ((uint32_t)cmsg.Frame[4] << 8) | cmsg.Frame[5];
+        offset = 6;
+        if (length <= ISO15765_FF_DL_MAX_12)
         {
-            Task_Tcp_Wireshark_Raw_AddNewRawMessage(iso15765_frame, iso15765_frame_position, cmsg.Id, cmsg.Timestamp, Raw_ISO15765);
-            iso15765_frame_position = 0;
-            break;
+            ESP_LOGE(TAG, "First Frame escape sequence with FF_DL 0x%x", length);
+            return;
         }
     }
+    else if (length < 8)
+    {
+        //Would fit into Single Frame
+        ESP_LOGE(TAG, "First Frame with FF_DL 0x%x", length);
+        return;
+    }
+    iso15765_frame_expectedLength = length;
+    iso15765_frame_expectedSN = 1; //Always starting on 1
+    iso15765_frame_snGap = false;
+    if (length > ISO15765_FRAME_LENGTH)
+    {
+        iso15765_frame_segment = 1;
+        iso15765_frame_segmentCount = (length + ISO15765_FRAME_LENGTH - 1) / ISO15765_FRAME_LENGTH;
+    }
+    Passive_Iso15765_Append(&cmsg, offset);
 }
 
 void Passive_Iso15765_ConsequtiveFrame(CanMessage cmsg)
 {
-    int i;
     int receivedSN;
+    if (iso15765_frame_expectedLength == 0)
+    {
+        //No First Frame, or it was lost
+        return;
+    }
     if((cmsg.Frame[0] & 0xF) == iso15765_frame_expectedSN)
     {
         iso15765_frame_expectedSN++;
@@ -95,21 +173,19 @@ void Passive_Iso15765_ConsequtiveFrame(CanMessage cmsg)
     {
         receivedSN = (cmsg.Frame[0] & 0xF);
         ESP_LOGE(TAG, "Expected S/N = 0x%x. Provided 0x%x\n", iso15765_frame_expectedSN, receivedSN);
-        iso15765_frame_expectedSN = receivedSN + 1;
+        iso15765_frame_expectedSN = (receivedSN + 1) & 0xF;
+        iso15765_frame_snGap = true;
     }
 
-    for (i = 1; i < cmsg.Dlc; i++)
+    Passive_Iso15765_Append(&cmsg, 1);
+}
+
+void Passive_Iso15765_Init(void)
+{
+    int i;
+    for(i = 0; i<valid_CanIds_Count;i++)
     {
-        iso15765_frame[iso15765_frame_position] = cmsg.Frame[i];
-        iso15765_frame_position++;
-        iso15765_frame_expectedLength--;
-        
-        if (iso15765_frame_expectedLength == 0)
-        {
-            Task_Tcp_Wireshark_Raw_AddNewRawMessage(iso15765_frame, iso15765_frame_position, cmsg.Id, cmsg.Timestamp, Raw_ISO15765);
-            iso15765_frame_position = 0;
-            break;
-        }
+        Passive_Can_Claim(valid_CanIds[i], valid_CanIds[i], Passive_Iso15765_Parse);
     }
 }
 
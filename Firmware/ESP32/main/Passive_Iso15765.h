@@ -14,3 +14,8 @@
  * @retval True if successfuly processed
 */
 bool Passive_Iso15765_Parse(CanMessage cmsg);
+
+/**
+ * @brief Claim CAN IDs of ISO15765 in Passive_Can
+*/
+void Passive_Iso15765_Init(void);
@@ -0,0 +1,21 @@
+/*******************************************************************************
+ * @brief   Parsing of CAN messages into J1939 transport protocol (TP.CM / TP.DT)
+ ******************************************************************************
+ * @attention
+ ******************************************************************************  
+ */ 
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "CanIf.h"
+
+/**
+ * @brief Try to parse CAN as J1939 transport protocol
+ * @retval True if successfuly processed
+*/
+bool Passive_J1939_Parse(CanMessage cmsg);
+
+/**
+ * @brief Claim CAN IDs of TP.CM and TP.DT in Passive_Can
+*/
+void Passive_J1939_Init(void);
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <esp_log.h>
 #include "rtos_utils.h"
+#include "Clock.h"
 #include "System_stats.h"
 #include "Task_Tcp_Wireshark_Raw.h"
 
@@ -417,7 +418,7 @@ void Passive_Kline_Dequeue_Iso14230(uint32_t start, uint32_t end)
         framePos++;
     }
     Stats_KlineBytes_RxFrameAdd(1);
-    Task_Tcp_Wireshark_Raw_AddNewRawMessage(kline_frame, framePos, 0x00, GetTime_ms(), Raw_ISO14230);
+    Task_Tcp_Wireshark_Raw_AddNewRawMessage(kline_frame, framePos, 0x00, Clock_GetTime_us(), Raw_ISO14230);
     kline_buffer_end = 0;
 }
 
@@ -459,7 +460,7 @@ void Passive_Kline_Dequeue_Kw1281(uint32_t start, uint32_t end)
         length++;
     }
     Stats_KlineBytes_RxFrameAdd(1);
-    Task_Tcp_Wireshark_Raw_AddNewRawMessage(kline_frame, framePos, 0x00, GetTime_ms(), Raw_KW1281);
+    Task_Tcp_Wireshark_Raw_AddNewRawMessage(kline_frame, framePos, 0x00, Clock_GetTime_us(), Raw_KW1281);
     kline_buffer_end = 0;
 }
 
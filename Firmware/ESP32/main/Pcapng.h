@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * @brief   Building of pcapng blocks (SHB, IDB, EPB) for Wireshark stream
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+
+#ifndef PCAPNG_H
+#define PCAPNG_H
+
+#include <stdint.h>
+
+#define PCAPNG_LINKTYPE_RAW           0x65
+#define PCAPNG_LINKTYPE_FLEXRAY       0xD2
+#define PCAPNG_LINKTYPE_CAN_SOCKETCAN 0xE3
+
+#define PCAPNG_TSRESOL_US             6
+#define PCAPNG_TSRESOL_NS             9
+
+/**
+ * @brief Link layer errors which can be flagged in epb_flags
+ */
+#define PCAPNG_EPB_FLAG_CRC_ERROR     (1UL << 24)
+
+/**
+ * @brief Size of Section Header Block
+ */
+#define PCAPNG_SHB_LENGTH             28
+/**
+ * @brief Size of Interface Description Block with if_tsresol option
+ */
+#define PCAPNG_IDB_LENGTH             32
+/**
+ * @brief Max size of Enhanced Packet Block without packet data and comment
+ *        Header (8) + Body (20) + Padding (3) + Flags (8) + Comment header and padding (7) + End of options (4) + Length (4)
+ */
+#define PCAPNG_EPB_OVERHEAD           54
+
+/**
+ * @brief  Write Section Header Block into array
+ * @retval Amount of written bytes (PCAPNG_SHB_LENGTH)
+ */
+uint32_t Pcapng_SectionHeaderBlock(uint8_t* array);
+
+/**
+ * @brief  Write Interface Description Block into array. Interface ID is given by order of IDBs in the stream.
+ * @param  linkType: PCAPNG_LINKTYPE_ of packets on this interface
+ * @param  tsresol: Resolution of timestamps as negative power of 10
+ * @retval Amount of written bytes (PCAPNG_IDB_LENGTH)
+ */
+uint32_t Pcapng_InterfaceDescriptionBlock(uint8_t* array, uint16_t linkType, uint8_t tsresol);
+
+/**
+ * @brief  Write Enhanced Packet Block into array
+ * @param  array: Must have at least PCAPNG_EPB_OVERHEAD + length + strlen(comment) bytes
+ * @param  timestamp: Timestamp in resolution given by if_tsresol of the interface
+ * @param  flags: epb_flags, 0 if not used
+ * @param  comment: Packet comment, NULL if not used
+ * @retval Amount of written bytes
+ */
+uint32_t Pcapng_EnhancedPacketBlock(uint8_t* array, uint32_t interfaceId, uint64_t timestamp, uint8_t* packet, uint32_t length, uint32_t flags, const char* comment);
+
+#endif
@@ -114,6 +114,15 @@ void Stats_TCP_WS_RAW_State_Set(uint32_t state);
  */
 uint32_t Stats_TCP_WS_RAW_State_Get(void);
 
+/**
+ * @brief Set state of Wirehsark pcapng socket
+ */
+void Stats_TCP_WS_Pcapng_State_Set(uint32_t state);
+/**
+ * @brief Return state of Wirehsark pcapng socket
+ */
+uint32_t Stats_TCP_WS_Pcapng_State_Get(void);
+
 /**
  * @brief Set state of KLINE RAW socket
  */
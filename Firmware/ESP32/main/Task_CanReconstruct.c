@@ -11,11 +11,14 @@
 #include <esp_log.h>
 #include "Task_Tcp_SocketCAN.h"
 #include "Task_Tcp_Wireshark_Raw.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
 #include "System_stats.h"
 #include "rtos_utils.h"
 #include "CanIf.h"
 
+#include "Passive_Can.h"
 #include "Passive_Iso15765.h"
+#include "Passive_J1939.h"
 #include "Passive_Vwtp20.h"
 
 //******************************************************************************
@@ -34,6 +37,11 @@ void Task_CanReconstruct(void* pvParameters)
     //Create TCP server for Wireshark
     Task_Tcp_SocketCAN_Init();
     Task_Tcp_Wireshark_Raw_Init();
+    Task_Tcp_Wireshark_Pcapng_Init();
+    //Transport protocols claim CAN IDs they expect
+    Passive_Iso15765_Init();
+    Passive_Vwtp20_Init();
+    Passive_J1939_Init();
     for(;;)
     {
         ProcessCanElements();
@@ -57,17 +65,10 @@ static void ProcessCanElements(void)
     {
         Task_Tcp_SocketCAN_AddNewCanMessage(cmsg);
     }
-    if(Stats_TCP_WS_RAW_State_Get() != 0)
-    {
-        //Try to process CAN element in ISO15765 passive protocol
-        if(Passive_Iso15765_Parse(cmsg) == true)
-        {
-            return;
-        }
-        //Try to process CAN element in VWTP20 passive protocol
-        if(Passive_Vwtp20_Parse(cmsg) == true)
-        {
-            return;
-        }
-    }
+    //pcapng keeps history also without connection
+    Task_Tcp_Wireshark_Pcapng_AddNewCanMessage(cmsg);
+    
+    //Parsers run always, so datagrams are in history when Wireshark connects
+    //CAN element is passed only into protocol which has claimed its ID
+    Passive_Can_Parse(cmsg);
 }
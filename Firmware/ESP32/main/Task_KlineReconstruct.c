@@ -50,9 +50,6 @@ static void ProcessKlineElements(void)
         return;
     }
 
-    if(Stats_TCP_WS_RAW_State_Get() != 0)
-    {
-        //Try to process element in passive KLINE protocol
-        Passive_Kline_Parse(c);
-    }
+    //Parser runs always, so datagrams are in history when Wireshark connects
+    Passive_Kline_Parse(c);
 }
@@ -58,15 +58,14 @@ static void tcpswcan_prepare_header(CanMessage* cmsg, uint8_t* array)
   uint32_t timestamp_microseconds;
 
   //Prepare timestamp
-  timestamp_seconds = (uint32_t)(cmsg->Timestamp / 1000); //Only second part (I know there should be Unix time, but I am too lazy to get RTC or NTP working)
-  timestamp_microseconds = (uint32_t)(cmsg->Timestamp % 1000); //Only remainder from seconds
-  timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+  timestamp_seconds = (uint32_t)(cmsg->Timestamp / 1000000); //Unix time seconds
+  timestamp_microseconds = (uint32_t)(cmsg->Timestamp % 1000000); //Only remainder from seconds
   //Store timestamp
   *(uint32_t*)array = timestamp_seconds;
   *(uint32_t*)(array + 4) = timestamp_microseconds;
 }
 
-static void tcpswcan_prepare_body(CanMessage* cmsg, uint8_t* array)
+void Task_Tcp_SocketCAN_PreparePacket(CanMessage* cmsg, uint8_t* array)
 {
   array[0] = (uint8_t)(cmsg->Id >> 24);
   array[1] = (uint8_t)(cmsg->Id >> 16);
@@ -127,7 +126,7 @@ static void do_transmit(const int sock)
       }
 
       //Write packet data
-      tcpswcan_prepare_body(xcmsg, packetBody);
+      Task_Tcp_SocketCAN_PreparePacket(xcmsg, packetBody);
       if(netconn_write(sock, packetBody, 16) == false)
       {
         //Failed to write into TCP, connection probably closed
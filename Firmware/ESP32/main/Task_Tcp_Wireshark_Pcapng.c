@@ -0,0 +1,352 @@
+/*******************************************************************************
+ * @brief   Implementation of sending of SocketCAN and RAW packets into Wireshark
+ *          multiplexed in one pcapng stream. Every link layer has own interface.
+ *          Blocks are kept in history ring also without connection, new client
+ *          gets last seconds of traffic before live data.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include "System_stats.h"
+#include "Pcapng.h"
+#include "Task_Tcp_SocketCAN.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "Clock.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include <lwip/netdb.h>
+
+// -- Private Definitions -------------------------------
+#define TAG "Task_Tcp_Wireshark_Pcapng.c"
+
+#define PORT                        19003
+#define KEEPALIVE_IDLE              100
+#define KEEPALIVE_INTERVAL          100
+#define KEEPALIVE_COUNT             100
+
+//Interface IDs are given by order of IDBs sent after connection
+#define IF_SOCKETCAN                0
+#define IF_RAW                      1
+
+#define COMMENT_MAX_LENGTH          64
+
+#define HISTORY_SIZE_PSRAM          (1024 * 1024) //History ring in PSRAM
+#define HISTORY_SIZE_INTERNAL       (32 * 1024)   //History ring in internal RAM if there is no PSRAM
+#define HISTORY_TIME_US             (10 * 1000000ULL) //How old blocks are replayed to new client
+
+#define BLOCK_MAX_LENGTH            (PCAPNG_EPB_OVERHEAD + 4116 + COMMENT_MAX_LENGTH) //4096 of data + 20 bytes of IPv4 header
+
+// -- Private Variables ---------------------------------
+static uint8_t fileHeader[PCAPNG_SHB_LENGTH + 2 * PCAPNG_IDB_LENGTH];
+static uint8_t block[BLOCK_MAX_LENGTH];       //Block being added into history, guarded by xHistoryMutex
+static uint8_t packet[4116];                  //Packet being added into history, guarded by xHistoryMutex
+static uint8_t sendBuffer[BLOCK_MAX_LENGTH];  //Blocks copied from history for sending
+
+static uint8_t* history = NULL;     //Ring of serialized EPBs
+static uint32_t historySize = 0;
+static uint32_t historyHead = 0;    //Amount of bytes ever written, position of next block is historyHead % historySize
+static uint32_t historyTail = 0;    //Position of oldest block in history
+static SemaphoreHandle_t xHistoryMutex = NULL;
+
+static void history_copy_in(uint32_t position, const uint8_t* data, uint32_t length)
+{
+  uint32_t offset = position % historySize;
+  uint32_t first = historySize - offset;
+  if(first >= length)
+  {
+    memcpy(history + offset, data, length);
+  }
+  else
+  {
+    memcpy(history + offset, data, first);
+    memcpy(history, data + first, length - first);
+  }
+}
+
+static void history_copy_out(uint32_t position, uint8_t* data, uint32_t length)
+{
+  uint32_t offset = position % historySize;
+  uint32_t first = historySize - offset;
+  if(first >= length)
+  {
+    memcpy(data, history + offset, length);
+  }
+  else
+  {
+    memcpy(data, history + offset, first);
+    memcpy(data + first, history, length - first);
+  }
+}
+
+static uint32_t history_block_length(uint32_t position)
+{
+  uint32_t length;
+  history_copy_out(position + 4, (uint8_t*)&length, 4);
+  return length;
+}
+
+static uint64_t history_block_timestamp(uint32_t position)
+{
+  uint32_t timestamp[2]; //High and low part
+  history_copy_out(position + 12, (uint8_t*)timestamp, 8);
+  return ((uint64_t)timestamp[0] << 32) | timestamp[1];
+}
+
+/**
+ * @brief Move block prepared in block[] into history. Oldest blocks are overwritten.
+ *        Caller must hold xHistoryMutex.
+ */
+static void history_add(uint32_t length)
+{
+  while(historyHead - historyTail + length > historySize)
+  {
+    historyTail += history_block_length(historyTail);
+  }
+  history_copy_in(historyHead, block, length);
+  historyHead += length;
+}
+
+static bool netconn_write(const int sock, uint8_t* tx_buffer, int len)
+{
+  // send() can return less bytes than supplied length.
+  // Walk-around for robust implementation.
+  int to_write = len;
+  while (to_write > 0)
+  {
+    int written = send(sock, tx_buffer + (len - to_write), to_write, 0);
+    if (written < 0)
+    {
+      ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+      return false;
+    }
+    to_write -= written;
+  }
+  return true;
+}
+
+static void do_transmit(const int sock)
+{
+  uint32_t headerLength;
+  uint32_t sendLength;
+  uint32_t blockLength;
+  uint32_t cursor;
+  uint64_t since;
+
+  //Show on LCD that we have connection
+  Stats_TCP_WS_Pcapng_State_Set(1);
+  ESP_LOGI(TAG, "Connection established");
+
+  //Write section header and one interface per link layer to init Wireshark
+  headerLength = Pcapng_SectionHeaderBlock(fileHeader);
+  headerLength += Pcapng_InterfaceDescriptionBlock(fileHeader + headerLength, PCAPNG_LINKTYPE_CAN_SOCKETCAN, PCAPNG_TSRESOL_US);
+  headerLength += Pcapng_InterfaceDescriptionBlock(fileHeader + headerLength, PCAPNG_LINKTYPE_RAW, PCAPNG_TSRESOL_US);
+  if(netconn_write(sock, fileHeader, headerLength) == false)
+  {
+    return;
+  }
+
+  //Start with oldest block which is not older than HISTORY_TIME_US
+  since = Clock_GetTime_us();
+  since = since > HISTORY_TIME_US ? since - HISTORY_TIME_US : 0;
+  xSemaphoreTake(xHistoryMutex, portMAX_DELAY);
+  cursor = historyTail;
+  while(cursor != historyHead && history_block_timestamp(cursor) < since)
+  {
+    cursor += history_block_length(cursor);
+  }
+  ESP_LOGI(TAG, "Replaying %u bytes of history", (unsigned int)(historyHead - cursor));
+  xSemaphoreGive(xHistoryMutex);
+
+  while (1)
+  {
+    //Copy as many whole blocks as fits into send buffer
+    sendLength = 0;
+    xSemaphoreTake(xHistoryMutex, portMAX_DELAY);
+    if(historyHead - cursor > historyHead - historyTail)
+    {
+      //Blocks for this client were overwritten, continue with oldest one
+      cursor = historyTail;
+    }
+    while(cursor != historyHead)
+    {
+      blockLength = history_block_length(cursor);
+      if(sendLength + blockLength > sizeof(sendBuffer))
+      {
+        break;
+      }
+      history_copy_out(cursor, sendBuffer + sendLength, blockLength);
+      sendLength += blockLength;
+      cursor += blockLength;
+    }
+    xSemaphoreGive(xHistoryMutex);
+
+    if(sendLength == 0)
+    {
+      vTaskDelay(10);
+      continue;
+    }
+    if(netconn_write(sock, sendBuffer, sendLength) == false)
+    {
+      //Failed to write into TCP, connection probably closed
+      return;
+    }
+  }
+}
+
+static void tcpwspcapng_thread(void *pvParameters)
+{
+  char addr_str[128];
+  int addr_family = (int)pvParameters;
+  int ip_protocol = 0;
+  int keepAlive = 1;
+  int keepIdle = KEEPALIVE_IDLE;
+  int keepInterval = KEEPALIVE_INTERVAL;
+  int keepCount = KEEPALIVE_COUNT;
+  struct sockaddr_storage dest_addr;
+
+  if (addr_family == AF_INET)
+  {
+    struct sockaddr_in *dest_addr_ip4 = (struct sockaddr_in *)&dest_addr;
+    dest_addr_ip4->sin_addr.s_addr = htonl(INADDR_ANY);
+    dest_addr_ip4->sin_family = AF_INET;
+    dest_addr_ip4->sin_port = htons(PORT);
+    ip_protocol = IPPROTO_IP;
+  }
+
+  int listen_sock = socket(addr_family, SOCK_STREAM, ip_protocol);
+  if (listen_sock < 0)
+  {
+    ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+    vTaskDelete(NULL);
+    return;
+  }
+  int opt = 1;
+  setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+  ESP_LOGI(TAG, "Socket created");
+
+  int err = bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+  if (err != 0)
+  {
+    ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
+    ESP_LOGE(TAG, "IPPROTO: %d", addr_family);
+    goto CLEAN_UP;
+  }
+  ESP_LOGI(TAG, "Socket bound, port %d", PORT);
+
+  err = listen(listen_sock, 1);
+  if (err != 0)
+  {
+    ESP_LOGE(TAG, "Error occurred during listen: errno %d", errno);
+    goto CLEAN_UP;
+  }
+
+  while (1)
+  {
+    ESP_LOGI(TAG, "Socket listening");
+
+    struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
+    socklen_t addr_len = sizeof(source_addr);
+    int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+    if (sock < 0)
+    {
+      ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
+      break;
+    }
+
+    // Set tcp keepalive option
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
+
+    // Convert ip address to string
+    if (source_addr.ss_family == PF_INET)
+    {
+        inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
+    }
+
+    ESP_LOGI(TAG, "Socket accepted ip address: %s", addr_str);
+    do_transmit(sock);
+    ESP_LOGW(TAG, "Socket closed");
+    Stats_TCP_WS_Pcapng_State_Set(0);
+    shutdown(sock, 0);
+    close(sock);
+  }
+CLEAN_UP:
+    close(listen_sock);
+    vTaskDelete(NULL);
+}
+
+/*-----------------------------------------------------------------------------------*/
+
+void Task_Tcp_Wireshark_Pcapng_Init(void)
+{
+  //History is large, use PSRAM if module has it
+  history = heap_caps_malloc(HISTORY_SIZE_PSRAM, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  historySize = HISTORY_SIZE_PSRAM;
+  if(history == NULL)
+  {
+    history = heap_caps_malloc(HISTORY_SIZE_INTERNAL, MALLOC_CAP_8BIT);
+    historySize = HISTORY_SIZE_INTERNAL;
+  }
+  if(history == NULL)
+  {
+    ESP_LOGE(TAG, "Unable to allocate history");
+    return;
+  }
+  ESP_LOGI(TAG, "History of %u bytes", (unsigned int)historySize);
+  xHistoryMutex = xSemaphoreCreateMutex();
+  xTaskCreate(tcpwspcapng_thread, "tcpwspcapng_thread", 4096, (void*)AF_INET, tskIDLE_PRIORITY + 5, NULL);
+}
+
+void Task_Tcp_Wireshark_Pcapng_AddNewCanMessage(CanMessage cmsg)
+{
+  uint32_t blockLength;
+  if(xHistoryMutex == NULL)
+  {
+    return;
+  }
+  xSemaphoreTake(xHistoryMutex, portMAX_DELAY);
+  memset(packet, 0, 16);
+  Task_Tcp_SocketCAN_PreparePacket(&cmsg, packet);
+  blockLength = Pcapng_EnhancedPacketBlock(block, IF_SOCKETCAN, cmsg.Timestamp, packet, 16, 0, NULL);
+  history_add(blockLength);
+  xSemaphoreGive(xHistoryMutex);
+}
+
+void Task_Tcp_Wireshark_Pcapng_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment)
+{
+  RawMessage rmsg;
+  uint32_t packetLength;
+  uint32_t blockLength;
+  if(xHistoryMutex == NULL || length > 4096)
+  {
+    return;
+  }
+  if(comment != NULL && strlen(comment) > COMMENT_MAX_LENGTH)
+  {
+    comment = NULL;
+  }
+  rmsg.Frame = frame;
+  rmsg.Length = length;
+  rmsg.Id = id;
+  rmsg.Timestamp = timestamp;
+  rmsg.MessageType = msgType;
+
+  xSemaphoreTake(xHistoryMutex, portMAX_DELAY);
+  packetLength = Task_Tcp_Wireshark_Raw_PreparePacket(&rmsg, packet, 0);
+  blockLength = Pcapng_EnhancedPacketBlock(block, IF_RAW, timestamp, packet, packetLength, 0, comment);
+  history_add(blockLength);
+  xSemaphoreGive(xHistoryMutex);
+}
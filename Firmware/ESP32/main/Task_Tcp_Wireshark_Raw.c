@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include "System_stats.h"
 #include "Task_Tcp_Wireshark_Raw.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
 #include "string.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -53,9 +54,8 @@ static void tcpswraw_prepare_header(RawMessage* rmsg, uint8_t* array)
   uint32_t timestamp_microseconds;
 
   //Prepare timestamp
-  timestamp_seconds = (uint32_t)(rmsg->Timestamp / 1000); //Only second part (I know there should be Unix time, but I am too lazy to get RTC or NTP working)
-  timestamp_microseconds = (uint32_t)(rmsg->Timestamp % 1000); //Only remainder from seconds
-  timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+  timestamp_seconds = (uint32_t)(rmsg->Timestamp / 1000000); //Unix time seconds
+  timestamp_microseconds = (uint32_t)(rmsg->Timestamp % 1000000); //Only remainder from seconds
   //Store timestamp
   *(uint32_t*)array = timestamp_seconds;
   *(uint32_t*)(array + 4) = timestamp_microseconds;
@@ -65,7 +65,7 @@ static void tcpswraw_prepare_header(RawMessage* rmsg, uint8_t* array)
   *(uint32_t*)(array + 12) = rmsg->Length + 20;
 }
 
-static int tcpswraw_prepare_body(RawMessage* rmsg, uint8_t* array, uint16_t sequence)
+int Task_Tcp_Wireshark_Raw_PreparePacket(RawMessage* rmsg, uint8_t* array, uint16_t sequence)
 {
   int totalLength = rmsg->Length + 20;
   array[0] = 0x45; //Version 4, 5 words (5*4=20 bytes)
@@ -142,7 +142,7 @@ static void do_transmit(const int sock)
       }
 
       //Write packet data
-      packetBody_Lenght = tcpswraw_prepare_body(xrmsg, packetBody, 0);
+      packetBody_Lenght = Task_Tcp_Wireshark_Raw_PreparePacket(xrmsg, packetBody, 0);
       if(netconn_write(sock, packetBody, packetBody_Lenght) == false)
       {
         //Failed to write into TCP, connection probably closed
@@ -249,9 +249,16 @@ void Task_Tcp_Wireshark_Raw_Init(void)
   xTaskCreate(tcpwsraw_thread, "tcpwsraw_thread", 4096, (void*)AF_INET, tskIDLE_PRIORITY + 5, NULL);
 }
 
-void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint32_t timestamp, RawMessageType msgType)
+void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType)
 {
-	if(xRawMessageQueue == NULL)
+  Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(frame, length, id, timestamp, msgType, NULL);
+}
+
+void Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment)
+{
+  //Same datagram goes also into pcapng history
+  Task_Tcp_Wireshark_Pcapng_AddNewRawMessage(frame, length, id, timestamp, msgType, comment);
+	if(xRawMessageQueue == NULL || Stats_TCP_WS_RAW_State_Get() == 0)
   {
     return;
   }
@@ -269,5 +276,9 @@ void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, ui
 	
   //ESP_LOGW(TAG, "Before queue %x", (uint32_t)qRawMessage);
   //ESP_LOG_BUFFER_HEXDUMP(TAG, (uint8_t*)&qRawMessage, sizeof(RawMessage), ESP_LOG_INFO);
-  xQueueSend(xRawMessageQueue, ( void * ) &qRawMessage, (TickType_t)0);
+  if(xQueueSend(xRawMessageQueue, ( void * ) &qRawMessage, (TickType_t)0) != pdPASS)
+  {
+    vPortFree(qRawMessage->Frame);
+    vPortFree(qRawMessage);
+  }
 }
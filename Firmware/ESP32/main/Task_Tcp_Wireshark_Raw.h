@@ -4,6 +4,9 @@
  * @attention
  ******************************************************************************  
  */ 
+#ifndef TASK_TCP_WIRESHARK_RAW_H
+#define TASK_TCP_WIRESHARK_RAW_H
+
 #include <stdint.h>
 typedef enum RawMessageType
 {
@@ -11,6 +14,7 @@ typedef enum RawMessageType
   Raw_KW1281 = 0x92,
   Raw_VWTP20 = 0x93,
   Raw_ISO15765 = 0x94,
+  Raw_J1939 = 0x95,
   
   Raw_Debug = 0xFA,    //For Debug information (i.e. SWO output)
   Raw_Warning = 0xFB,
@@ -25,7 +29,7 @@ typedef struct RawMessage
 	uint8_t*  Frame;
 	uint32_t  Length;      //Length of received frame
 	uint32_t  Id;          //ID of received frame
-	uint32_t  Timestamp;
+	uint64_t  Timestamp;   //Unix time [us], see Clock.h
   RawMessageType MessageType;
 }RawMessage;
 
@@ -38,4 +42,17 @@ void Task_Tcp_Wireshark_Raw_Init(void);
 /**
  * @brief Adds new CAN message into a queue for sending
 */
-void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint32_t timestamp, RawMessageType msgType);
+void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType);
+
+/**
+ * @brief Adds new CAN message into a queue for sending. Comment is forwarded only into pcapng stream.
+ * @param comment: Static string (i.e. "SN gap") or NULL
+*/
+void Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment);
+
+/**
+ * @brief Write fake IPv4 header followed by frame into array
+ * @retval Amount of written bytes (20 + Length)
+*/
+int Task_Tcp_Wireshark_Raw_PreparePacket(RawMessage* rmsg, uint8_t* array, uint16_t sequence);
+#endif
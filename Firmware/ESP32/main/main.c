@@ -21,6 +21,7 @@
 #include "Task_CanReconstruct.h"
 #include "Task_KlineReconstruct.h"
 #include "wifi.h"
+#include "Clock.h"
 
 #define LED_GPIO 27
 
@@ -33,6 +34,8 @@ void app_main(void)
     gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
 
     Wifi_Init();
+    //Start SNTP, timestamps are in Unix time after first synchronization
+    Clock_Init();
 
     xTaskCreatePinnedToCore(Task_CanReconstruct, "ReconstructCAN", 4096, NULL, 8, NULL, tskNO_AFFINITY);
     xTaskCreatePinnedToCore(Task_KlineReconstruct, "ReconstructKLINE", 4096, NULL, 8, NULL, tskNO_AFFINITY);
@@ -62,6 +62,8 @@ void taskMainThread(void* argument)
 {
 	//Init timer (port.c has some retarded init, which does not work correctly)
 	SysTick_Config(configCPU_CLOCK_HZ / configTICK_RATE_HZ);
+	//Timestamps of CAN messages in micro seconds
+	Gpt_Us_Init();
 	Application();
 }
 
@@ -12,108 +12,106 @@
 #include "rtos_utils.h"
 //******************************************************************************
 
-static QueueHandle_t canMessage_RxQueue = NULL;
+#define CAN_TX_QUEUE_ITEMS 32
+
 static QueueHandle_t canMessage_TxQueue = NULL;
-static bool _stop;
+static TaskHandle_t _rxTask = NULL; //Task notified about received messages
+static volatile bool _stop = true;
+static uint32_t _txOverflow = 0; //Amount of messages dropped because TX queue was full
+
 /**
-* @brief  Thread in which we are refreshing CAN state machine
+* @brief  Called from CAN RX interrupt, wakes up task which is consuming messages
+*/
+static void CanDriver_RxIsr(void)
+{
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+	vTaskNotifyGiveFromISR(_rxTask, &higherPriorityTaskWoken);
+	portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/**
+* @brief  Thread in which we are transmitting queued CAN messages
+* @note   Task and its queue live for whole runtime, so O right after C can't meet task which is still leaving
 */
 void CanDriver_Task(void* arg)
 {
-	ErrorCodes canResult;
-	CanMessage canRxMsg;
-	CanMessage* canRxMsg_Queue;
-	CanMessage* canTxMsg;
-	_stop = false;
-	
-	//printf("CAN Driver task has started\n");
-    if (Can_Enable() != ERROR_OK)
+	CanMessage canTxMsg;
+	while(true)
 	{
-        printf("ERROR: Init of CAN peripheral has failed\r\n");
-    }
-	//Hold 32 messages max 
-  	canMessage_RxQueue = xQueueCreate( 32, sizeof( CanMessage* ) );
-	canMessage_TxQueue = xQueueCreate( 32, sizeof( CanMessage* ) );
-    while(_stop == false)
-    {
-		//Check RX messages
-        canResult = Can_Rx(&canRxMsg);
-	    if (canResult == ERROR_OK)
-	    {
-			//Copy cmsg into allocated qCanMessage and queue it
-    		canRxMsg_Queue = (CanMessage*)pvPortMalloc(sizeof(CanMessage));
-    		canRxMsg_Queue->Dlc = canRxMsg.Dlc;
-    		canRxMsg_Queue->Id = canRxMsg.Id;
-			canRxMsg_Queue->ID_Type = canRxMsg.ID_Type;
-			canRxMsg_Queue->RTR = CAN_TYPE_DATA;
-    		canRxMsg_Queue->Timestamp = canRxMsg.Timestamp;
-    		memcpy(canRxMsg_Queue->Frame, canRxMsg.Frame, canRxMsg.Dlc);
-    		xQueueSend(canMessage_RxQueue, ( void * ) &canRxMsg_Queue, (TickType_t)0);
-			//print received CAN message on USB
-			//printf("Received %x - %x [%x]\n", canRxMsg.Id, canRxMsg.Dlc, canRxMsg.Frame[0]);
-	    }
-		
-		//Check TX Queue
-    	if(xQueueReceive( canMessage_TxQueue, &(canTxMsg), ( TickType_t ) 0 ) == pdPASS)
-    	{
-			Can_Tx(canTxMsg);
-      		vPortFree(canTxMsg);
-    	}
-		taskYIELD();
-    }
-	vQueueDelete(canMessage_RxQueue);
-	vQueueDelete(canMessage_TxQueue);
-	vTaskDelete(NULL);
+		if(xQueueReceive(canMessage_TxQueue, &canTxMsg, portMAX_DELAY) == pdPASS && _stop == false)
+		{
+			Can_Tx(&canTxMsg);
+		}
+	}
 }
 
 void CanDriver_Start(void)
 {
-	xTaskCreate(CanDriver_Task, (const char*)"CAN Driver", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL);
+	//Messages are received in interrupt directly into ring of CanIf, caller is notified about them
+	_rxTask = xTaskGetCurrentTaskHandle();
+	Can_Rx_SetCallback(CanDriver_RxIsr);
+	if (Can_Enable() != ERROR_OK)
+	{
+		printf("ERROR: Init of CAN peripheral has failed\r\n");
+	}
+	if(canMessage_TxQueue == NULL)
+	{
+		//Hold 32 messages max, messages are copied into queue by value
+		canMessage_TxQueue = xQueueCreate(CAN_TX_QUEUE_ITEMS, sizeof(CanMessage));
+		xTaskCreate(CanDriver_Task, (const char*)"CAN Driver", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+	}
+	_stop = false;
 }
 
 void CanDriver_Stop(void)
 {
+	Can_Rx_SetCallback(NULL);
 	_stop = true;
+	//Messages queued before close are not sent after next open
+	if(canMessage_TxQueue != NULL)
+	{
+		xQueueReset(canMessage_TxQueue);
+	}
 }
 
 void CanDriver_Transmit(CanMessage cmsg)
 {
-	CanMessage* qCanMessage;
-	if(canMessage_TxQueue == NULL)
+	if(canMessage_TxQueue == NULL || _stop == true)
 	{
-    	return;
-  	}
-	//Copy cmsg into allocated qCanMessage and queue it
-    qCanMessage = (CanMessage*)pvPortMalloc(sizeof(CanMessage));
-    qCanMessage->Dlc = cmsg.Dlc;
-    qCanMessage->Id = cmsg.Id;
-	qCanMessage->ID_Type = cmsg.ID_Type;
-    qCanMessage->Timestamp = cmsg.Timestamp;
-    memcpy(qCanMessage->Frame, cmsg.Frame, cmsg.Dlc);
-    xQueueSend(canMessage_TxQueue, ( void * ) &qCanMessage, (TickType_t)0);
+		return;
+	}
+	if(xQueueSend(canMessage_TxQueue, (void*)&cmsg, (TickType_t)0) != pdPASS)
+	{
+		_txOverflow++;
+	}
 }
 
-bool CanDriver_Receive(CanMessage* cmsg)
+uint32_t CanDriver_RxOverflow_Get(void)
 {
-	CanMessage* xcmsg;
-	if(canMessage_TxQueue == NULL)
-	{
-    	return false;
-  	}
+	return Can_Rx_Overflow();
+}
+
+uint32_t CanDriver_TxOverflow_Get(void)
+{
+	return _txOverflow;
+}
 
-    if(xQueueReceive( canMessage_RxQueue, &(xcmsg), ( TickType_t ) 0 ) == pdPASS)
-    {
-		//Copy allocated xcmsg into user's cmsg, and free it
-		cmsg->Dlc = xcmsg->Dlc;
-    	cmsg->Id = xcmsg->Id;
-		cmsg->ID_Type = xcmsg->ID_Type;
-    	memcpy(cmsg->Frame, xcmsg->Frame, cmsg->Dlc);
-		//printf("Dequeued %x - %x [%x]", cmsg->Id, cmsg->Dlc, cmsg->Frame[0]);
-      	vPortFree(xcmsg);
-	  	return true;
-    }
-	else
+uint32_t CanDriver_ErrorFlags_Get(void)
+{
+	return Can_ErrorFlags_Get();
+}
+
+bool CanDriver_Receive(CanMessage* cmsg)
+{
+	if(_stop == true)
 	{
 		return false;
 	}
+	//Timestamp was set by interrupt
+	return Can_Rx(cmsg) == ERROR_OK;
+}
+
+bool CanDriver_Wait(uint32_t timeout_ms)
+{
+	return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) != 0;
 }
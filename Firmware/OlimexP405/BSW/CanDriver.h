@@ -3,23 +3,41 @@
 #include "CanIf.h"
 
 /**
-* @brief  Thread in which we are refreshing CAN state machine
+* @brief  Thread in which we are transmitting queued CAN messages
 */
 void CanDriver_Task(void* arg);
 /**
- * @brief Enqueue data for transmission
+ * @brief Enqueue copy of message for transmission
  */
 void CanDriver_Transmit(CanMessage cmsg);
 /**
- * @brief Get enqueued data.
+ * @brief Get message received and timestamped [us] by interrupt.
  * @return True if message was dequeued. False if there is no message available.
  */
 bool CanDriver_Receive(CanMessage* cmsg);
 /**
- * @brief Start CAN driver task
+ * @brief Block calling task until new message is received or timeout elapses
+ * @note  Only task which has called CanDriver_Start is notified
+ * @return True if task was woken up by received message
+ */
+bool CanDriver_Wait(uint32_t timeout_ms);
+/**
+ * @brief Amount of received messages lost because RX queue was full
+ */
+uint32_t CanDriver_RxOverflow_Get(void);
+/**
+ * @brief Amount of messages lost because TX queue was full
+ */
+uint32_t CanDriver_TxOverflow_Get(void);
+/**
+ * @brief Get and clear CAN error flags (CAN_FLAG_*) collected since last call
+ */
+uint32_t CanDriver_ErrorFlags_Get(void);
+/**
+ * @brief Enable CAN, TX task and its queue are created on first call. Calling task is notified about received messages.
 */
 void CanDriver_Start(void);
 /**
- * @brief Stop CAN driver task
+ * @brief Stop reception and transmission, pending TX messages are discarded. TX task stays waiting for next start.
 */
 void CanDriver_Stop(void);
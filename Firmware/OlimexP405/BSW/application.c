@@ -23,14 +23,20 @@
 #include "rtos_utils.h"
 //******************************************************************************
 
-#ifdef DEBUG_TRACE
+//snprintf, sscanf
 #include "stdio.h"
-#endif
 
-char _cmdRxPartialBuffer[128];
-char _cmd[2048];
+#define SLCAN_CMD_MAX_LENGTH    64
+#define HEX_INVALID             0xFF
+
+//Commands are collected across USB packets, one packet can hold several commands
+static uint8_t _usbRx[64];
+static char _cmd[SLCAN_CMD_MAX_LENGTH];
+static uint16_t _cmdLength = 0;
+static bool _cmdOverflow = false;
+static uint8_t hexdec[256]; //Value of hex character or HEX_INVALID
 bool working            = false;
-bool timestamp          = false;
+uint8_t timestamp       = 0; //One of TIMESTAMP_*
 bool cr                 = false;
 bool disp_cnt           = false;
 can_bitrate can_speed   = CAN_BITRATE_500K;
@@ -38,13 +44,63 @@ uint32_t msg_cnt_in     = 0;
 uint32_t msg_cnt_out    = 0;
 
 static uint8_t hexval[17] = "0123456789ABCDEF";
-static char command[32];
+static char command[48];
+
+/**
+ * @brief Timestamp appended after data of ASCII frame (command Zn)
+ *        Frames are stamped in CAN interrupt with micro second resolution
+ */
+#define TIMESTAMP_OFF           0 //Z0
+#define TIMESTAMP_MS            1 //Z1 LAWICEL, 4 hex digits of milliseconds, wraps after 60s
+#define TIMESTAMP_US32          2 //Z2 (NOT SPEC) 8 hex digits of micro seconds, wraps after ~71 minutes
+#define TIMESTAMP_US64          3 //Z3 (NOT SPEC) 16 hex digits of micro seconds since start
+
+/**
+ * @brief Binary mode (command B1) sends received frames as fixed records instead of ASCII
+ *        Record is 20 bytes, little endian:
+ *        [0] 0xAA sync, [1] flags, [2] DLC, [3] sequence, [4..7] timestamp [us], [8..11] CAN ID, [12..19] data
+ *        Responses on commands are sent between records as in ASCII mode
+ */
+#define BINARY_RECORD_SYNC      0xAA
+#define BINARY_RECORD_LENGTH    20
+#define BINARY_FLAG_EXT         0x01
+#define BINARY_FLAG_RTR         0x02
+#define BINARY_PACKET_SIZE      64 //Size of USB CDC packet
+#define BINARY_BUFFER_SIZE      (4 * BINARY_PACKET_SIZE)
+
+#define ASCII_RECORD_LENGTH     48 //Longest ASCII frame T12345678811223344556677880123456789ABCDEF\r
+
+//LAWICEL status flags
+#define STATUS_RX_FIFO_FULL     0x01
+#define STATUS_TX_FIFO_FULL     0x02
+#define STATUS_ERROR_WARNING    0x04
+#define STATUS_DATA_OVERRUN     0x08
+#define STATUS_ERROR_PASSIVE    0x20
+#define STATUS_ARBITRATION_LOST 0x40
+#define STATUS_BUS_ERROR        0x80
+
+bool binary                 = false;
+uint32_t usb_overflow       = 0; //Amount of writes which did not fit into USB buffer
+static uint32_t status_usb_overflow = 0; //Counters at last 'F' command
+static uint32_t status_rx_overflow = 0;
+static uint32_t status_tx_overflow = 0;
+static uint8_t binaryBuffer[BINARY_BUFFER_SIZE + BINARY_RECORD_LENGTH];
+static uint32_t binaryLength = 0;
+static uint8_t binarySequence = 0;
 
 void pars_slcancmd(char *buf, uint16_t bufSize);
-void send_canmsg(char *buf, bool rtr, bool ext);
+void slcan_receive(void);
+void slcan_ack(void);
+void slcan_nack(void);
+bool send_canmsg(char *buf, uint16_t bufSize, bool rtr, bool ext);
 void transfer_can2tty(void);
-void slcan_mask(char *buf);
-void slcan_filter(char *buf);
+void transfer_can2tty_binary(void);
+void binary_flush(void);
+bool slcan_write(uint8_t* data, uint32_t length);
+bool slcan_print(const char* text);
+void slcan_status(char *buf);
+bool slcan_mask(char *buf, uint16_t bufSize);
+bool slcan_filter(char *buf, uint16_t bufSize);
 void slcan_pwm(char *buf, int pwmChannel);
 
 /**
@@ -52,9 +108,6 @@ void slcan_pwm(char *buf, int pwmChannel);
 */
 void Application(void)
 {
-    uint16_t bufferRxPartialSize;
-    uint16_t cmdSize;
-    bool cmdReceived;
     int i;
     /* Initialize all configured peripherals */
     TM_USB_VCP_Init();
@@ -96,55 +149,117 @@ void Application(void)
 #ifdef DEBUG_TRACE
     //printf("SLCAN - Boot finished\r\n");
 #endif
-    cmdSize = 0;
+    //Lookup table for decoding of hex characters
+    memset(hexdec, HEX_INVALID, sizeof(hexdec));
+    for(i = 0; i < 10; i++)
+    {
+        hexdec['0' + i] = i;
+    }
+    for(i = 0; i < 6; i++)
+    {
+        hexdec['A' + i] = 10 + i;
+        hexdec['a' + i] = 10 + i;
+    }
+
     for(;;)
     {
-        taskYIELD();
-        //Get partial command buffer from USB
-		bufferRxPartialSize = TM_USB_VCP_Gets(_cmdRxPartialBuffer, 128);
-        if(bufferRxPartialSize != 0)
+        //Sleep until CAN message is received, USB is checked every tick
+        CanDriver_Wait(1);
+        //Parse all commands received from USB
+        slcan_receive();
+        if(binary)
+        {
+            //Deque RX queue and send data over VCP in full USB packets
+            transfer_can2tty_binary();
+        }
+        else
+        {
+            //Deque RX queue and send data over VCP
+            transfer_can2tty();
+        }
+    }
+}
+
+//----------------------------------------------------------------
+
+void slcan_receive(void)
+{
+    uint16_t length;
+    uint16_t i;
+    char c;
+    while((length = TM_USB_VCP_Read(_usbRx, sizeof(_usbRx))) > 0)
+    {
+        for(i = 0; i < length; i++)
         {
-            //Copy partial buffer into overal buffer
-            memcpy((_cmd + cmdSize), _cmdRxPartialBuffer, bufferRxPartialSize);
-            cmdSize += bufferRxPartialSize;
-            //Check if we have received all characters
-            cmdReceived = false;
-            for(i = 0; i<cmdSize; i++)
+            c = (char)_usbRx[i];
+            if(c == '\r' || c == '\n')
             {
-                if(_cmd[i] == '\n')
+                //Empty line (i.e. \n after \r) is ignored
+                if(_cmdOverflow)
                 {
-                    cmdReceived = true;
-                    cmdSize = i;
+                    binary_flush();
+                    slcan_nack();
                 }
+                else if(_cmdLength > 0)
+                {
+                    _cmd[_cmdLength] = '\0';
+                    //Response must not be written into middle of binary record
+                    binary_flush();
+                    pars_slcancmd(_cmd, _cmdLength);
+                }
+                _cmdLength = 0;
+                _cmdOverflow = false;
+            }
+            else if(_cmdLength < SLCAN_CMD_MAX_LENGTH - 1)
+            {
+                _cmd[_cmdLength++] = c;
             }
-            if(cmdReceived == true)
+            else
             {
-                //Loopback
-                //TM_USB_VCP_Puts(cmd);
-                pars_slcancmd(_cmd, cmdSize);
-                cmdSize = 0;
+                _cmdOverflow = true;
             }
         }
-        else
+    }
+} // slcan_receive()
+
+/**
+ * @brief Decode given amount of hex characters
+ * @return False if there is not enough characters or character is not hex
+ */
+static bool hex_parse(const char *buf, uint16_t bufSize, uint16_t offset, uint16_t digits, uint32_t *value)
+{
+    uint16_t i;
+    uint8_t d;
+    uint32_t v = 0;
+    if(offset + digits > bufSize)
+    {
+        return false;
+    }
+    for(i = 0; i < digits; i++)
+    {
+        d = hexdec[(uint8_t)buf[offset + i]];
+        if(d == HEX_INVALID)
         {
-            //Deque RX queue and send data over VCP
-            transfer_can2tty();
+            return false;
         }
+        v = (v << 4) | d;
     }
-}
+    *value = v;
+    return true;
+} // hex_parse()
 
 //----------------------------------------------------------------
 
 void slcan_ack()
 {
-    printf("\r");
+    slcan_write((uint8_t*)"\r", 1);
 } // slcan_ack()
 
 //----------------------------------------------------------------
 
 void slcan_nack()
 {
-    printf("\a");
+    slcan_write((uint8_t*)"\a", 1);
 } // slcan_nack()
 
 //----------------------------------------------------------------
@@ -166,29 +281,77 @@ void pars_slcancmd(char *buf, uint16_t bufSize)
       slcan_ack();
       break;
     case 't':               // SEND STD FRAME - i.e. t12323E00 = 0x123 [3E 00]
-      send_canmsg(buf,false,false);
-      slcan_ack();
+      if(send_canmsg(buf,bufSize,false,false))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
       break;
     case 'T':               // SEND EXT FRAME
-      send_canmsg(buf,false,true);
-      slcan_ack();
+      if(send_canmsg(buf,bufSize,false,true))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
       break;
     case 'r':               // SEND STD RTR FRAME
-      send_canmsg(buf,true,false);
-      slcan_ack();
+      if(send_canmsg(buf,bufSize,true,false))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
       break;
     case 'R':               // SEND EXT RTR FRAME
-      send_canmsg(buf,true,true);
-      slcan_ack();
+      if(send_canmsg(buf,bufSize,true,true))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
+      break;
+    case 'B':               // (NOT SPEC) BINARY MODE
+      switch (buf[1]) {
+        case '0':           // ASCII FRAMES
+          binary = false;
+          slcan_ack();
+          break;
+        case '1':           // BINARY RECORDS
+          binarySequence = 0;
+          binary = true;
+          slcan_ack();
+          break;
+        default:
+          slcan_nack();
+          break;
+      }
       break;
     case 'Z':               // ENABLE TIMESTAMPS
       switch (buf[1]) {
         case '0':           // TIMESTAMP OFF  
-          timestamp = false;
+          timestamp = TIMESTAMP_OFF;
           slcan_ack();
           break;
         case '1':           // TIMESTAMP ON
-          timestamp = true;
+          timestamp = TIMESTAMP_MS;
+          slcan_ack();
+          break;
+        case '2':           // (NOT SPEC) TIMESTAMP 32bit us
+          timestamp = TIMESTAMP_US32;
+          slcan_ack();
+          break;
+        case '3':           // (NOT SPEC) TIMESTAMP 64bit us
+          timestamp = TIMESTAMP_US64;
           slcan_ack();
           break;
         default:
@@ -197,12 +360,24 @@ void pars_slcancmd(char *buf, uint16_t bufSize)
       }
       break;
     case 'M':               ///set ACCEPTANCE CODE ACn REG
-      slcan_filter(buf);
-      slcan_ack();
+      if(slcan_filter(buf, bufSize))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
       break;
     case 'm':               // set ACCEPTANCE MASK AMn REG
-      slcan_mask(buf);
-      slcan_ack();
+      if(slcan_mask(buf, bufSize))
+      {
+        slcan_ack();
+      }
+      else
+      {
+        slcan_nack();
+      }
       break;
     case 's':               // CUSTOM CAN bit-rate
       slcan_nack();
@@ -264,79 +439,88 @@ void pars_slcancmd(char *buf, uint16_t bufSize)
       }
       break;
     case 'F':               // STATUS FLAGS
-      printf("F00");
+      slcan_status(buf);
       slcan_ack();
       break;
     case 'V':               // VERSION NUMBER
-      printf("V1234");
+      slcan_print("V1234");
       slcan_ack();
       break;
     case 'N':               // SERIAL NUMBER
-      printf("N2208");
+      slcan_print("N2208");
       slcan_ack();
       break;
     case 'h':               // (NOT SPEC) HELP SERIAL
-      printf("\n");
-      printf("mintynet.com - slcan stm32\n");
-      printf("\n");
-      printf("O\t=\tStart slcan\n");
-      printf("C\t=\tStop slcan\n");
-      printf("t\t=\tSend std frame\n");
-      printf("r\t=\tSend std rtr frame\n");
-      printf("T\t=\tSend ext frame\n");
-      printf("R\t=\tSend ext rtr frame\n");
-      printf("Z0\t=\tTimestamp Off\n");
-      printf("Z1\t=\tTimestamp On\n");
-      printf("snn\t=\tSpeed 0xnnk N/A\n");
-      printf("S0\t=\tSpeed 10k N/A\n");
-      printf("S1\t=\tSpeed 20k N/A\n");
-      printf("S2\t=\tSpeed 50k N/A\n");
-      printf("S3\t=\tSpeed 100k\n");
-      printf("S4\t=\tSpeed 125k\n");
-      printf("S5\t=\tSpeed 250k\n");
-      printf("S6\t=\tSpeed 500k\n");
-      printf("S7\t=\tSpeed 800k N/A\n");
-      printf("S8\t=\tSpeed 1000k\n");
-      printf("f\t=\tCAN ID filter\n");
-      printf("F\t=\tFlags N/A\n");
-      printf("N\t=\tSerial No\n");
-      printf("V\t=\tVersion\n");
-      printf("-----NOT SPEC-----\n");
-      printf("Gn\t=\tSet GPIO n\n");
-      printf("gn\t=\tReset GPIO n\n");
-      printf("P1f00005555d44 = PWM Channel 1, 5555Hz, 44 percent DC\n");
-      printf("h\t=\tHelp\n");
-      printf("CAN_SPEED:\t");
+      slcan_print("\n");
+      slcan_print("mintynet.com - slcan stm32\n");
+      slcan_print("\n");
+      slcan_print("O\t=\tStart slcan\n");
+      slcan_print("C\t=\tStop slcan\n");
+      slcan_print("t\t=\tSend std frame\n");
+      slcan_print("r\t=\tSend std rtr frame\n");
+      slcan_print("T\t=\tSend ext frame\n");
+      slcan_print("R\t=\tSend ext rtr frame\n");
+      slcan_print("Z0\t=\tTimestamp Off\n");
+      slcan_print("Z1\t=\tTimestamp On\n");
+      slcan_print("B0\t=\tASCII frames\n");
+      slcan_print("B1\t=\tBinary records\n");
+      slcan_print("snn\t=\tSpeed 0xnnk N/A\n");
+      slcan_print("S0\t=\tSpeed 10k N/A\n");
+      slcan_print("S1\t=\tSpeed 20k N/A\n");
+      slcan_print("S2\t=\tSpeed 50k N/A\n");
+      slcan_print("S3\t=\tSpeed 100k\n");
+      slcan_print("S4\t=\tSpeed 125k\n");
+      slcan_print("S5\t=\tSpeed 250k\n");
+      slcan_print("S6\t=\tSpeed 500k\n");
+      slcan_print("S7\t=\tSpeed 800k N/A\n");
+      slcan_print("S8\t=\tSpeed 1000k\n");
+      slcan_print("f\t=\tCAN ID filter\n");
+      slcan_print("F\t=\tFlags\n");
+      slcan_print("N\t=\tSerial No\n");
+      slcan_print("V\t=\tVersion\n");
+      slcan_print("-----NOT SPEC-----\n");
+      slcan_print("FC\t=\tLost frames USB, CAN\n");
+      slcan_print("Z2\t=\tTimestamp 32bit us\n");
+      slcan_print("Z3\t=\tTimestamp 64bit us\n");
+      slcan_print("Gn\t=\tSet GPIO n\n");
+      slcan_print("gn\t=\tReset GPIO n\n");
+      slcan_print("P1f00005555d44 = PWM Channel 1, 5555Hz, 44 percent DC\n");
+      slcan_print("h\t=\tHelp\n");
+      slcan_print("CAN_SPEED:\t");
       switch(can_speed) 
       {
         case CAN_BITRATE_100K:
-          printf("100");
+          slcan_print("100");
           break;
         case CAN_BITRATE_125K:
-          printf("125");
+          slcan_print("125");
           break;
         case CAN_BITRATE_250K:
-          printf("250");
+          slcan_print("250");
           break;
         case CAN_BITRATE_500K:
-          printf("500");
+          slcan_print("500");
           break;
         case CAN_BITRATE_1000K:
-          printf("1000");
+          slcan_print("1000");
           break;
         default:
           break;
       }
-      printf("kbps");
+      slcan_print("kbps");
       if (timestamp) 
       {
-        printf("\tT");
+        slcan_print("\tT");
+      }
+      if (binary) 
+      {
+        slcan_print("\tB");
       }
       if (working) 
       {
-        printf("\tON");
+        slcan_print("\tON");
       } else {
-        printf("\tOFF");
+        slcan_print("\tOFF");
       }
       slcan_ack();
       break;
@@ -424,9 +608,9 @@ void transfer_can2tty(void)
   int i;
   CanMessage rx_frame;
   int cOff;
-  long time_now = 0;
-  //receive next CAN frame from queue
-  if(CanDriver_Receive(&rx_frame)==true) 
+  uint64_t time_now;
+  //Drain whole RX ring, frames stay in ring while USB has no space for them
+  while(TM_USB_VCP_TxFree() >= ASCII_RECORD_LENGTH && CanDriver_Receive(&rx_frame)==true) 
   {
     //do stuff!
     if(working) 
@@ -472,17 +656,24 @@ void transfer_can2tty(void)
             command[cOff++] = hexval[ rx_frame.Frame[i]>>4 ];
             command[cOff++] = hexval[ rx_frame.Frame[i]&15 ];
         }
-        if (timestamp) 
+        if (timestamp == TIMESTAMP_MS) 
         {
-            time_now =  GetTime_ms() % 60000;
+            time_now = (rx_frame.Timestamp / 1000) % 60000;
             command[cOff++] = hexval[ (time_now>>12)&15 ];
             command[cOff++] = hexval[ (time_now>>8)&15 ];
             command[cOff++] = hexval[ (time_now>>4)&15 ];
             command[cOff++] = hexval[ time_now&15 ];
         }
+        else if (timestamp != TIMESTAMP_OFF) 
+        {
+            time_now = rx_frame.Timestamp;
+            for(i = timestamp == TIMESTAMP_US32 ? 28 : 60; i >= 0; i -= 4)
+            {
+                command[cOff++] = hexval[ (time_now>>i)&15 ];
+            }
+        }
         command[cOff++] = '\r';
-        command[cOff++] = '\0';
-        printf(command);
+        slcan_write((uint8_t*)command, cOff);
         msg_cnt_in++;
     }
   }
@@ -490,97 +681,197 @@ void transfer_can2tty(void)
 
 //----------------------------------------------------------------
 
-void send_canmsg(char *buf, bool rtr, bool ext) 
+bool slcan_write(uint8_t* data, uint32_t length)
+{
+  //Write directly into CDC buffer, without stdio. Count what does not fit.
+  if(TM_USB_VCP_Write(data, length) != TM_USB_VCP_OK)
+  {
+    usb_overflow++;
+    return false;
+  }
+  return true;
+} // slcan_write()
+
+bool slcan_print(const char* text)
+{
+  return slcan_write((uint8_t*)text, strlen(text));
+} // slcan_print()
+
+void slcan_status(char *buf)
+{
+  int i;
+  uint8_t flags = 0;
+  uint32_t rx_overflow = CanDriver_RxOverflow_Get();
+  uint32_t tx_overflow = CanDriver_TxOverflow_Get();
+  uint32_t can_flags;
+  if(buf[1] == 'C')
+  {
+    // (NOT SPEC) FCuuuuuuuurrrrrrrr = writes lost on USB, frames lost in CAN RX queue
+    command[0] = 'F';
+    command[1] = 'C';
+    for(i = 0; i < 8; i++)
+    {
+      command[2 + i] = hexval[(usb_overflow >> (28 - i * 4)) & 15];
+      command[10 + i] = hexval[(rx_overflow >> (28 - i * 4)) & 15];
+    }
+    slcan_write((uint8_t*)command, 18);
+    return;
+  }
+  //Flags are set when something was lost or error occurred since last 'F'
+  can_flags = CanDriver_ErrorFlags_Get();
+  if(rx_overflow != status_rx_overflow)
+  {
+    flags |= STATUS_RX_FIFO_FULL;
+  }
+  if(tx_overflow != status_tx_overflow)
+  {
+    flags |= STATUS_TX_FIFO_FULL;
+  }
+  if(can_flags & CAN_FLAG_ERROR_WARNING)
+  {
+    flags |= STATUS_ERROR_WARNING;
+  }
+  if(usb_overflow != status_usb_overflow || (can_flags & CAN_FLAG_RX_OVERRUN))
+  {
+    flags |= STATUS_DATA_OVERRUN;
+  }
+  if(can_flags & CAN_FLAG_ERROR_PASSIVE)
+  {
+    flags |= STATUS_ERROR_PASSIVE;
+  }
+  if(can_flags & CAN_FLAG_ARBITRATION_LOST)
+  {
+    flags |= STATUS_ARBITRATION_LOST;
+  }
+  //LAWICEL has no bus off flag, it is the worst case of bus error
+  if(can_flags & (CAN_FLAG_BUS_ERROR | CAN_FLAG_BUS_OFF))
+  {
+    flags |= STATUS_BUS_ERROR;
+  }
+  status_rx_overflow = rx_overflow;
+  status_tx_overflow = tx_overflow;
+  status_usb_overflow = usb_overflow;
+  command[0] = 'F';
+  command[1] = hexval[flags >> 4];
+  command[2] = hexval[flags & 15];
+  slcan_write((uint8_t*)command, 3);
+} // slcan_status()
+
+void binary_flush(void)
+{
+  if(binaryLength > 0)
+  {
+    slcan_write(binaryBuffer, binaryLength);
+    binaryLength = 0;
+  }
+} // binary_flush()
+
+void transfer_can2tty_binary(void)
+{
+  CanMessage rx_frame;
+  uint8_t* record;
+  uint32_t packets;
+  //Drain whole RX queue, records are sent in full USB packets
+  //Leave frames in queue while USB has no space for whole buffer
+  while(TM_USB_VCP_TxFree() >= sizeof(binaryBuffer) && CanDriver_Receive(&rx_frame)==true) 
+  {
+    if(!working) 
+    {
+      continue;
+    }
+    record = binaryBuffer + binaryLength;
+    record[0] = BINARY_RECORD_SYNC;
+    record[1] = 0;
+    if(rx_frame.ID_Type==CAN_ID_TYPE_EXT) 
+    {
+      record[1] |= BINARY_FLAG_EXT;
+    }
+    if(rx_frame.RTR==CAN_TYPE_REMOTE) 
+    {
+      record[1] |= BINARY_FLAG_RTR;
+    }
+    record[2] = rx_frame.Dlc;
+    record[3] = binarySequence++;
+    *(uint32_t*)(record + 4) = (uint32_t)rx_frame.Timestamp;
+    *(uint32_t*)(record + 8) = rx_frame.Id;
+    memset(record + 12, 0, 8);
+    memcpy(record + 12, rx_frame.Frame, rx_frame.Dlc);
+    binaryLength += BINARY_RECORD_LENGTH;
+    msg_cnt_in++;
+
+    //Send full packets, keep the rest for next record
+    if(binaryLength >= BINARY_BUFFER_SIZE)
+    {
+      packets = binaryLength / BINARY_PACKET_SIZE;
+      slcan_write(binaryBuffer, packets * BINARY_PACKET_SIZE);
+      binaryLength -= packets * BINARY_PACKET_SIZE;
+      memmove(binaryBuffer, binaryBuffer + packets * BINARY_PACKET_SIZE, binaryLength);
+    }
+  }
+  //Bus is quiet, send the rest so frames are not delayed
+  binary_flush();
+} // transfer_can2tty_binary()
+
+//----------------------------------------------------------------
+
+bool send_canmsg(char *buf, uint16_t bufSize, bool rtr, bool ext) 
 {
     int i;
-    uint32_t msg_id = 0;
-    uint32_t msg_ide = 0;
-    uint32_t msg_len = 0;
-    uint32_t candata = 0;
+    uint16_t idDigits = ext ? 8 : 3;
+    uint32_t msg_id;
+    uint32_t msg_len;
+    uint32_t candata;
     CanMessage tx_frame;
-    if (working) 
+    if (!working) 
     {
-        if (rtr) 
-        {
-            if (ext) 
-            {
-                sscanf(&buf[1], "%04x%04x", &msg_ide, &msg_id);
-                tx_frame.RTR = CAN_TYPE_REMOTE;
-                tx_frame.ID_Type = CAN_ID_TYPE_EXT;
-            }
-            else 
-            {
-                sscanf(&buf[1], "%03x", &msg_id);
-                tx_frame.RTR = CAN_TYPE_REMOTE;
-                tx_frame.ID_Type = CAN_ID_TYPE_STD;
-            }
-        }
-        else 
-        {
-            if (ext) 
-            {
-                sscanf(&buf[1], "%04x%04x", &msg_ide, &msg_id);
-
-                tx_frame.RTR = CAN_TYPE_DATA;
-                tx_frame.ID_Type = CAN_ID_TYPE_EXT;
-            }
-            else 
-            {
-                sscanf(&buf[1], "%03x", &msg_id);
-                tx_frame.RTR = CAN_TYPE_DATA;
-                tx_frame.ID_Type = CAN_ID_TYPE_STD;
-            }
-        }
-        tx_frame.Id = (msg_ide << 16) + msg_id;
-        if (ext) 
-        {
-            sscanf(&buf[9], "%01x", &msg_len);
-        }
-        else 
-        {
-            sscanf(&buf[4], "%01x", &msg_len);
-        }
-        tx_frame.Dlc = msg_len;        
-        if (ext) 
-        {
-            for (i = 0; i < msg_len; i++) 
-            {
-                sscanf(&buf[10 + (i*2)], "%02x", &candata);
-                tx_frame.Frame[i] = (uint8_t)candata;
-            }
-        }
-        else 
+        return false;
+    }
+    //tiiildd.. or Tiiiiiiiildd..
+    if (!hex_parse(buf, bufSize, 1, idDigits, &msg_id) || !hex_parse(buf, bufSize, 1 + idDigits, 1, &msg_len) || msg_len > 8)
+    {
+        return false;
+    }
+    tx_frame.Id = msg_id;
+    tx_frame.Dlc = msg_len;
+    tx_frame.RTR = rtr ? CAN_TYPE_REMOTE : CAN_TYPE_DATA;
+    tx_frame.ID_Type = ext ? CAN_ID_TYPE_EXT : CAN_ID_TYPE_STD;
+    if (!rtr) 
+    {
+        for (i = 0; i < msg_len; i++) 
         {
-            for (i = 0; i < msg_len; i++) 
+            if (!hex_parse(buf, bufSize, 2 + idDigits + (i*2), 2, &candata))
             {
-                sscanf(&buf[5 + (i*2)], "%02x", &candata);
-                tx_frame.Frame[i] = (uint8_t)candata;
+                return false;
             }
+            tx_frame.Frame[i] = (uint8_t)candata;
         }
-        CanDriver_Transmit(tx_frame);
-        msg_cnt_out++;
     }
+    CanDriver_Transmit(tx_frame);
+    msg_cnt_out++;
+    return true;
 } // send_canmsg()
 
-void slcan_mask(char *buf)
+bool slcan_mask(char *buf, uint16_t bufSize)
 {
     uint32_t mask;
-    uint32_t maskM;
-    uint32_t maskL;
-    sscanf(&buf[1], "%04x%04x", &maskM, &maskL);
-    mask = (maskM << 16) + maskL;
+    if (!hex_parse(buf, bufSize, 1, 8, &mask))
+    {
+        return false;
+    }
     //printf("Set Mask to %x", mask);
     Can_Mask(mask);
+    return true;
 }
-void slcan_filter(char *buf)
+bool slcan_filter(char *buf, uint16_t bufSize)
 {
     uint32_t filter;
-    uint32_t filterM;
-    uint32_t filterL;
-    sscanf(&buf[1], "%04x%04x", &filterM, &filterL);
-    filter = (filterM << 16) + filterL;
+    if (!hex_parse(buf, bufSize, 1, 8, &filter))
+    {
+        return false;
+    }
     //printf("Set Filter to %x", filter);
     Can_Filter(filter);
+    return true;
 }
 
 void slcan_pwm(char *buf, int pwmChannel)
@@ -594,7 +885,8 @@ void slcan_pwm(char *buf, int pwmChannel)
   freq = (valM * 10000) + valL;
   sscanf(&buf[12], "%02d", &valM);
   dc = valM * 10;
-  printf("Set PWM ch%d %dHz %d DC", pwmChannel, freq, dc);
+  snprintf(command, sizeof(command), "Set PWM ch%d %dHz %d DC", pwmChannel, (int)freq, (int)dc);
+  slcan_print(command);
   Pwm_Enable(PWM_CHANNEL_01, freq, dc, dc);
 }
 //----------------------------------------------------------------
@@ -23,6 +23,16 @@
 */
 #define CAN_BUFFER_ITEMS 128
 
+/**
+* @brief Error flags collected by CAN interrupts, see Can_ErrorFlags_Get
+*/
+#define CAN_FLAG_RX_OVERRUN        0x01 //Message was lost in hardware FIFO before interrupt has read it
+#define CAN_FLAG_ERROR_WARNING     0x02 //Error counter has reached warning limit (96)
+#define CAN_FLAG_ERROR_PASSIVE     0x04 //Error counter is above 127
+#define CAN_FLAG_BUS_OFF           0x08 //Transmit error counter is above 255
+#define CAN_FLAG_ARBITRATION_LOST  0x10 //Transmitted message has lost arbitration
+#define CAN_FLAG_BUS_ERROR         0x20 //Stuff, form, ACK, bit or CRC error was detected
+
 typedef enum
 {
     CAN_TYPE_DATA,   //Data frame
@@ -45,7 +55,7 @@ typedef struct CanMessage
 	uint8_t   Frame[8]; //1-8 received bytes in CAN message
 	uint8_t   Dlc;      //Length of received frame
 	uint32_t  Id;       //ID of received frame
-    uint64_t  Timestamp; //Timestamp in miliseconds
+    uint64_t  Timestamp; //Timestamp in microseconds
 }CanMessage;
 
 /**
@@ -79,6 +89,23 @@ typedef enum {
 */
 ErrorCodes Can_Rx(CanMessage *canMsg);
 
+/**
+* @brief  Amount of received messages dropped because buffer was full
+*/
+uint32_t Can_Rx_Overflow(void);
+
+/**
+* @brief  Get error flags (CAN_FLAG_*) which were set since last call and clear them
+* @note   Error warning, error passive and bus off are also returned while the state lasts
+*/
+uint32_t Can_ErrorFlags_Get(void);
+
+/**
+* @brief  Register function called from RX interrupt after new message was added into buffer
+* @param  callback: Function or NULL
+*/
+void Can_Rx_SetCallback(void (*callback)(void));
+
 /**
 * @brief  Transmit message onto CAN bus
 * @param  canMsg: Strucutre, where transmitted CAN message is written
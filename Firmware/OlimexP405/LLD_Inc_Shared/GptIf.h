@@ -13,14 +13,14 @@
 #include "ErrorCodes.h"
 
 /**
-  * @brief  Configures TIM2 as free falling timer with period of 100us
+  * @brief  Configures TIM2 as free running counter of micro seconds
   * @retval None
   */
-ErrorCodes Gpt_100us_Init(void);
+ErrorCodes Gpt_Us_Init(void);
 
 /**
-  * @brief  Get elapsed time in micro seconds since Gpt_100us_Init() was called.
-  * @param  microSecs time in micro seconds aligned in 100us
-  * @retval None
+  * @brief  Get elapsed time in micro seconds since Gpt_Us_Init() was called.
+  * @note   Can be called also from interrupt
+  * @retval Time in micro seconds, does not overflow
   */
-ErrorCodes Gpt_100us_GetTime(uint64_t* microSecs);
+uint64_t Gpt_Us_GetTime(void);
@@ -147,7 +147,7 @@ Data -		PB14
  * @note   Increase this value if you need more memory for VCP receive data
  */
 #ifndef USB_VCP_RECEIVE_BUFFER_LENGTH
-#define USB_VCP_RECEIVE_BUFFER_LENGTH		128
+#define USB_VCP_RECEIVE_BUFFER_LENGTH		2048
 #endif
 
 /**
@@ -259,6 +259,14 @@ TM_USB_VCP_Result TM_USB_VCP_Putc(volatile char c);
  */
 uint16_t TM_USB_VCP_Gets(char* buffer, uint16_t bufsize);
 
+/**
+ * @brief  Reads all received data from VCP port without waiting for end of line
+ * @param  *buffer: Pointer to buffer where data are copied
+ * @param  bufsize: Maximum amount of bytes to read
+ * @retval Number of bytes copied into buffer, 0 when nothing was received
+ */
+uint16_t TM_USB_VCP_Read(uint8_t* buffer, uint16_t bufsize);
+
 /**
  * @brief  Puts string to USB VCP
  * @param  *str: Pointer to string variable
@@ -274,6 +282,21 @@ TM_USB_VCP_Result TM_USB_VCP_Puts(char* str);
  */
 TM_USB_VCP_Result TM_USB_VCP_Send(uint8_t* DataArray, uint32_t Length);
 
+/**
+ * @brief  Writes array of data into USB VCP buffer only if whole array fits in
+ * @param  *DataArray: Pointer to 8-bit data array to be sent over USB
+ * @param  Length: Number of elements to sent in units of bytes
+ * @retval TM_USB_VCP_OK: Data were written
+ *         TM_USB_VCP_ERROR: Not enough space, nothing was written
+ */
+TM_USB_VCP_Result TM_USB_VCP_Write(uint8_t* DataArray, uint32_t Length);
+
+/**
+ * @brief  Gets free space in USB VCP transmit buffer
+ * @retval Amount of bytes which can be written without overwriting of unsent data
+ */
+uint32_t TM_USB_VCP_TxFree(void);
+
 /**
  * @brief  Gets VCP status
  * @param  None
@@ -9,7 +9,9 @@
 */ 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "CanIf.h"
+#include "GptIf.h"
 #include "stm32f4xx_gpio.h"
 #include "stm32f4xx_rcc.h"
 #include "stm32f4xx_can.h"
@@ -20,10 +22,13 @@
 #endif
 
 /* Private variables ---------------------------------------------------------*/
-int canFifo0_readPtr = 0;   //Pointer where we are starting with reading
-int canFifo0_writePtr = 0;  //Pointer where we are starting with writing
-bool flagOverflow0 = false; //Overflow flag
+//Ring is written only by RX interrupt and read only by Can_Rx, so it does not need any lock
+volatile int canFifo0_readPtr = 0;   //Pointer where we are starting with reading
+volatile int canFifo0_writePtr = 0;  //Pointer where we are starting with writing
+volatile uint32_t canFifo0_overflow = 0; //Amount of messages dropped because ring was full
 struct CanMessage canMessageFifo0[CAN_BUFFER_ITEMS]; //FIFO buffer with received CAN messages for user
+static void (*canRxCallback)(void) = NULL; //Called from RX interrupt after message was added
+static volatile uint32_t canErrorFlags = 0; //CAN_FLAG_* set by interrupts, cleared by Can_ErrorFlags_Get
 
 ErrorCodes canLastError;
 
@@ -37,6 +42,14 @@ uint32_t _filter;
 static ErrorCodes Can_ResetFifo_0(void);
 static void Can_WaitReady (CAN_TypeDef* CANx);
 
+//Flags are set from interrupts of different priority and from task, keep read-modify-write atomic
+static void Can_ErrorFlags_Set(uint32_t flags)
+{
+    __disable_irq();
+    canErrorFlags |= flags;
+    __enable_irq();
+}
+
 /**
  * @brief Set Mask/Filter
 */
@@ -57,18 +70,10 @@ void Can_Filter(uint32_t filter)
 * @param  canMsg: Strucutre, where received CAN message will be written
 * @retval ERROR_OK: Received data are written in provided variables
 *         CAN_ERROR_DATA_EMPTY: In buffer are no data available
-*         CAN_ERROR_DATA_OVERFLOW: No data in buffer because pointers were reset
 */
 ErrorCodes Can_Rx(CanMessage *canMsg)
 {
-    //If buffer has overflow, reset pointers in FIFO
-    if (flagOverflow0 == true)
-    {
-        Can_ResetFifo_0();
-        return ERROR_DATA_OVERFLOW;
-    }
-
-    //If pointers are same before reading and without buffer overflow flag, then buffer is empty
+    //If pointers are same before reading, then buffer is empty
     if (canFifo0_writePtr == canFifo0_readPtr)
     {
         return ERROR_DATA_EMPTY;
@@ -89,12 +94,44 @@ ErrorCodes Can_Rx(CanMessage *canMsg)
 
 ErrorCodes Can_ResetFifo_0()
 {
-    canFifo0_readPtr = 0;
-    canFifo0_writePtr = 0;
-    flagOverflow0 = false;
+    canFifo0_readPtr = canFifo0_writePtr;
     return ERROR_OK;
 }
 
+uint32_t Can_Rx_Overflow(void)
+{
+    return canFifo0_overflow;
+}
+
+uint32_t Can_ErrorFlags_Get(void)
+{
+    uint32_t flags;
+    uint32_t esr = BOARD_CAN_IF->ESR;
+    __disable_irq();
+    flags = canErrorFlags;
+    canErrorFlags = 0;
+    __enable_irq();
+    //States are reported also when no new interrupt came since last call
+    if (esr & CAN_ESR_EWGF)
+    {
+        flags |= CAN_FLAG_ERROR_WARNING;
+    }
+    if (esr & CAN_ESR_EPVF)
+    {
+        flags |= CAN_FLAG_ERROR_PASSIVE;
+    }
+    if (esr & CAN_ESR_BOFF)
+    {
+        flags |= CAN_FLAG_BUS_OFF;
+    }
+    return flags;
+}
+
+void Can_Rx_SetCallback(void (*callback)(void))
+{
+    canRxCallback = callback;
+}
+
 ErrorCodes Can_Tx_State(void)
 {
     ErrorCodes status;
@@ -167,6 +204,11 @@ ErrorCodes Can_Tx(CanMessage* txMsg)
     
     //Wait until Transmit Message box 0 is ready
     Can_WaitReady(BOARD_CAN_IF);
+    //Result of previous transmission is valid until next request
+    if (BOARD_CAN_IF->TSR & CAN_TSR_ALST0)
+    {
+        Can_ErrorFlags_Set(CAN_FLAG_ARBITRATION_LOST);
+    }
     canLastError = ERROR_OK; //Remove last error from CAN
     //Transmit message only on mailbox 0
     if(CAN_Transmit_Mailbox0(BOARD_CAN_IF,&TxMessage) == CAN_TxStatus_NoMailBox )
@@ -340,17 +382,18 @@ ErrorCodes Can_Enable(void)
     CAN_FilterInitStructure.CAN_FilterActivation = ENABLE;
     CAN_FilterInit(CAN1, &CAN_FilterInitStructure);
   
-    // Enable FIFO 0 message pending Interrupt 
-    CAN_ITConfig(CAN1, CAN_IT_FMP0, ENABLE);
+    // Enable FIFO 0 message pending and overrun Interrupt 
+    CAN_ITConfig(CAN1, CAN_IT_FMP0 | CAN_IT_FOV0, ENABLE);
   
     // Enable the CAN1 gloabal Interrupt 
     NVIC_InitStructure.NVIC_IRQChannel = CAN1_RX0_IRQn;
-    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    //Callback can use FreeRTOS FromISR API, priority can't be higher than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 5;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 13;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
     
-    CAN_ITConfig(CAN1, CAN_IT_LEC | CAN_IT_ERR, ENABLE);
+    CAN_ITConfig(CAN1, CAN_IT_LEC | CAN_IT_EWG | CAN_IT_EPV | CAN_IT_BOF | CAN_IT_ERR, ENABLE);
     NVIC_InitStructure.NVIC_IRQChannel = CAN1_SCE_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 13;
@@ -493,17 +536,18 @@ ErrorCodes Can_Enable(void)
     CAN_FilterInitStructure.CAN_FilterActivation = ENABLE;
     CAN_FilterInit(CAN1, &CAN_FilterInitStructure);
   
-    // Enable FIFO 0 message pending Interrupt 
-    CAN_ITConfig(CAN1, CAN_IT_FMP0, ENABLE);
+    // Enable FIFO 0 message pending and overrun Interrupt 
+    CAN_ITConfig(CAN1, CAN_IT_FMP0 | CAN_IT_FOV0, ENABLE);
   
     // Enable the CAN1 gloabal Interrupt 
     NVIC_InitStructure.NVIC_IRQChannel = CAN1_RX0_IRQn;
-    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    //Callback can use FreeRTOS FromISR API, priority can't be higher than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 5;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 13;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
-    CAN_ITConfig(CAN1, CAN_IT_LEC | CAN_IT_ERR, ENABLE);
+    CAN_ITConfig(CAN1, CAN_IT_LEC | CAN_IT_EWG | CAN_IT_EPV | CAN_IT_BOF | CAN_IT_ERR, ENABLE);
     NVIC_InitStructure.NVIC_IRQChannel = CAN1_SCE_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 13;
@@ -517,8 +561,18 @@ void CAN1_RX0_IRQHandler (void)
 {
     CanRxMsg RxMessage;
     int i;
+    int nextWritePtr;
     uint32_t canId;
     CanIdType cIdType;
+    //Stamp message as soon as possible
+    uint64_t timestamp = Gpt_Us_GetTime();
+    
+    if(CAN_GetITStatus(BOARD_CAN_IF, CAN_IT_FOV0) == SET)
+    {
+        //Hardware FIFO was full, message was lost before we got here
+        Can_ErrorFlags_Set(CAN_FLAG_RX_OVERRUN);
+        CAN_ClearITPendingBit(BOARD_CAN_IF, CAN_IT_FOV0);
+    }
     
     //Check if message is pending for FIFO0
     if(CAN_GetITStatus(BOARD_CAN_IF, CAN_IT_FMP0) == RESET) 
@@ -530,9 +584,15 @@ void CAN1_RX0_IRQHandler (void)
     CAN_Receive(BOARD_CAN_IF,CAN_FIFO0, &RxMessage);
     
     //Save received CAN message to FIFO buffer
-    //Ignore any new message when buffer has overflown
-    if (flagOverflow0 == true)
+    //Drop new message when buffer is full, messages already in buffer are kept
+    nextWritePtr = canFifo0_writePtr + 1;
+    if (nextWritePtr >= CAN_BUFFER_ITEMS)
+    {
+        nextWritePtr = 0;
+    }
+    if (nextWritePtr == canFifo0_readPtr)
     {
+        canFifo0_overflow++;
         goto CanIsrEnd;
     }
     
@@ -557,20 +617,17 @@ void CAN1_RX0_IRQHandler (void)
     canMessageFifo0[canFifo0_writePtr].Dlc = RxMessage.DLC;
     canMessageFifo0[canFifo0_writePtr].Id = canId;
     canMessageFifo0[canFifo0_writePtr].ID_Type = cIdType;
+    canMessageFifo0[canFifo0_writePtr].RTR = RxMessage.RTR == CAN_RTR_Remote ? CAN_TYPE_REMOTE : CAN_TYPE_DATA;
+    canMessageFifo0[canFifo0_writePtr].Timestamp = timestamp;
     for (i = 0; i < RxMessage.DLC; i++)
     {
         canMessageFifo0[canFifo0_writePtr].Frame[i] = RxMessage.Data[i];
     }
-    //Move write pointer, if we are on the end of ring buffer, reset pointer
-    canFifo0_writePtr++;
-    if (canFifo0_writePtr >= CAN_BUFFER_ITEMS)
+    //Move write pointer only after message is complete
+    canFifo0_writePtr = nextWritePtr;
+    if (canRxCallback != NULL)
     {
-        canFifo0_writePtr = 0;
-    }
-    //If pointer are same after writing, then we made a buffer overflow of RX FIFO
-    if (canFifo0_writePtr == canFifo0_readPtr)
-    {
-        flagOverflow0 = true;
+        canRxCallback();
     }
     
 CanIsrEnd:
@@ -580,12 +637,29 @@ CanIsrEnd:
 
 void CAN1_SCE_IRQHandler( void )
  {
+    uint32_t flags = 0;
+    if (CAN_GetITStatus( BOARD_CAN_IF, CAN_IT_EWG ) == SET )
+    {
+        flags |= CAN_FLAG_ERROR_WARNING;
+    }
+    if (CAN_GetITStatus( BOARD_CAN_IF, CAN_IT_EPV ) == SET )
+    {
+        flags |= CAN_FLAG_ERROR_PASSIVE;
+    }
+    if (CAN_GetITStatus( BOARD_CAN_IF, CAN_IT_BOF ) == SET )
+    {
+        flags |= CAN_FLAG_BUS_OFF;
+    }
     if (CAN_GetITStatus( BOARD_CAN_IF, CAN_IT_LEC ) == SET )
     {
+        flags |= CAN_FLAG_BUS_ERROR;
         canLastError = CAN_GetLastErrorCode(BOARD_CAN_IF);
         canLastError >>=4; //LEC is only masked from CAN_ESR register, move it down by 4 bits;
         CAN_ClearITPendingBit(BOARD_CAN_IF, CAN_IT_LEC );
         //At this moment we can get into endless loop of errors. Cancel last transmitted message
         Can_Tx_Cancel();
     }
+    Can_ErrorFlags_Set(flags);
+    //Error states stay in ESR, only error interrupt flag is cleared
+    CAN_ClearITPendingBit(BOARD_CAN_IF, CAN_IT_ERR);
 }
@@ -19,38 +19,36 @@
 /*Private variables----------------------------------------------------------*/
 static NVIC_InitTypeDef nvicStructure;
 static TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
-static uint16_t TimerPeriod = 0;
-static uint64_t _timerCount = 0;
+static volatile uint32_t _timerOverflow = 0; //Upper 32 bits of time, TIM2 counts lower 32 bits
 
 /**
-  * @brief  Configures TIM2 as free falling timer to achieve higher time precision in FreeRTOS
+  * @brief  Configures TIM2 as free running 32bit counter of micro seconds to achieve higher time precision in FreeRTOS
   * @param  None
   * @retval None
   */
-ErrorCodes Gpt_100us_Init()
+ErrorCodes Gpt_Us_Init()
 {
 	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
 	
-  /* Compute the value to be set in ARR register to generate signal frequency at "freq" Khz */
-	//TIM2 connected on APB1 = 42MHz
-	//100uS = 10000Hz * 2 (because we are on APB1 instead APB2)
-  TimerPeriod = (SystemCoreClock / 20000) - 1;
-	_timerCount = 0;
+	//TIM2 connected on APB1 = 42MHz, timer clock is doubled = 84MHz
+	//Prescaler divides it down to 1MHz, counter overflows every ~71 minutes
+	_timerOverflow = 0;
 	
   /* Time Base configuration */
-  TIM_TimeBaseStructure.TIM_Prescaler = 0x0;
-  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Down;
-  TIM_TimeBaseStructure.TIM_Period = TimerPeriod;
+  TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / 2000000) - 1;
+  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+  TIM_TimeBaseStructure.TIM_Period = 0xFFFFFFFF;
   TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
   TIM_TimeBaseStructure.TIM_RepetitionCounter = 0; //Valid only for TIM1 and TIM8
   TIM_TimeBaseInit(TIM2, &TIM_TimeBaseStructure);
 	
-	//Setup interrupt requests for TIM2
+	//Setup interrupt requests for TIM2, only overflow of counter is counted
   nvicStructure.NVIC_IRQChannel = TIM2_IRQn;
   nvicStructure.NVIC_IRQChannelPreemptionPriority = 0;
   nvicStructure.NVIC_IRQChannelSubPriority = 1;
   nvicStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&nvicStructure);
+	TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
 	TIM_ITConfig(TIM2, TIM_IT_Update , ENABLE);
 	
 	TIM_Cmd(TIM2, ENABLE);
@@ -58,16 +56,22 @@ ErrorCodes Gpt_100us_Init()
 }
 
 /**
-  * @brief  Get elapsed time in micro seconds since Gpt_100us_Init() was called.
-  * @param  microSecs time in micro seconds aligned in 100us
-  * @retval None
+  * @brief  Get elapsed time in micro seconds since Gpt_Us_Init() was called.
+  * @note   Can be called also from interrupt
+  * @retval Time in micro seconds
   */
-ErrorCodes Gpt_100us_GetTime(uint64_t* microSecs)
+uint64_t Gpt_Us_GetTime(void)
 {
-	//Timer is set on 100uS, so we see how many times has timer went through
-	//To get time in microsecodns, we need to multiply it by 100;
-	*microSecs = (_timerCount * 100);
-	return ERROR_OK;
+	uint32_t high;
+	uint32_t low;
+	//Read again if overflow was counted between reading of both parts
+	do
+	{
+		high = _timerOverflow;
+		low = TIM2->CNT;
+	}
+	while(high != _timerOverflow);
+	return ((uint64_t)high << 32) | low;
 }
 
 void TIM2_IRQHandler(void)
@@ -75,6 +79,6 @@ void TIM2_IRQHandler(void)
 	if (TIM_GetITStatus(TIM2, TIM_IT_Update) != RESET)
   {
       TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
-      _timerCount++;
+      _timerOverflow++;
   }
 }
@@ -18,6 +18,7 @@
  */
 #include "Usb_Vcp_If.h"
 #include "usbd_usr.h"
+#include <string.h>
 
 /* Private */
 uint8_t TM_INT_USB_VCP_ReceiveBuffer[USB_VCP_RECEIVE_BUFFER_LENGTH];
@@ -143,6 +144,23 @@ TM_USB_VCP_Result TM_USB_VCP_Send(uint8_t* DataArray, uint32_t Length)
 	return TM_USB_VCP_OK;
 }
 
+TM_USB_VCP_Result TM_USB_VCP_Write(uint8_t* DataArray, uint32_t Length) 
+{
+	/* Write whole array or nothing, never overwrite data which were not sent yet */
+	if (VCP_TxFree() < Length) {
+		return TM_USB_VCP_ERROR;
+	}
+	VCP_DataTx(DataArray, Length);
+	
+	/* Return OK */
+	return TM_USB_VCP_OK;
+}
+
+uint32_t TM_USB_VCP_TxFree(void) 
+{
+	return VCP_TxFree();
+}
+
 uint16_t TM_USB_VCP_Gets(char* buffer, uint16_t bufsize) 
 {
 	uint16_t i = 0;
@@ -178,6 +196,42 @@ uint16_t TM_USB_VCP_Gets(char* buffer, uint16_t bufsize)
 	return i;
 }
 
+uint16_t TM_USB_VCP_Read(uint8_t* buffer, uint16_t bufsize) 
+{
+	uint16_t i, num, first;
+	
+	/* Take only data which are in buffer now, interrupt can add more meanwhile */
+	num = tm_int_usb_vcp_buf_num;
+	if (num > bufsize) {
+		num = bufsize;
+	}
+	if (num == 0) {
+		return 0;
+	}
+	if (tm_int_usb_vcp_buf_out >= USB_VCP_RECEIVE_BUFFER_LENGTH) {
+		tm_int_usb_vcp_buf_out = 0;
+	}
+	
+	/* Copy data in at most two blocks */
+	first = USB_VCP_RECEIVE_BUFFER_LENGTH - tm_int_usb_vcp_buf_out;
+	if (first > num) {
+		first = num;
+	}
+	memcpy(buffer, &TM_INT_USB_VCP_ReceiveBuffer[tm_int_usb_vcp_buf_out], first);
+	for (i = first; i < num; i++) {
+		buffer[i] = TM_INT_USB_VCP_ReceiveBuffer[i - first];
+	}
+	tm_int_usb_vcp_buf_out = (tm_int_usb_vcp_buf_out + num) % USB_VCP_RECEIVE_BUFFER_LENGTH;
+	
+	/* Counter is shared with USB interrupt */
+	__disable_irq();
+	tm_int_usb_vcp_buf_num -= num;
+	__enable_irq();
+	
+	/* Return number of bytes read */
+	return num;
+}
+
 TM_USB_VCP_Result TM_INT_USB_VCP_AddReceived(uint8_t c) 
 {
 	/* Still available data in buffer */
@@ -26,6 +26,7 @@
   */ 
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "usbd_cdc_vcp.h"
 #include "usb_conf.h"
 
@@ -63,6 +64,7 @@ extern uint8_t  APP_Rx_Buffer []; /* Write CDC received data in this buffer.
 extern uint32_t APP_Rx_ptr_in;    /* Increment this pointer or roll it back to
                                      start address when writing received data
                                      in the buffer APP_Rx_Buffer. */
+extern uint32_t APP_Rx_ptr_out;   /* Position from which CDC core sends data */
 
 /* Private function prototypes -----------------------------------------------*/
 static uint16_t VCP_Init     (void);
@@ -185,24 +187,49 @@ static uint16_t VCP_Ctrl (uint32_t Cmd, uint8_t* Buf, uint32_t Len)
   * @retval Result of the opeartion: USBD_OK if all operations are OK else VCP_FAIL
   */
 uint16_t VCP_DataTx (uint8_t* Buf, uint32_t Len) {
-	uint32_t tx_counter = 0;
+	uint32_t ptr_in = APP_Rx_ptr_in;
+	uint32_t first = APP_RX_DATA_SIZE - ptr_in;
 	
-	while (tx_counter < Len) {
-		APP_Rx_Buffer[APP_Rx_ptr_in] = *(Buf+tx_counter);
-		
-		APP_Rx_ptr_in++;
-		
-		/* To avoid buffer overflow */
-		if (APP_Rx_ptr_in >= APP_RX_DATA_SIZE) {
-			APP_Rx_ptr_in = 0;
-		}
-		
-		tx_counter++;
+	/* Copy in max two blocks, pointer is moved once so SOF interrupt sees only complete data */
+	if (Len < first) {
+		memcpy(&APP_Rx_Buffer[ptr_in], Buf, Len);
+		ptr_in += Len;
+	} else {
+		memcpy(&APP_Rx_Buffer[ptr_in], Buf, first);
+		memcpy(APP_Rx_Buffer, Buf + first, Len - first);
+		ptr_in = Len - first;
 	}
+	APP_Rx_ptr_in = ptr_in;
 	
 	return USBD_OK;
 }
 
+/**
+  * @brief  VCP_TxFree
+  *         Amount of bytes which can be written by VCP_DataTx without overwriting
+  *         data which were not sent yet.
+  * @retval Free space in bytes
+  */
+uint32_t VCP_TxFree (void) {
+	uint32_t ptr_in = APP_Rx_ptr_in;
+	uint32_t ptr_out = APP_Rx_ptr_out;
+	uint32_t used;
+	
+	if (ptr_out >= APP_RX_DATA_SIZE) {
+		ptr_out = 0;
+	}
+	if (ptr_in >= ptr_out) {
+		used = ptr_in - ptr_out;
+	} else {
+		used = APP_RX_DATA_SIZE - ptr_out + ptr_in;
+	}
+	/* Packet being sent right now is behind ptr_out, keep it untouched. One byte is lost to tell full from empty */
+	if (used + CDC_DATA_IN_PACKET_SIZE + 1 >= APP_RX_DATA_SIZE) {
+		return 0;
+	}
+	return APP_RX_DATA_SIZE - used - CDC_DATA_IN_PACKET_SIZE - 1;
+}
+
 /**
   * @brief  VCP_DataRx
   *         Data received over USB OUT endpoint are sent over CDC interface 
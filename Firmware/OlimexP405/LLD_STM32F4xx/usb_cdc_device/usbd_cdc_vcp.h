@@ -35,6 +35,7 @@
 #include "usbd_conf.h"
 
 uint16_t VCP_DataTx   (uint8_t* Buf, uint32_t Len);
+uint32_t VCP_TxFree   (void);
 uint16_t VCP_DataRx   (uint8_t* Buf, uint32_t Len);
 
 /* Exported typef ------------------------------------------------------------*/
@@ -28,7 +28,7 @@ typedef struct CanMessage
 	uint8_t   Frame[8]; //1-8 received bytes in CAN message
 	uint8_t   Dlc;      //Length of received frame
 	uint32_t  Id;       //ID of received frame
-	uint32_t  Timestamp;
+	uint64_t  Timestamp; //Unix time [us], see Clock.h
 }CanMessage;
 
 /**
@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * @brief   Clock domain of the device. Monotonic timer of the device is mapped
+ *          onto Unix time, anchor is taken from SNTP and refreshed periodically.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/**
+* @brief  Start SNTP client. Call after tcpip_init and Netif_Config.
+*/
+void Clock_Init(void);
+
+/**
+* @brief  Get current time in microseconds
+* @retval Unix time [us] after first SNTP sync, time since start of device before.
+*         Returned value never goes backwards.
+*/
+uint64_t Clock_GetTime_us(void);
+
+/**
+* @brief  Anchor monotonic timer to Unix time. Called on every SNTP sync.
+* @param  sec: Unix time seconds
+* @param  us: Microseconds part
+*/
+void Clock_SetUnixTime(uint32_t sec, uint32_t us);
+
+/**
+* @brief  Check if time was synchronized at least once
+* @retval 1 = Clock_GetTime_us returns Unix time, 0 = time since start of device
+*/
+uint32_t Clock_IsSynchronized(void);
+#endif
@@ -14,3 +14,8 @@
  * @retval True if successfuly processed
 */
 bool Passive_Vwtp20_Parse(CanMessage cmsg);
+
+/**
+ * @brief Claim broadcast channel of VWTP2.0 in Passive_Can, IDs of channels are claimed when channel is opened
+*/
+void Passive_Vwtp20_Init(void);
@@ -0,0 +1,26 @@
+/*******************************************************************************
+  * @brief   Module for sending SocketCAN and RAW data into Wireshark as one
+  *          pcapng stream via TCP Socket
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+
+#include "CanIf.h"
+#include "Task_Tcp_Wireshark_Raw.h"
+
+/**
+* @brief  Setup Wireshark pcapng socket
+*/
+void Task_Tcp_Wireshark_Pcapng_Init(void);
+
+/**
+ * @brief Adds new CAN message into history for sending
+*/
+void Task_Tcp_Wireshark_Pcapng_AddNewCanMessage(CanMessage cmsg);
+
+/**
+ * @brief Adds new RAW message into history for sending
+ * @param comment: Static string written as packet comment or NULL
+*/
+void Task_Tcp_Wireshark_Pcapng_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment);
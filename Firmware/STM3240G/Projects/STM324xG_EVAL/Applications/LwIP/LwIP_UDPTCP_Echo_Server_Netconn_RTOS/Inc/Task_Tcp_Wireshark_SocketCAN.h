@@ -16,3 +16,8 @@ void Task_Tcp_Wireshark_SocketCAN_Init(void);
  * Adds new CAN message into a queue for sending
 */
 void Task_Tcp_Wireshark_SocketCAN_AddNewCanMessage(CanMessage cmsg);
+
+/**
+ * @brief Write 16 bytes of SocketCAN packet into array
+*/
+void Task_Tcp_Wireshark_SocketCAN_PreparePacket(CanMessage* cmsg, uint8_t* array);
@@ -121,6 +121,15 @@ a lot of data that needs to be copied, this should be set high. */
 
 /* ---------- DHCP options ---------- */
 #define LWIP_DHCP               1
+#define LWIP_DHCP_GET_NTP_SRV   1
+
+
+/* ---------- SNTP options ---------- */
+/* Time from SNTP anchors monotonic timer of device to Unix time, see Clock.h */
+#include "Clock.h"
+#define SNTP_SET_SYSTEM_TIME_US(sec, us) Clock_SetUnixTime(sec, us)
+#define SNTP_GET_SERVERS_FROM_DHCP       1
+#define SNTP_UPDATE_DELAY                (15 * 60 * 1000) /* Re-anchor every 15 minutes to compensate drift of crystal */
 
 
 /* ---------- UDP options ---------- */
@@ -16,6 +16,7 @@
 //#include "stm32f4xx_hal_rcc.h"
 //***********************************************
 #include "rtos_utils.h"
+#include "Clock.h"
 
 /* Private definitions -------------------------------------------------------*/
 
@@ -327,7 +328,7 @@ void CAN2_RX0_IRQHandler (void)
 	//Add message to the buffer
 	canMessageFifo[canFifo_writePtr].Dlc = RxHeader.DLC;
 	canMessageFifo[canFifo_writePtr].Id = canId;
-	canMessageFifo[canFifo_writePtr].Timestamp = GetTime_ms();
+	canMessageFifo[canFifo_writePtr].Timestamp = Clock_GetTime_us();
 	
 	for (i = 0; i < RxHeader.DLC; i++)
 	{
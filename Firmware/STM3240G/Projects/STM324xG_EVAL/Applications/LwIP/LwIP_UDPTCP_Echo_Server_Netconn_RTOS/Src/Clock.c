@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * @brief   Clock domain of the device. HAL tick together with counter of TIM6
+ *          (1MHz time base of HAL) is used as monotonic time base,
+ *          offset to Unix time is taken from SNTP.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include "Clock.h"
+#include "stm32f4xx_hal.h"
+#include "lwip/opt.h"
+#include "lwip/tcpip.h"
+#include "lwip/ip_addr.h"
+#include "lwip/apps/sntp.h"
+
+// -- Private Definitions -------------------------------
+//Used when DHCP server does not provide NTP server (time.google.com, no DNS on board)
+#define CLOCK_SNTP_FALLBACK_SERVER  "216.239.35.0"
+
+// -- Private Variables ---------------------------------
+static int64_t  clock_offset_us = 0;     //Unix time - monotonic time
+static uint64_t clock_last_us = 0;       //Last returned time, used to keep time monotonic
+static uint32_t clock_tick_high = 0;     //Extension of 32bit HAL tick
+static uint32_t clock_tick_last = 0;
+static volatile uint32_t clock_synchronized = 0;
+
+/**
+* @brief  Monotonic time since start of device [us]. Must be called with interrupts disabled.
+*/
+static uint64_t clock_monotonic_us(void)
+{
+  uint32_t tick = HAL_GetTick();
+  uint32_t counter = TIM6->CNT;
+  //Counter has overflown, but tick was not incremented yet (interrupts are disabled)
+  if((TIM6->SR & TIM_SR_UIF) != 0)
+  {
+    counter = TIM6->CNT + 1000;
+  }
+  if(tick < clock_tick_last)
+  {
+    clock_tick_high++;
+  }
+  clock_tick_last = tick;
+  return ((((uint64_t)clock_tick_high << 32) | tick) * 1000) + counter;
+}
+
+static void clock_sntp_start(void* arg)
+{
+  ip_addr_t server;
+  LWIP_UNUSED_ARG(arg);
+
+  sntp_setoperatingmode(SNTP_OPMODE_POLL);
+  if(ipaddr_aton(CLOCK_SNTP_FALLBACK_SERVER, &server))
+  {
+    sntp_setserver(0, &server);
+  }
+  sntp_servermode_dhcp(1);
+  sntp_init();
+}
+
+/*-----------------------------------------------------------------------------------*/
+
+void Clock_Init(void)
+{
+  //SNTP has to be started from context of TCP/IP thread
+  tcpip_callback(clock_sntp_start, NULL);
+}
+
+uint64_t Clock_GetTime_us(void)
+{
+  uint64_t now;
+  uint32_t primask = __get_PRIMASK();
+  //Called also from CAN RX interrupt, so lock by disabling of interrupts
+  __disable_irq();
+  now = (uint64_t)((int64_t)clock_monotonic_us() + clock_offset_us);
+  //Re-anchor can move offset backwards. Hold time until monotonic timer catches up.
+  if(now < clock_last_us)
+  {
+    now = clock_last_us;
+  }
+  clock_last_us = now;
+  if(primask == 0)
+  {
+    __enable_irq();
+  }
+  return now;
+}
+
+void Clock_SetUnixTime(uint32_t sec, uint32_t us)
+{
+  int64_t offset;
+  int64_t drift;
+  uint32_t synchronized = clock_synchronized;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  offset = (int64_t)sec * 1000000 + us - (int64_t)clock_monotonic_us();
+  drift = offset - clock_offset_us;
+  clock_offset_us = offset;
+  clock_synchronized = 1;
+  if(primask == 0)
+  {
+    __enable_irq();
+  }
+
+  if(synchronized != 0)
+  {
+    printf("Clock re-anchored, drift %d us\n", (int)drift);
+  }
+  else
+  {
+    printf("Clock synchronized to Unix time %u\n", (unsigned int)sec);
+  }
+}
+
+uint32_t Clock_IsSynchronized(void)
+{
+  return clock_synchronized;
+}
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * @brief   Parsing of CAN messages into J1939 transport protocol (TP.CM / TP.DT).
+ *          Reassembles BAM and RTS/CTS transfers of PGNs longer than 8 bytes.
+ *          Datagram is [PGN (3 bytes, LE)][Source address][Destination address][Data]
+ ******************************************************************************
+ * @attention
+ ******************************************************************************  
+ */ 
+#include "string.h"
+#include "Passive_J1939.h"
+#include "Passive_Can.h"
+#include "Task_Tcp_Wireshark_Raw.h"
+
+// -- Private defintions
+typedef enum J1939_Control
+{
+    J1939_CM_RTS = 16,      //Request to send, destination specific transfer
+    J1939_CM_CTS = 17,      //Clear to send, sent by receiver
+    J1939_CM_EOMA = 19,     //End of message acknowledge, sent by receiver
+    J1939_CM_BAM = 32,      //Broadcast announce message
+    J1939_CM_ABORT = 255,   //Connection abort, sent by any side
+}J1939_Control;
+
+#define J1939_PF_TP_CM          0xEC
+#define J1939_PF_TP_DT          0xEB
+#define J1939_MAX_SESSIONS      4         //Concurrent transfers, i.e. BAM of DM1 and RTS/CTS of software identification
+#define J1939_MAX_LENGTH        1785      //255 packets * 7 bytes
+#define J1939_HEADER_LENGTH     5         //PGN, source address, destination address
+#define J1939_TIMEOUT           1250000   //[us] T2 / T3, transfer without any frame is dropped
+
+/**
+ * @brief One transfer between source and destination address
+ */
+typedef struct
+{
+    bool     Open;
+    uint8_t  Source;
+    uint8_t  Destination;       //0xFF for BAM
+    uint8_t  Priority;          //Priority of TP.CM
+    uint32_t Pgn;
+    uint32_t Size;
+    uint8_t  Packets;
+    uint8_t  ReceivedCount;
+    uint8_t  Received[32];      //Bit for every received sequence number of TP.DT
+    uint64_t LastActivity;      //Timestamp of last frame [us]
+    uint8_t  Frame[J1939_HEADER_LENGTH + J1939_MAX_LENGTH];
+} J1939_Session;
+
+// -- Private variables
+static J1939_Session j1939_sessions[J1939_MAX_SESSIONS];
+
+/**
+ * @retval NULL if there is no transfer from source to destination
+ */
+static J1939_Session* Passive_J1939_FindSession(uint8_t source, uint8_t destination)
+{
+    int i;
+    for (i = 0; i < J1939_MAX_SESSIONS; i++)
+    {
+        if (j1939_sessions[i].Open && j1939_sessions[i].Source == source && j1939_sessions[i].Destination == destination)
+        {
+            return &j1939_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Use session of the same addresses, free one, expired one or the oldest one
+ */
+static J1939_Session* Passive_J1939_OpenSession(uint8_t source, uint8_t destination, uint64_t timestamp)
+{
+    int i;
+    J1939_Session* session = Passive_J1939_FindSession(source, destination);
+    J1939_Session* oldest = NULL;
+    if (session != NULL)
+    {
+        printf("WARNING: J1939 Transfer of PGN %x from %x to %x was not finished\n", session->Pgn, source, destination);
+        return session;
+    }
+    for (i = 0; i < J1939_MAX_SESSIONS; i++)
+    {
+        session = &j1939_sessions[i];
+        if (!session->Open || timestamp - session->LastActivity > J1939_TIMEOUT)
+        {
+            return session;
+        }
+        if (oldest == NULL || session->LastActivity < oldest->LastActivity)
+        {
+            oldest = session;
+        }
+    }
+    printf("WARNING: J1939 Too many transfers, dropping PGN %x from %x\n", oldest->Pgn, oldest->Source);
+    return oldest;
+}
+
+/**
+ * @brief CAN ID of PGN as if it was sent in one frame
+ */
+static uint32_t Passive_J1939_CanId(J1939_Session* session)
+{
+    uint32_t id = (session->Priority << 26) | ((session->Pgn & 0x3FF00) << 8) | session->Source;
+    if (((session->Pgn >> 8) & 0xFF) < 240)
+    {
+        //PDU1 format, PS is destination address
+        id |= session->Destination << 8;
+    }
+    else
+    {
+        //PDU2 format, PS is group extension
+        id |= (session->Pgn & 0xFF) << 8;
+    }
+    return id;
+}
+
+/**
+ * @brief Send datagram and close transfer. Packets which were not received are 0xFF.
+ */
+static void Passive_J1939_Send(J1939_Session* session, uint64_t timestamp)
+{
+    const char* comment = session->ReceivedCount != session->Packets ? "SN gap" : NULL;
+    Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(session->Frame, J1939_HEADER_LENGTH + session->Size, Passive_J1939_CanId(session), timestamp, Raw_J1939, comment);
+    session->Open = false;
+}
+
+static void Passive_J1939_ConnectionManagement(CanMessage* cmsg, uint8_t source, uint8_t destination)
+{
+    J1939_Session* session;
+    uint32_t pgn = cmsg->Frame[5] | (cmsg->Frame[6] << 8) | ((uint32_t)cmsg->Frame[7] << 16);
+    switch (cmsg->Frame[0])
+    {
+        case J1939_CM_RTS:
+        case J1939_CM_BAM:
+        {
+            uint32_t size = cmsg->Frame[1] | (cmsg->Frame[2] << 8);
+            uint8_t packets = cmsg->Frame[3];
+            if (size <= 8 || size > J1939_MAX_LENGTH || packets != (size + 6) / 7)
+            {
+                printf("ERROR: J1939 TP.CM of PGN %x has invalid size %u / %u packets\n", pgn, size, packets);
+                return;
+            }
+            session = Passive_J1939_OpenSession(source, destination, cmsg->Timestamp);
+            session->Open = true;
+            session->Source = source;
+            session->Destination = destination;
+            session->Priority = (cmsg->Id >> 26) & 0x7;
+            session->Pgn = pgn;
+            session->Size = size;
+            session->Packets = packets;
+            session->ReceivedCount = 0;
+            memset(session->Received, 0, sizeof(session->Received));
+            memset(session->Frame + J1939_HEADER_LENGTH, 0xFF, size);
+            session->LastActivity = cmsg->Timestamp;
+            session->Frame[0] = pgn & 0xFF;
+            session->Frame[1] = (pgn >> 8) & 0xFF;
+            session->Frame[2] = (pgn >> 16) & 0xFF;
+            session->Frame[3] = source;
+            session->Frame[4] = destination;
+            break;
+        }
+        case J1939_CM_CTS:
+            //Receiver answers to originator
+            session = Passive_J1939_FindSession(destination, source);
+            if (session != NULL)
+            {
+                session->LastActivity = cmsg->Timestamp;
+            }
+            break;
+        case J1939_CM_EOMA:
+            //Receiver has everything, send also incomplete datagram
+            session = Passive_J1939_FindSession(destination, source);
+            if (session != NULL)
+            {
+                Passive_J1939_Send(session, cmsg->Timestamp);
+            }
+            break;
+        case J1939_CM_ABORT:
+            session = Passive_J1939_FindSession(source, destination);
+            if (session == NULL)
+            {
+                session = Passive_J1939_FindSession(destination, source);
+            }
+            if (session != NULL)
+            {
+                printf("WARNING: J1939 Transfer of PGN %x was aborted, reason %u\n", pgn, cmsg->Frame[1]);
+                session->Open = false;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void Passive_J1939_DataTransfer(CanMessage* cmsg, uint8_t source, uint8_t destination)
+{
+    uint32_t offset;
+    uint32_t length;
+    uint8_t seq = cmsg->Frame[0];
+    J1939_Session* session = Passive_J1939_FindSession(source, destination);
+    if (session == NULL)
+    {
+        //TP.CM was not received, i.e. transfer has started before connection
+        return;
+    }
+    if (cmsg->Timestamp - session->LastActivity > J1939_TIMEOUT)
+    {
+        printf("WARNING: J1939 Transfer of PGN %x has timed out\n", session->Pgn);
+        session->Open = false;
+        return;
+    }
+    if (seq == 0 || seq > session->Packets)
+    {
+        printf("ERROR: J1939 TP.DT of PGN %x has invalid sequence number %u\n", session->Pgn, seq);
+        return;
+    }
+    session->LastActivity = cmsg->Timestamp;
+    //Packet can be repeated on request of CTS
+    if ((session->Received[seq >> 3] & (1 << (seq & 7))) == 0)
+    {
+        session->Received[seq >> 3] |= 1 << (seq & 7);
+        session->ReceivedCount++;
+    }
+    offset = (seq - 1) * 7;
+    length = session->Size - offset < 7 ? session->Size - offset : 7;
+    if (length > cmsg->Dlc - 1)
+    {
+        length = cmsg->Dlc - 1;
+    }
+    memcpy(session->Frame + J1939_HEADER_LENGTH + offset, cmsg->Frame + 1, length);
+    //BAM can't repeat lost packets, RTS/CTS waits for repeated packets or End of message acknowledge
+    if (session->ReceivedCount == session->Packets || (seq == session->Packets && session->Destination == 0xFF))
+    {
+        Passive_J1939_Send(session, cmsg->Timestamp);
+    }
+}
+
+void Passive_J1939_Init(void)
+{
+    uint32_t priority;
+    //TP.DT and TP.CM of all priorities, EDP = 0 and DP = 0
+    for (priority = 0; priority < 8; priority++)
+    {
+        Passive_Can_Claim((priority << 26) | (J1939_PF_TP_DT << 16), (priority << 26) | (J1939_PF_TP_CM << 16) | 0xFFFF, Passive_J1939_Parse);
+    }
+}
+
+/**
+ * @brief Try to parse CAN as J1939 transport protocol
+ * @retval True if successfuly processed
+*/
+bool Passive_J1939_Parse(CanMessage cmsg)
+{
+    uint8_t pf = (cmsg.Id >> 16) & 0xFF;
+    uint8_t ps = (cmsg.Id >> 8) & 0xFF;
+    uint8_t sa = cmsg.Id & 0xFF;
+    //Only 29 bit IDs with EDP = 0 and DP = 0
+    if (cmsg.Id <= 0x7FF || (cmsg.Id & 0x3000000) != 0 || cmsg.Dlc < 2)
+    {
+        return false;
+    }
+    if (pf == J1939_PF_TP_CM && cmsg.Dlc == 8)
+    {
+        Passive_J1939_ConnectionManagement(&cmsg, sa, ps);
+        return true;
+    }
+    if (pf == J1939_PF_TP_DT)
+    {
+        Passive_J1939_DataTransfer(&cmsg, sa, ps);
+        return true;
+    }
+    return false;
+}
@@ -10,6 +10,7 @@
 #include "Task_Tcp_Wireshark_Raw.h"
 #include "System_stats.h"
 #include "rtos_utils.h"
+#include "Clock.h"
 
 // ** Private defintions
 #define MAX_PRINTF_BUFFER 255
@@ -29,11 +30,8 @@ void Passive_Printf_Add(uint8_t c)
     //If we have exceeded amount of data or found \n chracter, send the buffer
     if(c == '\n' || printf_buffer_position >= MAX_PRINTF_BUFFER)
     {
-        //Add datagram into a queue only if we are connected
-        if(Stats_TCP_WS_RAW_State_Get() != 0)
-        {
-            Task_Tcp_Wireshark_Raw_AddNewRawMessage(printf_buffer, printf_buffer_position, 0, GetTime_ms(), Raw_Debug);
-        }
+        //Datagram goes always into pcapng history, RAW stream takes it only when connected
+        Task_Tcp_Wireshark_Raw_AddNewRawMessage(printf_buffer, printf_buffer_position, 0, Clock_GetTime_us(), Raw_Debug);
         printf_buffer_position = 0;
     }
 }
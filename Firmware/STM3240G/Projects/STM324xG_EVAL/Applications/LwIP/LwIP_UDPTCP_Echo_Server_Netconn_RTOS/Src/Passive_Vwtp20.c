@@ -6,6 +6,7 @@
  */ 
 #include "string.h"
 #include "Passive_Vwtp20.h"
+#include "Passive_Can.h"
 #include "Task_Tcp_Wireshark_Raw.h"
 
 // -- Private defintions
@@ -24,6 +25,8 @@ typedef enum TCPI1
     TCPI1_CFrame_BlockSizeReachedAck = 0x00,
     // Bx - Ack, "X" is SEQ
     TCPI1_Ack = 0xB0,
+    // 9x - Ack, receiver is not ready for next block, "X" is SEQ
+    TCPI1_Ack_NotReady = 0x90,
     // A0 - Paramters request
     TCPI1_Connection_ParamRequest = 0xA0,
     // A1 - Parameters response. Returning paramters from A0 or A3
@@ -38,13 +41,201 @@ typedef enum TCPI1
     TCPI1_Unkown,
 }TCPI1;
 
+#define VWTP20_MAX_CHANNELS     4         //Concurrent channels, i.e. engine and gearbox opened by VCDS
+#define VWTP20_FRAME_LENGTH     0x400     //Longest datagram including 2 bytes of length
+#define VWTP20_CHANNEL_TIMEOUT  5000000   //[us] Channel without any frame is closed when new channel is negotiated
+#define VWTP20_MAX_RETRANSMIT   8         //Sequence number up to this count behind expected one is retransmission, further one is gap
+#define VWTP20_COMMENT_LENGTH   64
+
+/**
+ * @brief Reassembly of datagrams sent in one direction of channel
+ */
+typedef struct
+{
+    uint8_t  Frame[VWTP20_FRAME_LENGTH];
+    uint32_t Count;
+    bool     ExpectingAck;
+    int      LastSeq;          //Sequence number of last data frame, -1 if nothing was received
+    int      SeqPosition[16];  //Position in datagram where data of frame with sequence number starts, -1 if frame is not part of datagram
+    bool     Gap;              //Datagram is missing frames
+    bool     Retransmit;       //Datagram has retransmitted frames
+} Vwtp20_Direction;
+
+/**
+ * @brief One channel between tester and ECU, negotiated on broadcast channel 0x200 - 0x2FF
+ */
+typedef struct
+{
+    bool     Open;
+    uint32_t EcuAddress;
+    uint32_t TesterId;          //CAN ID used by tester
+    uint32_t EcuId;             //CAN ID used by ECU
+    uint64_t LastActivity;      //Timestamp of last frame [us]
+    Vwtp20_Direction FromTester;
+    Vwtp20_Direction FromEcu;
+    uint16_t Gaps;              //Frames lost between sequence numbers
+    uint16_t Retransmits;       //Frames received again (after Break or missing ACK)
+    uint16_t AckErrors;         //ACKs with other sequence number than next expected one
+    uint16_t Breaks;
+} Vwtp20_Channel;
+
 // -- Private variables
-static uint32_t testerId = 0xFFFFFFFF;
-static uint32_t ecuId = 0xFFFFFFFF;
-static uint8_t  tp20_frame[0x100];
-static uint32_t tp20_frame_count;
-static bool flag_DatagramReceived= false;
-static bool flag_expectingAck = false;
+static Vwtp20_Channel tp20_channels[VWTP20_MAX_CHANNELS];
+static char tp20_comment[VWTP20_COMMENT_LENGTH];
+
+/**
+ * @brief Drop datagram, keep state of connection
+ */
+static void Passive_Vwtp20_ClearDirection(Vwtp20_Direction* direction)
+{
+    int i;
+    direction->Count = 0;
+    direction->Gap = false;
+    direction->Retransmit = false;
+    for (i = 0; i < 16; i++)
+    {
+        direction->SeqPosition[i] = -1;
+    }
+}
+
+static void Passive_Vwtp20_ResetDirection(Vwtp20_Direction* direction)
+{
+    Passive_Vwtp20_ClearDirection(direction);
+    direction->ExpectingAck = false;
+    direction->LastSeq = -1;
+}
+
+/**
+ * @brief Check sequence number of data frame before its data are appended.
+ *        Retransmitted frame rewinds datagram to position where data of that frame started, so data are not duplicated.
+ * @retval False if frame is retransmission of datagram which was already completed and frame has to be dropped
+ */
+static bool Passive_Vwtp20_Sequence(Vwtp20_Channel* channel, Vwtp20_Direction* direction, int seq)
+{
+    int expected = (direction->LastSeq + 1) & 0xF;
+    if (direction->LastSeq >= 0 && seq != expected)
+    {
+        if (((expected - seq) & 0xF) <= VWTP20_MAX_RETRANSMIT)
+        {
+            channel->Retransmits++;
+            if (direction->SeqPosition[seq] < 0)
+            {
+                return false;
+            }
+            direction->Retransmit = true;
+            direction->Count = direction->SeqPosition[seq];
+        }
+        else
+        {
+            channel->Gaps += (seq - expected) & 0xF;
+            direction->Gap = true;
+        }
+    }
+    direction->SeqPosition[seq] = direction->Count;
+    direction->LastSeq = seq;
+    return true;
+}
+
+/**
+ * @brief Timing parameter of A0 / A1, bits 7-6 are unit (0.1 ms, 1 ms, 10 ms, 100 ms), bits 5-0 are count
+ * @retval Time [us]
+ */
+static uint32_t Passive_Vwtp20_DecodeTime(uint8_t time)
+{
+    static const uint32_t units[] = { 100, 1000, 10000, 100000 };
+    return units[time >> 6] * (time & 0x3F);
+}
+
+/**
+ * @brief Packet comment for datagram sent in given direction
+ * @retval i.e. "SEQ gap; gaps 1, retx 0, ACK err 0" or NULL if there is nothing to report
+ */
+static const char* Passive_Vwtp20_Comment(Vwtp20_Channel* channel, Vwtp20_Direction* direction)
+{
+    if (!direction->Gap && !direction->Retransmit && channel->Gaps == 0 && channel->Retransmits == 0 && channel->AckErrors == 0)
+    {
+        return NULL;
+    }
+    snprintf(tp20_comment, sizeof(tp20_comment), "%s%s%sgaps %u, retx %u, ACK err %u",
+        direction->Gap ? "SEQ gap" : "",
+        direction->Gap && direction->Retransmit ? ", " : "",
+        direction->Retransmit ? "retransmit; " : direction->Gap ? "; " : "",
+        channel->Gaps, channel->Retransmits, channel->AckErrors);
+    return tp20_comment;
+}
+
+/**
+ * @brief Find open channel which uses CAN ID
+ * @retval NULL if ID does not belong to any channel
+ */
+static Vwtp20_Channel* Passive_Vwtp20_FindChannel(uint32_t id)
+{
+    int i;
+    for (i = 0; i < VWTP20_MAX_CHANNELS; i++)
+    {
+        if (tp20_channels[i].Open && (tp20_channels[i].TesterId == id || tp20_channels[i].EcuId == id))
+        {
+            return &tp20_channels[i];
+        }
+    }
+    return NULL;
+}
+
+static void Passive_Vwtp20_CloseChannel(Vwtp20_Channel* channel)
+{
+    channel->Open = false;
+    Passive_Can_Release(channel->TesterId, channel->TesterId, Passive_Vwtp20_Parse);
+    Passive_Can_Release(channel->EcuId, channel->EcuId, Passive_Vwtp20_Parse);
+}
+
+static void Passive_Vwtp20_OpenChannel(uint32_t ecuAddress, uint32_t testerId, uint32_t ecuId, uint64_t timestamp)
+{
+    int i;
+    Vwtp20_Channel* channel;
+    Vwtp20_Channel* slot = NULL;
+    Vwtp20_Channel* oldest = NULL;
+    //Renegotiated IDs replace old channel
+    while ((channel = Passive_Vwtp20_FindChannel(testerId)) != NULL || (channel = Passive_Vwtp20_FindChannel(ecuId)) != NULL)
+    {
+        Passive_Vwtp20_CloseChannel(channel);
+    }
+    for (i = 0; i < VWTP20_MAX_CHANNELS; i++)
+    {
+        channel = &tp20_channels[i];
+        if (channel->Open && timestamp - channel->LastActivity > VWTP20_CHANNEL_TIMEOUT)
+        {
+            printf("TP20 Channel %x/%x has expired\n", channel->TesterId, channel->EcuId);
+            Passive_Vwtp20_CloseChannel(channel);
+        }
+        if (!channel->Open && slot == NULL)
+        {
+            slot = channel;
+        }
+        if (oldest == NULL || channel->LastActivity < oldest->LastActivity)
+        {
+            oldest = channel;
+        }
+    }
+    if (slot == NULL)
+    {
+        printf("TP20 Too many channels, closing %x/%x\n", oldest->TesterId, oldest->EcuId);
+        Passive_Vwtp20_CloseChannel(oldest);
+        slot = oldest;
+    }
+    slot->Open = true;
+    slot->EcuAddress = ecuAddress;
+    slot->TesterId = testerId;
+    slot->EcuId = ecuId;
+    Passive_Can_Claim(testerId, testerId, Passive_Vwtp20_Parse);
+    Passive_Can_Claim(ecuId, ecuId, Passive_Vwtp20_Parse);
+    slot->LastActivity = timestamp;
+    slot->Gaps = 0;
+    slot->Retransmits = 0;
+    slot->AckErrors = 0;
+    slot->Breaks = 0;
+    Passive_Vwtp20_ResetDirection(&slot->FromTester);
+    Passive_Vwtp20_ResetDirection(&slot->FromEcu);
+}
 
 /**
  * @brief Method is checking for 0x200~0x2FF CAN IDs
@@ -58,44 +249,52 @@ bool Passive_Vwtp20_BroadcastChannel(CanMessage msg)
     }
     uint8_t ecuAddress = msg.Frame[0];
     uint8_t opcode = msg.Frame[1];
-    uint16_t txid = *((uint16_t*)(msg.Frame + 2));
-    uint16_t rxid = *((uint16_t*)(msg.Frame + 4));
+    //Upper bits of IDs are validity flags
+    uint16_t txid = (msg.Frame[2] | (msg.Frame[3] << 8)) & 0x7FF;
+    uint16_t rxid = (msg.Frame[4] | (msg.Frame[5] << 8)) & 0x7FF;
     //uint8_t appType = msg.Frame[6];
     printf("ECU at address %x. TXID={%x} / RXID={%x}\n", ecuAddress, txid, rxid);
 
-    if (msg.Id == 0x200)
+    //Request to ECU (0x200) does not change anything, channel exists only after positive response
+    if (msg.Id != 0x200 && opcode == 0xD0)
     {
-        //Request to ECU on brodacst channel
-        ecuId = 0xFFFFFFFF;
-        testerId = 0xFFFFFFFF;
+        Passive_Vwtp20_OpenChannel(msg.Id & 0xFF, txid, rxid, msg.Timestamp);
     }
-    else
+    return true;
+}
+
+/**
+ * @brief Copy data of frame into datagram
+ * @retval False if datagram does not fit into buffer
+ */
+static bool Passive_Vwtp20_Append(Vwtp20_Direction* direction, CanMessage* msg)
+{
+    uint32_t length = msg->Dlc - 1;
+    if (direction->Count + length > VWTP20_FRAME_LENGTH)
     {
-        //Response from ECU - Only react on positive response
-        if(opcode == 0xD0)
-        {
-            ecuId = rxid;
-            testerId = txid;
-            tp20_frame_count = 0;
-            flag_DatagramReceived = false;
-        }
+        return false;
     }
+    memcpy(direction->Frame + direction->Count, msg->Frame + 1, length);
+    direction->Count += length;
     return true;
 }
 
 bool Passive_Vwtp20_UnicastChannel(CanMessage msg)
 {
-		int rtcpi;
-		int seq;
-    int id = msg.Id;
-    if (id != testerId && id != ecuId)
+    int rtcpi;
+    bool datagramReceived = false;
+    bool overflow = false;
+    Vwtp20_Channel* channel = Passive_Vwtp20_FindChannel(msg.Id);
+    if (channel == NULL || msg.Dlc == 0)
     {
         return false;
     }
+    channel->LastActivity = msg.Timestamp;
+    Vwtp20_Direction* direction = msg.Id == channel->TesterId ? &channel->FromTester : &channel->FromEcu;
+    Vwtp20_Direction* opposite = msg.Id == channel->TesterId ? &channel->FromEcu : &channel->FromTester;
 
     //Parse TCPI byte
     rtcpi = msg.Frame[0];
-    seq = rtcpi & 0xF;
     TCPI1 tcpi = TCPI1_Unkown;
     if ((rtcpi & 0xF0) == 0xA0)
     {
@@ -107,57 +306,72 @@ bool Passive_Vwtp20_UnicastChannel(CanMessage msg)
         //Use only first 4 bits for parsing, which are constants
         tcpi = (TCPI1)(rtcpi & 0xF0);
     }          
+    if ((rtcpi & 0xC0) == 0x00 && !Passive_Vwtp20_Sequence(channel, direction, rtcpi & 0xF))
+    {
+        //Retransmission of datagram which was already sent to Wireshark
+        return true;
+    }
     switch (tcpi)
     {
         case TCPI1_CFrame_LastMessageNoAck:
-            //_datagram.AddRange(msg.Data);
-            memcpy(tp20_frame + tp20_frame_count, msg.Frame, msg.Dlc);
-            tp20_frame_count += msg.Dlc;
-            flag_DatagramReceived = true;
-            flag_expectingAck = false;
+            //Received last message of datagram without ACK
+            overflow = !Passive_Vwtp20_Append(direction, &msg);
+            datagramReceived = true;
+            direction->ExpectingAck = false;
             break;
         case TCPI1_CFrame_Flow:
             //Received one frame from several frames
-            //_datagram.AddRange(msg.Data.Skip(1));
-            memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-            tp20_frame_count += msg.Dlc - 1;
+            overflow = !Passive_Vwtp20_Append(direction, &msg);
             break;
         case TCPI1_CFrame_LastMessageAck:
             //Received last message of block expecting ACK
-            //_datagram.AddRange(msg.Data.Skip(1));
-            memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-            tp20_frame_count += msg.Dlc - 1;
-            flag_DatagramReceived = true;
-            flag_expectingAck = true;
+            overflow = !Passive_Vwtp20_Append(direction, &msg);
+            datagramReceived = true;
+            direction->ExpectingAck = true;
             break;
         case TCPI1_CFrame_BlockSizeReachedAck:
             //Block has ended, expecting ACK
-            //_datagram.AddRange(msg.Frame.Skip(1));
-            memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-            tp20_frame_count += msg.Dlc - 1;
-            flag_expectingAck = true;
+            overflow = !Passive_Vwtp20_Append(direction, &msg);
+            direction->ExpectingAck = true;
             break;
         case TCPI1_Ack:
-            //Datagram received
-            flag_expectingAck = false;
+        case TCPI1_Ack_NotReady:
+            //ACK is sent by the other side, confirms data of this side and carries next expected sequence number
+            if (opposite->LastSeq >= 0 && (rtcpi & 0xF) != ((opposite->LastSeq + 1) & 0xF))
+            {
+                channel->AckErrors++;
+            }
+            opposite->ExpectingAck = false;
             break;
-        case TCPI1_Connection_Break:
-        case TCPI1_Connection_Disconnect:
-            if(tcpi == TCPI1_Connection_Disconnect)
+        case TCPI1_Connection_ParamRequest:
+        case TCPI1_Connection_ParamResponse:
+            //[A0, BS, T1, 0xFF, T3, 0xFF]
+            if (msg.Dlc >= 6)
             {
-                //Reset IDs
-                ecuId = 0xFFFFFFFF;
-                testerId = 0xFFFFFFFF;
+                printf("TP20 Channel %x/%x BS %u, T1 %u us, T3 %u us\n", channel->TesterId, channel->EcuId, msg.Frame[1], Passive_Vwtp20_DecodeTime(msg.Frame[2]), Passive_Vwtp20_DecodeTime(msg.Frame[4]));
             }
             break;
+        case TCPI1_Connection_Break:
+            //Receiver discards data since last ACK, sender repeats them with the same sequence numbers
+            channel->Breaks++;
+            break;
+        case TCPI1_Connection_Disconnect:
+            Passive_Vwtp20_CloseChannel(channel);
+            break;
         default:
             break;
     }
 
-    if(flag_DatagramReceived == true)
+    if (overflow)
     {
+        printf("ERROR: TP20 Datagram is longer than 0x%x bytes.\n", VWTP20_FRAME_LENGTH);
+        Passive_Vwtp20_ClearDirection(direction);
+    }
+    else if(datagramReceived == true)
+    {
+        uint32_t count = direction->Count;
         //Check minimal length
-        if (tp20_frame_count < 3)
+        if (count < 3)
         {
             //Too small.
             printf("ERROR: TP20 Datagram is smaller than 3 bytes.\n");
@@ -165,14 +379,13 @@ bool Passive_Vwtp20_UnicastChannel(CanMessage msg)
         //Validate datagram header
         else
         {
-            int dLength = tp20_frame[0] << 8 | tp20_frame[1];
-            if (dLength != tp20_frame_count - 2)
+            int dLength = direction->Frame[0] << 8 | direction->Frame[1];
+            if (dLength != count - 2)
             {
                 //Now there is some kind of special case used for errors (maybe)
-                if ((dLength ^ 0x8000) == tp20_frame_count - 2)
+                if ((dLength ^ 0x8000) == count - 2)
                 {
-                    tp20_frame_count = tp20_frame_count - 2;
-                    Task_Tcp_Wireshark_Raw_AddNewRawMessage(tp20_frame + 2, tp20_frame_count, msg.Id, msg.Timestamp, Raw_VWTP20);
+                    Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(direction->Frame + 2, count - 2, msg.Id, msg.Timestamp, Raw_VWTP20, Passive_Vwtp20_Comment(channel, direction));
                     printf("WARNING: TP20 Datagram header starts on 0x8000\n");
                 }
                 else
@@ -184,16 +397,19 @@ bool Passive_Vwtp20_UnicastChannel(CanMessage msg)
             else
             {
                 //Seems fine
-                tp20_frame_count = tp20_frame_count - 2;
-                Task_Tcp_Wireshark_Raw_AddNewRawMessage(tp20_frame + 2, tp20_frame_count, msg.Id, msg.Timestamp, Raw_VWTP20);
+                Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(direction->Frame + 2, count - 2, msg.Id, msg.Timestamp, Raw_VWTP20, Passive_Vwtp20_Comment(channel, direction));
             }
         }
-        tp20_frame_count = 0;
-        flag_DatagramReceived = false;
+        Passive_Vwtp20_ClearDirection(direction);
     }
     return true;
 }
 
+void Passive_Vwtp20_Init(void)
+{
+    Passive_Can_Claim(0x200, 0x2FF, Passive_Vwtp20_Parse);
+}
+
 /**
  * @brief Parse incomming messages into VWTP2.0
 */
@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * @brief   Building of pcapng blocks (SHB, IDB, EPB) for Wireshark stream
+ *          All blocks are little endian and padded on 32 bits
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+
+#include <string.h>
+#include "Pcapng.h"
+
+// -- Private definitions
+#define BLOCK_SHB     0x0A0D0D0A
+#define BLOCK_IDB     0x00000001
+#define BLOCK_EPB     0x00000006
+
+#define OPT_ENDOFOPT  0
+#define OPT_COMMENT   1
+#define IF_TSRESOL    9
+#define EPB_FLAGS     2
+
+#define PAD32(x)      (((x) + 3) & ~3UL)
+
+static void pcapng_write_u16(uint8_t* array, uint16_t data)
+{
+  array[0] = (uint8_t)data;
+  array[1] = (uint8_t)(data >> 8);
+}
+
+static void pcapng_write_u32(uint8_t* array, uint32_t data)
+{
+  array[0] = (uint8_t)data;
+  array[1] = (uint8_t)(data >> 8);
+  array[2] = (uint8_t)(data >> 16);
+  array[3] = (uint8_t)(data >> 24);
+}
+
+static uint32_t pcapng_write_option(uint8_t* array, uint16_t code, const uint8_t* value, uint16_t length)
+{
+  pcapng_write_u16(array, code);
+  pcapng_write_u16(array + 2, length);
+  if(length == 0)
+  {
+    return 4;
+  }
+  memcpy(array + 4, value, length);
+  memset(array + 4 + length, 0, PAD32(length) - length);
+  return 4 + PAD32(length);
+}
+
+static uint32_t pcapng_close_block(uint8_t* array, uint32_t type, uint32_t position)
+{
+  //Block total length is written on start and end of block
+  uint32_t totalLength = position + 4;
+  pcapng_write_u32(array, type);
+  pcapng_write_u32(array + 4, totalLength);
+  pcapng_write_u32(array + position, totalLength);
+  return totalLength;
+}
+
+uint32_t Pcapng_SectionHeaderBlock(uint8_t* array)
+{
+  pcapng_write_u32(array + 8, 0x1A2B3C4D); //Byte order magic
+  pcapng_write_u16(array + 12, 1); //Major version
+  pcapng_write_u16(array + 14, 0); //Minor version
+  memset(array + 16, 0xFF, 8); //Section length is not specified (-1)
+  return pcapng_close_block(array, BLOCK_SHB, 24);
+}
+
+uint32_t Pcapng_InterfaceDescriptionBlock(uint8_t* array, uint16_t linkType, uint8_t tsresol)
+{
+  uint32_t position = 8;
+  pcapng_write_u16(array + position, linkType);
+  pcapng_write_u16(array + position + 2, 0); //Reserved
+  pcapng_write_u32(array + position + 4, 0xFFFF); //Snap length
+  position += 8;
+  position += pcapng_write_option(array + position, IF_TSRESOL, &tsresol, 1);
+  position += pcapng_write_option(array + position, OPT_ENDOFOPT, NULL, 0);
+  return pcapng_close_block(array, BLOCK_IDB, position);
+}
+
+uint32_t Pcapng_EnhancedPacketBlock(uint8_t* array, uint32_t interfaceId, uint64_t timestamp, uint8_t* packet, uint32_t length, uint32_t flags, const char* comment)
+{
+  uint8_t flagsValue[4];
+  uint32_t position = 8;
+  pcapng_write_u32(array + position, interfaceId);
+  pcapng_write_u32(array + position + 4, (uint32_t)(timestamp >> 32));
+  pcapng_write_u32(array + position + 8, (uint32_t)timestamp);
+  pcapng_write_u32(array + position + 12, length); //Captured length
+  pcapng_write_u32(array + position + 16, length); //Original length
+  position += 20;
+  memcpy(array + position, packet, length);
+  memset(array + position + length, 0, PAD32(length) - length);
+  position += PAD32(length);
+
+  if(flags != 0 || comment != NULL)
+  {
+    if(comment != NULL)
+    {
+      position += pcapng_write_option(array + position, OPT_COMMENT, (const uint8_t*)comment, (uint16_t)strlen(comment));
+    }
+    if(flags != 0)
+    {
+      pcapng_write_u32(flagsValue, flags);
+      position += pcapng_write_option(array + position, EPB_FLAGS, flagsValue, 4);
+    }
+    position += pcapng_write_option(array + position, OPT_ENDOFOPT, NULL, 0);
+  }
+  return pcapng_close_block(array, BLOCK_EPB, position);
+}
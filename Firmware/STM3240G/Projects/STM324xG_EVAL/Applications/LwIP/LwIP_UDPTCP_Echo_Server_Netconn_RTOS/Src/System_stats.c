@@ -40,6 +40,7 @@ static char _ipAddress[20];
 
 static uint32_t _wsSocketCan_state;
 static uint32_t _wsRaw_state;
+static uint32_t _wsPcapng_state;
 static uint32_t _kline_state;
 
 void Stats_Reset(void)
@@ -262,6 +263,22 @@ uint32_t Stats_TCP_WS_RAW_State_Get(void)
     return _wsRaw_state;
 }
 
+/**
+ * @brief Set state of Wirehsark pcapng socket
+ */
+void Stats_TCP_WS_Pcapng_State_Set(uint32_t state)
+{
+    _wsPcapng_state = state;
+}
+
+/**
+ * @brief Return state of Wirehsark pcapng socket
+ */
+uint32_t Stats_TCP_WS_Pcapng_State_Get(void)
+{
+    return _wsPcapng_state;
+}
+
 /**
  * @brief Set state of Wirehsark SocketCAN socket
  */
@@ -10,13 +10,16 @@
 #include <stdbool.h>
 #include "main.h"
 #include "Task_Tcp_Wireshark_SocketCAN.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
 #include "Task_Tcp_KlineRaw.h"
 #include "System_stats.h"
 #include "rtos_utils.h"
 #include "CanIf.h"
 #include "UartIf.h"
 
+#include "Passive_Can.h"
 #include "Passive_Iso15765.h"
+#include "Passive_J1939.h"
 #include "Passive_Vwtp20.h"
 #include "Passive_Kline.h"
 
@@ -53,6 +56,10 @@ void Task_Hub(void const* pvParameters)
     //request init UART
     uartBaudrateChange_requested = true;
     uartBaudrateChange_selector = 0;
+    //Transport protocols claim CAN IDs they expect
+    Passive_Iso15765_Init();
+    Passive_Vwtp20_Init();
+    Passive_J1939_Init();
     for(;;)
     {
         if(uartBaudrateChange_requested == true)
@@ -95,10 +102,8 @@ static void ProcessKlineElements(void)
             }
 
             //Add CAN element into TCP ring buffer as socket CAN (if socket CAN is connected)
-            if(Stats_TCP_WS_RAW_State_Get() != 0)
-            {
-                Passive_Kline_Parse(c);
-            }
+            //Parser runs always, so datagrams are in history when Wireshark connects
+            Passive_Kline_Parse(c);
             if(Stats_TCP_KLINE_State_Get() != 0)
             {
                 Task_Tcp_Kline_AddNewByte(c);
@@ -134,19 +139,12 @@ static void ProcessCanElements(void)
             {
                 Task_Tcp_Wireshark_SocketCAN_AddNewCanMessage(cmsg);
             }
-            if(Stats_TCP_WS_RAW_State_Get() != 0)
-            {
-                //Try to process CAN element in ISO15765 passive protocol
-                if(Passive_Iso15765_Parse(cmsg) == true)
-                {
-                    continue;
-                }
-                //Try to process CAN element in VWTP20 passive protocol
-                if(Passive_Vwtp20_Parse(cmsg) == true)
-                {
-                    continue;
-                }
-            }
+            //pcapng keeps history also without connection
+            Task_Tcp_Wireshark_Pcapng_AddNewCanMessage(cmsg);
+            
+            //Parsers run always, so datagrams are in history when Wireshark connects
+            //CAN element is passed only into protocol which has claimed its ID
+            Passive_Can_Parse(cmsg);
         }
     }
     while(pduElements > 0);
@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * @brief   Implementation of sending of SocketCAN and RAW packets into Wireshark
+ *          multiplexed in one pcapng stream. Every link layer has own interface.
+ *          Blocks are kept in history ring also without connection, new client
+ *          gets last seconds of traffic before live data.
+ ******************************************************************************
+ * @attention
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "Pcapng.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
+#include "Task_Tcp_Wireshark_SocketCAN.h"
+#include "System_stats.h"
+#include "Clock.h"
+#include "lwip/opt.h"
+
+#include "FreeRTOS.h"
+#include "cmsis_os.h"
+
+#if LWIP_NETCONN
+
+#include "lwip/sys.h"
+#include "lwip/api.h"
+
+#define TCPECHO_THREAD_PRIO  ( tskIDLE_PRIORITY + 4 )
+
+//Interface IDs are given by order of IDBs sent after connection
+#define IF_SOCKETCAN         0
+#define IF_RAW               1
+
+#define COMMENT_MAX_LENGTH   64
+
+#ifndef PCAPNG_HISTORY_SIZE
+#define PCAPNG_HISTORY_SIZE  (16 * 1024)       //History ring, can be changed in project settings
+#endif
+#define HISTORY_TIME_US      (10 * 1000000ULL) //How old blocks are replayed to new client
+
+#define BLOCK_MAX_LENGTH     (PCAPNG_EPB_OVERHEAD + 4116 + COMMENT_MAX_LENGTH) //4096 of data + 20 bytes of IPv4 header
+
+// -- Private Variables ---------------------------------
+static u8_t fileHeader[PCAPNG_SHB_LENGTH + 2 * PCAPNG_IDB_LENGTH];
+static u8_t block[BLOCK_MAX_LENGTH];       //Block being added into history, guarded by historyMutex
+static u8_t packet[4116];                  //Packet being added into history, guarded by historyMutex
+static u8_t sendBuffer[BLOCK_MAX_LENGTH];  //Blocks copied from history for sending
+
+static u8_t  history[PCAPNG_HISTORY_SIZE]; //Ring of serialized EPBs
+static u32_t historyHead = 0;    //Amount of bytes ever written, position of next block is historyHead % PCAPNG_HISTORY_SIZE
+static u32_t historyTail = 0;    //Position of oldest block in history
+static osMutexId historyMutex = NULL;
+
+static void history_copy_in(u32_t position, const u8_t* data, u32_t length)
+{
+  u32_t offset = position % PCAPNG_HISTORY_SIZE;
+  u32_t first = PCAPNG_HISTORY_SIZE - offset;
+  if(first >= length)
+  {
+    memcpy(history + offset, data, length);
+  }
+  else
+  {
+    memcpy(history + offset, data, first);
+    memcpy(history, data + first, length - first);
+  }
+}
+
+static void history_copy_out(u32_t position, u8_t* data, u32_t length)
+{
+  u32_t offset = position % PCAPNG_HISTORY_SIZE;
+  u32_t first = PCAPNG_HISTORY_SIZE - offset;
+  if(first >= length)
+  {
+    memcpy(data, history + offset, length);
+  }
+  else
+  {
+    memcpy(data, history + offset, first);
+    memcpy(data + first, history, length - first);
+  }
+}
+
+static u32_t history_block_length(u32_t position)
+{
+  u32_t length;
+  history_copy_out(position + 4, (u8_t*)&length, 4);
+  return length;
+}
+
+static uint64_t history_block_timestamp(u32_t position)
+{
+  u32_t timestamp[2]; //High and low part
+  history_copy_out(position + 12, (u8_t*)timestamp, 8);
+  return ((uint64_t)timestamp[0] << 32) | timestamp[1];
+}
+
+/**
+ * @brief Move block prepared in block[] into history. Oldest blocks are overwritten.
+ *        Caller must hold historyMutex.
+ */
+static void history_add(u32_t length)
+{
+  while(historyHead - historyTail + length > PCAPNG_HISTORY_SIZE)
+  {
+    historyTail += history_block_length(historyTail);
+  }
+  history_copy_in(historyHead, block, length);
+  historyHead += length;
+}
+
+/*-----------------------------------------------------------------------------------*/
+static void tcpwspcapng_thread(void *arg)
+{
+  struct netconn *conn, *newconn;
+  err_t err, accept_err;
+  u32_t headerLength;
+  u32_t sendLength;
+  u32_t blockLength;
+  u32_t cursor;
+  uint64_t since;
+
+  LWIP_UNUSED_ARG(arg);
+
+  /* Create a new connection identifier. */
+  conn = netconn_new(NETCONN_TCP);
+
+  if (conn!=NULL)
+  {
+    /* Bind connection to 19003. */
+    err = netconn_bind(conn, NULL, 19003);
+
+    if (err == ERR_OK)
+    {
+      /* Tell connection to go into listening mode. */
+      netconn_listen(conn);
+
+      while (1)
+      {
+        /* Grab new connection. */
+        accept_err = netconn_accept(conn, &newconn);
+
+        /* Process the new connection. */
+        if (accept_err == ERR_OK)
+        {
+          //Show on LCD that we have connection
+          Stats_TCP_WS_Pcapng_State_Set(1);
+          printf("PCAPNG Connection established\n");
+
+          //Write section header and one interface per link layer to init Wireshark
+          headerLength = Pcapng_SectionHeaderBlock(fileHeader);
+          headerLength += Pcapng_InterfaceDescriptionBlock(fileHeader + headerLength, PCAPNG_LINKTYPE_CAN_SOCKETCAN, PCAPNG_TSRESOL_US);
+          headerLength += Pcapng_InterfaceDescriptionBlock(fileHeader + headerLength, PCAPNG_LINKTYPE_RAW, PCAPNG_TSRESOL_US);
+          netconn_write(newconn, fileHeader, headerLength, NETCONN_COPY);
+
+          //Start with oldest block which is not older than HISTORY_TIME_US
+          since = Clock_GetTime_us();
+          since = since > HISTORY_TIME_US ? since - HISTORY_TIME_US : 0;
+          osMutexWait(historyMutex, osWaitForever);
+          cursor = historyTail;
+          while(cursor != historyHead && history_block_timestamp(cursor) < since)
+          {
+            cursor += history_block_length(cursor);
+          }
+          osMutexRelease(historyMutex);
+
+          //Write history and then live blocks into TCP stream in endless loop
+          while (netconn_err(newconn) == ERR_OK)
+          {
+            //Copy as many whole blocks as fits into send buffer
+            sendLength = 0;
+            osMutexWait(historyMutex, osWaitForever);
+            if(historyHead - cursor > historyHead - historyTail)
+            {
+              //Blocks for this client were overwritten, continue with oldest one
+              cursor = historyTail;
+            }
+            while(cursor != historyHead)
+            {
+              blockLength = history_block_length(cursor);
+              if(sendLength + blockLength > sizeof(sendBuffer))
+              {
+                break;
+              }
+              history_copy_out(cursor, sendBuffer + sendLength, blockLength);
+              sendLength += blockLength;
+              cursor += blockLength;
+            }
+            osMutexRelease(historyMutex);
+
+            if(sendLength > 0)
+            {
+              netconn_write(newconn, sendBuffer, sendLength, NETCONN_COPY);
+              //Send all blocks in history on TCP
+              continue;
+            }
+            //Mandatory. Give RTOS chance to yield tasks. taskYIELD crashes whole RTOS from some reason
+            osDelay(10);
+          }
+          printf("PCAPNG Connection closed\n");
+
+          /* Close connection and discard connection identifier. */
+          netconn_close(newconn);
+          netconn_delete(newconn);
+          Stats_TCP_WS_Pcapng_State_Set(0);
+        }
+      }
+    }
+    else
+    {
+      netconn_delete(newconn);
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+
+void Task_Tcp_Wireshark_Pcapng_Init(void)
+{
+  osMutexDef(PCAPNG_HISTORY);
+  historyMutex = osMutexCreate(osMutex(PCAPNG_HISTORY));
+  sys_thread_new("tcpwspcapng_thread", tcpwspcapng_thread, NULL, DEFAULT_THREAD_STACKSIZE, TCPECHO_THREAD_PRIO);
+}
+
+void Task_Tcp_Wireshark_Pcapng_AddNewCanMessage(CanMessage cmsg)
+{
+  u32_t blockLength;
+  if(historyMutex == NULL)
+  {
+    return;
+  }
+  osMutexWait(historyMutex, osWaitForever);
+  memset(packet, 0, 16);
+  Task_Tcp_Wireshark_SocketCAN_PreparePacket(&cmsg, packet);
+  blockLength = Pcapng_EnhancedPacketBlock(block, IF_SOCKETCAN, cmsg.Timestamp, packet, 16, 0, NULL);
+  history_add(blockLength);
+  osMutexRelease(historyMutex);
+}
+
+void Task_Tcp_Wireshark_Pcapng_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment)
+{
+  RawMessage rmsg;
+  u32_t packetLength;
+  u32_t blockLength;
+  if(historyMutex == NULL || length > 4096)
+  {
+    return;
+  }
+  if(comment != NULL && strlen(comment) > COMMENT_MAX_LENGTH)
+  {
+    comment = NULL;
+  }
+  rmsg.Frame = frame;
+  rmsg.Length = length;
+  rmsg.Id = id;
+  rmsg.Timestamp = timestamp;
+  rmsg.MessageType = msgType;
+
+  osMutexWait(historyMutex, osWaitForever);
+  packetLength = Task_Tcp_Wireshark_Raw_PreparePacket(&rmsg, packet, 0);
+  blockLength = Pcapng_EnhancedPacketBlock(block, IF_RAW, timestamp, packet, packetLength, 0, comment);
+  history_add(blockLength);
+  osMutexRelease(historyMutex);
+}
+/*-----------------------------------------------------------------------------------*/
+
+#endif /* LWIP_NETCONN */
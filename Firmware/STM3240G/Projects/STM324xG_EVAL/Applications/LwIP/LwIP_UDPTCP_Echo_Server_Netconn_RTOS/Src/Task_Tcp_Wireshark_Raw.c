@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include "Task_Tcp_Wireshark_Raw.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
 #include "System_stats.h"
 #include "lwip/opt.h"
 
@@ -47,9 +48,8 @@ static void tcpswraw_prepare_header(RawMessage rmsg, u8_t* array)
   u32_t timestamp_microseconds;
 
   //Prepare timestamp
-  timestamp_seconds = (uint32_t)(rmsg.Timestamp / 1000); //Only second part (I know there should be Unix time, but I am too lazy to get RTC or NTP working)
-  timestamp_microseconds = (uint32_t)(rmsg.Timestamp % 1000); //Only remainder from seconds
-  timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+  timestamp_seconds = (uint32_t)(rmsg.Timestamp / 1000000); //Unix time seconds
+  timestamp_microseconds = (uint32_t)(rmsg.Timestamp % 1000000); //Only remainder from seconds
   //Store timestamp
   *(u32_t*)array = timestamp_seconds;
   *(u32_t*)(array + 4) = timestamp_microseconds;
@@ -59,9 +59,9 @@ static void tcpswraw_prepare_header(RawMessage rmsg, u8_t* array)
   *(u32_t*)(array + 12) = rmsg.Length + 20;
 }
 
-static int tcpswraw_prepare_body(RawMessage rmsg, u8_t* array, u16_t sequence)
+int Task_Tcp_Wireshark_Raw_PreparePacket(RawMessage* rmsg, u8_t* array, u16_t sequence)
 {
-  int totalLength = rmsg.Length + 20;
+  int totalLength = rmsg->Length + 20;
   array[0] = 0x45; //Version 4, 5 words (5*4=20 bytes)
   array[1] = 0x00; //Differential services
   array[2] = (u8_t)(totalLength >> 8); //Total size
@@ -71,19 +71,19 @@ static int tcpswraw_prepare_body(RawMessage rmsg, u8_t* array, u16_t sequence)
   array[6] = 0x40; //Don't fragment
   array[7] = 0x00;
   array[8] = 0x80; //TTL
-  array[9] = (u8_t)(rmsg.MessageType); //Undefined protocol. Used together with datagrams
+  array[9] = (u8_t)(rmsg->MessageType); //Undefined protocol. Used together with datagrams
   array[10] = 0x00; //Header checksum (disabled)
   array[11] = 0x00;
   array[12] = 192; //Source
   array[13] = 168;
   array[14] = 0;
   array[15] = 1;
-  array[16] = (u8_t)(rmsg.Id >> 24); //Destination
-  array[17] = (u8_t)(rmsg.Id >> 16);
-  array[18] = (u8_t)(rmsg.Id >> 8);
-  array[19] = (u8_t)(rmsg.Id);
+  array[16] = (u8_t)(rmsg->Id >> 24); //Destination
+  array[17] = (u8_t)(rmsg->Id >> 16);
+  array[18] = (u8_t)(rmsg->Id >> 8);
+  array[19] = (u8_t)(rmsg->Id);
   //Data
-  memcpy(&array[20], rmsg.Frame, rmsg.Length);
+  memcpy(&array[20], rmsg->Frame, rmsg->Length);
   return totalLength;
 }
 
@@ -170,7 +170,7 @@ static void tcpwsraw_thread(void *arg)
               netconn_write(newconn, packetHeader, 16, NETCONN_COPY);
 							
               //Write packet data
-              packetBody_Lenght = tcpswraw_prepare_body(rmsg, packetBody, sequence);
+              packetBody_Lenght = Task_Tcp_Wireshark_Raw_PreparePacket(&rmsg, packetBody, sequence);
 							//printf("Send Raw packet %x\n", packetBody_Lenght);
               netconn_write(newconn, packetBody, packetBody_Lenght, NETCONN_COPY);
 
@@ -209,9 +209,20 @@ void Task_Tcp_Wireshark_Raw_Init(void)
   sys_thread_new("tcpwsraw_thread", tcpwsraw_thread, NULL, DEFAULT_THREAD_STACKSIZE, TCPECHO_THREAD_PRIO);
 }
 
-void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint32_t timestamp, RawMessageType msgType)
+void Task_Tcp_Wireshark_Raw_AddNewRawMessage(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType)
+{
+  Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(frame, length, id, timestamp, msgType, NULL);
+}
+
+void Task_Tcp_Wireshark_Raw_AddNewRawMessageWithComment(uint8_t* frame, uint32_t length, uint32_t id, uint64_t timestamp, RawMessageType msgType, const char* comment)
 {
 	int i;
+  //Same datagram goes also into pcapng history
+  Task_Tcp_Wireshark_Pcapng_AddNewRawMessage(frame, length, id, timestamp, msgType, comment);
+  if(Stats_TCP_WS_RAW_State_Get() == 0)
+  {
+    return;
+  }
   //Write down data into ring buffer for sending
 	tcp_rawMessageFifo[tcp_rawFifo_writePtr].MessageType = msgType;
 	tcp_rawMessageFifo[tcp_rawFifo_writePtr].Id = id;
@@ -49,24 +49,23 @@ static void tcpswcan_prepare_header(CanMessage cmsg, u8_t* array)
   u32_t timestamp_microseconds;
 
   //Prepare timestamp
-  timestamp_seconds = (uint32_t)(cmsg.Timestamp / 1000); //Only second part (I know there should be Unix time, but I am too lazy to get RTC or NTP working)
-  timestamp_microseconds = (uint32_t)(cmsg.Timestamp % 1000); //Only remainder from seconds
-  timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+  timestamp_seconds = (uint32_t)(cmsg.Timestamp / 1000000); //Unix time seconds
+  timestamp_microseconds = (uint32_t)(cmsg.Timestamp % 1000000); //Only remainder from seconds
   //Store timestamp
   *(u32_t*)array = timestamp_seconds;
   *(u32_t*)(array + 4) = timestamp_microseconds;
 }
 
-static void tcpswcan_prepare_body(CanMessage cmsg, u8_t* array)
+void Task_Tcp_Wireshark_SocketCAN_PreparePacket(CanMessage* cmsg, u8_t* array)
 {
-  array[0] = (u8_t)(cmsg.Id >> 24);
-  array[1] = (u8_t)(cmsg.Id >> 16);
-  array[2] = (u8_t)(cmsg.Id >> 8);
-  array[3] = (u8_t)cmsg.Id;
+  array[0] = (u8_t)(cmsg->Id >> 24);
+  array[1] = (u8_t)(cmsg->Id >> 16);
+  array[2] = (u8_t)(cmsg->Id >> 8);
+  array[3] = (u8_t)cmsg->Id;
   //DLC
-  array[4] = cmsg.Dlc;
+  array[4] = cmsg->Dlc;
   //Data
-  memcpy(&array[8], cmsg.Frame, cmsg.Dlc);
+  memcpy(&array[8], cmsg->Frame, cmsg->Dlc);
 }
 
 static void tcpswcan_fifo_reset()
@@ -148,7 +147,7 @@ static void tcpwscan_thread(void *arg)
               netconn_write(newconn, packetHeader, 16, NETCONN_COPY);
 
               //Write packet data
-              tcpswcan_prepare_body(cmsg, packetBody);
+              Task_Tcp_Wireshark_SocketCAN_PreparePacket(&cmsg, packetBody);
               netconn_write(newconn, packetBody, 16, NETCONN_COPY);
 
               //Move to next packet
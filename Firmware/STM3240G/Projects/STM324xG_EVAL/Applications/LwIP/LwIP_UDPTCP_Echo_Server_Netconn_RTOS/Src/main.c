@@ -58,9 +58,11 @@
 #include "Task_Hub.h"
 #include "Task_Tcp_Wireshark_SocketCAN.h"
 #include "Task_Tcp_Wireshark_Raw.h"
+#include "Task_Tcp_Wireshark_Pcapng.h"
 #include "Task_Tcp_KlineRaw.h"
 #include "System_stats.h"
 #include "rtos_utils.h"
+#include "Clock.h"
 #include "Passive_Printf.h"
 #include "ButtonIf.h"
 
@@ -142,6 +144,9 @@ static void StartThread(void const * argument)
   
   /* Initialize the LwIP stack */
   Netif_Config();
+
+  //Start SNTP, timestamps are in Unix time after first synchronization
+  Clock_Init();
   
   /* Initialize tcp echo server */
   //tcpecho_init();
@@ -154,6 +159,9 @@ static void StartThread(void const * argument)
 
   //Initialize Socket CAN for Wireshark on port 19001
   Task_Tcp_Wireshark_SocketCAN_Init();
+
+  //Initialize pcapng (Socket CAN + RAW) for Wireshark on port 19003
+  Task_Tcp_Wireshark_Pcapng_Init();
   
   /* Notify user about the network interface config */
   User_notification(&gnetif);
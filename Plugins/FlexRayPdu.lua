@@ -0,0 +1,59 @@
+-- FlexRay PDU split from frame by WTM according to FIBEX
+-- Datagram: [Slot (2 bytes, LE)][Cycle][Channel][Data of PDU], destination IP address is index of PDU in FIBEX
+-- constants
+local frpdu_header_len = 4
+
+local frpdu_channel_name = {
+    [0] = "A",
+    [1] = "B",
+}
+
+-- fields
+local frpdu_slot = ProtoField.uint16("frpdu.slot", "Slot", base.DEC)
+local frpdu_cycle = ProtoField.uint8("frpdu.cycle", "Cycle", base.DEC)
+local frpdu_channel = ProtoField.uint8("frpdu.channel", "Channel", base.DEC, frpdu_channel_name)
+local frpdu_length = ProtoField.uint16("frpdu.length", "PDU Length", base.DEC)
+local frpdu_data = ProtoField.new("Data", "frpdu.data", ftypes.BYTES)
+
+-- declare dissector
+local frpdu_dissector = Proto.new("frpdu", "FlexRay PDU")
+
+frpdu_dissector.fields = {
+    frpdu_slot,
+    frpdu_cycle,
+    frpdu_channel,
+    frpdu_length,
+    frpdu_data,
+}
+
+function frpdu_dissector.dissector(tvbuf,pktinfo,root)
+    -- set the protocol column to show our protocol name
+    pktinfo.cols.protocol:set("FR PDU")
+    local pktlen = tvbuf:reported_length_remaining()
+    local tree = root:add(frpdu_dissector, tvbuf:range(0,pktlen))
+    if pktlen < frpdu_header_len then
+        return
+    end
+
+    -- Parse header
+    local slot = tvbuf:range(0,2):le_uint()
+    local cycle = tvbuf:range(2,1):uint()
+    local channel = tvbuf:range(3,1):uint()
+    tree:add_le(frpdu_slot, tvbuf:range(0,2))
+    tree:add(frpdu_cycle, tvbuf:range(2,1))
+    tree:add(frpdu_channel, tvbuf:range(3,1))
+    tree:add(frpdu_length, pktlen - frpdu_header_len)
+
+    -- Show data, if there are any
+    if pktlen > frpdu_header_len then
+        tree:add(frpdu_data, tvbuf:range(frpdu_header_len, pktlen - frpdu_header_len))
+    end
+
+    --Show packet information in info column, i.e. `PDU 12, slot 5:1 A, 4 bytes`
+    local pdu = pktinfo.dst
+    pktinfo.cols.info = string.format("PDU %s, slot %d:%d %s, %d bytes", tostring(pdu), slot, cycle, frpdu_channel_name[channel] or "?", pktlen - frpdu_header_len)
+end
+
+--Asign to protocol 0x96: FlexRay PDU
+local ipProtocol = DissectorTable.get("ip.proto")
+ipProtocol:add(0x96, frpdu_dissector)
@@ -0,0 +1,60 @@
+-- LUA bitwise operations: https://www.lua.org/manual/5.2/manual.html#6.7
+-- ISO9141-2 frame: priority, target, source, data (up to 7 bytes) and checksum
+
+-- fields
+local iso_prio = ProtoField.uint8("iso9141.prio", "Priority", base.HEX)
+local iso_tgt = ProtoField.uint8("iso9141.tgt", "Target Address", base.HEX)
+local iso_src = ProtoField.uint8("iso9141.src", "Source Address", base.HEX)
+local iso_data = ProtoField.new("Data", "iso9141.data", ftypes.BYTES)
+local iso_cs = ProtoField.uint8("iso9141.cs", "Checksum", base.HEX)
+local iso_cs_valid = ProtoField.string("iso9141.cs.status", "Checksum status")
+
+-- declare dissector
+local iso9141_dissector = Proto.new("iso9141", "ISO9141")
+
+iso9141_dissector.fields = {
+    iso_prio,
+    iso_tgt,
+    iso_src,
+    iso_data,
+    iso_cs,
+    iso_cs_valid,
+}
+
+function iso9141_dissector.dissector(tvbuf,pktinfo,root)
+    -- set the protocol column to show our protocol name
+    pktinfo.cols.protocol:set("ISO9141")
+    local pktlen = tvbuf:reported_length_remaining()
+    local tree = root:add(iso9141_dissector, tvbuf:range(0,pktlen))
+    if(pktlen < 4) then
+        tree:add(iso_data, tvbuf:range(0,pktlen))
+        return
+    end
+
+    tree:add(iso_prio, tvbuf:range(0,1))
+    tree:add(iso_tgt, tvbuf:range(1,1))
+    tree:add(iso_src, tvbuf:range(2,1))
+    if(pktlen > 4) then
+        tree:add(iso_data, tvbuf:range(3,pktlen - 4))
+        pktinfo.cols.info = "[" .. string.upper(tostring(tvbuf:range(3,pktlen - 4))) .. "]"
+    end
+
+    -- calculate checksum
+    local cs = 0
+    for i=0,pktlen-2,1
+    do
+        cs = cs + tvbuf:range(i,1):uint()
+    end
+    cs = bit32.band(cs, 0xFF)
+    local stored_cs = tvbuf:range(pktlen - 1,1):uint()
+    tree:add(iso_cs, tvbuf:range(pktlen - 1,1))
+    if cs == stored_cs then
+        tree:add(iso_cs_valid, "Good")
+    else
+        tree:add(iso_cs_valid, "Bad")
+    end
+end
+
+--Asign to protocol 0x97: ISO9141
+local ipProtocol = DissectorTable.get("ip.proto")
+ipProtocol:add(0x97, iso9141_dissector)
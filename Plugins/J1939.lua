@@ -0,0 +1,73 @@
+-- J1939 transport protocol (TP.CM / TP.DT) datagram reassembled by WTM
+-- Datagram: [PGN (3 bytes, LE)][Source address][Destination address][Data]
+-- constants
+local j1939_header_len = 5
+
+local j1939_pgn_name = {
+    [0xDA00] = "ISO15765 (Normal fixed addressing)",
+    [0xEA00] = "Request",
+    [0xEE00] = "Address Claimed",
+    [0xFECA] = "DM1 - Active Diagnostic Trouble Codes",
+    [0xFECB] = "DM2 - Previously Active Diagnostic Trouble Codes",
+    [0xFECC] = "DM3 - Diagnostic Data Clear",
+    [0xFED3] = "DM6 - Pending DTCs",
+    [0xFED4] = "DM7 - Command Non-continuously Monitored Test",
+    [0xFED5] = "DM11 - Diagnostic Data Clear Active DTCs",
+    [0xFEDA] = "SOFT - Software Identification",
+    [0xFEEB] = "CI - Component Identification",
+    [0xFEEC] = "VI - Vehicle Identification",
+    [0xFDC5] = "ECUID - ECU Identification",
+}
+
+-- fields
+local j1939_pgn = ProtoField.uint24("j1939tp.pgn", "PGN", base.HEX, j1939_pgn_name)
+local j1939_sa = ProtoField.uint8("j1939tp.sa", "Source Address", base.HEX)
+local j1939_da = ProtoField.uint8("j1939tp.da", "Destination Address", base.HEX) --0xFF for BAM (global)
+local j1939_length = ProtoField.uint16("j1939tp.length", "Payload Length", base.DEC)
+local j1939_data = ProtoField.new("Data", "j1939tp.data", ftypes.BYTES)
+
+-- declare dissector
+local j1939_dissector = Proto.new("j1939tp", "J1939 TP")
+
+j1939_dissector.fields = {
+    j1939_pgn,
+    j1939_sa,
+    j1939_da,
+    j1939_length,
+    j1939_data,
+}
+
+function j1939_dissector.dissector(tvbuf,pktinfo,root)
+    -- set the protocol column to show our protocol name
+    pktinfo.cols.protocol:set("J1939")
+    local pktlen = tvbuf:reported_length_remaining()
+    local tree = root:add(j1939_dissector, tvbuf:range(0,pktlen))
+    if pktlen < j1939_header_len then
+        return
+    end
+
+    -- Parse header
+    local pgn = tvbuf:range(0,3):le_uint()
+    local sa = tvbuf:range(3,1):uint()
+    local da = tvbuf:range(4,1):uint()
+    tree:add_le(j1939_pgn, tvbuf:range(0,3))
+    tree:add(j1939_sa, tvbuf:range(3,1))
+    tree:add(j1939_da, tvbuf:range(4,1))
+    tree:add(j1939_length, pktlen - j1939_header_len)
+
+    -- Show data, if there are any
+    if pktlen > j1939_header_len then
+        tree:add(j1939_data, tvbuf:range(j1939_header_len, pktlen - j1939_header_len))
+    end
+
+    --Show packet information in info column, i.e. `PGN 0xFECA (DM1 - Active Diagnostic Trouble Codes) 00 -> FF, 20 bytes`
+    local info = string.format("PGN 0x%04X", pgn)
+    if j1939_pgn_name[pgn] ~= nil then
+        info = info .. " (" .. j1939_pgn_name[pgn] .. ")"
+    end
+    pktinfo.cols.info = info .. string.format(" %02X -> %02X, %d bytes", sa, da, pktlen - j1939_header_len)
+end
+
+--Asign to protocol 0x95: J1939
+local ipProtocol = DissectorTable.get("ip.proto")
+ipProtocol:add(0x95, j1939_dissector)
@@ -0,0 +1,174 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+
+namespace WTM.Bench
+{
+    /// <summary>
+    /// FlexRay CRCs calculated by lookup tables (FlexRayCrc) against bit by bit calculation as written in specification.
+    /// Both are checked to give the same CRCs on random frames, then throughput of header CRC, frame CRC
+    /// and whole verification of FlexRayMessage is measured.
+    /// </summary>
+    internal static class Bench_FlexRayCrc
+    {
+        const int HEADER_POLYNOMIAL = 0x385;
+        const int HEADER_INIT = 0x01A;
+        const int FRAME_POLYNOMIAL = 0x5D6DCB;
+        const int FRAME_INIT_A = 0xFEDCBA;
+        const int FRAME_INIT_B = 0xABCDEF;
+        const int CHECKED_FRAMES = 10000;
+
+        public static int Run(string[] args)
+        {
+            int frames = args.Length > 0 ? int.Parse(args[0]) : 1000000;
+            Random random = new Random(1);
+
+            for (int i = 0; i < CHECKED_FRAMES; i++)
+            {
+                bool sync = random.Next(2) != 0;
+                bool startup = random.Next(2) != 0;
+                int frameId = random.Next(1, 2048);
+                byte[] payload = new byte[random.Next(128) * 2];
+                random.NextBytes(payload);
+                byte[] header = new byte[5];
+                random.NextBytes(header);
+                bool channelB = random.Next(2) != 0;
+                if (FlexRayCrc.Header(sync, startup, frameId, payload.Length / 2) != HeaderBitwise(sync, startup, frameId, payload.Length / 2)
+                    || FlexRayCrc.Frame(header, payload, channelB) != FrameBitwise(header, payload, channelB))
+                {
+                    Console.WriteLine($"CRC mismatch on frame {frameId}");
+                    return -1;
+                }
+            }
+            Console.WriteLine($"Checked:      {CHECKED_FRAMES} frames, table equals bitwise");
+
+            //First round only lets JIT optimize the loops
+            TextWriter console = Console.Out;
+            Console.SetOut(TextWriter.Null);
+            Measure(Math.Max(1, frames / 10));
+            Console.SetOut(console);
+            Measure(frames);
+            return 0;
+        }
+
+        static void Measure(int frames)
+        {
+            MeasureHeader(frames);
+            foreach (int length in new[] { 16, 64, 254 })
+            {
+                MeasureFrame(frames, length);
+            }
+            MeasureMessage(frames, 32);
+        }
+
+        static void MeasureHeader(int frames)
+        {
+            int sum = 0;
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                sum += FlexRayCrc.Header((i & 1) != 0, (i & 2) != 0, i & 0x7FF, i & 0x7F);
+            }
+            double table = Elapsed(sw, frames);
+            sw.Restart();
+            for (int i = 0; i < frames; i++)
+            {
+                sum += HeaderBitwise((i & 1) != 0, (i & 2) != 0, i & 0x7FF, i & 0x7F);
+            }
+            double bitwise = Elapsed(sw, frames);
+            Console.WriteLine($"Header:       {table:F1} ns table, {bitwise:F1} ns bitwise ({sum & 1})");
+        }
+
+        static void MeasureFrame(int frames, int length)
+        {
+            byte[] header = { 0x00, 0x2A, 0x20, 0x00, 0x01 };
+            byte[] payload = new byte[length];
+            new Random(2).NextBytes(payload);
+            int sum = 0;
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                sum += FlexRayCrc.Frame(header, payload, (i & 1) != 0);
+            }
+            double table = Elapsed(sw, frames);
+            //Bitwise is an order slower, fewer rounds are enough
+            int rounds = Math.Max(1, frames / 10);
+            sw.Restart();
+            for (int i = 0; i < rounds; i++)
+            {
+                sum += FrameBitwise(header, payload, (i & 1) != 0);
+            }
+            double bitwise = Elapsed(sw, rounds);
+            double mbps = (header.Length + length) * 1000.0 / table;
+            Console.WriteLine($"Frame {length,3} B:  {table:F1} ns table ({mbps:F0} MB/s), {bitwise:F1} ns bitwise ({sum & 1})");
+        }
+
+        /// <summary>
+        /// Verification as done for every received frame, including creation of header
+        /// </summary>
+        static void MeasureMessage(int frames, int length)
+        {
+            FlexRayMessage msg = new FlexRayMessage();
+            msg.FrameId = 42;
+            msg.PayloadLength = length / 2;
+            msg.Data = new byte[length];
+            msg.HeaderCrc = FlexRayCrc.Header(false, false, msg.FrameId, msg.PayloadLength);
+            msg.Crc = FlexRayCrc.Frame(msg.GetHeader(), msg.Data, false);
+            int valid = 0;
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                //Any change of property drops cached result, so every round verifies again
+                msg.Channel = FlexRayChannel.A;
+                if (msg.IsMessageValid())
+                {
+                    valid++;
+                }
+            }
+            double time = Elapsed(sw, frames);
+            Console.WriteLine($"Message {length,2} B: {time:F1} ns per verification, {valid} valid");
+        }
+
+        static double Elapsed(Stopwatch sw, int rounds)
+        {
+            return sw.Elapsed.TotalMilliseconds * 1000000 / rounds;
+        }
+
+        static int HeaderBitwise(bool sync, bool startup, int frameId, int payloadLength)
+        {
+            int bits = (sync ? 1 << 19 : 0) | (startup ? 1 << 18 : 0) | (frameId & 0x7FF) << 7 | (payloadLength & 0x7F);
+            int crc = HEADER_INIT;
+            for (int i = 19; i >= 0; i--)
+            {
+                int feedback = ((crc >> 10) ^ (bits >> i)) & 1;
+                crc = (crc << 1) & 0x7FF;
+                if (feedback != 0)
+                {
+                    crc ^= HEADER_POLYNOMIAL;
+                }
+            }
+            return crc;
+        }
+
+        static int FrameBitwise(byte[] header, byte[] payload, bool channelB)
+        {
+            int crc = channelB ? FRAME_INIT_B : FRAME_INIT_A;
+            foreach (byte[] data in new[] { header, payload })
+            {
+                foreach (byte b in data)
+                {
+                    for (int i = 7; i >= 0; i--)
+                    {
+                        int feedback = ((crc >> 23) ^ (b >> i)) & 1;
+                        crc = (crc << 1) & 0xFFFFFF;
+                        if (feedback != 0)
+                        {
+                            crc ^= FRAME_POLYNOMIAL;
+                        }
+                    }
+                }
+            }
+            return crc;
+        }
+    }
+}
@@ -0,0 +1,136 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+using System.Threading;
+using WTM.Protocols;
+
+namespace WTM.Bench
+{
+    /// <summary>
+    /// Dispatch of CAN frames into transport protocols. Routing by claimed IDs (Passive_Can_Pipeline) is compared
+    /// with trying ISO15765, VWTP2.0 and J1939 one after another, which was used before the pipeline.
+    /// IDs are claimed and released by other thread during the run, as it happens when CAN IDs file is changed.
+    /// </summary>
+    internal static class Bench_Pipeline
+    {
+        const int POOL_SIZE = 65536;
+
+        public static int Run(string[] args)
+        {
+            int frames = args.Length > 0 ? int.Parse(args[0]) : 5000000;
+            CanMessage[] traffic = Traffic();
+
+            //Protocols write about broken transfers, console would be measured instead of dispatch
+            TextWriter console = Console.Out;
+            Console.SetOut(TextWriter.Null);
+            long sequentialDatagrams, pipelineDatagrams, claims;
+            double sequential = Sequential(traffic, frames, out sequentialDatagrams);
+            double pipeline = Pipeline(traffic, frames, out pipelineDatagrams, out claims);
+            Console.SetOut(console);
+
+            Console.WriteLine($"Frames:     {frames}");
+            Console.WriteLine($"Sequential: {sequential:F1} ns/frame, {sequentialDatagrams} datagrams");
+            Console.WriteLine($"Pipeline:   {pipeline:F1} ns/frame, {pipelineDatagrams} datagrams, {claims} claims meanwhile");
+            return 0;
+        }
+
+        /// <summary>
+        /// Mix of bus: periodic frames, ISO15765 on 7E0/7E8, VWTP2.0 channel setup and J1939 broadcasts
+        /// </summary>
+        static CanMessage[] Traffic()
+        {
+            Random random = new Random(1);
+            CanMessage[] traffic = new CanMessage[POOL_SIZE];
+            for (int i = 0; i < traffic.Length; i++)
+            {
+                byte[] data = new byte[8];
+                random.NextBytes(data);
+                int kind = random.Next(100);
+                if (kind < 8)
+                {
+                    //Single frame request and response
+                    data[0] = 0x02;
+                    traffic[i] = new CanMessage(data, (kind & 1) == 0 ? 0x7E0 : 0x7E8);
+                }
+                else if (kind < 10)
+                {
+                    //Channel setup of VWTP2.0
+                    data[1] = 0xC0;
+                    traffic[i] = new CanMessage(data, 0x200 + random.Next(0x20));
+                }
+                else if (kind < 15)
+                {
+                    traffic[i] = new CanMessage(data, 0x18FEF100 | random.Next(0x100));
+                }
+                else
+                {
+                    traffic[i] = new CanMessage(data, 0x300 + random.Next(0x400));
+                }
+            }
+            return traffic;
+        }
+
+        static double Sequential(CanMessage[] traffic, int frames, out long datagrams)
+        {
+            Passive_ISO15765 isotp = new Passive_ISO15765();
+            Passive_VWTP20 vwtp20 = new Passive_VWTP20();
+            Passive_J1939 j1939 = new Passive_J1939();
+            long count = 0;
+            isotp.OnRawFrame += (s, e) => count++;
+            vwtp20.OnRawFrame += (s, e) => count++;
+            j1939.OnRawFrame += (s, e) => count++;
+
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                CanMessage cmsg = traffic[i % POOL_SIZE];
+                if (!isotp.Passive_Iso15765_Parse(cmsg) && !vwtp20.Passive_Vwtp20_Parse(cmsg))
+                {
+                    j1939.Passive_J1939_Parse(cmsg);
+                }
+            }
+            sw.Stop();
+            datagrams = count;
+            return sw.Elapsed.TotalMilliseconds * 1000000 / frames;
+        }
+
+        static double Pipeline(CanMessage[] traffic, int frames, out long datagrams, out long claims)
+        {
+            Passive_Can_Pipeline pipeline = new Passive_Can_Pipeline();
+            Passive_ISO15765 isotp = new Passive_ISO15765();
+            long count = 0;
+            pipeline.OnRawFrame += (s, e) => count++;
+            pipeline.Add(isotp);
+            pipeline.Add(new Passive_VWTP20());
+            pipeline.Add(new Passive_J1939());
+            pipeline.Claim(isotp, 0x7E0, 0x7E0);
+            pipeline.Claim(isotp, 0x7E8, 0x7E8);
+
+            bool stop = false;
+            long claimed = 0;
+            Thread churn = new Thread(() =>
+            {
+                while (!Volatile.Read(ref stop))
+                {
+                    pipeline.Claim(isotp, 0x7DF, 0x7DF);
+                    pipeline.Release(isotp, 0x7DF, 0x7DF);
+                    claimed++;
+                    Thread.Sleep(1);
+                }
+            });
+            churn.Start();
+
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                pipeline.Parse(traffic[i % POOL_SIZE]);
+            }
+            sw.Stop();
+            Volatile.Write(ref stop, true);
+            churn.Join();
+            datagrams = count;
+            claims = claimed;
+            return sw.Elapsed.TotalMilliseconds * 1000000 / frames;
+        }
+    }
+}
@@ -0,0 +1,228 @@
+﻿using System;
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading;
+using WTM.Slcan;
+
+namespace WTM.Bench
+{
+    /// <summary>
+    /// Loopback of Slcan_CanIf over pseudo terminal, Linux only. Master side of pty plays Olimex firmware:
+    /// acknowledges commands and after O streams frames as binary records (or ASCII lines with Z3 timestamp
+    /// when binary mode is refused). Slave side is opened by Slcan_CanIf as serial port.
+    /// Checks that all frames arrive in order and measures throughput of reading and decoding.
+    /// </summary>
+    internal static class Bench_SlcanPty
+    {
+        const int O_RDWR = 2;
+        const int O_NOCTTY = 0x100;
+        const int TCSANOW = 0;
+        const int RECORD_LENGTH = 20;
+        const int RECORDS_PER_WRITE = 64;
+        /// <summary>
+        /// Slcan_CanIf returns from constructor after O is acknowledged, give caller time to subscribe frames
+        /// </summary>
+        const int STREAM_DELAY_MS = 200;
+        /// <summary>
+        /// Test fails when no frame has arrived for this time
+        /// </summary>
+        const int STALL_TIMEOUT_MS = 2000;
+
+        [DllImport("libc", SetLastError = true)]
+        static extern int posix_openpt(int flags);
+        [DllImport("libc", SetLastError = true)]
+        static extern int grantpt(int fd);
+        [DllImport("libc", SetLastError = true)]
+        static extern int unlockpt(int fd);
+        [DllImport("libc", SetLastError = true)]
+        static extern IntPtr ptsname(int fd);
+        [DllImport("libc", SetLastError = true)]
+        static extern int tcgetattr(int fd, byte[] termios);
+        [DllImport("libc", SetLastError = true)]
+        static extern int tcsetattr(int fd, int action, byte[] termios);
+        [DllImport("libc", SetLastError = true)]
+        static extern void cfmakeraw(byte[] termios);
+        [DllImport("libc", SetLastError = true)]
+        static extern IntPtr read(int fd, byte[] buffer, IntPtr count);
+        [DllImport("libc", SetLastError = true)]
+        static extern IntPtr write(int fd, IntPtr buffer, IntPtr count);
+        [DllImport("libc", SetLastError = true)]
+        static extern int close(int fd);
+
+        static int _master;
+        static int _frames;
+        static bool _binary;
+        static readonly object _writeLock = new object();
+
+        public static int Run(string[] args)
+        {
+            if (Environment.OSVersion.Platform != PlatformID.Unix)
+            {
+                Console.WriteLine("Pseudo terminal is available only on Linux");
+                return -1;
+            }
+            _frames = args.Length > 0 ? int.Parse(args[0]) : 1000000;
+            _binary = args.Length < 2 || args[1].ToLower() != "ascii";
+
+            _master = posix_openpt(O_RDWR | O_NOCTTY);
+            if (_master < 0 || grantpt(_master) != 0 || unlockpt(_master) != 0)
+            {
+                Console.WriteLine($"Cannot create pseudo terminal, error {Marshal.GetLastWin32Error()}");
+                return -1;
+            }
+            //Raw mode, otherwise line discipline would interpret bytes of records (^C, erase, echo, ...)
+            byte[] termios = new byte[256];
+            tcgetattr(_master, termios);
+            cfmakeraw(termios);
+            tcsetattr(_master, TCSANOW, termios);
+            string slave = Marshal.PtrToStringAnsi(ptsname(_master));
+
+            Thread device = new Thread(Device);
+            device.IsBackground = true;
+            device.Start();
+
+            long received = 0;
+            bool ordered = true;
+            ManualResetEvent done = new ManualResetEvent(false);
+            Slcan_CanIf can = new Slcan_CanIf(slave, 500000);
+            can.OnReceiveCanFrame += (s, e) =>
+            {
+                if (e.Id != FrameId(received) || e.Dlc != 8 || e.Data[0] != (byte)received)
+                {
+                    ordered = false;
+                }
+                if (++received == _frames)
+                {
+                    done.Set();
+                }
+            };
+
+            Stopwatch sw = Stopwatch.StartNew();
+            long last = -1;
+            while (!done.WaitOne(STALL_TIMEOUT_MS))
+            {
+                if (received == last)
+                {
+                    break;
+                }
+                last = received;
+            }
+            sw.Stop();
+            bool binary = can.Binary;
+            can.Dispose();
+            close(_master);
+
+            double seconds = (sw.Elapsed.TotalMilliseconds - STREAM_DELAY_MS) / 1000;
+            Console.WriteLine($"Mode:     {(binary ? "binary" : "ASCII")}");
+            Console.WriteLine($"Received: {received} of {_frames} frames{(ordered ? "" : ", OUT OF ORDER")}");
+            Console.WriteLine($"Rate:     {received / seconds:F0} frames/s");
+            return received == _frames && ordered && binary == _binary ? 0 : -1;
+        }
+
+        static int FrameId(long index)
+        {
+            return 0x100 + (int)(index % 0x600);
+        }
+
+        /// <summary>
+        /// Firmware side, answers commands of Slcan_CanIf
+        /// </summary>
+        static void Device()
+        {
+            byte[] buffer = new byte[256];
+            StringBuilder command = new StringBuilder();
+            while (true)
+            {
+                long count = (long)read(_master, buffer, (IntPtr)buffer.Length);
+                if (count <= 0)
+                {
+                    return;
+                }
+                for (int i = 0; i < count; i++)
+                {
+                    if (buffer[i] != '\r')
+                    {
+                        command.Append((char)buffer[i]);
+                        continue;
+                    }
+                    string cmd = command.ToString();
+                    command.Clear();
+                    bool ack = cmd != "B1" || _binary;
+                    Write(Encoding.ASCII.GetBytes(ack ? "\r" : "\a"));
+                    if (cmd == "O")
+                    {
+                        Thread stream = new Thread(Stream);
+                        stream.IsBackground = true;
+                        stream.Start();
+                    }
+                }
+            }
+        }
+
+        static void Stream()
+        {
+            Thread.Sleep(STREAM_DELAY_MS);
+            byte[] data = new byte[8];
+            for (long index = 0; index < _frames; )
+            {
+                StringBuilder ascii = new StringBuilder();
+                byte[] block = new byte[RECORDS_PER_WRITE * RECORD_LENGTH];
+                int length = 0;
+                for (int r = 0; r < RECORDS_PER_WRITE && index < _frames; r++, index++)
+                {
+                    int id = FrameId(index);
+                    ulong timestamp = (ulong)index * 100;
+                    data[0] = (byte)index;
+                    if (_binary)
+                    {
+                        //[0] sync, [1] flags, [2] DLC, [3] sequence, [4..7] timestamp [us], [8..11] CAN ID, [12..19] data
+                        block[length] = 0xAA;
+                        block[length + 1] = 0;
+                        block[length + 2] = 8;
+                        block[length + 3] = (byte)index;
+                        BitConverter.GetBytes((uint)timestamp).CopyTo(block, length + 4);
+                        BitConverter.GetBytes(id).CopyTo(block, length + 8);
+                        data.CopyTo(block, length + 12);
+                        length += RECORD_LENGTH;
+                    }
+                    else
+                    {
+                        ascii.AppendFormat("t{0:X3}8{1}{2:X16}\r", id, BitConverter.ToString(data).Replace("-", ""), timestamp);
+                    }
+                }
+                Write(_binary ? block : Encoding.ASCII.GetBytes(ascii.ToString()), _binary ? length : -1);
+            }
+        }
+
+        static void Write(byte[] data, int length = -1)
+        {
+            if (length < 0)
+            {
+                length = data.Length;
+            }
+            GCHandle pinned = GCHandle.Alloc(data, GCHandleType.Pinned);
+            try
+            {
+                lock (_writeLock)
+                {
+                    //Pty takes only what fits into its buffer, rest is written when host reads
+                    int offset = 0;
+                    while (offset < length)
+                    {
+                        long written = (long)write(_master, pinned.AddrOfPinnedObject() + offset, (IntPtr)(length - offset));
+                        if (written <= 0)
+                        {
+                            return;
+                        }
+                        offset += (int)written;
+                    }
+                }
+            }
+            finally
+            {
+                pinned.Free();
+            }
+        }
+    }
+}
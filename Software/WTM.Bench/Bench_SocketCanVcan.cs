@@ -0,0 +1,159 @@
+﻿using System;
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using System.Threading;
+using WTM.SocketCan;
+
+namespace WTM.Bench
+{
+    /// <summary>
+    /// Throughput of SocketCan_CanIf on virtual CAN interface, Linux only.
+    /// Frames are sent by own raw CAN socket at given rate, receiver must get all of them in order
+    /// and kernel must not drop any (SO_RXQ_OVFL).
+    /// Interface is created by: sudo ip link add dev vcan0 type vcan &amp;&amp; sudo ip link set up vcan0
+    /// </summary>
+    internal static class Bench_SocketCanVcan
+    {
+        const int AF_CAN = 29;
+        const int SOCK_RAW = 3;
+        const int CAN_RAW = 1;
+        const int CAN_MTU = 16;
+        const int ENOBUFS = 105;
+        /// <summary>
+        /// Frames of the test are recognized by this ID, other traffic on interface is ignored
+        /// </summary>
+        const int TEST_ID = 0x123;
+        const int STALL_TIMEOUT_MS = 2000;
+
+        [StructLayout(LayoutKind.Sequential)]
+        struct sockaddr_can
+        {
+            public ushort can_family;
+            public int can_ifindex;
+            public ulong can_addr_0;
+            public ulong can_addr_1;
+        }
+
+        [DllImport("libc", SetLastError = true)]
+        static extern int socket(int domain, int type, int protocol);
+        [DllImport("libc", SetLastError = true)]
+        static extern int bind(int sockfd, ref sockaddr_can addr, int addrlen);
+        [DllImport("libc", SetLastError = true)]
+        static extern IntPtr write(int fd, byte[] buffer, IntPtr count);
+        [DllImport("libc", SetLastError = true)]
+        static extern int close(int fd);
+        [DllImport("libc", SetLastError = true)]
+        static extern uint if_nametoindex(string ifname);
+
+        public static int Run(string[] args)
+        {
+            if (Environment.OSVersion.Platform != PlatformID.Unix)
+            {
+                Console.WriteLine("SocketCAN is available only on Linux");
+                return -1;
+            }
+            string interfaceName = args.Length > 0 ? args[0] : "vcan0";
+            int frames = args.Length > 1 ? int.Parse(args[1]) : 1000000;
+            int rate = args.Length > 2 ? int.Parse(args[2]) : 50000;
+
+            int sender = OpenSender(interfaceName);
+            if (sender < 0)
+            {
+                return -1;
+            }
+
+            long received = 0;
+            bool ordered = true;
+            ManualResetEvent done = new ManualResetEvent(false);
+            SocketCan_CanIf can = new SocketCan_CanIf(interfaceName, 0);
+            can.OnReceiveCanFrame += (s, e) =>
+            {
+                if (e.Id != TEST_ID)
+                {
+                    return;
+                }
+                if (e.Dlc != 8 || BitConverter.ToInt32(e.Data, 0) != (int)received)
+                {
+                    ordered = false;
+                }
+                if (++received == frames)
+                {
+                    done.Set();
+                }
+            };
+
+            Stopwatch sw = Stopwatch.StartNew();
+            long sendErrors = Send(sender, frames, rate);
+            double sendTime = sw.Elapsed.TotalSeconds;
+            long last = -1;
+            while (!done.WaitOne(STALL_TIMEOUT_MS))
+            {
+                if (received == last)
+                {
+                    break;
+                }
+                last = received;
+            }
+            sw.Stop();
+            uint dropped = can.Dropped;
+            can.Dispose();
+            close(sender);
+
+            Console.WriteLine($"Sent:     {frames - sendErrors} of {frames} frames, {(frames - sendErrors) / sendTime:F0} frames/s");
+            Console.WriteLine($"Received: {received} frames{(ordered ? "" : ", OUT OF ORDER")}");
+            Console.WriteLine($"Dropped:  {dropped} frames by kernel");
+            return received == frames && ordered && dropped == 0 && sendErrors == 0 ? 0 : -1;
+        }
+
+        static int OpenSender(string interfaceName)
+        {
+            uint ifindex = if_nametoindex(interfaceName);
+            if (ifindex == 0)
+            {
+                Console.WriteLine($"CAN interface {interfaceName} not found");
+                return -1;
+            }
+            int sender = socket(AF_CAN, SOCK_RAW, CAN_RAW);
+            sockaddr_can addr = new sockaddr_can { can_family = AF_CAN, can_ifindex = (int)ifindex };
+            if (sender < 0 || bind(sender, ref addr, Marshal.SizeOf(typeof(sockaddr_can))) < 0)
+            {
+                Console.WriteLine($"Unable to open CAN socket on {interfaceName} (errno {Marshal.GetLastWin32Error()})");
+                return -1;
+            }
+            return sender;
+        }
+
+        /// <summary>
+        /// Send frames with index in first 4 bytes of data, rate is kept per millisecond
+        /// </summary>
+        /// <returns>Amount of frames which were not sent</returns>
+        static long Send(int sender, int frames, int rate)
+        {
+            //struct can_frame { canid_t can_id; __u8 can_dlc; __u8 pad, res0, len8_dlc; __u8 data[8]; }
+            byte[] frame = new byte[CAN_MTU];
+            BitConverter.GetBytes(TEST_ID).CopyTo(frame, 0);
+            frame[4] = 8;
+            long errors = 0;
+            Stopwatch sw = Stopwatch.StartNew();
+            for (int i = 0; i < frames; i++)
+            {
+                while (i >= sw.Elapsed.TotalMilliseconds * rate / 1000)
+                {
+                    Thread.Sleep(0);
+                }
+                BitConverter.GetBytes(i).CopyTo(frame, 8);
+                //Queue of interface is full, try again later
+                while ((long)write(sender, frame, (IntPtr)CAN_MTU) != CAN_MTU)
+                {
+                    if (Marshal.GetLastWin32Error() != ENOBUFS)
+                    {
+                        errors++;
+                        break;
+                    }
+                    Thread.Sleep(1);
+                }
+            }
+            return errors;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+﻿using System;
+using System.Linq;
+
+namespace WTM.Bench
+{
+    /// <summary>
+    /// Benchmarks and loopback tests which need no vehicle and no device.
+    /// Exit code is non-zero when a check has failed, so they can run on build server.
+    /// </summary>
+    internal class Program
+    {
+        static int Main(string[] args)
+        {
+            if (args.Length == 0)
+            {
+                PrintUsage();
+                return -1;
+            }
+            string[] rest = args.Skip(1).ToArray();
+            switch (args[0].ToLower())
+            {
+                case "crc":
+                    return Bench_FlexRayCrc.Run(rest);
+                case "pipeline":
+                    return Bench_Pipeline.Run(rest);
+                case "pty":
+                    return Bench_SlcanPty.Run(rest);
+                case "vcan":
+                    return Bench_SocketCanVcan.Run(rest);
+                default:
+                    PrintUsage();
+                    return -1;
+            }
+        }
+
+        static void PrintUsage()
+        {
+            Console.WriteLine("Usage: WTM.Bench.exe <benchmark> [arguments]");
+            Console.WriteLine("  crc [frames]        FlexRay header and frame CRC by tables against bitwise");
+            Console.WriteLine("  pipeline [frames]   Dispatch of CAN frames into transport protocols");
+            Console.WriteLine("  pty [frames] [ascii] SLCAN device emulated on pseudo terminal (Linux)");
+            Console.WriteLine("  vcan [interface] [frames] [rate] SocketCAN receiver on virtual CAN (Linux)");
+        }
+    }
+}
@@ -1,31 +1,48 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.IO;
-using System.Linq;
-using System.Runtime.Remoting.Channels;
-using System.Security.Cryptography;
-using System.Text;
 using System.Threading;
-using System.Threading.Tasks;
 using SAE.J2534;
 
 
 namespace WTM.J2534
 {
+    /// <summary>
+    /// CAN and optionally K-Line (ISO9141 / ISO14230) channel of one J2534 device.
+    /// Every channel is read by own thread, up to RX_BATCH messages per PassThruReadMsgs.
+    /// </summary>
     internal class J2534_CanIf : ICanIf
     {
-        bool m_endThread;
-        Thread _rxThread;
+        /// <summary>
+        /// Messages requested by one PassThruReadMsgs
+        /// </summary>
+        const int RX_BATCH = 64;
+
+        volatile bool m_endThread;
+        readonly List<Thread> _rxThreads = new List<Thread>();
 
         API m_j2534Api;
         Device m_j2534Interface;
         Channel m_j2534Channel;
+        Channel m_j2534Kline;
+        RawMessageType m_klineType;
 
         public event EventHandler<CanMessage> OnReceiveCanFrame;
+        /// <summary>
+        /// K-Line frames framed by device
+        /// </summary>
+        public event EventHandler<RawMessage> OnRawFrame;
 
         public int Baudrate { get; }
 
-        public J2534_CanIf(string dllName, int baudrate)
+        /// <summary>
+        /// Timeout of PassThruReadMsgs on empty queue [ms], thread checks end of reading at least this often
+        /// </summary>
+        public int RxTimeout { get; set; } = 100;
+
+        /// <param name="klineBaudrate">Baudrate of K-Line channel, 0 if K-Line is not used</param>
+        /// <param name="klineProtocol">ISO9141 or ISO14230</param>
+        public J2534_CanIf(string dllName, int baudrate, int klineBaudrate = 0, Protocol klineProtocol = Protocol.ISO14230)
         {
             //Get full path to DLL
             var q = APIFactory.GetAPIinfo();
@@ -59,61 +76,126 @@ namespace WTM.J2534
             m_j2534Channel = m_j2534Interface.GetChannel(Protocol.CAN, (Baud)baudrate, ConnectFlag.CAN_ID_BOTH);
             MessageFilter msgPattern = new MessageFilter(UserFilterType.PASSALL, null);
             int filterId = m_j2534Channel.StartMsgFilter(msgPattern);
+            StartRxThread(m_j2534Channel, ProcessCanMessage);
 
-            _rxThread = new Thread(RxThread_CanMessages);
-            _rxThread.Start();
-
-            m_j2534Channel.ClearRxBuffer();
+            if (klineBaudrate != 0)
+            {
+                //Checksum is passed as received, the same as from WTM.KLine
+                m_klineType = klineProtocol == Protocol.ISO9141 ? RawMessageType.Raw_ISO9141 : RawMessageType.Raw_ISO14230;
+                m_j2534Kline = m_j2534Interface.GetChannel(klineProtocol, (Baud)klineBaudrate, ConnectFlag.ISO9141_NO_CHECKSUM);
+                m_j2534Kline.StartMsgFilter(new MessageFilter(UserFilterType.PASSALL, null));
+                StartRxThread(m_j2534Kline, ProcessKlineMessage);
+                Console.WriteLine($"KLINE Ready @ {klineProtocol} {klineBaudrate}");
+            }
         }
 
         public void Dispose()
         {
             m_endThread = true;
+            foreach (Thread t in _rxThreads)
+            {
+                t.Join();
+            }
+            _rxThreads.Clear();
         }
 
-        private void RxThread_CanMessages()
+        /// <summary>
+        /// J2534 timestamp of one channel, 32 bit micro seconds extended to 64 bits
+        /// </summary>
+        class ChannelTime
         {
-            Console.WriteLine("readMessages started");
-            m_endThread = false;
-            m_j2534Channel.DefaultRxTimeout = 100;
-            while (!m_endThread)
+            //J2534 timestamps are in microseconds
+            public readonly ClockDomain Clock = new ClockDomain(1000000);
+            public uint Last;
+            public long High;
+            /// <summary>
+            /// Device has sent non-zero timestamp
+            /// </summary>
+            public bool Valid;
+
+            /// <returns>Unix time [ns]</returns>
+            public long ToUnixNs(uint timestamp)
             {
-                //Receive message
-                GetMessageResults Response = m_j2534Channel.GetMessage();
-                if (Response == null)
+                if (timestamp != 0)
                 {
-                    continue;
+                    Valid = true;
                 }
-
-                if (Response == null)
+                if (!Valid)
                 {
-                    continue;
+                    //Device does not provide timestamps
+                    return ClockDomain.HostNowNs;
                 }
-                foreach (Message m in Response.Messages)
+                //Rollover after ~71 minutes
+                if (timestamp < Last && Last - timestamp > 0x80000000u)
                 {
-                    int id = 0;
-                    byte[] data = m.Data.Skip(4).ToArray();
-                    id |= m.Data[0] << 24;
-                    id |= m.Data[1] << 16;
-                    id |= m.Data[2] << 8;
-                    id |= m.Data[3];
-
-                    CanMessage msg = new CanMessage(data, id);
-                    if (m.Timestamp == 0)
-                    {
-                        DateTime dtnow = DateTime.Now;
-                        msg.Timestamp += dtnow.Hour * 3600 * 1000;
-                        msg.Timestamp += dtnow.Minute * 60 * 1000;
-                        msg.Timestamp += dtnow.Second * 1000;
-                        msg.Timestamp += dtnow.Millisecond;
-                    }
-                    else
+                    High += 0x100000000L;
+                }
+                Last = timestamp;
+                return Clock.ToUnixNs(High + timestamp);
+            }
+        }
+
+        private void StartRxThread(Channel channel, Action<Message, long> process)
+        {
+            channel.ClearRxBuffer();
+            Thread t = new Thread(() => RxThread(channel, process));
+            t.IsBackground = true;
+            _rxThreads.Add(t);
+            t.Start();
+        }
+
+        private void RxThread(Channel channel, Action<Message, long> process)
+        {
+            ChannelTime time = new ChannelTime();
+            bool drain = false;
+            while (!m_endThread)
+            {
+                //PassThruReadMsgs with timeout waits until all requested messages are received.
+                //Wait only for the first message when queue is empty, then take what device has collected without waiting.
+                //Wrapper marshals every message into new Message with own Data array, buffer can't be reused through it.
+                GetMessageResults response = drain ? channel.GetMessages(RX_BATCH, 0) : channel.GetMessages(1, RxTimeout);
+                int count = 0;
+                if (response != null && response.Messages != null)
+                {
+                    foreach (Message m in response.Messages)
                     {
-                        msg.Timestamp = m.Timestamp; //Is it in miliseconds?
+                        process(m, time.ToUnixNs((uint)m.Timestamp));
+                        count++;
                     }
-                    OnReceiveCanFrame?.Invoke(this, msg);
                 }
+                drain = count != 0;
+            }
+        }
+
+        private void ProcessCanMessage(Message m, long timestamp)
+        {
+            byte[] raw = m.Data;
+            if (raw == null || raw.Length < 4)
+            {
+                return;
+            }
+            //4 bytes of CAN ID (big endian) followed by data
+            int id = (raw[0] << 24) | (raw[1] << 16) | (raw[2] << 8) | raw[3];
+            byte[] data = new byte[Math.Min(raw.Length - 4, CanMessage.MAX_LENGTH_CAN)];
+            Buffer.BlockCopy(raw, 4, data, 0, data.Length);
+
+            bool extended = (m.RxStatus & RxFlag.CAN_29BIT_ID) != 0;
+            CanMessage msg = new CanMessage(data, id & 0x1FFFFFFF, CanFdFlags.None, extended);
+            msg.Timestamp = timestamp;
+            OnReceiveCanFrame?.Invoke(this, msg);
+        }
+
+        private void ProcessKlineMessage(Message m, long timestamp)
+        {
+            if (m.Data == null || m.Data.Length == 0)
+            {
+                return;
             }
+            RawMessage rmsg = new RawMessage(m.Data.Length);
+            rmsg.MessageType = m_klineType;
+            rmsg.Timestamp = (ulong)timestamp;
+            Buffer.BlockCopy(m.Data, 0, rmsg.Frame, 0, m.Data.Length);
+            OnRawFrame?.Invoke(this, rmsg);
         }
     }
 }
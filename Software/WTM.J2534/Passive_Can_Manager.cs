@@ -4,6 +4,7 @@ using System.IO.Ports;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
+using SAE.J2534;
 using WTM.Protocols;
 using WTM.Wireshark;
 
@@ -11,10 +12,18 @@ namespace WTM.J2534
 {
     internal class Passive_Can_Manager : A_Passive_Can_Manager
     {
-        public void Start(string dllName, int baudrate, string pathCanIds)
+        /// <param name="klineBaudrate">Baudrate of K-Line channel, 0 if K-Line is not used</param>
+        /// <param name="klineProtocol">ISO9141 or ISO14230</param>
+        public void Start(string dllName, int baudrate, int klineBaudrate, Protocol klineProtocol, string pathCanIds, Pcapng_Spool spool)
         {
-            ICanIf can = new J2534_CanIf(dllName, baudrate);
-            Start(can, pathCanIds);
+            J2534_CanIf can = new J2534_CanIf(dllName, baudrate, klineBaudrate, klineProtocol);
+            can.OnRawFrame += Can_OnRawFrame;
+            Start(can, pathCanIds, spool);
+        }
+
+        private void Can_OnRawFrame(object sender, RawMessage e)
+        {
+            AddRawFrame(e);
         }
     }
 }
@@ -3,7 +3,9 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
+using SAE.J2534;
 using WTM.Shared;
+using WTM.Wireshark;
 
 namespace WTM.J2534
 {
@@ -14,10 +16,11 @@ namespace WTM.J2534
             var pargs = Arguments.Parse(args);
             if (pargs != null)
             {
+                Wireshark_Server.Configure(pargs);
                 if (!pargs.ContainsKey(ArgumentTypes.Baudrate))
                 {
                     Console.WriteLine("Missing Baudrate. Aborting.");
-                    Console.WriteLine("Usage: -b 500000 [-f canId.xml] [-dll op20pt32.dll]");
+                    Console.WriteLine("Usage: -b 500000 [-f canId.xml] [-dll op20pt32.dll] [-kb 10400 [-kp ISO9141|ISO14230]] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
                 }
                 else
                 {
@@ -31,8 +34,19 @@ namespace WTM.J2534
                     {
                         dll = pargs[ArgumentTypes.J2534Dll] as string;
                     }
+                    //K-Line channel is opened only with its baudrate
+                    int klineBaudrate = 0;
+                    Protocol klineProtocol = Protocol.ISO14230;
+                    if (pargs.ContainsKey(ArgumentTypes.KlineBaudrate))
+                    {
+                        klineBaudrate = (int)pargs[ArgumentTypes.KlineBaudrate];
+                    }
+                    if (pargs.ContainsKey(ArgumentTypes.KlineProtocol))
+                    {
+                        klineProtocol = (Protocol)Enum.Parse(typeof(Protocol), pargs[ArgumentTypes.KlineProtocol] as string, true);
+                    }
                     Passive_Can_Manager pcm = new Passive_Can_Manager();
-                    pcm.Start(dll, (int)pargs[ArgumentTypes.Baudrate], pathCanIds);
+                    pcm.Start(dll, (int)pargs[ArgumentTypes.Baudrate], klineBaudrate, klineProtocol, pathCanIds, Pcapng_Spool.FromArguments(pargs));
                     WaitEsc();
                     pcm.Dispose();
                     return 0;
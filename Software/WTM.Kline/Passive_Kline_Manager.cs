@@ -15,6 +15,7 @@ namespace WTM.KLine
         SerialPort _sp;
         Passive_Kline _pk;
         Wireshark_Raw _raw;
+        Pcapng_Spool _spool;
 
         int _defaultBaudrate;
 
@@ -24,10 +25,12 @@ namespace WTM.KLine
             _sp.Dispose();
             _pk.Dispose();
             _raw.Dispose();
+            _spool?.Dispose();
         }
 
-        public void Start(string comPort, int baudrate, bool verbose = false)
+        public void Start(string comPort, int baudrate, bool verbose = false, Pcapng_Spool spool = null)
         {
+            _spool = spool;
             _defaultBaudrate = baudrate;
             _verbose = verbose;
             _raw = new Wireshark_Raw();
@@ -59,8 +62,9 @@ namespace WTM.KLine
             {
                 Console.WriteLine();
             }
-            Console.WriteLine($"{e.MessageType} @ {e.Timestamp}ms [{BitConverter.ToString(e.Frame)}]");
+            Console.WriteLine($"{e.MessageType} @ {ClockDomain.Format((long)e.Timestamp)} [{BitConverter.ToString(e.Frame)}]");
             _raw.Add(e);
+            _spool?.Add(e);
             ParseStartDiagnosticSession(e);
         }
 
@@ -4,6 +4,7 @@ using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using WTM.Shared;
+using WTM.Wireshark;
 
 namespace WTM.KLine
 {
@@ -14,20 +15,21 @@ namespace WTM.KLine
             var pargs = Arguments.Parse(args);
             if (pargs != null)
             {
+                Wireshark_Server.Configure(pargs);
                 if (!pargs.ContainsKey(ArgumentTypes.ComPort))
                 {
                     Console.WriteLine("Missing COM port. Aborting.");
-                    Console.WriteLine("Usage: -c COM1 -b 10400.");
+                    Console.WriteLine("Usage: -c COM1 -b 10400 [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
                 }
                 else if (!pargs.ContainsKey(ArgumentTypes.Baudrate))
                 {
                     Console.WriteLine("Missing Baudrate. Aborting.");
-                    Console.WriteLine("Usage: -c COM1 -b 10400.");
+                    Console.WriteLine("Usage: -c COM1 -b 10400 [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
                 }
                 else
                 {
                     Passive_Kline_Manager pkm = new Passive_Kline_Manager();
-                    pkm.Start(pargs[ArgumentTypes.ComPort] as string, (int)pargs[ArgumentTypes.Baudrate], true);
+                    pkm.Start(pargs[ArgumentTypes.ComPort] as string, (int)pargs[ArgumentTypes.Baudrate], true, Pcapng_Spool.FromArguments(pargs));
                     WaitEsc();
                     pkm.Dispose();
                     return 0;
@@ -1059,6 +1059,21 @@ namespace WTM.Pcan
             return Read(Channel, out MessageBuffer, IntPtr.Zero);
         }
 
+        /// <summary>
+        /// Reads a CAN message from the receive queue of a PCAN Channel into unmanaged buffer
+        /// </summary>
+        /// <param name="Channel">The handle of a PCAN Channel</param>
+        /// <param name="MessageBuffer">Pinned buffer for native TPCANMsg (16 bytes)</param>
+        /// <param name="TimestampBuffer">A TPCANTimestamp structure buffer to get
+        /// the reception time of the message</param>
+        /// <returns>A TPCANStatus error code</returns>
+        [DllImport("PCANBasic.dll", EntryPoint = "CAN_Read")]
+        public static extern TPCANStatus Read(
+            [MarshalAs(UnmanagedType.U2)]
+            TPCANHandle Channel,
+            IntPtr MessageBuffer,
+            out TPCANTimestamp TimestampBuffer);
+
         /// <summary>
         /// Reads a CAN message from the receive queue of a FD capable PCAN Channel 
         /// </summary>
@@ -1081,6 +1096,21 @@ namespace WTM.Pcan
             out TPCANMsgFD MessageBuffer,
             IntPtr TimestampBuffer);
 
+        /// <summary>
+        /// Reads a CAN message from the receive queue of a FD capable PCAN Channel into unmanaged buffer
+        /// </summary>
+        /// <param name="Channel">The handle of a FD capable PCAN Channel</param>
+        /// <param name="MessageBuffer">Pinned buffer for native TPCANMsgFD (72 bytes)</param>
+        /// <param name="TimestampBuffer">A TPCANTimestampFD buffer to get the
+        /// reception time of the message</param>
+        /// <returns>A TPCANStatus error code</returns>
+        [DllImport("PCANBasic.dll", EntryPoint = "CAN_ReadFD")]
+        public static extern TPCANStatus ReadFD(
+            [MarshalAs(UnmanagedType.U2)]
+            TPCANHandle Channel,
+            IntPtr MessageBuffer,
+            out TPCANTimestampFD TimestampBuffer);
+
         /// <summary>
         /// Reads a CAN message from the receive queue of a FD capable PCAN Channel 
         /// </summary>
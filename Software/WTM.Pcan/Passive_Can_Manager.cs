@@ -11,10 +11,11 @@ namespace WTM.Pcan
 {
     internal class Passive_Can_Manager : A_Passive_Can_Manager
     {
-        public void Start(int baudarate, string pathCanIds)
+        /// <param name="dataBaudrate">Baudrate of CAN FD data phase, 0 for classic CAN</param>
+        public void Start(int baudarate, int dataBaudrate, string pathCanIds, Pcapng_Spool spool)
         {
-            ICanIf can = new Pcan_CanIf(baudarate);
-            Start(can, pathCanIds);
+            ICanIf can = new Pcan_CanIf(baudarate, dataBaudrate);
+            Start(can, pathCanIds, spool);
         }
     }
 }
@@ -31,6 +31,23 @@ namespace WTM.Pcan
 
     class Pcan_CanIf : ICanIf
     {
+        /// <summary>
+        /// Messages read from driver queue before they are processed
+        /// </summary>
+        const int RX_BATCH = 64;
+        /// <summary>
+        /// Size of native TPCANMsg and TPCANMsgFD, DATA starts at DATA_OFFSET
+        /// </summary>
+        const int MSG_SIZE = 16;
+        const int MSG_FD_SIZE = 72;
+        const int MSGTYPE_OFFSET = 4;
+        const int LEN_OFFSET = 5;
+        const int DATA_OFFSET = 6;
+        /// <summary>
+        /// Clock of CAN FD controller for TPCANBitrateFD [Hz], supported by all FD capable devices
+        /// </summary>
+        const int CLOCK_FD = 80000000;
+
         bool _enabled;
 
         public event EventHandler<CanMessage> OnReceiveCanFrame;
@@ -59,12 +76,42 @@ namespace WTM.Pcan
         /// </summary>
         private TPCANHandle[] m_HandlesArray;
 
+        /// <summary>
+        /// Maps microsecond timestamps of PCAN hardware onto Unix time
+        /// </summary>
+        private ClockDomain m_Clock = new ClockDomain(1000000);
+
+        /// <summary>
+        /// Channel was initialized by CAN_InitializeFD and is read by CAN_ReadFD
+        /// </summary>
+        private bool m_Fd;
+
+        /// <summary>
+        /// Native messages of one batch and their timestamps [us]
+        /// </summary>
+        private readonly byte[] m_RxBuffer = new byte[RX_BATCH * MSG_FD_SIZE];
+        private readonly long[] m_RxTimestamps = new long[RX_BATCH];
+
+        private int m_RateCount;
+        private int m_RateStart;
+
         public int Baudrate { get; }
 
+        /// <summary>
+        /// Amount of received CAN frames
+        /// </summary>
+        public long Received { get; private set; }
+        /// <summary>
+        /// Received frames per second, updated every second
+        /// </summary>
+        public int Rate { get; private set; }
+        public int MaxRate { get; private set; }
+
         /// <summary>
         /// Initialize PeakCAN Driver
         /// </summary>
-        public Pcan_CanIf(int baudrate)
+        /// <param name="dataBaudrate">Baudrate of CAN FD data phase, 0 for classic CAN</param>
+        public Pcan_CanIf(int baudrate, int dataBaudrate = 0)
         {
             // Creates the event used for signalize incomming messages 
             m_ReceiveEvent = new AutoResetEvent(false);
@@ -92,7 +139,7 @@ namespace WTM.Pcan
             };
 
             //Enable PeakCAN device first
-            if (!InitDevice(baudrate))
+            if (!InitDevice(baudrate, dataBaudrate))
             {
                 throw new Exception("Cannot continue, unable to enable PeakCAN device");
             }
@@ -189,7 +236,7 @@ namespace WTM.Pcan
             return true;
         }
 
-        private bool InitDevice(int baudrate)
+        private bool InitDevice(int baudrate, int dataBaudrate)
         {
             //Translate baudrate into PeakCAN enum
             TPCANBaudrate m_Baudrate;
@@ -239,6 +286,14 @@ namespace WTM.Pcan
                 if (AvailableDevicesHanldes.Count != 0)
                 {
                     //Handles are found, try to connect to first one
+                    if (dataBaudrate != 0 && IsFdCapable(AvailableDevicesHanldes[0]))
+                    {
+                        return InitDeviceFD(AvailableDevicesHanldes[0], GetBitrateFD(baudrate, dataBaudrate));
+                    }
+                    if (dataBaudrate != 0)
+                    {
+                        Console.WriteLine("PeakCAN device is not CAN FD capable, using classic CAN");
+                    }
                     if (InitDevice(AvailableDevicesHanldes[0], m_Baudrate))
                     {
                         return true;
@@ -263,6 +318,74 @@ namespace WTM.Pcan
                 m_ReadThread.Join();
                 m_ReadThread = null;
             }
+            Console.WriteLine($"PeakCAN received {Received} frames, max {MaxRate} frames/s");
+        }
+
+        /// <returns>True if channel supports CAN FD</returns>
+        private bool IsFdCapable(TPCANHandle deviceHandle)
+        {
+            UInt32 iBuffer;
+            TPCANStatus stsResult = PCANBasic.GetValue(deviceHandle, TPCANParameter.PCAN_CHANNEL_FEATURES, out iBuffer, sizeof(UInt32));
+            return (stsResult == TPCANStatus.PCAN_ERROR_OK) && ((iBuffer & PCANBasic.FEATURE_FD_CAPABLE) == PCANBasic.FEATURE_FD_CAPABLE);
+        }
+
+        /// <summary>
+        /// Create TPCANBitrateFD string for CLOCK_FD with sample point at 80 %
+        /// </summary>
+        private static string GetBitrateFD(int baudrate, int dataBaudrate)
+        {
+            int nomBrp, nomTseg1, nomTseg2;
+            int dataBrp, dataTseg1, dataTseg2;
+            if (!GetBitTiming(baudrate, 40, 8, out nomBrp, out nomTseg1, out nomTseg2))
+            {
+                throw new NotImplementedException(string.Format("Baudare {0} is not supported by driver or device", baudrate));
+            }
+            if (!GetBitTiming(dataBaudrate, 20, 5, out dataBrp, out dataTseg1, out dataTseg2))
+            {
+                throw new NotImplementedException(string.Format("Data baudare {0} is not supported by driver or device", dataBaudrate));
+            }
+            return $"f_clock={CLOCK_FD}, nom_brp={nomBrp}, nom_tseg1={nomTseg1}, nom_tseg2={nomTseg2}, nom_sjw={nomTseg2}, " +
+                $"data_brp={dataBrp}, data_tseg1={dataTseg1}, data_tseg2={dataTseg2}, data_sjw={dataTseg2}";
+        }
+
+        /// <summary>
+        /// Find prescaler for the most time quanta per bit between maxTq and minTq
+        /// </summary>
+        /// <returns>False if baudrate cannot be derived from CLOCK_FD</returns>
+        private static bool GetBitTiming(int baudrate, int maxTq, int minTq, out int brp, out int tseg1, out int tseg2)
+        {
+            for (int tq = maxTq; tq >= minTq; tq--)
+            {
+                if (baudrate > 0 && CLOCK_FD % (baudrate * tq) == 0)
+                {
+                    brp = CLOCK_FD / (baudrate * tq);
+                    tseg2 = Math.Max(1, tq / 5);
+                    tseg1 = tq - 1 - tseg2;
+                    return true;
+                }
+            }
+            brp = tseg1 = tseg2 = 0;
+            return false;
+        }
+
+        /// <summary>
+        /// Inits FD capable device with provided handle
+        /// </summary>
+        /// <param name="deviceHandle">Handle to Plug and Play device</param>
+        /// <param name="bitrate">TPCANBitrateFD string of nominal and data phase</param>
+        /// <returns>True, if init was successful</returns>
+        private bool InitDeviceFD(TPCANHandle deviceHandle, string bitrate)
+        {
+            TPCANStatus stsResult = PCANBasic.InitializeFD(deviceHandle, bitrate);
+            if (stsResult != TPCANStatus.PCAN_ERROR_OK)
+            {
+                Console.WriteLine(GetFormatedError(stsResult));
+                return false;
+            }
+            m_PcanHandle = deviceHandle;
+            m_Fd = true;
+            Console.WriteLine("PeakCAN: CAN FD " + bitrate);
+            return true;
         }
 
         /// <summary>
@@ -322,66 +445,132 @@ namespace WTM.Pcan
                 return;
             }
 
-            // While this mode is selected
-            while (_enabled)
+            //Driver writes messages directly into pinned buffer, nothing is marshalled per message
+            GCHandle pinned = GCHandle.Alloc(m_RxBuffer, GCHandleType.Pinned);
+            m_RateStart = Environment.TickCount;
+            try
+            {
+                // While this mode is selected
+                while (_enabled)
+                {
+                    // Waiting for Receive-Event, queue is checked also after timeout so nothing stays there
+                    m_ReceiveEvent.WaitOne(50);
+                    ReadMessages(pinned.AddrOfPinnedObject());
+                }
+            }
+            finally
             {
-                // Waiting for Receive-Event
-                // 
-                if (m_ReceiveEvent.WaitOne(50))
-                    // Process Receive-Event using .NET Invoke function
-                    // in order to interact with Winforms UI (calling the 
-                    // function ReadMessages)
-                    // 
-                    ReadMessages();
+                pinned.Free();
             }
         }
 
-        private void ReadMessages()
+        /// <summary>
+        /// Drain receive queue until it is empty, RX_BATCH messages at once
+        /// </summary>
+        private void ReadMessages(IntPtr buffer)
         {
-            TPCANStatus stsResult;
-
-            // We read at least one time the queue looking for messages.
-            // If a message is found, we look again trying to find more.
-            // If the queue is empty or an error occurr, we get out from
-            // the dowhile statement.
-            //			
-            do
+            bool empty = false;
+            while (_enabled && !empty)
             {
-                stsResult = ReadMessage();
-                if (stsResult == TPCANStatus.PCAN_ERROR_ILLOPERATION)
-                    break;
-
-            } while (_enabled && (!Convert.ToBoolean(stsResult & TPCANStatus.PCAN_ERROR_QRCVEMPTY)));
+                int count = 0;
+                while (count < RX_BATCH)
+                {
+                    TPCANStatus stsResult = ReadMessage(buffer, count);
+                    if (stsResult != TPCANStatus.PCAN_ERROR_OK)
+                    {
+                        //PCAN_ERROR_QRCVEMPTY or error of bus, rest of queue is read after next wake-up
+                        empty = true;
+                        break;
+                    }
+                    count++;
+                }
+                ProcessMessages(count);
+            }
         }
 
-        private TPCANStatus ReadMessage()
+        /// <summary>
+        /// Read one message into slot of buffer
+        /// </summary>
+        private TPCANStatus ReadMessage(IntPtr buffer, int index)
         {
-            TPCANMsg CANMsg;
-            TPCANTimestamp CANTimeStamp;
             TPCANStatus stsResult;
-
-            // We execute the "Read" function of the PCANBasic
-            stsResult = PCANBasic.Read(m_PcanHandle, out CANMsg, out CANTimeStamp);
-            if (stsResult == TPCANStatus.PCAN_ERROR_OK)
+            if (m_Fd)
+            {
+                ulong timestamp;
+                stsResult = PCANBasic.ReadFD(m_PcanHandle, buffer + index * MSG_FD_SIZE, out timestamp);
+                m_RxTimestamps[index] = (long)timestamp;
+            }
+            else
             {
-                // We process the received message
-                ProcessMessage(CANMsg, CANTimeStamp);
+                TPCANTimestamp timestamp;
+                stsResult = PCANBasic.Read(m_PcanHandle, buffer + index * MSG_SIZE, out timestamp);
+                //Total Microseconds = micros + 1000 * millis + 0x100000000 * 1000 * millis_overflow
+                m_RxTimestamps[index] = timestamp.micros + 1000L * timestamp.millis + 0x100000000L * 1000 * timestamp.millis_overflow;
             }
             return stsResult;
         }
 
-        private void ProcessMessage(TPCANMsg theMsg, TPCANTimestamp itsTimeStamp)
+        private void ProcessMessages(int count)
         {
-            byte[] data = new byte[theMsg.LEN];
-            if (data.Length > 8 || data.Length == 0)
+            int size = m_Fd ? MSG_FD_SIZE : MSG_SIZE;
+            int frames = 0;
+            for (int i = 0; i < count; i++)
             {
-                return;
+                int offset = i * size;
+                TPCANMessageType type = (TPCANMessageType)m_RxBuffer[offset + MSGTYPE_OFFSET];
+                if ((type & (TPCANMessageType.PCAN_MESSAGE_STATUS | TPCANMessageType.PCAN_MESSAGE_RTR)) != 0)
+                {
+                    continue;
+                }
+                CanFdFlags flags = CanFdFlags.None;
+                int length = m_RxBuffer[offset + LEN_OFFSET];
+                if (m_Fd)
+                {
+                    //LEN is DLC for TPCANMsgFD
+                    length = CanMessage.DlcToLength(length & 0xF);
+                    if ((type & TPCANMessageType.PCAN_MESSAGE_FD) != 0)
+                    {
+                        flags |= CanFdFlags.Fd;
+                        if ((type & TPCANMessageType.PCAN_MESSAGE_BRS) != 0)
+                        {
+                            flags |= CanFdFlags.Brs;
+                        }
+                        if ((type & TPCANMessageType.PCAN_MESSAGE_ESI) != 0)
+                        {
+                            flags |= CanFdFlags.Esi;
+                        }
+                    }
+                }
+                if (flags == CanFdFlags.None)
+                {
+                    length = Math.Min(length, CanMessage.MAX_LENGTH_CAN);
+                }
+
+                byte[] data = new byte[length];
+                Buffer.BlockCopy(m_RxBuffer, offset + DATA_OFFSET, data, 0, length);
+                int id = BitConverter.ToInt32(m_RxBuffer, offset) & 0x1FFFFFFF;
+                bool extended = (type & TPCANMessageType.PCAN_MESSAGE_EXTENDED) != 0;
+                CanMessage cmsg = new CanMessage(data, id, flags, extended);
+                cmsg.Timestamp = m_Clock.ToUnixNs(m_RxTimestamps[i]);
+                OnReceiveCanFrame?.Invoke(this, cmsg);
+                frames++;
             }
+            //Status and remote frames are not counted
+            Received += frames;
+            UpdateRate(frames);
+        }
 
-            Buffer.BlockCopy(theMsg.DATA, 0, data, 0, data.Length);
-            CanMessage cmsg = new CanMessage(data, (int)theMsg.ID);
-            cmsg.Timestamp = itsTimeStamp.millis;
-            OnReceiveCanFrame?.Invoke(this, cmsg);
+        private void UpdateRate(int count)
+        {
+            m_RateCount += count;
+            int elapsed = Environment.TickCount - m_RateStart;
+            if (elapsed >= 1000)
+            {
+                Rate = (int)(m_RateCount * 1000L / elapsed);
+                MaxRate = Math.Max(MaxRate, Rate);
+                m_RateCount = 0;
+                m_RateStart = Environment.TickCount;
+            }
         }
     }
 }
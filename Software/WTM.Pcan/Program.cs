@@ -4,6 +4,7 @@ using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using WTM.Shared;
+using WTM.Wireshark;
 
 namespace WTM.Pcan
 {
@@ -14,10 +15,11 @@ namespace WTM.Pcan
             var pargs = Arguments.Parse(args);
             if (pargs != null)
             {
+                Wireshark_Server.Configure(pargs);
                 if (!pargs.ContainsKey(ArgumentTypes.Baudrate))
                 {
                     Console.WriteLine("Missing Baudrate. Aborting.");
-                    Console.WriteLine("Usage: -b 500000 [-f canId.xml]");
+                    Console.WriteLine("Usage: -b 500000 [-db 2000000] [-f canId.xml] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
                 }
                 else
                 {
@@ -26,8 +28,14 @@ namespace WTM.Pcan
                     {
                         pathCanIds = pargs[ArgumentTypes.CanIdsFile] as string;
                     }
+                    //CAN FD is used only when data phase baudrate is known
+                    int dataBaudrate = 0;
+                    if (pargs.ContainsKey(ArgumentTypes.DataBaudrate))
+                    {
+                        dataBaudrate = (int)pargs[ArgumentTypes.DataBaudrate];
+                    }
                     Passive_Can_Manager pcm = new Passive_Can_Manager();
-                    pcm.Start((int)pargs[ArgumentTypes.Baudrate], pathCanIds);
+                    pcm.Start((int)pargs[ArgumentTypes.Baudrate], dataBaudrate, pathCanIds, Pcapng_Spool.FromArguments(pargs));
                     WaitEsc();
                     pcm.Dispose();
                     return 0;
@@ -13,29 +13,45 @@ namespace WTM
     {
         ICanIf _can;
         CanIds _canIds;
+        Passive_Can_Pipeline _pipeline;
         Passive_ISO15765 _pisotp;
         Passive_VWTP20 _pvwtp20;
+        Passive_J1939 _pj1939;
         Wireshark_SocketCan _ws_can;
         Wireshark_Raw _ws_raw;
+        Wireshark_Pcapng _ws_pcapng;
+        Pcapng_Spool _spool;
 
-        public void Dispose()
+        public virtual void Dispose()
         {
             _can.Dispose();
             _ws_can.Dispose();
             _ws_raw.Dispose();
+            _ws_pcapng.Dispose();
+            _spool?.Dispose();
             _canIds.Dispose();
         }
 
-        public void Start(ICanIf can, string canidsPath = null)
+        /// <param name="spool">Optional archive of all traffic into files, see Pcapng_Spool.FromArguments</param>
+        public void Start(ICanIf can, string canidsPath = null, Pcapng_Spool spool = null)
         {
+            _spool = spool;
             _canIds = new CanIds(canidsPath);
 
             _ws_can = new Wireshark_SocketCan();
             _ws_raw = new Wireshark_Raw();
+            _ws_pcapng = new Wireshark_Pcapng();
+            //Transport protocols claim CAN IDs they expect, CAN message is passed only into one of them
+            _pipeline = new Passive_Can_Pipeline();
+            _pipeline.OnRawFrame += _canPdu_OnRawFrame;
             _pisotp = new Passive_ISO15765();
-            _pisotp.OnRawFrame += _canPdu_OnRawFrame;
+            _pipeline.Add(_pisotp);
             _pvwtp20 = new Passive_VWTP20();
-            _pvwtp20.OnRawFrame += _canPdu_OnRawFrame;
+            _pipeline.Add(_pvwtp20);
+            _pj1939 = new Passive_J1939();
+            _pipeline.Add(_pj1939);
+            ClaimIso15765Ids();
+            _canIds.Changed += _canIds_Changed;
             //Create Create CAN input
             _can = can;
             //Route CAN messages on passive protocols
@@ -44,10 +60,48 @@ namespace WTM
         }
 
 
+        private void ClaimIso15765Ids()
+        {
+            _pipeline.Release(_pisotp);
+            var ids = _canIds.Iso15765Ids;
+            if (ids == null)
+            {
+                return;
+            }
+            foreach (int id in ids)
+            {
+                _pipeline.Claim(_pisotp, id, id);
+            }
+        }
+
+        private void _canIds_Changed(object sender, EventArgs e)
+        {
+            ClaimIso15765Ids();
+        }
+
         private void _canPdu_OnRawFrame(object sender, RawMessage e)
         {
-            Console.WriteLine($"{e.MessageType} @ {e.Timestamp}ms [{BitConverter.ToString(e.Frame)}]");
+            AddRawFrame(e);
+        }
+
+        /// <summary>
+        /// Send datagram which was not reconstructed from CAN (i.e. K-Line of J2534 device)
+        /// </summary>
+        protected void AddRawFrame(RawMessage e)
+        {
+            Console.WriteLine($"{e.MessageType} @ {ClockDomain.Format((long)e.Timestamp)} [{BitConverter.ToString(e.Frame)}]");
             _ws_raw.Add(e);
+            _ws_pcapng.Add(e);
+            _spool?.Add(e);
+        }
+
+        /// <summary>
+        /// Send FlexRay frame which was received next to CAN (i.e. FlexRay channel of XL device)
+        /// </summary>
+        protected void AddFlexRayFrame(FlexRayMessage e)
+        {
+            _ws_pcapng.Add(e);
+            _spool?.Add(e);
         }
 
         private void _can_OnReceiveCanFrame(object sender, CanMessage e)
@@ -59,18 +113,10 @@ namespace WTM
 
             //Console.WriteLine(e);
             _ws_can.Add(e);
+            _ws_pcapng.Add(e);
+            _spool?.Add(e);
 
-            if (_canIds.IsIso15765(e))
-            {
-                if (_pisotp.Passive_Iso15765_Parse(e))
-                {
-                    return;
-                }
-            }
-            if (_pvwtp20.Passive_Vwtp20_Parse(e))
-            {
-                return;
-            }
+            _pipeline.Parse(e);
         }
     }
 }
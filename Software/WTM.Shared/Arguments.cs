@@ -5,15 +5,28 @@ using System.Linq;
 using System.Security.AccessControl;
 using System.Text;
 using System.Threading.Tasks;
+using WTM.Wireshark;
 
 namespace WTM.Shared
 {
     public enum ArgumentTypes
     {
         CanIdsFile,
+        FibexFile,
         ComPort,
+        CanInterface,
         Baudrate,
+        DataBaudrate,
+        KlineBaudrate,
+        KlineProtocol,
         J2534Dll,
+        SpoolDirectory,
+        SpoolFileSize,
+        SpoolFileTime,
+        SpoolCompress,
+        HistoryTime,
+        HistorySize,
+        SlowClient,
     }
 
     public static class Arguments
@@ -31,6 +44,10 @@ namespace WTM.Shared
                         case "-com":
                             pargs.Add(ArgumentTypes.ComPort, args[i + 1]);
                             break;
+                        case "-i":
+                        case "-interface":
+                            pargs.Add(ArgumentTypes.CanInterface, args[i + 1]);
+                            break;
                         case "-dll":
                             pargs.Add(ArgumentTypes.J2534Dll, args[i + 1]);
                             break;
@@ -46,11 +63,64 @@ namespace WTM.Shared
                                 throw new Exception($"Invalid path to CanIDs file: {canidFilePath}");
                             }
                             break;
+                        case "-fibex":
+                            string fibexFilePath = args[i + 1];
+                            if (File.Exists(fibexFilePath))
+                            {
+                                pargs.Add(ArgumentTypes.FibexFile, fibexFilePath);
+                            }
+                            else
+                            {
+                                throw new Exception($"Invalid path to FIBEX file: {fibexFilePath}");
+                            }
+                            break;
                         case "-b":
                         case "-baudrate":
                             int baudarte = Convert.ToInt32(args[i + 1]);
                             pargs.Add(ArgumentTypes.Baudrate, baudarte);
                             break;
+                        case "-db":
+                        case "-databaudrate":
+                            pargs.Add(ArgumentTypes.DataBaudrate, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-kb":
+                            pargs.Add(ArgumentTypes.KlineBaudrate, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-kp":
+                            pargs.Add(ArgumentTypes.KlineProtocol, args[i + 1]);
+                            break;
+                        case "-w":
+                        case "-write":
+                            pargs.Add(ArgumentTypes.SpoolDirectory, args[i + 1]);
+                            break;
+                        case "-wsize":
+                            pargs.Add(ArgumentTypes.SpoolFileSize, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-wtime":
+                            pargs.Add(ArgumentTypes.SpoolFileTime, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-gz":
+                            pargs.Add(ArgumentTypes.SpoolCompress, true);
+                            break;
+                        case "-history":
+                            pargs.Add(ArgumentTypes.HistoryTime, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-hsize":
+                            pargs.Add(ArgumentTypes.HistorySize, Convert.ToInt32(args[i + 1]));
+                            break;
+                        case "-slow":
+                            switch (args[i + 1].ToLower())
+                            {
+                                case "drop":
+                                    pargs.Add(ArgumentTypes.SlowClient, SlowClientPolicy.Drop);
+                                    break;
+                                case "disconnect":
+                                    pargs.Add(ArgumentTypes.SlowClient, SlowClientPolicy.Disconnect);
+                                    break;
+                                default:
+                                    throw new Exception($"Invalid slow client policy: {args[i + 1]}");
+                            }
+                            break;
                         default:
                             break;
                     }
@@ -7,11 +7,57 @@ using System.Xml.Linq;
 
 namespace WTM
 {
+    /// <summary>
+    /// Flags of CAN FD frame, values are the same as flags of struct canfd_frame in SocketCAN
+    /// </summary>
+    [Flags]
+    public enum CanFdFlags : byte
+    {
+        None = 0,
+        /// <summary>
+        /// Bit rate switch, data phase was sent with data bitrate
+        /// </summary>
+        Brs = 0x01,
+        /// <summary>
+        /// Error state indicator of transmitting node (error passive)
+        /// </summary>
+        Esi = 0x02,
+        /// <summary>
+        /// Frame is CAN FD frame (FDF / EDL bit)
+        /// </summary>
+        Fd = 0x04,
+    }
+
     /// <summary>
     /// Container for CAN message
     /// </summary>
     public class CanMessage
     {
+        /// <summary>
+        /// Maximal length of data in classic CAN frame
+        /// </summary>
+        public const int MAX_LENGTH_CAN = 8;
+        /// <summary>
+        /// Maximal length of data in CAN FD frame
+        /// </summary>
+        public const int MAX_LENGTH_FD = 64;
+        /// <summary>
+        /// Highest CAN ID with 11 bit identifier
+        /// </summary>
+        public const int MAX_ID_STANDARD = 0x7FF;
+        /// <summary>
+        /// Highest CAN ID with 29 bit identifier
+        /// </summary>
+        public const int MAX_ID_EXTENDED = 0x1FFFFFFF;
+
+        /// <summary>
+        /// Length of data for DLC code 0 - 15 of CAN FD frame
+        /// </summary>
+        static readonly byte[] _dlcToLength = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+        /// <summary>
+        /// Unix time [ns], see ClockDomain
+        /// </summary>
         public long Timestamp { get; set; }
         /// <summary>
         /// Body of message
@@ -24,30 +70,93 @@ namespace WTM
         public int Id { get; }
 
         /// <summary>
-        /// DLC of message
+        /// CAN ID is 29 bit identifier
+        /// </summary>
+        public bool IsExtended { get; }
+
+        /// <summary>
+        /// Length of data of message (up to 8 for CAN, up to 64 for CAN FD)
         /// </summary>
         public int Dlc { get { return Data.Length; } }
 
+        /// <summary>
+        /// CAN FD flags, None for classic CAN frame
+        /// </summary>
+        public CanFdFlags Flags { get; }
+
+        /// <summary>
+        /// True for CAN FD frame
+        /// </summary>
+        public bool IsFd { get { return (Flags & CanFdFlags.Fd) != 0; } }
+
         /// <summary>
         /// Creating CAN message, data field and CAN ID
         /// </summary>
         /// <param name="data">Data of message</param>
         /// <param name="id">CAN ID of message</param>
-        public CanMessage(byte[] data, int id)
+        public CanMessage(byte[] data, int id) : this(data, id, CanFdFlags.None)
         {
-            Id = id;
+        }
 
-            //Check if data is maximally 8 bytes long. If not make them
-            if (data.Length > 8)
+        /// <summary>
+        /// Creating CAN or CAN FD message
+        /// </summary>
+        /// <param name="data">Data of message, CAN FD data are padded by zeros to the next valid length</param>
+        /// <param name="id">CAN ID of message</param>
+        /// <param name="flags">CAN FD flags, BRS and ESI are valid only together with Fd</param>
+        public CanMessage(byte[] data, int id, CanFdFlags flags) : this(data, id, flags, id > MAX_ID_STANDARD)
+        {
+        }
+
+        /// <summary>
+        /// Creating CAN or CAN FD message from interface which tells format of CAN ID
+        /// </summary>
+        /// <param name="data">Data of message, CAN FD data are padded by zeros to the next valid length</param>
+        /// <param name="id">CAN ID of message</param>
+        /// <param name="flags">CAN FD flags, BRS and ESI are valid only together with Fd</param>
+        /// <param name="extended">CAN ID is 29 bit identifier, also when its value fits into 11 bits</param>
+        public CanMessage(byte[] data, int id, CanFdFlags flags, bool extended)
+        {
+            Id = id;
+            IsExtended = extended;
+            if ((flags & CanFdFlags.Fd) != 0)
             {
-                Data = new byte[8];
+                Flags = flags;
+                //CAN FD frame can have only lengths which are representable by DLC
+                Data = new byte[DlcToLength(LengthToDlc(data.Length))];
             }
             else
             {
-                Data = new byte[data.Length];
+                //Check if data is maximally 8 bytes long. If not make them
+                Data = new byte[Math.Min(data.Length, MAX_LENGTH_CAN)];
             }
 
-            Buffer.BlockCopy(data, 0, Data, 0, data.Length);
+            Buffer.BlockCopy(data, 0, Data, 0, Math.Min(data.Length, Data.Length));
+        }
+
+        /// <summary>
+        /// Length of data for DLC code (i.e. 9 = 12 bytes, 15 = 64 bytes)
+        /// </summary>
+        public static int DlcToLength(int dlc)
+        {
+            return _dlcToLength[dlc & 0xF];
+        }
+
+        /// <summary>
+        /// The smallest DLC code which can carry given length, lengths above 64 give DLC 15
+        /// </summary>
+        public static int LengthToDlc(int length)
+        {
+            if (length <= MAX_LENGTH_CAN)
+            {
+                return length;
+            }
+            int dlc = 9;
+            while (dlc < 15 && _dlcToLength[dlc] < length)
+            {
+                dlc++;
+            }
+            return dlc;
         }
 
         /// <summary>
@@ -0,0 +1,212 @@
+﻿using System;
+using System.Diagnostics;
+
+namespace WTM
+{
+    /// <summary>
+    /// Maps monotonic time of device onto Unix time in nanoseconds. Create one instance per device clock.
+    /// Device time is anchored to host clock on first message and re-anchored periodically to compensate drift.
+    /// </summary>
+    public class ClockDomain
+    {
+        const long NS_PER_SECOND = 1000000000;
+        /// <summary>
+        /// Window in which lowest latency between device and host is searched, drift is corrected at end of window
+        /// </summary>
+        const long REANCHOR_INTERVAL_NS = 10 * NS_PER_SECOND;
+        /// <summary>
+        /// Device time ahead of host by more than this means that device clock has jumped. Message delivered
+        /// later than this is an outlier (stalled driver or host) and is not used for mapping.
+        /// </summary>
+        const long MAX_JUMP_NS = NS_PER_SECOND;
+        /// <summary>
+        /// Crystals are well below this, larger correction is a jitter of host
+        /// </summary>
+        const double MAX_DRIFT_PPM = 500;
+        /// <summary>
+        /// Step of system time (i.e. NTP on host) which is taken into account by host clock
+        /// </summary>
+        const long HOST_STEP_NS = 100000000;
+
+        static readonly object _hostSync = new object();
+        static long _hostAnchorUnixNs;
+        static long _hostAnchorTicks;
+        static long _hostLastCheck;
+        static long _hostLastNs;
+
+        readonly object _sync = new object();
+        readonly double _nominalNsPerTick;
+        double _nsPerTick;
+        bool _anchored;
+        long _anchorTicks;
+        long _anchorUnixNs;
+        long _lastTicks;
+        long _lastNs;
+        long _windowStartNs;
+        long _windowMinOffset;
+        bool _driftValid;
+        long _outlierSinceNs;
+
+        static ClockDomain()
+        {
+            AnchorHost();
+        }
+
+        /// <summary>
+        /// Create clock domain for device
+        /// </summary>
+        /// <param name="ticksPerSecond">Resolution of device timestamps, i.e. 1000000 for microseconds</param>
+        public ClockDomain(long ticksPerSecond)
+        {
+            _nominalNsPerTick = (double)NS_PER_SECOND / ticksPerSecond;
+            _nsPerTick = _nominalNsPerTick;
+        }
+
+        /// <summary>
+        /// Current Unix time of host [ns]. Stopwatch based, so resolution is far better than DateTime.UtcNow
+        /// and it never goes backwards.
+        /// </summary>
+        public static long HostNowNs
+        {
+            get
+            {
+                lock (_hostSync)
+                {
+                    long ticks = Stopwatch.GetTimestamp();
+                    long now = _hostAnchorUnixNs + TicksToNs(ticks - _hostAnchorTicks);
+                    //Follow steps of system time, check once per second
+                    if (ticks - _hostLastCheck > Stopwatch.Frequency)
+                    {
+                        _hostLastCheck = ticks;
+                        if (Math.Abs(UtcNowNs() - now) > HOST_STEP_NS)
+                        {
+                            AnchorHost();
+                            now = _hostAnchorUnixNs;
+                        }
+                    }
+                    if (now < _hostLastNs)
+                    {
+                        now = _hostLastNs;
+                    }
+                    _hostLastNs = now;
+                    return now;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Convert device timestamp into Unix time
+        /// </summary>
+        /// <param name="deviceTicks">Monotonic timestamp of device</param>
+        /// <returns>Unix time [ns]</returns>
+        public long ToUnixNs(long deviceTicks)
+        {
+            long host = HostNowNs;
+            lock (_sync)
+            {
+                long mapped = _anchorUnixNs + (long)((deviceTicks - _anchorTicks) * _nsPerTick);
+                long latency = host - mapped;
+                if (_anchored && deviceTicks >= _lastTicks && latency > MAX_JUMP_NS)
+                {
+                    //Late message says nothing about device clock, unless device clock has stopped for a while
+                    if (_outlierSinceNs == 0)
+                    {
+                        _outlierSinceNs = host;
+                    }
+                    if (host - _outlierSinceNs <= REANCHOR_INTERVAL_NS)
+                    {
+                        _lastTicks = deviceTicks;
+                        return Monotonic(mapped);
+                    }
+                }
+                else
+                {
+                    _outlierSinceNs = 0;
+                }
+
+                if (!_anchored || deviceTicks < _lastTicks || Math.Abs(latency) > MAX_JUMP_NS)
+                {
+                    //First message, restart of device or rollover of its timer
+                    _anchored = true;
+                    _driftValid = false;
+                    _nsPerTick = _nominalNsPerTick;
+                    _anchorTicks = deviceTicks;
+                    _anchorUnixNs = host;
+                    _windowStartNs = host;
+                    _windowMinOffset = long.MaxValue;
+                    _outlierSinceNs = 0;
+                    mapped = host;
+                }
+                _lastTicks = deviceTicks;
+
+                //Message is received after it was timestamped, lowest latency is closest to real offset
+                long offset = host - mapped;
+                if (offset < _windowMinOffset)
+                {
+                    _windowMinOffset = offset;
+                }
+                if (host - _windowStartNs > REANCHOR_INTERVAL_NS)
+                {
+                    Reanchor(deviceTicks, mapped, host);
+                }
+
+                return Monotonic(mapped);
+            }
+        }
+
+        /// <summary>
+        /// Format Unix time [ns] as local time of day with microseconds, used for console output
+        /// </summary>
+        public static string Format(long unixNs)
+        {
+            DateTime dt = new DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind.Utc).AddTicks(unixNs / 100);
+            return dt.ToLocalTime().ToString("HH:mm:ss.ffffff");
+        }
+
+        private long Monotonic(long mapped)
+        {
+            if (mapped < _lastNs)
+            {
+                mapped = _lastNs;
+            }
+            _lastNs = mapped;
+            return mapped;
+        }
+
+        private void Reanchor(long deviceTicks, long mapped, long host)
+        {
+            if (_driftValid)
+            {
+                //Offset was zero at start of window, so what is left is drift of device against host
+                double drift = (double)_windowMinOffset / (host - _windowStartNs);
+                double limit = MAX_DRIFT_PPM / 1000000;
+                _nsPerTick *= 1 + drift;
+                _nsPerTick = Math.Max(_nominalNsPerTick * (1 - limit), Math.Min(_nominalNsPerTick * (1 + limit), _nsPerTick));
+            }
+            //First window holds latency of anchor message, drift can be measured from next one
+            _driftValid = true;
+            _anchorTicks = deviceTicks;
+            _anchorUnixNs = mapped + _windowMinOffset;
+            _windowStartNs = host;
+            _windowMinOffset = long.MaxValue;
+        }
+
+        private static void AnchorHost()
+        {
+            _hostAnchorTicks = Stopwatch.GetTimestamp();
+            _hostAnchorUnixNs = UtcNowNs();
+            _hostLastCheck = _hostAnchorTicks;
+        }
+
+        private static long UtcNowNs()
+        {
+            return (DateTime.UtcNow.Ticks - new DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind.Utc).Ticks) * 100;
+        }
+
+        private static long TicksToNs(long ticks)
+        {
+            //Split to avoid overflow of ticks * 1e9
+            return ticks / Stopwatch.Frequency * NS_PER_SECOND + ticks % Stopwatch.Frequency * NS_PER_SECOND / Stopwatch.Frequency;
+        }
+    }
+}
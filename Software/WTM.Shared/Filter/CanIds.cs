@@ -13,6 +13,10 @@ namespace WTM.Filter
         FileSystemWatcher _watcher;
         public List<int> IgnoredIds { get; set; }
         public List<int> Iso15765Ids { get; set; }
+        /// <summary>
+        /// File with CAN IDs was changed and parsed again
+        /// </summary>
+        public event EventHandler Changed;
         public CanIds(string path)
         {
             Iso15765Ids = new List<int>(new int[]{ 0x700, 0x7E0, 0x7E8, 0x7E1, 0x7E9 }); //Default setup for ISO15765
@@ -105,6 +109,7 @@ namespace WTM.Filter
                 }
                 IgnoredIds = ignored;
                 Iso15765Ids = iso15765;
+                Changed?.Invoke(this, EventArgs.Empty);
             }
             catch(Exception ex)
             {
@@ -0,0 +1,93 @@
+﻿using System;
+using System.Linq;
+
+namespace WTM
+{
+    /// <summary>
+    /// CRCs of FlexRay frame, FlexRay - Protocol Specification V2.1 Rev.A.pdf pg 93 and 99.
+    /// Both CRCs are MSB first without final XOR, calculated by byte lookup tables.
+    /// </summary>
+    public static class FlexRayCrc
+    {
+        /// <summary>
+        /// x^11 + x^9 + x^8 + x^7 + x^2 + 1
+        /// </summary>
+        const int HEADER_POLYNOMIAL = 0x385;
+        const int HEADER_INIT = 0x01A;
+        /// <summary>
+        /// x^24 + x^22 + x^20 + x^19 + x^18 + x^16 + x^14 + x^13 + x^11 + x^10 + x^8 + x^7 + x^6 + x^3 + x + 1
+        /// </summary>
+        const int FRAME_POLYNOMIAL = 0x5D6DCB;
+        const int FRAME_INIT_A = 0xFEDCBA;
+        const int FRAME_INIT_B = 0xABCDEF;
+
+        static readonly ushort[] _headerTable = CreateTable(11, HEADER_POLYNOMIAL).Select(x => (ushort)x).ToArray();
+        static readonly int[] _frameTable = CreateTable(24, FRAME_POLYNOMIAL);
+
+        /// <summary>
+        /// 11 bit header CRC over sync frame indicator, startup frame indicator, frame ID and payload length (20 bits)
+        /// </summary>
+        public static int Header(bool sync, bool startup, int frameId, int payloadLength)
+        {
+            int bits = (sync ? 1 << 19 : 0) | (startup ? 1 << 18 : 0) | (frameId & 0x7FF) << 7 | (payloadLength & 0x7F);
+            int crc = HEADER_INIT;
+            //Two whole bytes by table, remaining 4 bits one by one
+            crc = ((crc << 8) ^ _headerTable[((crc >> 3) ^ (bits >> 12)) & 0xFF]) & 0x7FF;
+            crc = ((crc << 8) ^ _headerTable[((crc >> 3) ^ (bits >> 4)) & 0xFF]) & 0x7FF;
+            for (int i = 3; i >= 0; i--)
+            {
+                int feedback = ((crc >> 10) ^ (bits >> i)) & 1;
+                crc = (crc << 1) & 0x7FF;
+                if (feedback != 0)
+                {
+                    crc ^= HEADER_POLYNOMIAL;
+                }
+            }
+            return crc;
+        }
+
+        /// <summary>
+        /// 24 bit frame CRC over 5 bytes of header and payload
+        /// </summary>
+        /// <param name="channelB">Frame was received on channel B, CRC has different init vector than channel A</param>
+        public static int Frame(byte[] header, byte[] payload, bool channelB)
+        {
+            int crc = channelB ? FRAME_INIT_B : FRAME_INIT_A;
+            crc = Update(crc, header);
+            if (payload != null)
+            {
+                crc = Update(crc, payload);
+            }
+            return crc;
+        }
+
+        static int Update(int crc, byte[] data)
+        {
+            for (int i = 0; i < data.Length; i++)
+            {
+                crc = ((crc << 8) ^ _frameTable[((crc >> 16) ^ data[i]) & 0xFF]) & 0xFFFFFF;
+            }
+            return crc;
+        }
+
+        /// <summary>
+        /// Remainder of every byte shifted to the top of CRC register
+        /// </summary>
+        static int[] CreateTable(int width, int polynomial)
+        {
+            int[] table = new int[256];
+            int top = 1 << (width - 1);
+            int mask = (1 << width) - 1;
+            for (int i = 0; i < table.Length; i++)
+            {
+                int crc = i << (width - 8);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & top) != 0 ? (crc << 1) ^ polynomial : crc << 1;
+                }
+                table[i] = crc & mask;
+            }
+            return table;
+        }
+    }
+}
@@ -18,45 +18,80 @@ namespace WTM
         FLAG_ReservedBit = 0x10,
     }
     /// <summary>
-    /// Setup of FlexRay message as described in FlexRay v2.1 specification
+    /// FlexRay channel on which frame was received
+    /// </summary>
+    public enum FlexRayChannel
+    {
+        A = 0,
+        B = 1,
+    }
+    /// <summary>
+    /// Setup of FlexRay message as described in FlexRay v2.1 specification.
+    /// Result of verification is cached, changing of any property verifies frame again.
     /// </summary>
     public class FlexRayMessage
     {
+        FlexRayFlags _flags;
+        int _frameId;
+        int _payloadLength;
+        int _headerCrc;
+        int _cycleCount;
+        byte[] _data;
+        int _crc;
+        FlexRayChannel _channel;
+        bool? _valid;
+
+        /// <summary>
+        /// Unix time [ns], see ClockDomain
+        /// </summary>
         public long Timestamp { get; set; }
         /// <summary>
-        /// TBD - Create enum with list of possible flags
+        /// Indicators of header, FLAG_NullFrameIndicator is set for null frame
         /// </summary>
-        public FlexRayFlags Flags { get; set; }
+        public FlexRayFlags Flags { get { return _flags; } set { _flags = value; _valid = null; } }
         /// <summary>
         /// 11 bit Frame ID
         /// </summary>
-        public int FrameId { get; set; }
+        public int FrameId { get { return _frameId; } set { _frameId = value; _valid = null; } }
         /// <summary>
         /// Payload length in uint16. Must be always even.
         /// </summary>
-        public int PayloadLength { get; set; }
+        public int PayloadLength { get { return _payloadLength; } set { _payloadLength = value; _valid = null; } }
         /// <summary>
-        /// CRC of header
+        /// 11 bit CRC of header
         /// </summary>
-        public int HeaderCrc { get; set; }
+        public int HeaderCrc { get { return _headerCrc; } set { _headerCrc = value; _valid = null; } }
         /// <summary>
         /// 6 bit cycle count
         /// </summary>
-        public int CycleCount { get; set; }
+        public int CycleCount { get { return _cycleCount; } set { _cycleCount = value; _valid = null; } }
+        /// <summary>
+        /// Data transferred in the frame. Content of array is not expected to change after frame was verified.
+        /// </summary>
+        public byte[] Data { get { return _data; } set { _data = value; _valid = null; } }
         /// <summary>
-        /// Data transferred in the frame
+        /// 24 bit CRC of whole frame
         /// </summary>
-        public byte[] Data { get; set; }
+        public int Crc { get { return _crc; } set { _crc = value; _valid = null; } }
         /// <summary>
-        /// CRC of whole frame
+        /// Channel selects init vector of frame CRC
         /// </summary>
-        public int Crc { get; set; }
+        public FlexRayChannel Channel { get { return _channel; } set { _channel = value; _valid = null; } }
 
         /// <summary>
         /// Verify length and CRCs of FlexRay frame
         /// </summary>
         /// <returns></returns>
         public bool IsMessageValid()
+        {
+            if (_valid == null)
+            {
+                _valid = Verify();
+            }
+            return _valid.Value;
+        }
+
+        private bool Verify()
         {
             if (PayloadLength != 0)
             {
@@ -91,18 +126,36 @@ namespace WTM
         {
             /*
              * ISO17458 - FlexRay\FlexRay - Protocol Specification V2.1 Rev.A.pdf
-             * Page 93 - Verification is 20 bits long. So this mean that I do apply CRC with given polynomial on bits instead of bytes?
+             * Page 93 - Header CRC covers sync frame indicator, startup frame indicator, frame ID and payload length (20 bits)
              */
-            return true;
+            bool sync = (Flags & FlexRayFlags.FLAG_SyncFrameIndicator) != 0;
+            bool startup = (Flags & FlexRayFlags.FLAG_StartupFrameIndicator) != 0;
+            return FlexRayCrc.Header(sync, startup, FrameId, PayloadLength) == HeaderCrc;
         }
 
         private bool VerifyFrameCrc()
         {
             /*
              * ISO17458 - FlexRay\FlexRay - Protocol Specification V2.1 Rev.A.pdf
-             * Page 99
+             * Page 99 - Frame CRC covers whole header (40 bits) and payload
              */
-            return true;
+            return FlexRayCrc.Frame(GetHeader(), Data, Channel == FlexRayChannel.B) == Crc;
+        }
+
+        /// <summary>
+        /// 5 bytes of header as sent on bus: Flags-FID-DLC-HCRC-CYC (5-11-7-11-6 bits)
+        /// </summary>
+        public byte[] GetHeader()
+        {
+            //Null Frame is active in 0
+            FlexRayFlags flags = Flags ^ FlexRayFlags.FLAG_NullFrameIndicator;
+            byte[] header = new byte[5];
+            header[0] = (byte)((int)flags << 3 | ((FrameId >> 8) & 7));
+            header[1] = (byte)(FrameId & 0xFF);
+            header[2] = (byte)(PayloadLength << 1 | ((HeaderCrc >> 10) & 1));
+            header[3] = (byte)((HeaderCrc >> 2) & 0xFF);
+            header[4] = (byte)(HeaderCrc << 6 | (CycleCount & 0x3F));
+            return header;
         }
 
         /// <summary>
@@ -0,0 +1,26 @@
+﻿using System;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Transport protocol reconstructing datagrams from CAN messages, see Passive_Can_Pipeline
+    /// </summary>
+    public interface IPassive_Can_Protocol
+    {
+        /// <summary>
+        /// Reconstructed datagram
+        /// </summary>
+        event EventHandler<RawMessage> OnRawFrame;
+
+        /// <summary>
+        /// Protocol was added into pipeline, claim CAN IDs which protocol expects
+        /// </summary>
+        void Attach(Passive_Can_Pipeline pipeline);
+
+        /// <summary>
+        /// Parse CAN message with ID claimed by protocol
+        /// </summary>
+        /// <returns>True if successfuly processed</returns>
+        bool Parse(CanMessage cmsg);
+    }
+}
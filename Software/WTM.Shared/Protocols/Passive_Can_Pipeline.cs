@@ -0,0 +1,174 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Threading;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Routing of CAN messages into passive transport protocols.
+    /// Every protocol claims CAN IDs it expects, so message is passed only into one protocol instead of trying all of them.
+    /// Datagrams of all protocols are forwarded by OnRawFrame.
+    /// </summary>
+    public class Passive_Can_Pipeline
+    {
+        /// <summary>
+        /// Standard IDs are routed by table, extended IDs by list of ranges
+        /// </summary>
+        const int STANDARD_IDS = 0x800;
+
+        struct Range
+        {
+            public int First;
+            public int Last;
+            public byte Protocol;
+        }
+
+        readonly object _lock = new object();
+        //Arrays are never modified after they were published, changes are made on copy which replaces them under lock.
+        //Parse reads them without lock while IDs are claimed from other thread.
+        IPassive_Can_Protocol[] _protocols = new IPassive_Can_Protocol[0];
+        Range[] _extended = new Range[0];
+        /// <summary>
+        /// Index of protocol + 1 for every standard ID, 0 = not claimed
+        /// </summary>
+        byte[] _standard = new byte[STANDARD_IDS];
+
+        /// <summary>
+        /// Datagram reconstructed by any protocol
+        /// </summary>
+        public event EventHandler<RawMessage> OnRawFrame;
+
+        public void Add(IPassive_Can_Protocol protocol)
+        {
+            lock (_lock)
+            {
+                if (_protocols.Length >= byte.MaxValue)
+                {
+                    throw new InvalidOperationException("Too many passive CAN protocols");
+                }
+                Volatile.Write(ref _protocols, _protocols.Concat(new[] { protocol }).ToArray());
+            }
+            protocol.OnRawFrame += Protocol_OnRawFrame;
+            protocol.Attach(this);
+        }
+
+        /// <summary>
+        /// Route CAN IDs first ~ last into protocol. IDs already claimed by other protocol are kept.
+        /// </summary>
+        /// <returns>False if some ID is claimed by other protocol</returns>
+        public bool Claim(IPassive_Can_Protocol protocol, int first, int last)
+        {
+            bool result = true;
+            lock (_lock)
+            {
+                byte index = Index(protocol);
+                if (first < STANDARD_IDS)
+                {
+                    byte[] standard = (byte[])_standard.Clone();
+                    for (int id = first; id <= last && id < STANDARD_IDS; id++)
+                    {
+                        if (standard[id] == 0)
+                        {
+                            standard[id] = index;
+                        }
+                        else if (standard[id] != index)
+                        {
+                            result = false;
+                        }
+                    }
+                    Volatile.Write(ref _standard, standard);
+                }
+                if (last >= STANDARD_IDS)
+                {
+                    Range range = new Range() { First = Math.Max(first, STANDARD_IDS), Last = last, Protocol = index };
+                    Volatile.Write(ref _extended, _extended.Concat(new[] { range }).ToArray());
+                }
+            }
+            if (!result)
+            {
+                Console.WriteLine($"CAN IDs {first:X} ~ {last:X} are partially claimed by other protocol");
+            }
+            return result;
+        }
+
+        /// <summary>
+        /// Stop routing CAN IDs first ~ last into protocol
+        /// </summary>
+        public void Release(IPassive_Can_Protocol protocol, int first, int last)
+        {
+            lock (_lock)
+            {
+                byte index = Index(protocol);
+                if (first < STANDARD_IDS)
+                {
+                    byte[] standard = (byte[])_standard.Clone();
+                    for (int id = first; id <= last && id < STANDARD_IDS; id++)
+                    {
+                        if (standard[id] == index)
+                        {
+                            standard[id] = 0;
+                        }
+                    }
+                    Volatile.Write(ref _standard, standard);
+                }
+                Volatile.Write(ref _extended, _extended.Where(r => r.Protocol != index || r.First < first || r.Last > last).ToArray());
+            }
+        }
+
+        /// <summary>
+        /// Stop routing all CAN IDs into protocol, i.e. before new configuration is claimed
+        /// </summary>
+        public void Release(IPassive_Can_Protocol protocol)
+        {
+            Release(protocol, 0, int.MaxValue);
+        }
+
+        /// <summary>
+        /// Pass CAN message into protocol which has claimed its ID
+        /// </summary>
+        /// <returns>True if successfuly processed</returns>
+        public bool Parse(CanMessage cmsg)
+        {
+            int index = 0;
+            if (cmsg.Id >= 0 && cmsg.Id < STANDARD_IDS)
+            {
+                index = Volatile.Read(ref _standard)[cmsg.Id];
+            }
+            else
+            {
+                Range[] extended = Volatile.Read(ref _extended);
+                for (int i = 0; i < extended.Length; i++)
+                {
+                    if (cmsg.Id >= extended[i].First && cmsg.Id <= extended[i].Last)
+                    {
+                        index = extended[i].Protocol;
+                        break;
+                    }
+                }
+            }
+            if (index == 0)
+            {
+                return false;
+            }
+            //Protocol is published before any of its IDs, so table read above never points behind the end
+            return Volatile.Read(ref _protocols)[index - 1].Parse(cmsg);
+        }
+
+        /// <returns>Index of protocol + 1</returns>
+        byte Index(IPassive_Can_Protocol protocol)
+        {
+            int index = Array.IndexOf(_protocols, protocol);
+            if (index < 0)
+            {
+                throw new ArgumentException("Protocol was not added into pipeline");
+            }
+            return (byte)(index + 1);
+        }
+
+        private void Protocol_OnRawFrame(object sender, RawMessage e)
+        {
+            OnRawFrame?.Invoke(sender, e);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Placement of one PDU inside of FlexRay frame (FIBEX PDU-INSTANCE)
+    /// </summary>
+    public class FlexRayPduLayout
+    {
+        /// <summary>
+        /// Update bit is not used, PDU is always valid
+        /// </summary>
+        public const int NO_UPDATE_BIT = -1;
+
+        /// <summary>
+        /// Index of PDU in FIBEX file, used as destination IP address of datagram
+        /// </summary>
+        public int Id { get; set; }
+        public string Name { get; set; }
+        /// <summary>
+        /// Offset of PDU in payload of frame [bytes]
+        /// </summary>
+        public int Offset { get; set; }
+        /// <summary>
+        /// Length of PDU [bytes]
+        /// </summary>
+        public int Length { get; set; }
+        /// <summary>
+        /// Bit in payload of frame (bit 0 = LSB of byte 0), PDU was not updated by sender when bit is 0. NO_UPDATE_BIT if not used.
+        /// </summary>
+        public int UpdateBit { get; set; } = NO_UPDATE_BIT;
+
+        public override string ToString()
+        {
+            return $"{Name} [{Offset}:{Length}]";
+        }
+    }
+
+    /// <summary>
+    /// Frame sent in slot on cycles base + N * repetition (FIBEX FRAME-TRIGGERING with its FRAME)
+    /// </summary>
+    public class FlexRayFrameTriggering
+    {
+        public FlexRayChannel Channel { get; set; }
+        /// <summary>
+        /// Slot = Frame ID, 1 - 2047
+        /// </summary>
+        public int Slot { get; set; }
+        /// <summary>
+        /// First cycle in which frame is sent, 0 - 63
+        /// </summary>
+        public int BaseCycle { get; set; }
+        /// <summary>
+        /// Frame is sent every N-th cycle, power of two 1 - 64
+        /// </summary>
+        public int CycleRepetition { get; set; } = 1;
+        public string FrameName { get; set; }
+        public List<FlexRayPduLayout> Pdus { get; } = new List<FlexRayPduLayout>();
+
+        public override string ToString()
+        {
+            return $"{FrameName} {Channel} slot {Slot} cycle {BaseCycle}/{CycleRepetition}, {Pdus.Count} PDUs";
+        }
+    }
+}
@@ -0,0 +1,106 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Split FlexRay frames into PDUs as described by FIBEX, see FlexRayFrameTriggering.
+    /// Layouts are indexed by channel, slot and cycle, so lookup of frame does not depend on size of FIBEX.
+    /// Datagram is [Slot (2 bytes, LE)][Cycle][Channel][Data of PDU]
+    /// </summary>
+    public class Passive_FlexRay_Pdu
+    {
+        public const int HEADER_LENGTH = 4;
+        const int SLOTS = 2048;
+        const int CYCLES = 64;
+
+        /// <summary>
+        /// [channel][slot] = null if slot is unknown, otherwise PDUs of frame by cycle (null for cycle without frame)
+        /// </summary>
+        readonly FlexRayPduLayout[][][][] _layouts = new FlexRayPduLayout[2][][][];
+
+        public event EventHandler<RawMessage> OnRawFrame;
+
+        /// <summary>
+        /// Amount of PDUs with update bit in 0, those are not sent further
+        /// </summary>
+        public long NotUpdated { get; private set; }
+
+        public Passive_FlexRay_Pdu(IEnumerable<FlexRayFrameTriggering> triggerings)
+        {
+            _layouts[(int)FlexRayChannel.A] = new FlexRayPduLayout[SLOTS][][];
+            _layouts[(int)FlexRayChannel.B] = new FlexRayPduLayout[SLOTS][][];
+            foreach (FlexRayFrameTriggering ft in triggerings)
+            {
+                Add(ft);
+            }
+        }
+
+        void Add(FlexRayFrameTriggering ft)
+        {
+            if (ft.Slot <= 0 || ft.Slot >= SLOTS || ft.BaseCycle < 0 || ft.BaseCycle >= CYCLES || ft.CycleRepetition <= 0)
+            {
+                Console.WriteLine("FlexRay frame {0} has invalid timing, slot {1} cycle {2}/{3}", ft.FrameName, ft.Slot, ft.BaseCycle, ft.CycleRepetition);
+                return;
+            }
+            FlexRayPduLayout[][] cycles = _layouts[(int)ft.Channel][ft.Slot];
+            if (cycles == null)
+            {
+                cycles = new FlexRayPduLayout[CYCLES][];
+                _layouts[(int)ft.Channel][ft.Slot] = cycles;
+            }
+            FlexRayPduLayout[] pdus = ft.Pdus.ToArray();
+            for (int cycle = ft.BaseCycle; cycle < CYCLES; cycle += ft.CycleRepetition)
+            {
+                cycles[cycle] = pdus;
+            }
+        }
+
+        /// <summary>
+        /// Send PDUs of FlexRay frame
+        /// </summary>
+        /// <returns>True if frame has known layout</returns>
+        public bool Parse(FlexRayMessage fmsg)
+        {
+            if (fmsg.FrameId <= 0 || fmsg.FrameId >= SLOTS || fmsg.CycleCount >= CYCLES)
+            {
+                return false;
+            }
+            FlexRayPduLayout[][] cycles = _layouts[(int)fmsg.Channel][fmsg.FrameId];
+            FlexRayPduLayout[] pdus = cycles?[fmsg.CycleCount];
+            if (pdus == null)
+            {
+                return false;
+            }
+            //Null frame and frame with wrong CRC are shown only on FlexRay link layer
+            if ((fmsg.Flags & FlexRayFlags.FLAG_NullFrameIndicator) != 0 || fmsg.Data == null || !fmsg.IsMessageValid())
+            {
+                return true;
+            }
+            byte[] data = fmsg.Data;
+            foreach (FlexRayPduLayout pdu in pdus)
+            {
+                if (pdu.Offset + pdu.Length > data.Length)
+                {
+                    continue;
+                }
+                if (pdu.UpdateBit != FlexRayPduLayout.NO_UPDATE_BIT && (pdu.UpdateBit >> 3 >= data.Length || (data[pdu.UpdateBit >> 3] & (1 << (pdu.UpdateBit & 7))) == 0))
+                {
+                    NotUpdated++;
+                    continue;
+                }
+                RawMessage rmsg = new RawMessage(HEADER_LENGTH + pdu.Length);
+                rmsg.MessageType = RawMessageType.Raw_FlexRayPdu;
+                rmsg.Timestamp = (ulong)fmsg.Timestamp;
+                rmsg.Id = (uint)pdu.Id;
+                rmsg.Frame[0] = (byte)fmsg.FrameId;
+                rmsg.Frame[1] = (byte)(fmsg.FrameId >> 8);
+                rmsg.Frame[2] = (byte)fmsg.CycleCount;
+                rmsg.Frame[3] = (byte)fmsg.Channel;
+                Buffer.BlockCopy(data, pdu.Offset, rmsg.Frame, HEADER_LENGTH, pdu.Length);
+                OnRawFrame?.Invoke(this, rmsg);
+            }
+            return true;
+        }
+    }
+}
@@ -6,24 +6,56 @@ using System.Threading.Tasks;
 
 namespace WTM.Protocols
 {
-    public class Passive_ISO15765
+    public class Passive_ISO15765 : IPassive_Can_Protocol
     {
+        /// <summary>
+        /// Initial buffer size for classic FF_DL (12 bits), it grows up to ISO15765_SEGMENT_LENGTH by longer datagrams
+        /// </summary>
+        const int ISO15765_FRAME_LENGTH = 4096;
+        /// <summary>
+        /// Longer datagrams are sent in segments of this size, IPv4 header of RAW packet has only 16 bit length
+        /// </summary>
+        const int ISO15765_SEGMENT_LENGTH = 0xFFFF - 20;
+        /// <summary>
+        /// Longer FF_DL is coded by escape sequence (FF_DL = 0 + 32 bit length)
+        /// </summary>
+        const int ISO15765_FF_DL_MAX_12 = 0xFFF;
+
         // -- Private variables
-        byte[] iso15765_frame = new byte[4096];
+        byte[] iso15765_frame = new byte[ISO15765_FRAME_LENGTH];
         int iso15765_frame_position = 0;
-        int iso15765_frame_expectedLength = 0;
+        long iso15765_frame_expectedLength = 0;
         int iso15765_frame_expectedSN;
+        bool iso15765_frame_snGap;
+        int iso15765_frame_segment;     //Segment of datagram in buffer, 0 if datagram fits into one RAW packet
+        int iso15765_frame_segmentCount;
+        Passive_ISO15765_Timing iso15765_timing = new Passive_ISO15765_Timing();
 
         public event EventHandler<RawMessage> OnRawFrame;
 
+        /// <summary>
+        /// IDs of ISO15765 are configured by CanIds and claimed by owner of pipeline
+        /// </summary>
+        void IPassive_Can_Protocol.Attach(Passive_Can_Pipeline pipeline)
+        {
+        }
+
+        bool IPassive_Can_Protocol.Parse(CanMessage cmsg)
+        {
+            return Passive_Iso15765_Parse(cmsg);
+        }
+
         void Passive_Iso15765_VerifyPreviousDatagram()
         {
-            if (iso15765_frame_position != 0)
+            if (iso15765_frame_expectedLength != 0)
             {
                 Console.WriteLine("We are trying to process another datagram, even that we still have datagram with length 0x{0:x} bytes in buffer", iso15765_frame_position);
                 Console.WriteLine("Datagram is still missing 0x{0:x} bytes to be complete", iso15765_frame_expectedLength);
-                iso15765_frame_position = 0;
             }
+            iso15765_frame_position = 0;
+            iso15765_frame_expectedLength = 0;
+            iso15765_frame_segment = 0;
+            iso15765_timing.End();
         }
 
         void Passive_Iso15765_SingleFrame(CanMessage cmsg)
@@ -31,45 +63,81 @@ namespace WTM.Protocols
             int i;
             Passive_Iso15765_VerifyPreviousDatagram();
             int length = cmsg.Data[0] & 0xF;
-            if (length > cmsg.Dlc - 1)
+            int offset = 1;
+            if (length == 0 && cmsg.Dlc > CanMessage.MAX_LENGTH_CAN)
+            {
+                //CAN FD escape sequence, SF_DL is in the second byte
+                length = cmsg.Data[1];
+                offset = 2;
+            }
+            if (length == 0 || length > cmsg.Dlc - offset)
             {
                 return;
             }
 
-            for (i = 1; i < length + 1; i++)
+            for (i = offset; i < length + offset; i++)
             {
                 iso15765_frame[iso15765_frame_position] = cmsg.Data[i];
                 iso15765_frame_position++;
             }
-            AddNewMessage(cmsg.Id, cmsg.Timestamp);
+            AddNewMessage(cmsg.Id, cmsg.Timestamp, false);
             iso15765_frame_position = 0;
         }
 
         void Passive_Iso15765_FirstFrame(CanMessage cmsg)
         {
-            int i;
             Passive_Iso15765_VerifyPreviousDatagram();
-            iso15765_frame_expectedLength = ((cmsg.Data[0] & 0xF) << 8) | cmsg.Data[1];
-            iso15765_frame_expectedSN = 1; //Always starting on 1
-            for (i = 2; i < cmsg.Dlc; i++)
+            int offset = 2;
+            if (cmsg.Dlc < CanMessage.MAX_LENGTH_CAN)
             {
-                iso15765_frame[iso15765_frame_position] = cmsg.Data[i];
-                iso15765_frame_position++;
-                iso15765_frame_expectedLength--;
-
-                if (iso15765_frame_expectedLength == 0)
+                //First Frame uses always whole CAN frame
+                Console.WriteLine("ISO15765 First Frame with DLC {0}", cmsg.Dlc);
+                return;
+            }
+            long length = ((cmsg.Data[0] & 0xF) << 8) | cmsg.Data[1];
+            if (length == 0)
+            {
+                //Escape sequence, FF_DL is 32 bit big endian value
+                offset = 6;
+                length = ((long)cmsg.Data[2] << 24) | ((long)cmsg.Data[3] << 16) | ((long)cmsg.Data[4] << 8) | cmsg.Data[5];
+                if (length <= ISO15765_FF_DL_MAX_12)
                 {
-                    AddNewMessage(cmsg.Id, cmsg.Timestamp);
-                    iso15765_frame_position = 0;
-                    break;
+                    Console.WriteLine("ISO15765 First Frame escape sequence with FF_DL 0x{0:x}", length);
+                    return;
                 }
             }
+            else if (length < cmsg.Dlc)
+            {
+                //Would fit into Single Frame
+                Console.WriteLine("ISO15765 First Frame with FF_DL 0x{0:x}", length);
+                return;
+            }
+            if (length > iso15765_frame.Length && iso15765_frame.Length < ISO15765_SEGMENT_LENGTH)
+            {
+                //Buffer is kept for following datagrams, consecutive frames are only copied
+                iso15765_frame = new byte[Math.Min(length, ISO15765_SEGMENT_LENGTH)];
+            }
+            iso15765_frame_expectedLength = length;
+            iso15765_timing.FirstFrame(cmsg.Timestamp, length);
+            iso15765_frame_expectedSN = 1; //Always starting on 1
+            iso15765_frame_snGap = false;
+            if (length > ISO15765_SEGMENT_LENGTH)
+            {
+                iso15765_frame_segment = 1;
+                iso15765_frame_segmentCount = (int)((length + ISO15765_SEGMENT_LENGTH - 1) / ISO15765_SEGMENT_LENGTH);
+            }
+            Passive_Iso15765_Append(cmsg, offset);
         }
 
         void Passive_Iso15765_ConsequtiveFrame(CanMessage cmsg)
         {
-            int i;
             int receivedSN;
+            if (iso15765_frame_expectedLength == 0)
+            {
+                //No First Frame, or it was lost
+                return;
+            }
+            iso15765_timing.ConsecutiveFrame(cmsg.Timestamp);
             if ((cmsg.Data[0] & 0xF) == iso15765_frame_expectedSN)
             {
                 iso15765_frame_expectedSN++;
@@ -79,31 +147,61 @@ namespace WTM.Protocols
             {
                 receivedSN = (cmsg.Data[0] & 0xF);
                 Console.WriteLine("Expected S/N = 0x{0:X}. Provided 0x{1:X}", iso15765_frame_expectedSN, receivedSN);
-                iso15765_frame_expectedSN = receivedSN + 1;
+                iso15765_frame_expectedSN = (receivedSN + 1) & 0xF;
+                iso15765_frame_snGap = true;
             }
 
-            for (i = 1; i < cmsg.Dlc; i++)
+            Passive_Iso15765_Append(cmsg, 1);
+        }
+
+        /// <summary>
+        /// Copy data of First Frame or Consecutive Frame into buffer, never more than expected length
+        /// </summary>
+        void Passive_Iso15765_Append(CanMessage cmsg, int offset)
+        {
+            int i;
+            for (i = offset; i < cmsg.Dlc && iso15765_frame_expectedLength != 0; i++)
             {
+                if (iso15765_frame_position == iso15765_frame.Length)
+                {
+                    //Buffer is full, stream it out as segment
+                    AddNewMessage(cmsg.Id, cmsg.Timestamp, false);
+                }
                 iso15765_frame[iso15765_frame_position] = cmsg.Data[i];
                 iso15765_frame_position++;
                 iso15765_frame_expectedLength--;
-
-                if (iso15765_frame_expectedLength == 0)
-                {
-                    AddNewMessage(cmsg.Id, cmsg.Timestamp);
-                    iso15765_frame_position = 0;
-                    break;
-                }
+            }
+            if (iso15765_frame_expectedLength == 0)
+            {
+                AddNewMessage(cmsg.Id, cmsg.Timestamp, true);
+                iso15765_frame_segment = 0;
+                iso15765_timing.End();
             }
         }
 
-        private void AddNewMessage(int id, long timestamp)
+        /// <param name="complete">Last packet of segmented transfer, timing of transfer is added into comment</param>
+        private void AddNewMessage(int id, long timestamp, bool complete)
         {
             RawMessage rmsg = new RawMessage(iso15765_frame_position);
             rmsg.MessageType = RawMessageType.Raw_ISO15765;
             rmsg.Timestamp = (ulong)timestamp;
             rmsg.Id = (uint)id;
+            if (iso15765_frame_segment != 0)
+            {
+                rmsg.Comment = $"segment {iso15765_frame_segment}/{iso15765_frame_segmentCount}{(iso15765_frame_snGap ? ", SN gap" : "")}";
+                iso15765_frame_segment++;
+            }
+            else if (iso15765_frame_snGap)
+            {
+                rmsg.Comment = "SN gap";
+            }
+            if (complete)
+            {
+                rmsg.Comment = rmsg.Comment == null ? iso15765_timing.ToString() : rmsg.Comment + "; " + iso15765_timing;
+            }
+            iso15765_frame_snGap = false;
             Buffer.BlockCopy(iso15765_frame, 0, rmsg.Frame, 0, iso15765_frame_position);
+            iso15765_frame_position = 0;
             OnRawFrame(this, rmsg);
         }
 
@@ -135,7 +233,8 @@ namespace WTM.Protocols
                     Passive_Iso15765_ConsequtiveFrame(cmsg);
                     break;
                 case 3:
-                    //Do nothing with flow control frame
+                    //Flow control is only measured, it does not carry data
+                    iso15765_timing.FlowControl(cmsg.Data, cmsg.Timestamp);
                     break;
                 default:
                     Console.WriteLine("Invalid PCI byte was provided!");
@@ -0,0 +1,220 @@
+﻿using System;
+using System.Globalization;
+using System.Text;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Timing of one segmented ISO15765 transfer (First Frame, Flow Controls, Consecutive Frames).
+    /// Checks BS and STmin of every Flow Control against spacing of Consecutive Frames and N_Bs / N_Cr timeouts.
+    /// Everything is computed when frame is received, nothing is buffered.
+    /// </summary>
+    public class Passive_ISO15765_Timing
+    {
+        const long NS_PER_MS = 1000000;
+        /// <summary>
+        /// Time until sender receives Flow Control (ISO 15765-2 default)
+        /// </summary>
+        const long N_BS_TIMEOUT_NS = 1000 * NS_PER_MS;
+        /// <summary>
+        /// Time until receiver receives next Consecutive Frame (ISO 15765-2 default)
+        /// </summary>
+        const long N_CR_TIMEOUT_NS = 1000 * NS_PER_MS;
+
+        const int FS_CTS = 0;
+        const int FS_WAIT = 1;
+        const int FS_OVFLW = 2;
+
+        bool _active;
+        long _length;
+        long _start;            //First Frame
+        long _last;             //Last frame of sender (FF or CF) or last FC.WAIT
+        long _end;              //Last Consecutive Frame
+        bool _waitingFc;        //First Frame or last CF of block was sent, next should be Flow Control
+        int _blockSize;
+        long _stMin;            //[ns]
+        int _cfInBlock;
+
+        int _fcCount;
+        int _fcWait;
+        int _fcMissing;
+        bool _fcOverflow;
+        long _fcResponseMax;
+        long _cfGapMin;
+        long _cfGapMax;
+        int _stMinViolations;
+        int _nBsTimeouts;
+        int _nCrTimeouts;
+
+        /// <summary>
+        /// Transfer was started by First Frame
+        /// </summary>
+        public void FirstFrame(long timestamp, long length)
+        {
+            _active = true;
+            _length = length;
+            _start = timestamp;
+            _last = timestamp;
+            _end = timestamp;
+            _waitingFc = true;
+            _blockSize = 0;
+            _stMin = 0;
+            _cfInBlock = 0;
+            _fcCount = 0;
+            _fcWait = 0;
+            _fcMissing = 0;
+            _fcOverflow = false;
+            _fcResponseMax = 0;
+            _cfGapMin = long.MaxValue;
+            _cfGapMax = 0;
+            _stMinViolations = 0;
+            _nBsTimeouts = 0;
+            _nCrTimeouts = 0;
+        }
+
+        /// <summary>
+        /// Flow Control frame of receiver
+        /// </summary>
+        /// <param name="data">Data of CAN frame, [0] = 0x3 + FS, [1] = BS, [2] = STmin</param>
+        public void FlowControl(byte[] data, long timestamp)
+        {
+            if (!_active || data.Length < 3)
+            {
+                return;
+            }
+            _fcCount++;
+            long response = timestamp - _last;
+            _fcResponseMax = Math.Max(_fcResponseMax, response);
+            if (response > N_BS_TIMEOUT_NS)
+            {
+                _nBsTimeouts++;
+            }
+
+            switch (data[0] & 0xF)
+            {
+                case FS_CTS:
+                    _blockSize = data[1];
+                    _stMin = DecodeStMin(data[2]);
+                    _cfInBlock = 0;
+                    _waitingFc = false;
+                    _last = timestamp;
+                    break;
+                case FS_WAIT:
+                    //N_Bs starts again with every FC.WAIT
+                    _fcWait++;
+                    _last = timestamp;
+                    break;
+                case FS_OVFLW:
+                    //Receiver refused transfer
+                    _fcOverflow = true;
+                    break;
+            }
+        }
+
+        /// <summary>
+        /// Consecutive Frame of sender
+        /// </summary>
+        public void ConsecutiveFrame(long timestamp)
+        {
+            if (!_active)
+            {
+                return;
+            }
+            long gap = timestamp - _last;
+            if (gap > N_CR_TIMEOUT_NS)
+            {
+                _nCrTimeouts++;
+            }
+            if (_waitingFc)
+            {
+                //Sender has not waited for Flow Control (or FC was not received by us)
+                _fcMissing++;
+                _waitingFc = false;
+                _cfInBlock = 0;
+            }
+            else if (_cfInBlock > 0)
+            {
+                //Spacing inside of block, first CF is measured from Flow Control
+                _cfGapMin = Math.Min(_cfGapMin, gap);
+                _cfGapMax = Math.Max(_cfGapMax, gap);
+                if (gap < _stMin)
+                {
+                    _stMinViolations++;
+                }
+            }
+            _cfInBlock++;
+            if (_blockSize != 0 && _cfInBlock == _blockSize)
+            {
+                _waitingFc = true;
+            }
+            _last = timestamp;
+            _end = timestamp;
+        }
+
+        /// <summary>
+        /// Transfer is complete or was aborted
+        /// </summary>
+        public void End()
+        {
+            _active = false;
+        }
+
+        /// <summary>
+        /// Separation time in ns. 0x00 - 0x7F ms, 0xF1 - 0xF9 100 - 900 us, reserved values are 0x7F ms.
+        /// </summary>
+        public static long DecodeStMin(byte stMin)
+        {
+            if (stMin <= 0x7F)
+            {
+                return stMin * NS_PER_MS;
+            }
+            if (stMin >= 0xF1 && stMin <= 0xF9)
+            {
+                return (stMin - 0xF0) * 100000L;
+            }
+            return 0x7F * NS_PER_MS;
+        }
+
+        /// <summary>
+        /// Summary of transfer for packet comment
+        /// </summary>
+        /// <returns>i.e. 4095 B in 52.31 ms (78.3 kB/s), FC 1 (BS 0, STmin 0.00 ms), CF gap 0.12-0.45 ms, FC response max 1.20 ms</returns>
+        public override string ToString()
+        {
+            StringBuilder sb = new StringBuilder();
+            long duration = _end - _start;
+            sb.AppendFormat(CultureInfo.InvariantCulture, "{0} B in {1:0.00} ms", _length, (double)duration / NS_PER_MS);
+            if (duration > 0)
+            {
+                sb.AppendFormat(CultureInfo.InvariantCulture, " ({0:0.0} kB/s)", _length * 1000000.0 / duration);
+            }
+            sb.AppendFormat(CultureInfo.InvariantCulture, ", FC {0} (BS {1}, STmin {2:0.00} ms)", _fcCount, _blockSize, (double)_stMin / NS_PER_MS);
+            if (_cfGapMax > 0)
+            {
+                sb.AppendFormat(CultureInfo.InvariantCulture, ", CF gap {0:0.00}-{1:0.00} ms", (double)_cfGapMin / NS_PER_MS, (double)_cfGapMax / NS_PER_MS);
+            }
+            if (_fcCount > 0)
+            {
+                sb.AppendFormat(CultureInfo.InvariantCulture, ", FC response max {0:0.00} ms", (double)_fcResponseMax / NS_PER_MS);
+            }
+            AppendCount(sb, "FC.WAIT", _fcWait);
+            AppendCount(sb, "FC missing", _fcMissing);
+            AppendCount(sb, "STmin violation", _stMinViolations);
+            AppendCount(sb, "N_Bs timeout", _nBsTimeouts);
+            AppendCount(sb, "N_Cr timeout", _nCrTimeouts);
+            if (_fcOverflow)
+            {
+                sb.Append(", FC.OVFLW");
+            }
+            return sb.ToString();
+        }
+
+        private static void AppendCount(StringBuilder sb, string name, int count)
+        {
+            if (count > 0)
+            {
+                sb.Append($", {name} {count}x");
+            }
+        }
+    }
+}
@@ -0,0 +1,194 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// Passive reassembly of J1939 transport protocol (TP.CM / TP.DT), BAM and RTS/CTS transfers of PGNs longer than 8 bytes.
+    /// Datagram is [PGN (3 bytes, LE)][Source address][Destination address][Data]
+    /// </summary>
+    public class Passive_J1939 : IPassive_Can_Protocol
+    {
+        enum Control
+        {
+            //Request to send, destination specific transfer
+            RTS = 16,
+            //Clear to send, sent by receiver
+            CTS = 17,
+            //End of message acknowledge, sent by receiver
+            EOMA = 19,
+            //Broadcast announce message
+            BAM = 32,
+            //Connection abort, sent by any side
+            Abort = 255,
+        }
+
+        const int PF_TP_CM = 0xEC;
+        const int PF_TP_DT = 0xEB;
+        const int ADDRESS_GLOBAL = 0xFF;
+        /// <summary>
+        /// T2 / T3, transfer without any frame is dropped
+        /// </summary>
+        const long TIMEOUT_NS = 1250L * 1000000;
+
+        /// <summary>
+        /// Transfers by source address &lt;&lt; 8 | destination address, closed ones are reused
+        /// </summary>
+        readonly Dictionary<int, Passive_J1939_Session> _sessions = new Dictionary<int, Passive_J1939_Session>();
+
+        public event EventHandler<RawMessage> OnRawFrame;
+
+        /// <summary>
+        /// TP.DT and TP.CM of all priorities, EDP = 0 and DP = 0
+        /// </summary>
+        void IPassive_Can_Protocol.Attach(Passive_Can_Pipeline pipeline)
+        {
+            for (int priority = 0; priority < 8; priority++)
+            {
+                pipeline.Claim(this, (priority << 26) | (PF_TP_DT << 16), (priority << 26) | (PF_TP_CM << 16) | 0xFFFF);
+            }
+        }
+
+        bool IPassive_Can_Protocol.Parse(CanMessage cmsg)
+        {
+            return Passive_J1939_Parse(cmsg);
+        }
+
+        /// <summary>
+        /// Try to parse CAN as J1939 transport protocol
+        /// </summary>
+        /// <returns>True if successfuly processed</returns>
+        public bool Passive_J1939_Parse(CanMessage cmsg)
+        {
+            int pf = (cmsg.Id >> 16) & 0xFF;
+            int ps = (cmsg.Id >> 8) & 0xFF;
+            int sa = cmsg.Id & 0xFF;
+            //Only 29 bit IDs with EDP = 0 and DP = 0
+            if (cmsg.Id <= 0x7FF || (cmsg.Id & 0x3000000) != 0 || cmsg.Dlc < 2 || cmsg.IsFd)
+            {
+                return false;
+            }
+            if (pf == PF_TP_CM && cmsg.Dlc == 8)
+            {
+                ConnectionManagement(cmsg, sa, ps);
+                return true;
+            }
+            if (pf == PF_TP_DT)
+            {
+                DataTransfer(cmsg, sa, ps);
+                return true;
+            }
+            return false;
+        }
+
+        /// <returns>Null if there is no open transfer from source to destination</returns>
+        Passive_J1939_Session FindSession(int source, int destination)
+        {
+            Passive_J1939_Session session;
+            if (_sessions.TryGetValue(source << 8 | destination, out session) && session.Open)
+            {
+                return session;
+            }
+            return null;
+        }
+
+        void ConnectionManagement(CanMessage cmsg, int source, int destination)
+        {
+            Passive_J1939_Session session;
+            int pgn = cmsg.Data[5] | (cmsg.Data[6] << 8) | (cmsg.Data[7] << 16);
+            switch ((Control)cmsg.Data[0])
+            {
+                case Control.RTS:
+                case Control.BAM:
+                    int size = cmsg.Data[1] | (cmsg.Data[2] << 8);
+                    int packets = cmsg.Data[3];
+                    if (size <= 8 || size > Passive_J1939_Session.MAX_LENGTH || packets != (size + 6) / 7)
+                    {
+                        Console.WriteLine("J1939 TP.CM of PGN {0:x} has invalid size {1} / {2} packets", pgn, size, packets);
+                        return;
+                    }
+                    if (!_sessions.TryGetValue(source << 8 | destination, out session))
+                    {
+                        session = new Passive_J1939_Session(source, destination);
+                        _sessions[source << 8 | destination] = session;
+                    }
+                    else if (session.Open)
+                    {
+                        Console.WriteLine("J1939 Transfer of PGN {0:x} from {1:x} to {2:x} was not finished", session.Pgn, source, destination);
+                    }
+                    session.Start((cmsg.Id >> 26) & 0x7, pgn, size, packets, cmsg.Timestamp);
+                    break;
+                case Control.CTS:
+                    //Receiver answers to originator
+                    session = FindSession(destination, source);
+                    if (session != null)
+                    {
+                        session.LastActivity = cmsg.Timestamp;
+                    }
+                    break;
+                case Control.EOMA:
+                    //Receiver has everything, send also incomplete datagram
+                    session = FindSession(destination, source);
+                    if (session != null)
+                    {
+                        AddNewMessage(session, cmsg.Timestamp);
+                    }
+                    break;
+                case Control.Abort:
+                    session = FindSession(source, destination) ?? FindSession(destination, source);
+                    if (session != null)
+                    {
+                        Console.WriteLine("J1939 Transfer of PGN {0:x} was aborted, reason {1}", pgn, cmsg.Data[1]);
+                        session.Close();
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void DataTransfer(CanMessage cmsg, int source, int destination)
+        {
+            int seq = cmsg.Data[0];
+            Passive_J1939_Session session = FindSession(source, destination);
+            if (session == null)
+            {
+                //TP.CM was not received, i.e. transfer has started before connection
+                return;
+            }
+            if (cmsg.Timestamp - session.LastActivity > TIMEOUT_NS)
+            {
+                Console.WriteLine("J1939 Transfer of PGN {0:x} has timed out", session.Pgn);
+                session.Close();
+                return;
+            }
+            if (seq == 0 || seq > session.Packets)
+            {
+                Console.WriteLine("J1939 TP.DT of PGN {0:x} has invalid sequence number {1}", session.Pgn, seq);
+                return;
+            }
+            session.LastActivity = cmsg.Timestamp;
+            session.Append(seq, cmsg.Data);
+            //BAM can't repeat lost packets, RTS/CTS waits for repeated packets or End of message acknowledge
+            if (session.ReceivedCount == session.Packets || (seq == session.Packets && session.Destination == ADDRESS_GLOBAL))
+            {
+                AddNewMessage(session, cmsg.Timestamp);
+            }
+        }
+
+        private void AddNewMessage(Passive_J1939_Session session, long timestamp)
+        {
+            RawMessage rmsg = new RawMessage(Passive_J1939_Session.HEADER_LENGTH + session.Size);
+            rmsg.MessageType = RawMessageType.Raw_J1939;
+            rmsg.Timestamp = (ulong)timestamp;
+            rmsg.Id = (uint)session.CanId;
+            if (session.ReceivedCount != session.Packets)
+            {
+                rmsg.Comment = "SN gap";
+            }
+            Buffer.BlockCopy(session.Frame, 0, rmsg.Frame, 0, rmsg.Frame.Length);
+            session.Close();
+            OnRawFrame?.Invoke(this, rmsg);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+﻿using System;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// One J1939 transfer (BAM or RTS/CTS) between source and destination address
+    /// </summary>
+    internal class Passive_J1939_Session
+    {
+        /// <summary>
+        /// PGN, source address, destination address
+        /// </summary>
+        public const int HEADER_LENGTH = 5;
+        /// <summary>
+        /// 255 packets * 7 bytes
+        /// </summary>
+        public const int MAX_LENGTH = 1785;
+
+        readonly bool[] _received = new bool[256];
+
+        public bool Open { get; private set; }
+        public int Source { get; }
+        /// <summary>
+        /// 0xFF for BAM
+        /// </summary>
+        public int Destination { get; }
+        /// <summary>
+        /// Priority of TP.CM
+        /// </summary>
+        public int Priority { get; private set; }
+        public int Pgn { get; private set; }
+        public int Size { get; private set; }
+        public int Packets { get; private set; }
+        public int ReceivedCount { get; private set; }
+        /// <summary>
+        /// Timestamp of last frame [ns]
+        /// </summary>
+        public long LastActivity { get; set; }
+        /// <summary>
+        /// Header and data of datagram
+        /// </summary>
+        public byte[] Frame { get; } = new byte[HEADER_LENGTH + MAX_LENGTH];
+
+        public Passive_J1939_Session(int source, int destination)
+        {
+            Source = source;
+            Destination = destination;
+        }
+
+        public void Start(int priority, int pgn, int size, int packets, long timestamp)
+        {
+            Open = true;
+            Priority = priority;
+            Pgn = pgn;
+            Size = size;
+            Packets = packets;
+            ReceivedCount = 0;
+            LastActivity = timestamp;
+            Array.Clear(_received, 0, _received.Length);
+            Frame[0] = (byte)pgn;
+            Frame[1] = (byte)(pgn >> 8);
+            Frame[2] = (byte)(pgn >> 16);
+            Frame[3] = (byte)Source;
+            Frame[4] = (byte)Destination;
+            //Packets which are not received are 0xFF
+            for (int i = HEADER_LENGTH; i < HEADER_LENGTH + size; i++)
+            {
+                Frame[i] = 0xFF;
+            }
+        }
+
+        /// <summary>
+        /// Copy data of TP.DT, packet can be repeated on request of CTS
+        /// </summary>
+        public void Append(int seq, byte[] data)
+        {
+            if (!_received[seq])
+            {
+                _received[seq] = true;
+                ReceivedCount++;
+            }
+            int offset = (seq - 1) * 7;
+            int length = Math.Min(Math.Min(7, Size - offset), data.Length - 1);
+            Buffer.BlockCopy(data, 1, Frame, HEADER_LENGTH + offset, length);
+        }
+
+        public void Close()
+        {
+            Open = false;
+        }
+
+        /// <summary>
+        /// CAN ID of PGN as if it was sent in one frame
+        /// </summary>
+        public int CanId
+        {
+            get
+            {
+                int id = (Priority << 26) | ((Pgn & 0x3FF00) << 8) | Source;
+                if (((Pgn >> 8) & 0xFF) < 240)
+                {
+                    //PDU1 format, PS is destination address
+                    return id | (Destination << 8);
+                }
+                //PDU2 format, PS is group extension
+                return id | ((Pgn & 0xFF) << 8);
+            }
+        }
+    }
+}
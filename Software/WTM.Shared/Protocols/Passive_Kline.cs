@@ -461,7 +461,7 @@ namespace WTM.Protocols
                 framePos++;
             }
             msg.MessageType = RawMessageType.Raw_ISO14230;
-            msg.Timestamp = GetTime_ms();
+            msg.Timestamp = (ulong)ClockDomain.HostNowNs;
             //Console.WriteLine("ISO14230 data: " + BitConverter.ToString(msg.Frame, 0, msg.Frame.Length));
             OnRawFrame?.Invoke(this, msg);
             _kline_buffer_end = 0;
@@ -507,7 +507,7 @@ namespace WTM.Protocols
                 length++;
             }
             msg.MessageType = RawMessageType.Raw_KW1281;
-            msg.Timestamp = GetTime_ms();
+            msg.Timestamp = (ulong)ClockDomain.HostNowNs;
             OnRawFrame?.Invoke(this, msg);
             _kline_buffer_end = 0;
         }
@@ -6,7 +6,10 @@ using System.Threading.Tasks;
 
 namespace WTM.Protocols
 {
-    public class Passive_VWTP20
+    /// <summary>
+    /// Passive reassembly of VWTP2.0 datagrams. Every channel negotiated on broadcast channel (i.e. engine and gearbox at once) has own state.
+    /// </summary>
+    public class Passive_VWTP20 : IPassive_Can_Protocol
     {
         // -- Private defintions
         enum TCPI1
@@ -24,6 +27,8 @@ namespace WTM.Protocols
             TCPI1_CFrame_BlockSizeReachedAck = 0x00,
             // Bx - Ack, "X" is SEQ
             TCPI1_Ack = 0xB0,
+            // 9x - Ack, receiver is not ready for next block, "X" is SEQ
+            TCPI1_Ack_NotReady = 0x90,
             // A0 - Paramters request
             TCPI1_Connection_ParamRequest = 0xA0,
             // A1 - Parameters response. Returning paramters from A0 or A3
@@ -38,16 +43,42 @@ namespace WTM.Protocols
             TCPI1_Unkown,
         }
 
+        /// <summary>
+        /// Channel without any frame for this time is closed when new channel is negotiated
+        /// </summary>
+        const long CHANNEL_TIMEOUT_NS = 5000000000;
+
         // -- Private variables
-        uint testerId = 0xFFFFFFFF;
-        uint ecuId = 0xFFFFFFFF;
-        byte[] tp20_frame = new byte[0x100];
-        int tp20_frame_count;
-        bool flag_DatagramReceived = false;
-        bool flag_expectingAck = false;
+        /// <summary>
+        /// Open channels by CAN ID of tester and CAN ID of ECU
+        /// </summary>
+        Dictionary<int, Passive_VWTP20_Channel> _channels = new Dictionary<int, Passive_VWTP20_Channel>();
+        /// <summary>
+        /// Closed channels with already allocated buffers
+        /// </summary>
+        Stack<Passive_VWTP20_Channel> _channelPool = new Stack<Passive_VWTP20_Channel>();
 
         public event EventHandler<RawMessage> OnRawFrame;
 
+        /// <summary>
+        /// Pipeline which routes IDs of channels into this protocol, null if protocol is used directly
+        /// </summary>
+        Passive_Can_Pipeline _pipeline;
+
+        /// <summary>
+        /// Broadcast channel is claimed at once, IDs of channels are claimed when channel is opened
+        /// </summary>
+        void IPassive_Can_Protocol.Attach(Passive_Can_Pipeline pipeline)
+        {
+            _pipeline = pipeline;
+            _pipeline.Claim(this, 0x200, 0x2FF);
+        }
+
+        bool IPassive_Can_Protocol.Parse(CanMessage cmsg)
+        {
+            return Passive_Vwtp20_Parse(cmsg);
+        }
+
         /// <summary>
         /// Method is checking for 0x200~0x2FF CAN IDs
         /// </summary>
@@ -62,44 +93,84 @@ namespace WTM.Protocols
             }
             byte ecuAddress = msg.Data[0];
             byte opcode = msg.Data[1];
-            ushort txid = BitConverter.ToUInt16(msg.Data, 2);
-            ushort rxid = BitConverter.ToUInt16(msg.Data, 4);
+            //Upper bits of IDs are validity flags
+            int txid = BitConverter.ToUInt16(msg.Data, 2) & 0x7FF;
+            int rxid = BitConverter.ToUInt16(msg.Data, 4) & 0x7FF;
             //byte appType = msg.Frame[6];
             Console.WriteLine("ECU at address {0:x}. TXID=[{1:x}] / RXID=[{2:x}]", ecuAddress, txid, rxid);
 
-            if (msg.Id == 0x200)
+            //Request to ECU (0x200) does not change anything, channel exists only after positive response
+            if (msg.Id != 0x200 && opcode == 0xD0)
             {
-                //Request to ECU on brodacst channel
-                ecuId = 0xFFFFFFFF;
-                testerId = 0xFFFFFFFF;
+                OpenChannel(msg.Id & 0xFF, txid, rxid, msg.Timestamp);
             }
-            else
+            return true;
+        }
+
+        void OpenChannel(int ecuAddress, int testerId, int ecuId, long timestamp)
+        {
+            //Renegotiated IDs replace old channel, dead channels are closed so their IDs can't collide
+            Passive_VWTP20_Channel channel;
+            if (_channels.TryGetValue(testerId, out channel))
+            {
+                CloseChannel(channel);
+            }
+            if (_channels.TryGetValue(ecuId, out channel))
+            {
+                CloseChannel(channel);
+            }
+            foreach (Passive_VWTP20_Channel old in _channels.Values.Distinct().ToArray())
             {
-                //Response from ECU - Only react on positive response
-                if (opcode == 0xD0)
+                if (timestamp - old.LastActivity > CHANNEL_TIMEOUT_NS)
                 {
-                    ecuId = rxid;
-                    testerId = txid;
-                    tp20_frame_count = 0;
-                    flag_DatagramReceived = false;
+                    Console.WriteLine("TP20 Channel {0:x}/{1:x} has expired", old.TesterId, old.EcuId);
+                    CloseChannel(old);
                 }
             }
-            return true;
+
+            channel = _channelPool.Count > 0 ? _channelPool.Pop() : new Passive_VWTP20_Channel();
+            channel.Open(ecuAddress, testerId, ecuId, timestamp);
+            _channels[testerId] = channel;
+            _channels[ecuId] = channel;
+            _pipeline?.Claim(this, testerId, testerId);
+            _pipeline?.Claim(this, ecuId, ecuId);
+        }
+
+        void CloseChannel(Passive_VWTP20_Channel channel)
+        {
+            //Both IDs could be already taken by another channel
+            Passive_VWTP20_Channel other;
+            if (_channels.TryGetValue(channel.TesterId, out other) && other == channel)
+            {
+                _channels.Remove(channel.TesterId);
+                _pipeline?.Release(this, channel.TesterId, channel.TesterId);
+            }
+            if (_channels.TryGetValue(channel.EcuId, out other) && other == channel)
+            {
+                _channels.Remove(channel.EcuId);
+                _pipeline?.Release(this, channel.EcuId, channel.EcuId);
+            }
+            if (!_channelPool.Contains(channel))
+            {
+                _channelPool.Push(channel);
+            }
         }
 
         bool Passive_Vwtp20_UnicastChannel(CanMessage msg)
         {
             int rtcpi;
-            //int seq;
-            int id = msg.Id;
-            if (id != testerId && id != ecuId)
+            Passive_VWTP20_Channel channel;
+            if (msg.Dlc == 0 || !_channels.TryGetValue(msg.Id, out channel))
             {
                 return false;
             }
+            channel.LastActivity = msg.Timestamp;
+            Passive_VWTP20_Direction direction = channel.Direction(msg.Id);
+            bool datagramReceived = false;
+            bool overflow = false;
 
             //Parse TCPI byte
             rtcpi = msg.Data[0];
-            //seq = rtcpi & 0xF;
             TCPI1 tcpi = TCPI1.TCPI1_Unkown;
             if ((rtcpi & 0xF0) == 0xA0)
             {
@@ -111,57 +182,71 @@ namespace WTM.Protocols
                 //Use only first 4 bits for parsing, which are constants
                 tcpi = (TCPI1)(rtcpi & 0xF0);
             }
+            bool dataFrame = (rtcpi & 0xC0) == 0x00;
+            if (dataFrame && !direction.Sequence(rtcpi & 0xF, channel))
+            {
+                //Retransmission of datagram which was already sent to Wireshark
+                return true;
+            }
             switch (tcpi)
             {
                 case TCPI1.TCPI1_CFrame_LastMessageNoAck:
-                    Buffer.BlockCopy(msg.Data, 0, tp20_frame, tp20_frame_count, msg.Dlc);
-                    //memcpy(tp20_frame + tp20_frame_count, msg.Frame, msg.Dlc);
-                    tp20_frame_count += msg.Dlc;
-                    flag_DatagramReceived = true;
-                    flag_expectingAck = false;
+                    //Received last message of datagram without ACK
+                    overflow = !direction.Append(msg.Data, 1, msg.Dlc - 1);
+                    datagramReceived = true;
+                    direction.ExpectingAck = false;
                     break;
                 case TCPI1.TCPI1_CFrame_Flow:
                     //Received one frame from several frames
-                    Buffer.BlockCopy(msg.Data, 1, tp20_frame, tp20_frame_count, msg.Dlc - 1);
-                    //memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-                    tp20_frame_count += msg.Dlc - 1;
+                    overflow = !direction.Append(msg.Data, 1, msg.Dlc - 1);
                     break;
                 case TCPI1.TCPI1_CFrame_LastMessageAck:
                     //Received last message of block expecting ACK
-                    Buffer.BlockCopy(msg.Data, 1, tp20_frame, tp20_frame_count, msg.Dlc - 1);
-                    //memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-                    tp20_frame_count += msg.Dlc - 1;
-                    flag_DatagramReceived = true;
-                    flag_expectingAck = true;
+                    overflow = !direction.Append(msg.Data, 1, msg.Dlc - 1);
+                    datagramReceived = true;
+                    direction.ExpectingAck = true;
                     break;
                 case TCPI1.TCPI1_CFrame_BlockSizeReachedAck:
                     //Block has ended, expecting ACK
-                    Buffer.BlockCopy(msg.Data, 1, tp20_frame, tp20_frame_count, msg.Dlc - 1);
-                    //memcpy(tp20_frame + tp20_frame_count, msg.Frame + 1, msg.Dlc - 1);
-                    tp20_frame_count += msg.Dlc - 1;
-                    flag_expectingAck = true;
+                    overflow = !direction.Append(msg.Data, 1, msg.Dlc - 1);
+                    direction.ExpectingAck = true;
                     break;
                 case TCPI1.TCPI1_Ack:
-                    //Datagram received
-                    flag_expectingAck = false;
+                case TCPI1.TCPI1_Ack_NotReady:
+                    //ACK is sent by the other side, confirms data of this side and carries next expected sequence number
+                    Passive_VWTP20_Direction acked = channel.Direction(msg.Id == channel.TesterId ? channel.EcuId : channel.TesterId);
+                    if (acked.LastSeq >= 0 && (rtcpi & 0xF) != acked.ExpectedSeq)
+                    {
+                        channel.AckErrors++;
+                    }
+                    acked.ExpectingAck = false;
+                    break;
+                case TCPI1.TCPI1_Connection_ParamRequest:
+                case TCPI1.TCPI1_Connection_ParamResponse:
+                    channel.Parameters(msg.Data);
                     break;
                 case TCPI1.TCPI1_Connection_Break:
+                    //Receiver discards data since last ACK, sender repeats them with the same sequence numbers
+                    channel.Breaks++;
+                    break;
                 case TCPI1.TCPI1_Connection_Disconnect:
-                    if (tcpi == TCPI1.TCPI1_Connection_Disconnect)
-                    {
-                        //Reset IDs
-                        ecuId = 0xFFFFFFFF;
-                        testerId = 0xFFFFFFFF;
-                    }
+                    CloseChannel(channel);
                     break;
                 default:
                     break;
             }
 
-            if (flag_DatagramReceived == true)
+            if (overflow)
+            {
+                Console.WriteLine("TP20 Datagram is longer than 0xFFFF bytes.");
+                direction.Clear();
+            }
+            else if (datagramReceived)
             {
+                int count = direction.Count;
+                byte[] frame = direction.Frame;
                 //Check minimal length
-                if (tp20_frame_count < 3)
+                if (count < 3)
                 {
                     //Too small.
                     Console.WriteLine("TP20 Datagram is smaller than 3 bytes.");
@@ -169,14 +254,13 @@ namespace WTM.Protocols
                 //Validate datagram header
                 else
                 {
-                    int dLength = tp20_frame[0] << 8 | tp20_frame[1];
-                    if (dLength != tp20_frame_count - 2)
+                    int dLength = frame[0] << 8 | frame[1];
+                    if (dLength != count - 2)
                     {
                         //Now there is some kind of special case used for errors (maybe)
-                        if ((dLength ^ 0x8000) == tp20_frame_count - 2)
+                        if ((dLength ^ 0x8000) == count - 2)
                         {
-                            tp20_frame_count = tp20_frame_count - 2;
-                            AddNewMessage(msg.Id, msg.Timestamp);
+                            AddNewMessage(msg.Id, msg.Timestamp, frame, count - 2, channel.Comment(direction));
                             Console.WriteLine("TP20 Datagram header starts on 0x8000");
                         }
                         else
@@ -188,23 +272,22 @@ namespace WTM.Protocols
                     else
                     {
                         //Seems fine
-                        tp20_frame_count = tp20_frame_count - 2;
-                        AddNewMessage(msg.Id, msg.Timestamp);
+                        AddNewMessage(msg.Id, msg.Timestamp, frame, count - 2, channel.Comment(direction));
                     }
                 }
-                tp20_frame_count = 0;
-                flag_DatagramReceived = false;
+                direction.Clear();
             }
             return true;
         }
 
-        private void AddNewMessage(int id, long timestamp)
+        private void AddNewMessage(int id, long timestamp, byte[] frame, int length, string comment)
         {
-            RawMessage rmsg = new RawMessage(tp20_frame_count);
+            RawMessage rmsg = new RawMessage(length);
+            rmsg.Comment = comment;
             rmsg.MessageType = RawMessageType.Raw_VWTP20;
             rmsg.Timestamp = (ulong)timestamp;
             rmsg.Id = (uint)id;
-            Buffer.BlockCopy(tp20_frame, 2, rmsg.Frame, 0, tp20_frame_count);
+            Buffer.BlockCopy(frame, 2, rmsg.Frame, 0, length);
             OnRawFrame(this, rmsg);
         }
 
@@ -215,6 +298,11 @@ namespace WTM.Protocols
         /// <returns></returns>
         public bool Passive_Vwtp20_Parse(CanMessage cmsg)
         {
+            if (cmsg.IsFd)
+            {
+                //VWTP2.0 is defined only for classic CAN
+                return false;
+            }
             if (Passive_Vwtp20_BroadcastChannel(cmsg) == true)
             {
                 return true;
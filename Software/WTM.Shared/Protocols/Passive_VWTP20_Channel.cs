@@ -0,0 +1,242 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+
+namespace WTM.Protocols
+{
+    /// <summary>
+    /// One VWTP2.0 channel between tester and ECU, negotiated on broadcast channel 0x200 - 0x2FF
+    /// </summary>
+    internal class Passive_VWTP20_Channel
+    {
+        public int EcuAddress { get; private set; }
+        /// <summary>
+        /// CAN ID used by tester
+        /// </summary>
+        public int TesterId { get; private set; }
+        /// <summary>
+        /// CAN ID used by ECU
+        /// </summary>
+        public int EcuId { get; private set; }
+        /// <summary>
+        /// Timestamp of last frame on channel, Unix time [ns]
+        /// </summary>
+        public long LastActivity { get; set; }
+
+        public Passive_VWTP20_Direction FromTester { get; } = new Passive_VWTP20_Direction();
+        public Passive_VWTP20_Direction FromEcu { get; } = new Passive_VWTP20_Direction();
+
+        /// <summary>
+        /// Frames lost between sequence numbers
+        /// </summary>
+        public int Gaps { get; set; }
+        /// <summary>
+        /// Frames received again (after Break or missing ACK)
+        /// </summary>
+        public int Retransmits { get; set; }
+        /// <summary>
+        /// ACKs with other sequence number than next expected one
+        /// </summary>
+        public int AckErrors { get; set; }
+        public int Breaks { get; set; }
+
+        /// <summary>
+        /// Timing parameters from last A0 / A1 frame, BlockSize -1 until received
+        /// </summary>
+        public int BlockSize { get; private set; }
+        /// <summary>
+        /// Time to wait for ACK [ns]
+        /// </summary>
+        public long T1 { get; private set; }
+        /// <summary>
+        /// Interval between frames [ns]
+        /// </summary>
+        public long T3 { get; private set; }
+
+        /// <summary>
+        /// Prepare channel for new connection, buffers are kept from previous connection
+        /// </summary>
+        public void Open(int ecuAddress, int testerId, int ecuId, long timestamp)
+        {
+            EcuAddress = ecuAddress;
+            TesterId = testerId;
+            EcuId = ecuId;
+            LastActivity = timestamp;
+            FromTester.Reset();
+            FromEcu.Reset();
+            Gaps = 0;
+            Retransmits = 0;
+            AckErrors = 0;
+            Breaks = 0;
+            BlockSize = -1;
+            T1 = 0;
+            T3 = 0;
+        }
+
+        /// <summary>
+        /// Parameters of A0 (request) or A1 (response): [A0, BS, T1, 0xFF, T3, 0xFF]
+        /// </summary>
+        public void Parameters(byte[] data)
+        {
+            if (data.Length < 6)
+            {
+                return;
+            }
+            BlockSize = data[1];
+            T1 = DecodeTime(data[2]);
+            T3 = DecodeTime(data[4]);
+        }
+
+        /// <summary>
+        /// Bits 7-6 are unit (0.1 ms, 1 ms, 10 ms, 100 ms), bits 5-0 are count
+        /// </summary>
+        /// <returns>Time [ns]</returns>
+        public static long DecodeTime(byte time)
+        {
+            long[] units = { 100000, 1000000, 10000000, 100000000 };
+            return units[time >> 6] * (time & 0x3F);
+        }
+
+        /// <summary>
+        /// Packet comment for datagram sent in given direction
+        /// </summary>
+        /// <returns>i.e. SEQ gap; gaps 1, retransmits 0, ACK errors 0, breaks 0; BS 15, T1 100.0 ms, T3 0.5 ms or null</returns>
+        public string Comment(Passive_VWTP20_Direction direction)
+        {
+            List<string> parts = new List<string>();
+            if (direction.Gap || direction.Retransmit)
+            {
+                parts.Add(direction.Gap && direction.Retransmit ? "SEQ gap, retransmit" : direction.Gap ? "SEQ gap" : "retransmit");
+            }
+            if (Gaps != 0 || Retransmits != 0 || AckErrors != 0 || Breaks != 0)
+            {
+                parts.Add($"gaps {Gaps}, retransmits {Retransmits}, ACK errors {AckErrors}, breaks {Breaks}");
+            }
+            if (BlockSize >= 0)
+            {
+                parts.Add(string.Format(CultureInfo.InvariantCulture, "BS {0}, T1 {1:0.0} ms, T3 {2:0.0} ms", BlockSize, T1 / 1000000.0, T3 / 1000000.0));
+            }
+            return parts.Count == 0 ? null : string.Join("; ", parts);
+        }
+
+        public Passive_VWTP20_Direction Direction(int id)
+        {
+            return id == TesterId ? FromTester : FromEcu;
+        }
+    }
+
+    /// <summary>
+    /// Reassembly of datagrams sent in one direction of channel
+    /// </summary>
+    internal class Passive_VWTP20_Direction
+    {
+        /// <summary>
+        /// Datagram length is 16 bit + 2 bytes of length itself
+        /// </summary>
+        const int MAX_FRAME_LENGTH = 0xFFFF + 2;
+        /// <summary>
+        /// Sequence number up to this count behind expected one is retransmission, further one is gap
+        /// </summary>
+        const int MAX_RETRANSMIT = 8;
+
+        byte[] _frame = new byte[0x100];
+        /// <summary>
+        /// Position in datagram where data of frame with given sequence number starts, -1 if frame is not part of datagram
+        /// </summary>
+        readonly int[] _seqPosition = new int[16];
+
+        /// <summary>
+        /// Datagram including 2 bytes of length
+        /// </summary>
+        public byte[] Frame { get { return _frame; } }
+        public int Count { get; private set; }
+        public bool ExpectingAck { get; set; }
+        /// <summary>
+        /// Sequence number of last data frame, -1 if nothing was received
+        /// </summary>
+        public int LastSeq { get; private set; } = -1;
+        /// <summary>
+        /// Sequence number which should come in next data frame
+        /// </summary>
+        public int ExpectedSeq { get { return (LastSeq + 1) & 0xF; } }
+        /// <summary>
+        /// Datagram in buffer is missing frames
+        /// </summary>
+        public bool Gap { get; private set; }
+        /// <summary>
+        /// Datagram in buffer has retransmitted frames
+        /// </summary>
+        public bool Retransmit { get; private set; }
+
+        /// <summary>
+        /// Check sequence number of data frame before its data are appended.
+        /// Retransmitted frame rewinds datagram to position where data of that frame started, so data are not duplicated.
+        /// </summary>
+        /// <returns>False if frame is retransmission of datagram which was already completed and frame has to be dropped</returns>
+        public bool Sequence(int seq, Passive_VWTP20_Channel channel)
+        {
+            if (LastSeq >= 0 && seq != ExpectedSeq)
+            {
+                int behind = (ExpectedSeq - seq) & 0xF;
+                if (behind <= MAX_RETRANSMIT)
+                {
+                    channel.Retransmits++;
+                    if (_seqPosition[seq] < 0)
+                    {
+                        return false;
+                    }
+                    Retransmit = true;
+                    Count = _seqPosition[seq];
+                }
+                else
+                {
+                    channel.Gaps += (seq - ExpectedSeq) & 0xF;
+                    Gap = true;
+                }
+            }
+            _seqPosition[seq] = Count;
+            LastSeq = seq;
+            return true;
+        }
+
+        /// <returns>False if datagram would be longer than any valid datagram</returns>
+        public bool Append(byte[] data, int offset, int length)
+        {
+            if (Count + length > MAX_FRAME_LENGTH)
+            {
+                return false;
+            }
+            if (Count + length > _frame.Length)
+            {
+                //Grows only by datagrams longer than any before, buffer is kept when channel is reused
+                byte[] frame = new byte[Math.Min(Math.Max(_frame.Length * 2, Count + length), MAX_FRAME_LENGTH)];
+                Buffer.BlockCopy(_frame, 0, frame, 0, Count);
+                _frame = frame;
+            }
+            Buffer.BlockCopy(data, offset, _frame, Count, length);
+            Count += length;
+            return true;
+        }
+
+        /// <summary>
+        /// Drop datagram, keep state of connection
+        /// </summary>
+        public void Clear()
+        {
+            Count = 0;
+            Gap = false;
+            Retransmit = false;
+            for (int i = 0; i < _seqPosition.Length; i++)
+            {
+                _seqPosition[i] = -1;
+            }
+        }
+
+        public void Reset()
+        {
+            Clear();
+            ExpectingAck = false;
+            LastSeq = -1;
+        }
+    }
+}
@@ -13,7 +13,7 @@ namespace WTM
         /// </summary>
         public RawMessageType MessageType { get; set; }
         /// <summary>
-        /// When were data received
+        /// When were data received. Unix time [ns], see ClockDomain
         /// </summary>
         public ulong Timestamp { get; set; }
         /// <summary>
@@ -21,6 +21,10 @@ namespace WTM
         /// </summary>
         public byte[] Frame { get; }
         public uint Id { get; set; }
+        /// <summary>
+        /// Optional note about the frame (i.e. "SN gap"). Written only into pcapng stream as packet comment.
+        /// </summary>
+        public string Comment { get; set; }
         public RawMessage(int length)
         {
             Frame = new byte[length];
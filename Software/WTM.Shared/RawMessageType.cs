@@ -15,5 +15,8 @@ namespace WTM
         Raw_KW1281 = 0x92,
         Raw_VWTP20 = 0x93,
         Raw_ISO15765 = 0x94,
+        Raw_J1939 = 0x95,
+        Raw_FlexRayPdu = 0x96,
+        Raw_ISO9141 = 0x97,
     }
 }
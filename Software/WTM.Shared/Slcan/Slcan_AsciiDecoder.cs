@@ -0,0 +1,245 @@
+﻿using System;
+using System.Text;
+
+namespace WTM.Slcan
+{
+    /// <summary>
+    /// Decoder of ASCII SLCAN (LAWICEL) stream, i.e. t12323E00\r or T1234567881122334455667788\r.
+    /// Timestamp after data is recognized by its length:
+    /// 4 digits = Z1 milliseconds wrapping after 60 s, 8 digits = Z2 32 bit micro seconds, 16 digits = Z3 64 bit micro seconds.
+    /// Frames without timestamp are stamped by host clock.
+    /// </summary>
+    public class Slcan_AsciiDecoder
+    {
+        const int MAX_LINE_LENGTH = 64;
+        const byte HEX_INVALID = 0xFF;
+
+        /// <summary>
+        /// Value of hex character or HEX_INVALID. Lookup is cheaper than parsing via Convert or int.Parse
+        /// </summary>
+        static readonly byte[] _hex = CreateHexTable();
+
+        readonly byte[] _line = new byte[MAX_LINE_LENGTH];
+        readonly ClockDomain _clockMs = new ClockDomain(1000);
+        readonly ClockDomain _clockUs = new ClockDomain(1000000);
+        int _lineLength;
+        bool _overflow;
+        long _lastMs;
+        long _msHigh;   //Z1 timestamp wraps after 60 s, extend it
+        long _lastUs;
+        long _usHigh;   //Z2 timestamp wraps after ~71 minutes, extend it
+
+        /// <summary>
+        /// Received CAN frame with Unix time timestamp
+        /// </summary>
+        public event EventHandler<CanMessage> OnReceiveCanFrame;
+        /// <summary>
+        /// Response on SLCAN command including terminating \r or \a
+        /// </summary>
+        public event EventHandler<string> OnResponse;
+
+        /// <summary>
+        /// Amount of received frames
+        /// </summary>
+        public long Received { get; private set; }
+        /// <summary>
+        /// Amount of frames which could not be decoded (invalid hex digit, DLC, length)
+        /// </summary>
+        public long Invalid { get; private set; }
+
+        /// <summary>
+        /// Decode part of the stream. Lines can be split between calls.
+        /// </summary>
+        public void Decode(byte[] buffer, int offset, int count)
+        {
+            for (int i = offset; i < offset + count; i++)
+            {
+                byte b = buffer[i];
+                if (b == '\r' || b == '\a')
+                {
+                    if (_overflow)
+                    {
+                        Invalid++;
+                    }
+                    else if (!DecodeFrame())
+                    {
+                        OnResponse?.Invoke(this, Encoding.ASCII.GetString(_line, 0, _lineLength) + (char)b);
+                    }
+                    _lineLength = 0;
+                    _overflow = false;
+                }
+                else if (b == '\n')
+                {
+                    //Some devices terminate lines by \r\n
+                    continue;
+                }
+                else if (_lineLength < MAX_LINE_LENGTH)
+                {
+                    _line[_lineLength++] = b;
+                }
+                else
+                {
+                    _overflow = true;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Decode line in _line as CAN frame
+        /// </summary>
+        /// <returns>False if line is not a frame and should be reported as response</returns>
+        bool DecodeFrame()
+        {
+            if (_lineLength < 2)
+            {
+                return false;
+            }
+            byte type = _line[0];
+            bool rtr = type == 'r' || type == 'R';
+            bool extended = type == 'T' || type == 'R';
+            int idDigits;
+            if (type == 't' || type == 'r')
+            {
+                idDigits = 3;
+            }
+            else if (extended)
+            {
+                idDigits = 8;
+            }
+            else
+            {
+                //z\r and Z\r are acknowledges of transmitted frames
+                return false;
+            }
+
+            long id = ParseHex(1, idDigits);
+            long dlc = ParseHex(1 + idDigits, 1);
+            if (id < 0 || id > CanMessage.MAX_ID_EXTENDED || dlc < 0 || dlc > 8)
+            {
+                Invalid++;
+                return true;
+            }
+            int dataOffset = 2 + idDigits;
+            int dataLength = rtr ? 0 : (int)dlc;
+            int timestampDigits = _lineLength - dataOffset - dataLength * 2;
+
+            byte[] data = new byte[dataLength];
+            for (int i = 0; i < dataLength; i++)
+            {
+                if (dataOffset + i * 2 + 1 >= _lineLength)
+                {
+                    Invalid++;
+                    return true;
+                }
+                int high = _hex[_line[dataOffset + i * 2]];
+                int low = _hex[_line[dataOffset + i * 2 + 1]];
+                //HEX_INVALID in any of both digits is above 15
+                if ((high | low) > 15)
+                {
+                    Invalid++;
+                    return true;
+                }
+                data[i] = (byte)((high << 4) | low);
+            }
+
+            long timestamp;
+            switch (timestampDigits)
+            {
+                case 0:
+                    timestamp = ClockDomain.HostNowNs;
+                    break;
+                case 4:
+                case 8:
+                case 16:
+                    long value = ParseHex(_lineLength - timestampDigits, timestampDigits);
+                    if (value < 0)
+                    {
+                        Invalid++;
+                        return true;
+                    }
+                    timestamp = ToUnixNs(value, timestampDigits);
+                    break;
+                default:
+                    Invalid++;
+                    return true;
+            }
+
+            CanMessage cmsg = new CanMessage(data, (int)id, CanFdFlags.None, extended);
+            cmsg.Timestamp = timestamp;
+            Received++;
+            OnReceiveCanFrame?.Invoke(this, cmsg);
+            return true;
+        }
+
+        long ToUnixNs(long value, int digits)
+        {
+            switch (digits)
+            {
+                case 4:
+                    if (value < _lastMs)
+                    {
+                        _msHigh += 60000;
+                    }
+                    _lastMs = value;
+                    return _clockMs.ToUnixNs(_msHigh + value);
+                case 8:
+                    if (value < _lastUs)
+                    {
+                        _usHigh += 0x100000000L;
+                    }
+                    _lastUs = value;
+                    return _clockUs.ToUnixNs(_usHigh + value);
+                default:
+                    return _clockUs.ToUnixNs(value);
+            }
+        }
+
+        /// <returns>Value of hex digits or -1 if line is too short or digit is not hex</returns>
+        long ParseHex(int offset, int digits)
+        {
+            if (offset + digits > _lineLength)
+            {
+                return -1;
+            }
+            long value = 0;
+            for (int i = offset; i < offset + digits; i++)
+            {
+                byte d = _hex[_line[i]];
+                if (d == HEX_INVALID)
+                {
+                    return -1;
+                }
+                value = (value << 4) | d;
+            }
+            return value;
+        }
+
+        static byte[] CreateHexTable()
+        {
+            byte[] table = new byte[256];
+            for (int i = 0; i < table.Length; i++)
+            {
+                table[i] = HEX_INVALID;
+            }
+            for (int i = 0; i < 10; i++)
+            {
+                table['0' + i] = (byte)i;
+            }
+            for (int i = 0; i < 6; i++)
+            {
+                table['A' + i] = (byte)(10 + i);
+                table['a' + i] = (byte)(10 + i);
+            }
+            return table;
+        }
+
+        /// <summary>
+        /// Reset state of decoder, i.e. after reopening of the port
+        /// </summary>
+        public void Reset()
+        {
+            _lineLength = 0;
+            _overflow = false;
+        }
+    }
+}
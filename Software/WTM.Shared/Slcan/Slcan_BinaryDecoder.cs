@@ -0,0 +1,152 @@
+﻿using System;
+using System.Text;
+
+namespace WTM.Slcan
+{
+    /// <summary>
+    /// Decoder of binary SLCAN stream sent by Olimex firmware after command B1.
+    /// Record is 20 bytes, little endian:
+    /// [0] 0xAA sync, [1] flags, [2] DLC, [3] sequence, [4..7] timestamp [us], [8..11] CAN ID, [12..19] data.
+    /// Responses on SLCAN commands (\r, \a, F00\r, ...) are sent between records.
+    /// Sync byte can appear also in data of record, so every record is validated and when it is not valid,
+    /// stream is searched for next sync byte right after the false one.
+    /// </summary>
+    public class Slcan_BinaryDecoder
+    {
+        public const int RECORD_LENGTH = 20;
+        const byte RECORD_SYNC = 0xAA;
+        const byte FLAG_EXT = 0x01;
+        const byte FLAG_RTR = 0x02;
+        const byte FLAG_MASK = FLAG_EXT | FLAG_RTR;
+
+        readonly byte[] _record = new byte[RECORD_LENGTH];
+        readonly StringBuilder _response = new StringBuilder();
+        readonly ClockDomain _clock = new ClockDomain(1000000);
+        int _recordLength;
+        int _lastSequence = -1;
+        uint _lastTimestamp;
+        long _timestampHigh; //Timestamp of device is 32 bit, extend it into 64 bit
+
+        /// <summary>
+        /// Received CAN frame with Unix time timestamp
+        /// </summary>
+        public event EventHandler<CanMessage> OnReceiveCanFrame;
+        /// <summary>
+        /// Response on SLCAN command including terminating \r or \a
+        /// </summary>
+        public event EventHandler<string> OnResponse;
+
+        /// <summary>
+        /// Amount of records lost between device and PC, given by gaps in sequence
+        /// </summary>
+        public long Lost { get; private set; }
+        /// <summary>
+        /// Amount of received records
+        /// </summary>
+        public long Received { get; private set; }
+        /// <summary>
+        /// Amount of false sync bytes, records starting on them have failed validation
+        /// </summary>
+        public long Invalid { get; private set; }
+
+        /// <summary>
+        /// Decode part of the stream. Records can be split between calls.
+        /// </summary>
+        public void Decode(byte[] buffer, int offset, int count)
+        {
+            for (int i = offset; i < offset + count; i++)
+            {
+                byte b = buffer[i];
+                if (_recordLength > 0)
+                {
+                    _record[_recordLength++] = b;
+                    if (_recordLength == RECORD_LENGTH)
+                    {
+                        _recordLength = 0;
+                        if (IsRecordValid())
+                        {
+                            DecodeRecord();
+                        }
+                        else
+                        {
+                            //Sync was false, search for next one in bytes which were taken as the record
+                            Invalid++;
+                            byte[] rest = new byte[RECORD_LENGTH - 1];
+                            Buffer.BlockCopy(_record, 1, rest, 0, rest.Length);
+                            Decode(rest, 0, rest.Length);
+                        }
+                    }
+                }
+                else if (b == RECORD_SYNC)
+                {
+                    _record[_recordLength++] = b;
+                }
+                else if (b >= 0x80)
+                {
+                    //Responses are ASCII, this is rest of damaged record
+                }
+                else
+                {
+                    //Outside of record we can see only ASCII responses
+                    _response.Append((char)b);
+                    if (b == '\r' || b == '\a')
+                    {
+                        OnResponse?.Invoke(this, _response.ToString());
+                        _response.Clear();
+                    }
+                }
+            }
+        }
+
+        bool IsRecordValid()
+        {
+            byte flags = _record[1];
+            int id = BitConverter.ToInt32(_record, 8);
+            if ((flags & ~FLAG_MASK) != 0 || _record[2] > CanMessage.MAX_LENGTH_CAN || id < 0)
+            {
+                return false;
+            }
+            return id <= ((flags & FLAG_EXT) != 0 ? CanMessage.MAX_ID_EXTENDED : CanMessage.MAX_ID_STANDARD);
+        }
+
+        void DecodeRecord()
+        {
+            byte flags = _record[1];
+            int dlc = _record[2];
+            int sequence = _record[3];
+            uint timestamp = BitConverter.ToUInt32(_record, 4);
+            int id = BitConverter.ToInt32(_record, 8);
+
+            //Check sequence to see if USB has lost some records
+            if (_lastSequence >= 0)
+            {
+                Lost += (sequence - _lastSequence - 1) & 0xFF;
+            }
+            _lastSequence = sequence;
+            Received++;
+
+            //Timestamp overflows every 71 minutes
+            if (timestamp < _lastTimestamp)
+            {
+                _timestampHigh += 0x100000000L;
+            }
+            _lastTimestamp = timestamp;
+
+            byte[] data = new byte[(flags & FLAG_RTR) != 0 ? 0 : dlc];
+            Buffer.BlockCopy(_record, 12, data, 0, data.Length);
+            CanMessage cmsg = new CanMessage(data, id, CanFdFlags.None, (flags & FLAG_EXT) != 0);
+            cmsg.Timestamp = _clock.ToUnixNs(_timestampHigh + timestamp);
+            OnReceiveCanFrame?.Invoke(this, cmsg);
+        }
+
+        /// <summary>
+        /// Reset state of decoder, i.e. after reopening of the port
+        /// </summary>
+        public void Reset()
+        {
+            _recordLength = 0;
+            _lastSequence = -1;
+            _response.Clear();
+        }
+    }
+}
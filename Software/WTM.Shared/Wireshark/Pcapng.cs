@@ -0,0 +1,182 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+
+namespace WTM.Wireshark
+{
+    /// <summary>
+    /// Link layer errors which can be flagged in epb_flags of Enhanced Packet Block
+    /// </summary>
+    [Flags]
+    public enum PcapngEpbFlags : uint
+    {
+        None = 0,
+        Inbound = 1,
+        Outbound = 2,
+        CrcError = 1u << 24,
+        PacketTooLong = 1u << 25,
+        PacketTooShort = 1u << 26,
+        SymbolError = 1u << 31,
+    }
+
+    /// <summary>
+    /// Builds blocks of pcapng file format. Every block is padded on 32 bits and little endian.
+    /// See https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html
+    /// </summary>
+    public static class Pcapng
+    {
+        public const ushort LINKTYPE_RAW = 0x65;
+        public const ushort LINKTYPE_FLEXRAY = 0xD2;
+        public const ushort LINKTYPE_CAN_SOCKETCAN = 0xE3;
+
+        /// <summary>
+        /// if_tsresol for timestamps in microseconds
+        /// </summary>
+        public const byte TSRESOL_US = 6;
+        /// <summary>
+        /// if_tsresol for timestamps in nanoseconds
+        /// </summary>
+        public const byte TSRESOL_NS = 9;
+
+        const uint BLOCK_SHB = 0x0A0D0D0A;
+        const uint BLOCK_IDB = 0x00000001;
+        const uint BLOCK_EPB = 0x00000006;
+
+        const ushort OPT_ENDOFOPT = 0;
+        const ushort OPT_COMMENT = 1;
+        const ushort IF_NAME = 2;
+        const ushort IF_TSRESOL = 9;
+        const ushort EPB_FLAGS = 2;
+
+        /// <summary>
+        /// Section Header Block. Must be first block in every stream.
+        /// </summary>
+        public static byte[] SectionHeaderBlock()
+        {
+            byte[] body = new byte[16];
+            WriteLE(body, 0x1A2B3C4D, 0); //Byte order magic
+            body[4] = 1; //Major version
+            body[6] = 0; //Minor version
+            //Section length is not specified (-1)
+            for (int i = 8; i < 16; i++)
+            {
+                body[i] = 0xFF;
+            }
+            return PrepareBlock(BLOCK_SHB, body, null);
+        }
+
+        /// <summary>
+        /// Interface Description Block. Interface ID is given by order of IDBs in the section.
+        /// </summary>
+        /// <param name="linkType">LINKTYPE_ of packets on this interface</param>
+        /// <param name="name">Name shown in Wireshark</param>
+        /// <param name="tsresol">Resolution of timestamps as negative power of 10</param>
+        public static byte[] InterfaceDescriptionBlock(ushort linkType, string name, byte tsresol)
+        {
+            byte[] body = new byte[8];
+            body[0] = (byte)linkType;
+            body[1] = (byte)(linkType >> 8);
+            WriteLE(body, 0xFFFF, 4); //Snap length
+
+            MemoryStream options = new MemoryStream();
+            if (!string.IsNullOrEmpty(name))
+            {
+                WriteOption(options, IF_NAME, Encoding.UTF8.GetBytes(name));
+            }
+            WriteOption(options, IF_TSRESOL, new byte[] { tsresol });
+            WriteOption(options, OPT_ENDOFOPT, null);
+
+            return PrepareBlock(BLOCK_IDB, body, options.ToArray());
+        }
+
+        /// <summary>
+        /// Enhanced Packet Block
+        /// </summary>
+        /// <param name="interfaceId">Index of IDB</param>
+        /// <param name="timestamp">Timestamp in resolution given by if_tsresol of the interface</param>
+        /// <param name="packet">Data of packet</param>
+        /// <param name="flags">Optional epb_flags</param>
+        /// <param name="comment">Optional comment shown as packet comment in Wireshark</param>
+        public static byte[] EnhancedPacketBlock(uint interfaceId, ulong timestamp, byte[] packet, PcapngEpbFlags flags = PcapngEpbFlags.None, string comment = null)
+        {
+            int paddedLength = Pad(packet.Length);
+            byte[] body = new byte[20 + paddedLength];
+            WriteLE(body, interfaceId, 0);
+            WriteLE(body, (uint)(timestamp >> 32), 4);
+            WriteLE(body, (uint)timestamp, 8);
+            WriteLE(body, (uint)packet.Length, 12); //Captured length
+            WriteLE(body, (uint)packet.Length, 16); //Original length
+            Buffer.BlockCopy(packet, 0, body, 20, packet.Length);
+
+            byte[] options = null;
+            if (flags != PcapngEpbFlags.None || !string.IsNullOrEmpty(comment))
+            {
+                MemoryStream ms = new MemoryStream();
+                if (!string.IsNullOrEmpty(comment))
+                {
+                    WriteOption(ms, OPT_COMMENT, Encoding.UTF8.GetBytes(comment));
+                }
+                if (flags != PcapngEpbFlags.None)
+                {
+                    byte[] f = new byte[4];
+                    WriteLE(f, (uint)flags, 0);
+                    WriteOption(ms, EPB_FLAGS, f);
+                }
+                WriteOption(ms, OPT_ENDOFOPT, null);
+                options = ms.ToArray();
+            }
+
+            return PrepareBlock(BLOCK_EPB, body, options);
+        }
+
+        private static byte[] PrepareBlock(uint type, byte[] body, byte[] options)
+        {
+            int optionsLength = options == null ? 0 : options.Length;
+            //Type + Total Length + Body + Options + Total Length
+            int totalLength = 12 + body.Length + optionsLength;
+            byte[] block = new byte[totalLength];
+            WriteLE(block, type, 0);
+            WriteLE(block, (uint)totalLength, 4);
+            Buffer.BlockCopy(body, 0, block, 8, body.Length);
+            if (options != null)
+            {
+                Buffer.BlockCopy(options, 0, block, 8 + body.Length, options.Length);
+            }
+            WriteLE(block, (uint)totalLength, totalLength - 4);
+            return block;
+        }
+
+        private static void WriteOption(MemoryStream ms, ushort code, byte[] value)
+        {
+            int length = value == null ? 0 : value.Length;
+            ms.WriteByte((byte)code);
+            ms.WriteByte((byte)(code >> 8));
+            ms.WriteByte((byte)length);
+            ms.WriteByte((byte)(length >> 8));
+            if (value != null)
+            {
+                ms.Write(value, 0, value.Length);
+                //Padding on 32 bits
+                for (int i = length; i < Pad(length); i++)
+                {
+                    ms.WriteByte(0);
+                }
+            }
+        }
+
+        private static int Pad(int length)
+        {
+            return (length + 3) & ~3;
+        }
+
+        private static void WriteLE(byte[] array, uint data, int offset)
+        {
+            array[offset] = (byte)data;
+            array[offset + 1] = (byte)(data >> 8);
+            array[offset + 2] = (byte)(data >> 16);
+            array[offset + 3] = (byte)(data >> 24);
+        }
+    }
+}
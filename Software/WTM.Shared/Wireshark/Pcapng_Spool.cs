@@ -0,0 +1,254 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.Compression;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using WTM.Shared;
+
+namespace WTM.Wireshark
+{
+    /// <summary>
+    /// Writes everything into rotating pcapng files on disk, independently of connected Wireshark.
+    /// Producers only enqueue blocks, file is written by own thread, so slow disk never blocks TCP streams.
+    /// </summary>
+    public class Pcapng_Spool : IDisposable
+    {
+        readonly Object _syncObject = new Object();
+
+        /// <summary>
+        /// Size of FileStream buffer, data are written to disk in large sequential chunks
+        /// </summary>
+        const int WRITE_BUFFER_SIZE = 1024 * 1024;
+        /// <summary>
+        /// Limit of memory waiting for disk. Blocks above this limit are dropped and counted.
+        /// </summary>
+        const long MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+        readonly string _directory;
+        readonly long _maxFileSize;
+        readonly TimeSpan _maxFileAge;
+        readonly bool _compress;
+
+        Thread _writeThread;
+        AutoResetEvent _dataReady;
+        bool _cancelThread;
+        List<byte[]> _qBlocks;
+        List<byte[]> _qWrite;
+        long _queuedBytes;
+
+        Stream _file;
+        long _fileSize;
+        DateTime _fileCreated;
+        int _fileIndex;
+
+        /// <summary>
+        /// Blocks dropped because disk was not able to keep up
+        /// </summary>
+        public long Dropped { get; private set; }
+
+        /// <summary>
+        /// Failed writes into capture file. Every failure closes the file and continues in a new one.
+        /// </summary>
+        public long WriteErrors { get; private set; }
+
+        /// <summary>
+        /// Create spool and start writer thread
+        /// </summary>
+        /// <param name="directory">Folder where capture files are created</param>
+        /// <param name="maxFileSize">Start new file after this amount of bytes (uncompressed)</param>
+        /// <param name="maxFileAge">Start new file after this time, TimeSpan.Zero to rotate only by size</param>
+        /// <param name="compress">Write .pcapng.gz files, Wireshark opens them directly</param>
+        public Pcapng_Spool(string directory, long maxFileSize, TimeSpan maxFileAge, bool compress)
+        {
+            _directory = directory;
+            _maxFileSize = maxFileSize;
+            _maxFileAge = maxFileAge;
+            _compress = compress;
+            Directory.CreateDirectory(_directory);
+
+            _qBlocks = new List<byte[]>();
+            _qWrite = new List<byte[]>();
+            _dataReady = new AutoResetEvent(false);
+            _writeThread = new Thread(Write);
+            _writeThread.Start();
+        }
+
+        /// <summary>
+        /// Create spool from command line arguments
+        /// </summary>
+        /// <returns>null when spooling was not requested by -w argument</returns>
+        public static Pcapng_Spool FromArguments(Dictionary<ArgumentTypes, object> pargs)
+        {
+            if (!pargs.ContainsKey(ArgumentTypes.SpoolDirectory))
+            {
+                return null;
+            }
+            long size = 100;
+            int minutes = 0;
+            if (pargs.ContainsKey(ArgumentTypes.SpoolFileSize))
+            {
+                size = (int)pargs[ArgumentTypes.SpoolFileSize];
+            }
+            if (pargs.ContainsKey(ArgumentTypes.SpoolFileTime))
+            {
+                minutes = (int)pargs[ArgumentTypes.SpoolFileTime];
+            }
+            return new Pcapng_Spool(pargs[ArgumentTypes.SpoolDirectory] as string, size * 1024 * 1024, TimeSpan.FromMinutes(minutes), pargs.ContainsKey(ArgumentTypes.SpoolCompress));
+        }
+
+        public void Add(CanMessage msg)
+        {
+            Enqueue(Wireshark_Pcapng.PrepareBlock(msg));
+        }
+
+        public void Add(RawMessage msg)
+        {
+            Enqueue(Wireshark_Pcapng.PrepareBlock(msg));
+        }
+
+        public void Add(FlexRayMessage msg)
+        {
+            Enqueue(Wireshark_Pcapng.PrepareBlock(msg));
+        }
+
+        private void Enqueue(byte[] block)
+        {
+            lock (_syncObject)
+            {
+                if (_queuedBytes + block.Length > MAX_QUEUED_BYTES)
+                {
+                    Dropped++;
+                    return;
+                }
+                _queuedBytes += block.Length;
+                _qBlocks.Add(block);
+            }
+            _dataReady.Set();
+        }
+
+        private void Write()
+        {
+            while (true)
+            {
+                _dataReady.WaitOne(1000);
+                //Swap queues, so producers can continue while we are writing
+                lock (_syncObject)
+                {
+                    List<byte[]> swap = _qWrite;
+                    _qWrite = _qBlocks;
+                    _qBlocks = swap;
+                    _queuedBytes = 0;
+                }
+                for (int i = 0; i < _qWrite.Count; i++)
+                {
+                    if (!WriteBlock(_qWrite[i]))
+                    {
+                        //Disk is still failing, drop rest of batch and try again with next one
+                        lock (_syncObject)
+                        {
+                            Dropped += _qWrite.Count - i;
+                        }
+                        break;
+                    }
+                }
+                _qWrite.Clear();
+                //Leave after queue was flushed
+                lock (_syncObject)
+                {
+                    if (_cancelThread && _qBlocks.Count == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+            CloseFile();
+        }
+
+        /// <summary>
+        /// Write block into current file. When write fails, file is closed and block is written into a new one.
+        /// </summary>
+        /// <returns>false when also new file has failed</returns>
+        private bool WriteBlock(byte[] block)
+        {
+            for (int attempt = 0; attempt < 2; attempt++)
+            {
+                try
+                {
+                    if (_file == null || _fileSize >= _maxFileSize || (_maxFileAge > TimeSpan.Zero && DateTime.Now - _fileCreated >= _maxFileAge))
+                    {
+                        Rotate();
+                    }
+                    _file.Write(block, 0, block.Length);
+                    _fileSize += block.Length;
+                    return true;
+                }
+                catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
+                {
+                    WriteErrors++;
+                    Console.WriteLine("Spool-IOException " + ex.Message);
+                    CloseFile();
+                }
+            }
+            return false;
+        }
+
+        private void CloseFile()
+        {
+            try
+            {
+                _file?.Dispose();
+            }
+            catch (IOException ex)
+            {
+                //Buffered data are lost, file is still readable up to last flush
+                Console.WriteLine("Spool-IOException " + ex.Message);
+            }
+            _file = null;
+        }
+
+        private void Rotate()
+        {
+            CloseFile();
+            _fileCreated = DateTime.Now;
+            _fileSize = 0;
+            string name = string.Format("wtm_{0:yyyyMMdd_HHmmss}_{1:D3}.pcapng", _fileCreated, _fileIndex++);
+            if (_compress)
+            {
+                name += ".gz";
+            }
+            string path = Path.Combine(_directory, name);
+            Stream file = new FileStream(path, FileMode.CreateNew, FileAccess.Write, FileShare.Read, WRITE_BUFFER_SIZE, FileOptions.SequentialScan);
+            if (_compress)
+            {
+                //Compress whole buffers, not every small block
+                file = new BufferedStream(new GZipStream(file, CompressionLevel.Fastest), WRITE_BUFFER_SIZE);
+            }
+            _file = file;
+            Console.WriteLine($"Spooling into {path}");
+
+            //Every file is standalone capture
+            foreach (byte[] block in Wireshark_Pcapng.PrepareHeader())
+            {
+                _file.Write(block, 0, block.Length);
+                _fileSize += block.Length;
+            }
+        }
+
+        public void Dispose()
+        {
+            _cancelThread = true;
+            _dataReady.Set();
+            _writeThread.Join();
+            if (Dropped != 0)
+            {
+                Console.WriteLine($"Spool dropped {Dropped} blocks");
+            }
+            if (WriteErrors != 0)
+            {
+                Console.WriteLine($"Spool failed {WriteErrors} writes");
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+
+namespace WTM.Wireshark
+{
+    /// <summary>
+    /// Send SocketCAN, IP RAW and FlexRay data into Wireshark as one pcapng stream
+    /// </summary>
+    public class Wireshark_Pcapng : IDisposable
+    {
+        const int _port = 19003;
+        //Interface IDs are given by order of IDBs sent in the stream header
+        const uint IF_SOCKETCAN = 0;
+        const uint IF_RAW = 1;
+        const uint IF_FLEXRAY = 2;
+
+        Wireshark_Server _server;
+
+        public Wireshark_Pcapng()
+        {
+            _server = new Wireshark_Server(_port, PrepareHeader().SelectMany(b => b).ToArray());
+        }
+
+        public bool IsConnected
+        {
+            get
+            {
+                return _server.IsConnected;
+            }
+        }
+
+        public void Add(CanMessage msg)
+        {
+            _server.Add(PrepareBlock(msg));
+        }
+
+        public void Add(RawMessage msg)
+        {
+            _server.Add(PrepareBlock(msg));
+        }
+
+        public void Add(FlexRayMessage msg)
+        {
+            _server.Add(PrepareBlock(msg));
+        }
+
+        /// <summary>
+        /// Section header followed by one interface per link layer. Order of interfaces gives IF_* IDs.
+        /// </summary>
+        internal static List<byte[]> PrepareHeader()
+        {
+            return new List<byte[]>
+            {
+                Pcapng.SectionHeaderBlock(),
+                Pcapng.InterfaceDescriptionBlock(Pcapng.LINKTYPE_CAN_SOCKETCAN, "can", Pcapng.TSRESOL_NS),
+                Pcapng.InterfaceDescriptionBlock(Pcapng.LINKTYPE_RAW, "raw", Pcapng.TSRESOL_NS),
+                Pcapng.InterfaceDescriptionBlock(Pcapng.LINKTYPE_FLEXRAY, "flexray", Pcapng.TSRESOL_NS),
+            };
+        }
+
+        internal static byte[] PrepareBlock(CanMessage msg)
+        {
+            return Pcapng.EnhancedPacketBlock(IF_SOCKETCAN, (ulong)msg.Timestamp, Wireshark_SocketCan.PreparePayload(msg));
+        }
+
+        internal static byte[] PrepareBlock(RawMessage msg)
+        {
+            return Pcapng.EnhancedPacketBlock(IF_RAW, msg.Timestamp, Wireshark_Raw.PreparePayload(msg), PcapngEpbFlags.None, msg.Comment);
+        }
+
+        internal static byte[] PrepareBlock(FlexRayMessage msg)
+        {
+            PcapngEpbFlags flags = PcapngEpbFlags.None;
+            string comment = null;
+            if (!msg.IsMessageValid())
+            {
+                flags = PcapngEpbFlags.CrcError;
+                comment = "invalid checksum";
+            }
+            return Pcapng.EnhancedPacketBlock(IF_FLEXRAY, (ulong)msg.Timestamp, Wireshark_FlexRay.PreparePayload(msg), flags, comment);
+        }
+
+        public void Dispose()
+        {
+            _server.Dispose();
+        }
+    }
+}
@@ -1,12 +1,8 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
-using System.Net.Sockets;
-using System.Net;
 using System.Text;
-using System.Threading;
 using System.Threading.Tasks;
-using System.IO;
 
 namespace WTM.Wireshark
 {
@@ -15,116 +11,31 @@ namespace WTM.Wireshark
     /// </summary>
     public class Wireshark_Raw : IDisposable
     {
-        readonly Object _syncObject = new Object();
-
         const int _port = 19000;
-        Thread _listenThread;
-        Queue<RawMessage> _qRaw;
-        bool _cancelThread;
-        TcpListener _server;
+        static readonly byte[] _fileHeader =
+        {
+            0xD4, 0xC3, 0xB2, 0xA1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0xFF, 0xFF, 0x00, 0x00, 0x65, 0x00, 0x00, 0x00
+        };
 
-        public TcpClient Client { get; private set; }
+        Wireshark_Server _server;
 
         public Wireshark_Raw()
         {
-            _qRaw = new Queue<RawMessage>();
-            _listenThread = new Thread(Listen);
-            _listenThread.Start();
+            _server = new Wireshark_Server(_port, _fileHeader);
         }
 
-        public void Add(RawMessage msg)
+        public bool IsConnected
         {
-            if (Client == null)
-            {
-                return;
-            }
-            if (!Client.Connected)
-            {
-                return;
-            }
-            lock (_syncObject)
+            get
             {
-                _qRaw.Enqueue(msg);
+                return _server.IsConnected;
             }
         }
 
-        private void Listen()
-        {
-            _cancelThread = false;
-            
-            try
-            {
-                _server = new TcpListener(IPAddress.Any, _port);
-                // Start listening for client requests.
-                _server.Start();
-                Console.WriteLine($"Waiting on connection on {_port}");
-
-                while (!_cancelThread)
-                {
-                    Client = _server.AcceptTcpClient();
-                    Console.WriteLine("Client connected");
-                    try
-                    {
-                        Send();
-                    }
-                    catch(IOException)
-                    {
-                        Console.WriteLine("Client disonnected");
-                    }
-                    lock (_syncObject)
-                    {
-                        _qRaw.Clear();
-                    }
-                }
-            }
-            catch (SocketException ex)
-            {
-                Console.WriteLine("Server-SocketException" + ex.Message);
-            }
-            finally
-            {
-                //server.Stop();
-            }
-        }
-
-        private void Send()
+        public void Add(RawMessage msg)
         {
-            NetworkStream stream = Client.GetStream();
-
-            //Write header
-            byte[] fileHeader =
-            {
-                0xD4, 0xC3, 0xB2, 0xA1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                0xFF, 0xFF, 0x00, 0x00, 0x65, 0x00, 0x00, 0x00
-            };
-            stream.Write(fileHeader, 0, fileHeader.Length);
-
-            while(!_cancelThread)
-            {
-                //Check if we are still connected
-                if(!Client.Connected)
-                {
-                    return;
-                }
-                //If we have more than one element in queue, process it, or wait 20ms
-                if (_qRaw.Count > 0)
-                {
-                    RawMessage rmsg;
-                    lock (_syncObject)
-                    {
-                        rmsg = _qRaw.Dequeue();
-                    }
-                    byte[] header = PreapreHeader(rmsg);
-                    stream.Write(header, 0, header.Length);
-
-                    byte[] payload = PreparePayload(rmsg);
-                    stream.Write(payload, 0, payload.Length);
-                }
-                else
-                {
-                    Thread.Sleep(20);
-                }
-            }
+            _server.Add(PreapreHeader(msg), PreparePayload(msg));
         }
 
         private byte[] PreapreHeader(RawMessage rmsg)
@@ -139,9 +50,8 @@ namespace WTM.Wireshark
 
             byte[] header = new byte[16];
 
-            uint timestamp_seconds = (uint)(rmsg.Timestamp / 1000); //Only second part (I know there should be Unix time, but I am too lazy to get RTC or NTP working)
-            uint timestamp_microseconds = (uint)(rmsg.Timestamp % 1000); //Only remainder from seconds
-            timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+            uint timestamp_seconds = (uint)(rmsg.Timestamp / 1000000000); //Unix time seconds
+            uint timestamp_microseconds = (uint)(rmsg.Timestamp % 1000000000 / 1000); //Only remainder from seconds
 
             WriteLE(header, timestamp_seconds, 0);
             WriteLE(header, timestamp_microseconds, 4);
@@ -151,7 +61,7 @@ namespace WTM.Wireshark
             return header;
         }
 
-        private byte[] PreparePayload(RawMessage rmsg)
+        internal static byte[] PreparePayload(RawMessage rmsg)
         {
             ushort sequence = 0;
 
@@ -192,16 +102,7 @@ namespace WTM.Wireshark
 
         public void Dispose()
         {
-            _cancelThread = true;
-            _server.Stop();
-
-            if(Client != null)
-            {
-                if(Client.Connected)
-                {
-                    Client.Close();
-                }
-            }
+            _server.Dispose();
         }
     }
 }
@@ -0,0 +1,343 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Net;
+using System.Net.Sockets;
+using System.Text;
+using System.Threading;
+using WTM.Shared;
+
+namespace WTM.Wireshark
+{
+    /// <summary>
+    /// What to do with client which can't keep up with incoming records
+    /// </summary>
+    public enum SlowClientPolicy
+    {
+        /// <summary>
+        /// Skip records which were removed from the ring, client continues with oldest available record
+        /// </summary>
+        Drop,
+        /// <summary>
+        /// Close connection of the client
+        /// </summary>
+        Disconnect,
+    }
+
+    /// <summary>
+    /// Connected client and its statistics, which are reported when client disconnects
+    /// </summary>
+    public class Wireshark_Subscriber
+    {
+        internal TcpClient Client { get; set; }
+        /// <summary>
+        /// Sequence number of next record which will be sent to this client
+        /// </summary>
+        internal long Cursor { get; set; }
+        public string Endpoint { get; internal set; }
+        public long Sent { get; internal set; }
+        public long Dropped { get; internal set; }
+        /// <summary>
+        /// Amount of records which were not sent to this client when it has disconnected
+        /// </summary>
+        public long Lag { get; internal set; }
+        public long MaxLag { get; internal set; }
+
+        public override string ToString()
+        {
+            return $"{Endpoint}: sent {Sent}, dropped {Dropped}, lag {Lag}, max lag {MaxLag}";
+        }
+    }
+
+    /// <summary>
+    /// TCP server for Wireshark with any amount of connected clients.
+    /// Records are serialized once into shared ring, every client reads it from own cursor by own thread,
+    /// so slow client does not slow down others.
+    /// Ring is filled also without clients and holds last seconds of traffic, which are replayed to new client.
+    /// </summary>
+    public class Wireshark_Server : IDisposable
+    {
+        readonly Object _syncObject = new Object();
+
+        /// <summary>
+        /// Records are merged into one write up to this size
+        /// </summary>
+        const int SEND_BUFFER_SIZE = 64 * 1024;
+        /// <summary>
+        /// Initial amount of records in the ring, ring doubles whenever it is full
+        /// </summary>
+        const int INITIAL_CAPACITY = 4096;
+
+        /// <summary>
+        /// How old records are replayed to newly connected client
+        /// </summary>
+        public static TimeSpan HistoryTime { get; set; } = TimeSpan.FromSeconds(10);
+        /// <summary>
+        /// Memory limit of the ring for one port
+        /// </summary>
+        public static long HistoryBytes { get; set; } = 16 * 1024 * 1024;
+        /// <summary>
+        /// What to do with client lagging more than the ring holds
+        /// </summary>
+        public static SlowClientPolicy SlowClients { get; set; } = SlowClientPolicy.Drop;
+
+        readonly int _port;
+        readonly byte[] _header;
+        byte[][] _ring;
+        long[] _ringTime; //Host time of record [ns]
+        readonly SlowClientPolicy _policy;
+        long _head; //Sequence number of next record written into ring
+        long _tail; //Sequence number of oldest record in ring
+        long _ringBytes;
+
+        Thread _listenThread;
+        volatile bool _cancelThread;
+        TcpListener _server;
+        List<Wireshark_Subscriber> _subscribers;
+
+        /// <summary>
+        /// Start listening on TCP port
+        /// </summary>
+        /// <param name="port">TCP port</param>
+        /// <param name="header">Sent to every client after connection, before any record</param>
+        public Wireshark_Server(int port, byte[] header)
+        {
+            _port = port;
+            _header = header;
+            _ring = new byte[INITIAL_CAPACITY][];
+            _ringTime = new long[INITIAL_CAPACITY];
+            _policy = SlowClients;
+            _subscribers = new List<Wireshark_Subscriber>();
+            _listenThread = new Thread(Listen);
+            _listenThread.Start();
+        }
+
+        public bool IsConnected
+        {
+            get
+            {
+                lock (_syncObject)
+                {
+                    return _subscribers.Count != 0;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Set history from command line arguments -history [s] and -hsize [MB], slow clients from -slow drop|disconnect
+        /// </summary>
+        public static void Configure(Dictionary<ArgumentTypes, object> pargs)
+        {
+            if (pargs.ContainsKey(ArgumentTypes.HistoryTime))
+            {
+                HistoryTime = TimeSpan.FromSeconds((int)pargs[ArgumentTypes.HistoryTime]);
+            }
+            if (pargs.ContainsKey(ArgumentTypes.HistorySize))
+            {
+                HistoryBytes = (long)(int)pargs[ArgumentTypes.HistorySize] * 1024 * 1024;
+            }
+            if (pargs.ContainsKey(ArgumentTypes.SlowClient))
+            {
+                SlowClients = (SlowClientPolicy)pargs[ArgumentTypes.SlowClient];
+            }
+        }
+
+        /// <summary>
+        /// Add serialized record for all connected clients and into history.
+        /// Ring holds records from last HistoryTime up to HistoryBytes, client lagging more than that is a slow client.
+        /// </summary>
+        public void Add(byte[] record)
+        {
+            long now = ClockDomain.HostNowNs;
+            long since = now - HistoryTime.Ticks * 100;
+            lock (_syncObject)
+            {
+                //Remove records which are too old or do not fit into memory limit
+                while (_tail < _head && (_ringTime[_tail % _ring.Length] < since || _ringBytes + record.Length > HistoryBytes))
+                {
+                    int oldest = (int)(_tail % _ring.Length);
+                    _ringBytes -= _ring[oldest].Length;
+                    _ring[oldest] = null;
+                    _tail++;
+                }
+                if (_head - _tail == _ring.Length)
+                {
+                    Grow();
+                }
+                int index = (int)(_head % _ring.Length);
+                _ring[index] = record;
+                _ringTime[index] = now;
+                _ringBytes += record.Length;
+                _head++;
+                Monitor.PulseAll(_syncObject);
+            }
+        }
+
+        /// <summary>
+        /// Double the ring, records keep their sequence numbers, so cursors of clients stay valid
+        /// </summary>
+        private void Grow()
+        {
+            byte[][] ring = new byte[_ring.Length * 2][];
+            long[] ringTime = new long[ring.Length];
+            for (long seq = _tail; seq < _head; seq++)
+            {
+                ring[seq % ring.Length] = _ring[seq % _ring.Length];
+                ringTime[seq % ring.Length] = _ringTime[seq % _ring.Length];
+            }
+            _ring = ring;
+            _ringTime = ringTime;
+        }
+
+        /// <summary>
+        /// Add record made of packet header and packet body
+        /// </summary>
+        public void Add(byte[] header, byte[] payload)
+        {
+            byte[] record = new byte[header.Length + payload.Length];
+            Buffer.BlockCopy(header, 0, record, 0, header.Length);
+            Buffer.BlockCopy(payload, 0, record, header.Length, payload.Length);
+            Add(record);
+        }
+
+        private void Listen()
+        {
+            _cancelThread = false;
+
+            try
+            {
+                _server = new TcpListener(IPAddress.Any, _port);
+                // Start listening for client requests.
+                _server.Start();
+                Console.WriteLine($"Waiting on connection on {_port}");
+
+                while (!_cancelThread)
+                {
+                    TcpClient client = _server.AcceptTcpClient();
+                    Wireshark_Subscriber sub = new Wireshark_Subscriber();
+                    sub.Client = client;
+                    sub.Endpoint = client.Client.RemoteEndPoint.ToString();
+                    lock (_syncObject)
+                    {
+                        //New client gets history first, then live records
+                        long since = ClockDomain.HostNowNs - HistoryTime.Ticks * 100;
+                        sub.Cursor = _tail;
+                        while (sub.Cursor < _head && _ringTime[sub.Cursor % _ring.Length] < since)
+                        {
+                            sub.Cursor++;
+                        }
+                        _subscribers.Add(sub);
+                    }
+                    Console.WriteLine($"Client {sub.Endpoint} connected on {_port}");
+                    Thread sendThread = new Thread(() => Send(sub));
+                    sendThread.IsBackground = true;
+                    sendThread.Start();
+                }
+            }
+            catch (SocketException ex)
+            {
+                if (!_cancelThread)
+                {
+                    Console.WriteLine("Server-SocketException" + ex.Message);
+                }
+            }
+        }
+
+        private void Send(Wireshark_Subscriber sub)
+        {
+            byte[] buffer = new byte[SEND_BUFFER_SIZE];
+            try
+            {
+                NetworkStream stream = sub.Client.GetStream();
+                stream.Write(_header, 0, _header.Length);
+
+                while (!_cancelThread)
+                {
+                    List<byte[]> records = new List<byte[]>();
+                    lock (_syncObject)
+                    {
+                        while (sub.Cursor == _head && !_cancelThread)
+                        {
+                            Monitor.Wait(_syncObject, 100);
+                        }
+                        if (sub.Cursor < _tail)
+                        {
+                            //Records for this client were already removed
+                            if (_policy == SlowClientPolicy.Disconnect)
+                            {
+                                Console.WriteLine($"Client {sub.Endpoint} on {_port} is too slow, disconnecting");
+                                break;
+                            }
+                            sub.Dropped += _tail - sub.Cursor;
+                            sub.Cursor = _tail;
+                        }
+                        long lag = _head - sub.Cursor;
+                        if (lag > sub.MaxLag)
+                        {
+                            sub.MaxLag = lag;
+                        }
+                        int size = 0;
+                        while (sub.Cursor < _head && size < SEND_BUFFER_SIZE)
+                        {
+                            byte[] record = _ring[sub.Cursor % _ring.Length];
+                            records.Add(record);
+                            size += record.Length;
+                            sub.Cursor++;
+                        }
+                    }
+
+                    //Write outside of lock, so other clients and producers are not blocked by this client
+                    int position = 0;
+                    foreach (byte[] record in records)
+                    {
+                        if (position + record.Length > buffer.Length)
+                        {
+                            stream.Write(buffer, 0, position);
+                            position = 0;
+                        }
+                        if (record.Length > buffer.Length)
+                        {
+                            stream.Write(record, 0, record.Length);
+                            continue;
+                        }
+                        Buffer.BlockCopy(record, 0, buffer, position, record.Length);
+                        position += record.Length;
+                    }
+                    if (position != 0)
+                    {
+                        stream.Write(buffer, 0, position);
+                    }
+                    sub.Sent += records.Count;
+                }
+            }
+            catch (IOException)
+            {
+            }
+            catch (ObjectDisposedException)
+            {
+            }
+            lock (_syncObject)
+            {
+                _subscribers.Remove(sub);
+                sub.Lag = _head - sub.Cursor;
+            }
+            sub.Client.Close();
+            Console.WriteLine($"Client disonnected {sub}");
+        }
+
+        public void Dispose()
+        {
+            _cancelThread = true;
+            _server.Stop();
+            lock (_syncObject)
+            {
+                foreach (Wireshark_Subscriber sub in _subscribers)
+                {
+                    sub.Client.Close();
+                }
+                Monitor.PulseAll(_syncObject);
+            }
+        }
+    }
+}
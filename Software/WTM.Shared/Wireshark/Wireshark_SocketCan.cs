@@ -1,12 +1,8 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
-using System.Net.Sockets;
-using System.Net;
 using System.Text;
-using System.Threading;
 using System.Threading.Tasks;
-using System.IO;
 
 namespace WTM.Wireshark
 {
@@ -15,116 +11,39 @@ namespace WTM.Wireshark
     /// </summary>
     public class Wireshark_SocketCan : IDisposable
     {
-        readonly Object _syncObject = new Object();
-
         const int _port = 19001;
-        Thread _listenThread;
-        Queue<CanMessage> _qRaw;
-        bool _cancelThread;
-        TcpListener _server;
+        /// <summary>
+        /// Size of struct can_frame
+        /// </summary>
+        const int CAN_MTU = 16;
+        /// <summary>
+        /// Size of struct canfd_frame
+        /// </summary>
+        const int CANFD_MTU = 72;
+        static readonly byte[] _fileHeader =
+        {
+            0xD4, 0xC3, 0xB2, 0xA1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0xFF, 0xFF, 0x00, 0x00, 0xE3, 0x00, 0x00, 0x00
+        };
 
-        public TcpClient Client { get; private set; }
+        Wireshark_Server _server;
 
         public Wireshark_SocketCan()
         {
-            _qRaw = new Queue<CanMessage>();
-            _listenThread = new Thread(Listen);
-            _listenThread.Start();
+            _server = new Wireshark_Server(_port, _fileHeader);
         }
 
-        public void Add(CanMessage msg)
+        public bool IsConnected
         {
-            if (Client == null)
-            {
-                return;
-            }
-            if (!Client.Connected)
-            {
-                return;
-            }
-            lock (_syncObject)
+            get
             {
-                _qRaw.Enqueue(msg);
+                return _server.IsConnected;
             }
         }
 
-        private void Listen()
-        {
-            _cancelThread = false;
-            
-            try
-            {
-                _server = new TcpListener(IPAddress.Any, _port);
-                // Start listening for client requests.
-                _server.Start();
-                Console.WriteLine($"Waiting on connection on {_port}");
-
-                while (!_cancelThread)
-                {
-                    Client = _server.AcceptTcpClient();
-                    Console.WriteLine("Client connected");
-                    try
-                    {
-                        Send();
-                    }
-                    catch(IOException)
-                    {
-                        Console.WriteLine("Client disonnected");
-                    }
-                    lock (_syncObject)
-                    {
-                        _qRaw.Clear();
-                    }
-                }
-            }
-            catch (SocketException ex)
-            {
-                Console.WriteLine("Server-SocketException" + ex.Message);
-            }
-            finally
-            {
-                //server.Stop();
-            }
-        }
-
-        private void Send()
+        public void Add(CanMessage msg)
         {
-            NetworkStream stream = Client.GetStream();
-
-            //Write header
-            byte[] fileHeader =
-            {
-                0xD4, 0xC3, 0xB2, 0xA1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                0xFF, 0xFF, 0x00, 0x00, 0xE3, 0x00, 0x00, 0x00
-            };
-            stream.Write(fileHeader, 0, fileHeader.Length);
-
-            while(!_cancelThread)
-            {
-                //Check if we are still connected
-                if(!Client.Connected)
-                {
-                    return;
-                }
-                //If we have more than one element in queue, process it, or wait 20ms
-                if (_qRaw.Count > 0)
-                {
-                    CanMessage cmsg;
-                    lock (_syncObject)
-                    {
-                        cmsg = _qRaw.Dequeue();
-                    }
-                    byte[] header = PreapreHeader(cmsg);
-                    stream.Write(header, 0, header.Length);
-
-                    byte[] payload = PreparePayload(cmsg);
-                    stream.Write(payload, 0, payload.Length);
-                }
-                else
-                {
-                    Thread.Sleep(20);
-                }
-            }
+            _server.Add(PreapreHeader(msg), PreparePayload(msg));
         }
 
         private byte[] PreapreHeader(CanMessage rmsg)
@@ -135,37 +54,43 @@ namespace WTM.Wireshark
              * 00-00-00-00 = Time Stamp micro seconds
              * 10-00-00-00 = Size of packet saved in a file = 16 bytes of socket CAN data
              * 10-00-00-00 = Actual size of packet = 16 bytes of socket CAN data
+             * (CAN FD frames have 72 bytes = 48-00-00-00)
              */
 
             byte[] header = new byte[16];
+            uint size = (uint)(rmsg.IsFd ? CANFD_MTU : CAN_MTU);
 
-            uint timestamp_seconds = (uint)(rmsg.Timestamp / 1000); //Only second part
-            uint timestamp_microseconds = (uint)(rmsg.Timestamp % 1000); //Only remainder from seconds
-            timestamp_microseconds = timestamp_microseconds * 1000; //Convert milisecond to microseconds
+            uint timestamp_seconds = (uint)(rmsg.Timestamp / 1000000000); //Unix time seconds
+            uint timestamp_microseconds = (uint)(rmsg.Timestamp % 1000000000 / 1000); //Only remainder from seconds
 
             WriteLE(header, timestamp_seconds, 0);
             WriteLE(header, timestamp_microseconds, 4);
-            WriteLE(header, 16, 8);
-            WriteLE(header, 16, 12);
+            WriteLE(header, size, 8);
+            WriteLE(header, size, 12);
 
             return header;
         }
 
-        private byte[] PreparePayload(CanMessage rmsg)
+        /// <summary>
+        /// struct can_frame (16 bytes) or struct canfd_frame (72 bytes) with CAN ID in big endian
+        /// </summary>
+        internal static byte[] PreparePayload(CanMessage rmsg)
         {
-            byte[] payload = new byte[16];
+            byte[] payload = new byte[rmsg.IsFd ? CANFD_MTU : CAN_MTU];
 
             payload[0] = (byte)(rmsg.Id >> 24);
             payload[1] = (byte)(rmsg.Id >> 16);
             payload[2] = (byte)(rmsg.Id >> 8);
             payload[3] = (byte)rmsg.Id;
-            if(rmsg.Id > 0x7FF)
+            if(rmsg.IsExtended)
             {
                 //Flag extended CAN messages
                 payload[0] |= 0x80;
             }
-            //DLC
+            //DLC (length of data for CAN FD)
             payload[4] = (byte)rmsg.Dlc;
+            //CANFD_BRS, CANFD_ESI, CANFD_FDF
+            payload[5] = (byte)rmsg.Flags;
             //Data
             Buffer.BlockCopy(rmsg.Data, 0, payload, 8, rmsg.Dlc);
 
@@ -182,16 +107,7 @@ namespace WTM.Wireshark
 
         public void Dispose()
         {
-            _cancelThread = true;
-            _server.Stop();
-
-            if(Client != null)
-            {
-                if(Client.Connected)
-                {
-                    Client.Close();
-                }
-            }
+            _server.Dispose();
         }
     }
 }
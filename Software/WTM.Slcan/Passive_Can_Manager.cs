@@ -0,0 +1,20 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO.Ports;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using WTM.Protocols;
+using WTM.Wireshark;
+
+namespace WTM.Slcan
+{
+    internal class Passive_Can_Manager : A_Passive_Can_Manager
+    {
+        public void Start(string comPort, int baudarate, string pathCanIds, Pcapng_Spool spool)
+        {
+            ICanIf can = new Slcan_CanIf(comPort, baudarate);
+            Start(can, pathCanIds, spool);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using WTM.Shared;
+using WTM.Wireshark;
+
+namespace WTM.Slcan
+{
+    internal class Program
+    {
+        static int Main(string[] args)
+        {
+            var pargs = Arguments.Parse(args);
+            if (pargs != null)
+            {
+                Wireshark_Server.Configure(pargs);
+                if (!pargs.ContainsKey(ArgumentTypes.ComPort))
+                {
+                    Console.WriteLine("Missing COM port. Aborting.");
+                    Console.WriteLine("Usage: -c COM5 -b 500000 [-f canId.xml] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
+                }
+                else if (!pargs.ContainsKey(ArgumentTypes.Baudrate))
+                {
+                    Console.WriteLine("Missing Baudrate. Aborting.");
+                    Console.WriteLine("Usage: -c COM5 -b 500000 [-f canId.xml] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
+                }
+                else
+                {
+                    string pathCanIds = string.Empty;
+                    if(pargs.ContainsKey( ArgumentTypes.CanIdsFile))
+                    {
+                        pathCanIds = pargs[ArgumentTypes.CanIdsFile] as string;
+                    }
+                    Passive_Can_Manager pcm = new Passive_Can_Manager();
+                    pcm.Start(pargs[ArgumentTypes.ComPort] as string, (int)pargs[ArgumentTypes.Baudrate], pathCanIds, Pcapng_Spool.FromArguments(pargs));
+                    WaitEsc();
+                    pcm.Dispose();
+                    return 0;
+                }
+            }
+            return -1;
+        }
+
+        static void WaitEsc()
+        {
+            ConsoleKeyInfo key;
+            do
+            {
+                key = Console.ReadKey();
+            } while (key.Key != ConsoleKey.Escape);
+        }
+    }
+}
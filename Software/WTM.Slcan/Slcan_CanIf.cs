@@ -0,0 +1,226 @@
+﻿using System;
+using System.Collections.Concurrent;
+using System.IO;
+using System.IO.Ports;
+using System.Text;
+using System.Threading;
+
+namespace WTM.Slcan
+{
+    /// <summary>
+    /// CAN interface for SLCAN (LAWICEL) devices on serial port, i.e. Firmware/OlimexP405.
+    /// When device accepts command B1, frames are received as binary records, otherwise as ASCII lines.
+    /// </summary>
+    public class Slcan_CanIf : ICanIf
+    {
+        /// <summary>
+        /// Driver buffer of serial port. USB CDC can deliver ~1 MB/s, keep enough data while reader thread is not scheduled
+        /// </summary>
+        const int PORT_BUFFER_SIZE = 1024 * 1024;
+        /// <summary>
+        /// One read takes everything what driver has collected since last read
+        /// </summary>
+        const int READ_BUFFER_SIZE = 64 * 1024;
+        const int READ_TIMEOUT_MS = 100;
+        const int RESPONSE_TIMEOUT_MS = 500;
+
+        readonly SerialPort _sp;
+        readonly Thread _readThread;
+        readonly Slcan_AsciiDecoder _ascii = new Slcan_AsciiDecoder();
+        readonly Slcan_BinaryDecoder _binary = new Slcan_BinaryDecoder();
+        readonly BlockingCollection<string> _responses = new BlockingCollection<string>();
+        volatile bool _enabled;
+        volatile bool _binaryMode;
+
+        public event EventHandler<CanMessage> OnReceiveCanFrame;
+
+        public int Baudrate { get; }
+
+        /// <summary>
+        /// Device has accepted binary mode (command B1)
+        /// </summary>
+        public bool Binary { get { return _binaryMode; } }
+
+        /// <summary>
+        /// Open SLCAN device and start CAN in listen mode
+        /// </summary>
+        /// <param name="comPort">Serial port of device, i.e. COM5</param>
+        /// <param name="baudrate">CAN baudrate</param>
+        public Slcan_CanIf(string comPort, int baudrate)
+        {
+            string speed = GetSpeedCommand(baudrate);
+
+            //Baudrate of serial port does not matter for USB CDC, but real UART devices needs it
+            _sp = new SerialPort(comPort, 115200);
+            _sp.ReadBufferSize = PORT_BUFFER_SIZE;
+            _sp.ReadTimeout = READ_TIMEOUT_MS;
+            _sp.Open();
+
+            //Device can be still open and streaming from previous session. Close it and drop everything received.
+            Write("\r\r\rC\r");
+            Thread.Sleep(100);
+            _sp.DiscardInBuffer();
+
+            _ascii.OnReceiveCanFrame += Decoder_OnReceiveCanFrame;
+            _ascii.OnResponse += Decoder_OnResponse;
+            _binary.OnReceiveCanFrame += Decoder_OnReceiveCanFrame;
+            _binary.OnResponse += Decoder_OnResponse;
+
+            //Start thread for reading of data
+            _enabled = true;
+            _readThread = new Thread(ReadThreadFunc);
+            _readThread.IsBackground = true;
+            _readThread.Start();
+
+            if (!Command(speed))
+            {
+                Dispose();
+                throw new Exception($"Cannot continue, SLCAN device on {comPort} has refused baudrate {baudrate}");
+            }
+            //Binary records are supported only by own firmware, other devices get ASCII with the best timestamp they offer
+            if (Command("B1"))
+            {
+                _binaryMode = true;
+            }
+            else if (!Command("Z3"))
+            {
+                Command("Z1");
+            }
+            if (!Command("O"))
+            {
+                Dispose();
+                throw new Exception($"Cannot continue, unable to open CAN on SLCAN device {comPort}");
+            }
+            Baudrate = baudrate;
+            Console.WriteLine($"SLCAN @ {comPort}, {(_binaryMode ? "binary" : "ASCII")} mode");
+        }
+
+        /// <summary>
+        /// Close CAN on device and release serial port
+        /// </summary>
+        public void Dispose()
+        {
+            if (_sp.IsOpen)
+            {
+                try
+                {
+                    Write("C\r");
+                }
+                catch (IOException)
+                {
+                    //Device was disconnected
+                }
+            }
+            _enabled = false;
+            _readThread?.Join();
+            _sp.Close();
+            if (_binary.Lost > 0)
+            {
+                Console.WriteLine($"SLCAN lost {_binary.Lost} of {_binary.Received + _binary.Lost} frames on USB");
+            }
+            if (_binary.Invalid > 0)
+            {
+                Console.WriteLine($"SLCAN skipped {_binary.Invalid} false record syncs");
+            }
+            if (_ascii.Invalid > 0)
+            {
+                Console.WriteLine($"SLCAN received {_ascii.Invalid} invalid frames");
+            }
+        }
+
+        private static string GetSpeedCommand(int baudrate)
+        {
+            switch (baudrate)
+            {
+                case 10000:
+                    return "S0";
+                case 20000:
+                    return "S1";
+                case 50000:
+                    return "S2";
+                case 100000:
+                    return "S3";
+                case 125000:
+                    return "S4";
+                case 250000:
+                    return "S5";
+                case 500000:
+                    return "S6";
+                case 800000:
+                    return "S7";
+                case 1000000:
+                    return "S8";
+                default:
+                    throw new NotImplementedException(string.Format("Baudare {0} is not supported by SLCAN", baudrate));
+            }
+        }
+
+        /// <summary>
+        /// Send command and wait for its response
+        /// </summary>
+        /// <returns>True if device has acknowledged command</returns>
+        private bool Command(string command)
+        {
+            string response;
+            //Drop responses which nobody has waited for
+            while (_responses.TryTake(out response)) { }
+            Write(command + "\r");
+            if (!_responses.TryTake(out response, RESPONSE_TIMEOUT_MS))
+            {
+                return false;
+            }
+            return response.EndsWith("\r");
+        }
+
+        private void Write(string text)
+        {
+            byte[] data = Encoding.ASCII.GetBytes(text);
+            _sp.Write(data, 0, data.Length);
+        }
+
+        private void ReadThreadFunc()
+        {
+            byte[] buffer = new byte[READ_BUFFER_SIZE];
+            while (_enabled)
+            {
+                int count;
+                try
+                {
+                    //Returns as soon as anything is received, up to whole buffer
+                    count = _sp.BaseStream.Read(buffer, 0, buffer.Length);
+                }
+                catch (TimeoutException)
+                {
+                    continue;
+                }
+                catch (IOException ex)
+                {
+                    if (_enabled)
+                    {
+                        Console.WriteLine($"SLCAN read failed: {ex.Message}");
+                    }
+                    return;
+                }
+                if (_binaryMode)
+                {
+                    _binary.Decode(buffer, 0, count);
+                }
+                else
+                {
+                    _ascii.Decode(buffer, 0, count);
+                }
+            }
+        }
+
+        private void Decoder_OnResponse(object sender, string e)
+        {
+            //Picked up by Command()
+            _responses.Add(e);
+        }
+
+        private void Decoder_OnReceiveCanFrame(object sender, CanMessage e)
+        {
+            OnReceiveCanFrame?.Invoke(this, e);
+        }
+    }
+}
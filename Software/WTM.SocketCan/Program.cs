@@ -0,0 +1,56 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using WTM.Shared;
+using WTM.Wireshark;
+
+namespace WTM.SocketCan
+{
+    internal class Program
+    {
+        static int Main(string[] args)
+        {
+            var pargs = Arguments.Parse(args);
+            if (pargs != null)
+            {
+                Wireshark_Server.Configure(pargs);
+                if (!pargs.ContainsKey(ArgumentTypes.CanInterface))
+                {
+                    Console.WriteLine("Missing CAN interface. Aborting.");
+                    Console.WriteLine("Usage: -i can0 [-b 500000] [-f canId.xml] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
+                }
+                else
+                {
+                    //Bitrate is configured on interface by "ip link", argument is only for information
+                    int baudrate = 0;
+                    if (pargs.ContainsKey(ArgumentTypes.Baudrate))
+                    {
+                        baudrate = (int)pargs[ArgumentTypes.Baudrate];
+                    }
+                    string pathCanIds = string.Empty;
+                    if(pargs.ContainsKey( ArgumentTypes.CanIdsFile))
+                    {
+                        pathCanIds = pargs[ArgumentTypes.CanIdsFile] as string;
+                    }
+                    Passive_Can_Manager pcm = new Passive_Can_Manager();
+                    pcm.Start(pargs[ArgumentTypes.CanInterface] as string, baudrate, pathCanIds, Pcapng_Spool.FromArguments(pargs));
+                    WaitEsc();
+                    pcm.Dispose();
+                    return 0;
+                }
+            }
+            return -1;
+        }
+
+        static void WaitEsc()
+        {
+            ConsoleKeyInfo key;
+            do
+            {
+                key = Console.ReadKey();
+            } while (key.Key != ConsoleKey.Escape);
+        }
+    }
+}
@@ -0,0 +1,304 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+namespace WTM.SocketCan
+{
+    /// <summary>
+    /// CAN interface for Linux SocketCAN (can0, vcan0, ...) using raw AF_CAN socket.
+    /// Frames are received in batches by recvmmsg and stamped by kernel (SO_TIMESTAMPING).
+    /// Runs under Mono or .NET on Linux, bitrate of interface is set by "ip link".
+    /// </summary>
+    public class SocketCan_CanIf : ICanIf
+    {
+        const int AF_CAN = 29;
+        const int SOCK_RAW = 3;
+        const int CAN_RAW = 1;
+        const int SOL_SOCKET = 1;
+        const int SOL_CAN_RAW = 101;
+        const int CAN_RAW_FD_FRAMES = 5;
+        const int SO_RCVTIMEO = 20;
+        const int SO_TIMESTAMPING = 37;
+        const int SO_RXQ_OVFL = 40;
+        const int SOF_TIMESTAMPING_RX_HARDWARE = 1 << 2;
+        const int SOF_TIMESTAMPING_RX_SOFTWARE = 1 << 3;
+        const int SOF_TIMESTAMPING_SOFTWARE = 1 << 4;
+        const int SOF_TIMESTAMPING_RAW_HARDWARE = 1 << 6;
+        const int MSG_WAITFORONE = 0x10000;
+        const int EAGAIN = 11;
+        const int EINTR = 4;
+
+        const uint CAN_EFF_FLAG = 0x80000000;
+        const uint CAN_RTR_FLAG = 0x40000000;
+        const uint CAN_ERR_FLAG = 0x20000000;
+        const uint CAN_EFF_MASK = 0x1FFFFFFF;
+        const uint CAN_SFF_MASK = 0x7FF;
+
+        /// <summary>
+        /// Frames received by one recvmmsg call
+        /// </summary>
+        const int BATCH = 64;
+        const int CAN_MTU = 16;
+        const int CANFD_MTU = 72;
+        const int CAN_FRAME_SIZE = CANFD_MTU;
+        const int IOVEC_SIZE = 16;
+        const int MMSGHDR_SIZE = 64;
+        const int CONTROL_SIZE = 128;   //SCM_TIMESTAMPING (16 + 3 * 16) and SO_RXQ_OVFL (16 + 4 + padding)
+        const int READ_TIMEOUT_MS = 100;
+
+        //Offsets inside of struct mmsghdr on 64 bit Linux, constructor refuses 32 bit process
+        const int MSG_IOV = 16;
+        const int MSG_IOVLEN = 24;
+        const int MSG_CONTROL = 32;
+        const int MSG_CONTROLLEN = 40;
+        const int MSG_LEN = 56;
+
+        [StructLayout(LayoutKind.Sequential)]
+        struct sockaddr_can
+        {
+            public ushort can_family;
+            public int can_ifindex;
+            public ulong can_addr_0; //Union of transport protocol addresses, not used by CAN_RAW
+            public ulong can_addr_1;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        struct timeval
+        {
+            public long tv_sec;
+            public long tv_usec;
+        }
+
+        [DllImport("libc", SetLastError = true)]
+        static extern int socket(int domain, int type, int protocol);
+        [DllImport("libc", SetLastError = true)]
+        static extern int bind(int sockfd, ref sockaddr_can addr, int addrlen);
+        [DllImport("libc", SetLastError = true)]
+        static extern int setsockopt(int sockfd, int level, int optname, ref int optval, int optlen);
+        [DllImport("libc", SetLastError = true)]
+        static extern int setsockopt(int sockfd, int level, int optname, ref timeval optval, int optlen);
+        [DllImport("libc", SetLastError = true)]
+        static extern int recvmmsg(int sockfd, IntPtr msgvec, uint vlen, int flags, IntPtr timeout);
+        [DllImport("libc", SetLastError = true)]
+        static extern int close(int fd);
+        [DllImport("libc", SetLastError = true)]
+        static extern uint if_nametoindex(string ifname);
+
+        readonly int _socket;
+        readonly Thread _readThread;
+        readonly IntPtr _buffer;      //mmsghdr[BATCH], iovec[BATCH], can_frame[BATCH], control[BATCH]
+        readonly ClockDomain _hwClock = new ClockDomain(1000000000);
+        volatile bool _enabled;
+        uint _dropped;
+
+        public event EventHandler<CanMessage> OnReceiveCanFrame;
+
+        public int Baudrate { get; }
+
+        /// <summary>
+        /// Amount of frames dropped by kernel because socket buffer was full
+        /// </summary>
+        public uint Dropped { get { return _dropped; } }
+
+        /// <summary>
+        /// Open raw CAN socket on given interface
+        /// </summary>
+        /// <param name="interfaceName">i.e. can0 or vcan0</param>
+        /// <param name="baudrate">Bitrate configured on interface, used only for information</param>
+        public SocketCan_CanIf(string interfaceName, int baudrate)
+        {
+            //mmsghdr, iovec, cmsghdr and timeval are laid out for LP64, 32 bit process would read garbage
+            if (!Environment.Is64BitProcess)
+            {
+                throw new Exception("Cannot continue, SocketCAN is supported only in 64 bit process");
+            }
+            uint ifindex = if_nametoindex(interfaceName);
+            if (ifindex == 0)
+            {
+                throw new Exception($"Cannot continue, CAN interface {interfaceName} not found");
+            }
+            _socket = socket(AF_CAN, SOCK_RAW, CAN_RAW);
+            if (_socket < 0)
+            {
+                throw new Exception($"Cannot continue, unable to create CAN socket (errno {Marshal.GetLastWin32Error()})");
+            }
+
+            //Hardware timestamp when interface supports it, otherwise kernel stamps frame when it is received
+            int timestamping = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+            setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPING, ref timestamping, sizeof(int));
+            int enable = 1;
+            setsockopt(_socket, SOL_SOCKET, SO_RXQ_OVFL, ref enable, sizeof(int));
+            //Receive CAN FD frames too, kernel without CAN FD support sends only struct can_frame
+            setsockopt(_socket, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, ref enable, sizeof(int));
+            //Wake up reader thread from time to time to check if it should end
+            timeval timeout = new timeval { tv_sec = 0, tv_usec = READ_TIMEOUT_MS * 1000 };
+            setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, ref timeout, Marshal.SizeOf(typeof(timeval)));
+
+            sockaddr_can addr = new sockaddr_can { can_family = AF_CAN, can_ifindex = (int)ifindex };
+            if (bind(_socket, ref addr, Marshal.SizeOf(typeof(sockaddr_can))) < 0)
+            {
+                int errno = Marshal.GetLastWin32Error();
+                close(_socket);
+                throw new Exception($"Cannot continue, unable to bind CAN socket to {interfaceName} (errno {errno})");
+            }
+
+            _buffer = Marshal.AllocHGlobal(BATCH * (MMSGHDR_SIZE + IOVEC_SIZE + CAN_FRAME_SIZE + CONTROL_SIZE));
+            PrepareHeaders();
+            Baudrate = baudrate;
+
+            //Start thread for reading of data
+            _enabled = true;
+            _readThread = new Thread(ReadThreadFunc);
+            _readThread.IsBackground = true;
+            _readThread.Start();
+        }
+
+        /// <summary>
+        /// Close socket
+        /// </summary>
+        public void Dispose()
+        {
+            _enabled = false;
+            _readThread.Join();
+            close(_socket);
+            Marshal.FreeHGlobal(_buffer);
+            if (_dropped > 0)
+            {
+                Console.WriteLine($"SocketCAN dropped {_dropped} frames");
+            }
+        }
+
+        private IntPtr Header(int i) { return _buffer + i * MMSGHDR_SIZE; }
+        private IntPtr Iovec(int i) { return _buffer + BATCH * MMSGHDR_SIZE + i * IOVEC_SIZE; }
+        private IntPtr Frame(int i) { return _buffer + BATCH * (MMSGHDR_SIZE + IOVEC_SIZE) + i * CAN_FRAME_SIZE; }
+        private IntPtr Control(int i) { return _buffer + BATCH * (MMSGHDR_SIZE + IOVEC_SIZE + CAN_FRAME_SIZE) + i * CONTROL_SIZE; }
+
+        /// <summary>
+        /// Every message of batch has own frame and control buffer, headers are reused by every recvmmsg
+        /// </summary>
+        private void PrepareHeaders()
+        {
+            for (int i = 0; i < BATCH; i++)
+            {
+                for (int j = 0; j < MMSGHDR_SIZE; j += 8)
+                {
+                    Marshal.WriteInt64(Header(i), j, 0);
+                }
+                Marshal.WriteIntPtr(Iovec(i), 0, Frame(i));
+                Marshal.WriteInt64(Iovec(i), 8, CAN_FRAME_SIZE);
+                Marshal.WriteIntPtr(Header(i), MSG_IOV, Iovec(i));
+                Marshal.WriteInt64(Header(i), MSG_IOVLEN, 1);
+                Marshal.WriteIntPtr(Header(i), MSG_CONTROL, Control(i));
+            }
+        }
+
+        private void ReadThreadFunc()
+        {
+            byte[] frame = new byte[CAN_FRAME_SIZE];
+            while (_enabled)
+            {
+                //Kernel overwrites length of control data with length actually used
+                for (int i = 0; i < BATCH; i++)
+                {
+                    Marshal.WriteInt64(Header(i), MSG_CONTROLLEN, CONTROL_SIZE);
+                }
+                //Wait for first frame, then take everything what is queued up to BATCH
+                int count = recvmmsg(_socket, _buffer, BATCH, MSG_WAITFORONE, IntPtr.Zero);
+                if (count < 0)
+                {
+                    int errno = Marshal.GetLastWin32Error();
+                    if (errno == EAGAIN || errno == EINTR)
+                    {
+                        continue;
+                    }
+                    Console.WriteLine($"SocketCAN read failed (errno {errno})");
+                    return;
+                }
+                for (int i = 0; i < count; i++)
+                {
+                    int length = Marshal.ReadInt32(Header(i), MSG_LEN);
+                    if (length != CAN_MTU && length != CANFD_MTU)
+                    {
+                        continue;
+                    }
+                    Marshal.Copy(Frame(i), frame, 0, length);
+                    ProcessFrame(frame, length == CANFD_MTU, ReadTimestamp(i));
+                }
+            }
+        }
+
+        /// <summary>
+        /// Walk control messages of i-th message of batch
+        /// </summary>
+        /// <returns>Unix time [ns]</returns>
+        private long ReadTimestamp(int i)
+        {
+            long controlLength = Marshal.ReadInt64(Header(i), MSG_CONTROLLEN);
+            IntPtr control = Control(i);
+            long software = 0;
+            long hardware = 0;
+            int offset = 0;
+            //struct cmsghdr { size_t cmsg_len; int cmsg_level; int cmsg_type; data aligned on 8 bytes }
+            while (offset + 16 <= controlLength)
+            {
+                long length = Marshal.ReadInt64(control, offset);
+                int level = Marshal.ReadInt32(control, offset + 8);
+                int type = Marshal.ReadInt32(control, offset + 12);
+                if (length < 16)
+                {
+                    break;
+                }
+                if (level == SOL_SOCKET && type == SO_TIMESTAMPING)
+                {
+                    //struct timespec ts[3], [0] = software, [2] = raw hardware
+                    software = ReadTimespec(control, offset + 16);
+                    hardware = ReadTimespec(control, offset + 16 + 32);
+                }
+                else if (level == SOL_SOCKET && type == SO_RXQ_OVFL)
+                {
+                    _dropped = (uint)Marshal.ReadInt32(control, offset + 16);
+                }
+                offset += (int)((length + 7) & ~7L);
+            }
+            if (hardware != 0)
+            {
+                //Clock of controller does not have to be Unix time
+                return _hwClock.ToUnixNs(hardware);
+            }
+            if (software != 0)
+            {
+                //Kernel software timestamp is already Unix time
+                return software;
+            }
+            return ClockDomain.HostNowNs;
+        }
+
+        private static long ReadTimespec(IntPtr ptr, int offset)
+        {
+            return Marshal.ReadInt64(ptr, offset) * 1000000000 + Marshal.ReadInt64(ptr, offset + 8);
+        }
+
+        /// <summary>
+        /// struct can_frame { canid_t can_id; __u8 can_dlc; __u8 pad, res0, len8_dlc; __u8 data[8]; }
+        /// struct canfd_frame { canid_t can_id; __u8 len; __u8 flags, res0, res1; __u8 data[64]; }
+        /// </summary>
+        private void ProcessFrame(byte[] frame, bool fd, long timestamp)
+        {
+            uint canId = BitConverter.ToUInt32(frame, 0);
+            if ((canId & CAN_ERR_FLAG) != 0)
+            {
+                return;
+            }
+            bool extended = (canId & CAN_EFF_FLAG) != 0;
+            int id = (int)(extended ? canId & CAN_EFF_MASK : canId & CAN_SFF_MASK);
+            int dlc = Math.Min((int)frame[4], fd ? CanMessage.MAX_LENGTH_FD : CanMessage.MAX_LENGTH_CAN);
+            byte[] data = new byte[(canId & CAN_RTR_FLAG) != 0 && !fd ? 0 : dlc];
+            Buffer.BlockCopy(frame, 8, data, 0, data.Length);
+            //Flags of canfd_frame are the same as CanFdFlags, CANFD_FDF is not set by older kernels
+            CanFdFlags flags = fd ? (CanFdFlags)frame[5] | CanFdFlags.Fd : CanFdFlags.None;
+            CanMessage cmsg = new CanMessage(data, id, flags, extended);
+            cmsg.Timestamp = timestamp;
+            OnReceiveCanFrame?.Invoke(this, cmsg);
+        }
+    }
+}
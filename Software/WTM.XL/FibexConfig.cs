@@ -0,0 +1,161 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+using WTM;
+using WTM.Protocols;
+
+namespace WTM.XL
+{
+    /// <summary>
+    /// Everything what WTM.XL needs from FIBEX file. Stored in binary cache keyed by hash of FIBEX, see FibexParser.
+    /// </summary>
+    class FibexConfig
+    {
+        /// <summary>
+        /// Change whenever format of cache changes, old caches are then ignored
+        /// </summary>
+        const string CACHE_MAGIC = "WTM.FIBEX.1";
+
+        /// <summary>
+        /// Text of first occurrence of cluster and controller parameters (flexray:*, fx:SPEED) by element name
+        /// </summary>
+        public Dictionary<string, string> Values { get; } = new Dictionary<string, string>();
+        /// <summary>
+        /// Bit 0 = Channel_A, bit 1 = Channel_B
+        /// </summary>
+        public ushort Channels { get; set; }
+        public FibexDescription Description { get; } = new FibexDescription();
+        public List<FlexRayFrameTriggering> Triggerings { get; } = new List<FlexRayFrameTriggering>();
+
+        /// <summary>
+        /// Cluster or controller parameter
+        /// </summary>
+        /// <exception cref="KeyNotFoundException">Parameter is not in FIBEX</exception>
+        public string Value(string name)
+        {
+            string value;
+            if (!Values.TryGetValue(name, out value))
+            {
+                throw new KeyNotFoundException(name);
+            }
+            return value;
+        }
+
+        public void Save(string fileName, byte[] hash)
+        {
+            using (BinaryWriter bw = new BinaryWriter(File.Create(fileName), Encoding.UTF8))
+            {
+                bw.Write(CACHE_MAGIC);
+                bw.Write(hash.Length);
+                bw.Write(hash);
+                bw.Write(Values.Count);
+                foreach (KeyValuePair<string, string> kv in Values)
+                {
+                    WriteString(bw, kv.Key);
+                    WriteString(bw, kv.Value);
+                }
+                bw.Write(Channels);
+                WriteString(bw, Description.Name);
+                WriteString(bw, Description.Description);
+                bw.Write(Triggerings.Count);
+                foreach (FlexRayFrameTriggering ft in Triggerings)
+                {
+                    bw.Write((byte)ft.Channel);
+                    bw.Write((ushort)ft.Slot);
+                    bw.Write((byte)ft.BaseCycle);
+                    bw.Write((byte)ft.CycleRepetition);
+                    WriteString(bw, ft.FrameName);
+                    bw.Write(ft.Pdus.Count);
+                    foreach (FlexRayPduLayout pdu in ft.Pdus)
+                    {
+                        bw.Write(pdu.Id);
+                        WriteString(bw, pdu.Name);
+                        bw.Write(pdu.Offset);
+                        bw.Write(pdu.Length);
+                        bw.Write(pdu.UpdateBit);
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Names are optional in FIBEX, missing one is stored as empty string
+        /// </summary>
+        static void WriteString(BinaryWriter bw, string value)
+        {
+            bw.Write(value ?? string.Empty);
+        }
+
+        /// <returns>Null if cache does not exist, was created from other FIBEX or by other version, or is damaged</returns>
+        public static FibexConfig Load(string fileName, byte[] hash)
+        {
+            if (!File.Exists(fileName))
+            {
+                return null;
+            }
+            try
+            {
+                using (BinaryReader br = new BinaryReader(File.OpenRead(fileName), Encoding.UTF8))
+                {
+                    if (br.ReadString() != CACHE_MAGIC)
+                    {
+                        return null;
+                    }
+                    byte[] cachedHash = br.ReadBytes(br.ReadInt32());
+                    if (Convert.ToBase64String(cachedHash) != Convert.ToBase64String(hash))
+                    {
+                        return null;
+                    }
+                    FibexConfig config = new FibexConfig();
+                    int count = br.ReadInt32();
+                    for (int i = 0; i < count; i++)
+                    {
+                        string key = br.ReadString();
+                        config.Values[key] = br.ReadString();
+                    }
+                    config.Channels = br.ReadUInt16();
+                    config.Description.Name = br.ReadString();
+                    config.Description.Description = br.ReadString();
+                    count = br.ReadInt32();
+                    for (int i = 0; i < count; i++)
+                    {
+                        FlexRayFrameTriggering ft = new FlexRayFrameTriggering();
+                        ft.Channel = (FlexRayChannel)br.ReadByte();
+                        ft.Slot = br.ReadUInt16();
+                        ft.BaseCycle = br.ReadByte();
+                        ft.CycleRepetition = br.ReadByte();
+                        ft.FrameName = br.ReadString();
+                        int pdus = br.ReadInt32();
+                        for (int j = 0; j < pdus; j++)
+                        {
+                            FlexRayPduLayout pdu = new FlexRayPduLayout();
+                            pdu.Id = br.ReadInt32();
+                            pdu.Name = br.ReadString();
+                            pdu.Offset = br.ReadInt32();
+                            pdu.Length = br.ReadInt32();
+                            pdu.UpdateBit = br.ReadInt32();
+                            ft.Pdus.Add(pdu);
+                        }
+                        config.Triggerings.Add(ft);
+                    }
+                    return config;
+                }
+            }
+            catch (Exception ex)
+            {
+                //Truncated, damaged or locked cache, parse FIBEX again
+                Console.WriteLine($"Ignoring FIBEX cache {fileName}: {ex.Message}");
+                try
+                {
+                    File.Delete(fileName);
+                }
+                catch (Exception deleteEx) when (deleteEx is IOException || deleteEx is UnauthorizedAccessException)
+                {
+                    //Cache is still in use, it will be overwritten by new one
+                }
+                return null;
+            }
+        }
+    }
+}
@@ -1,16 +1,24 @@
 ﻿using System;
 using System.Collections;
 using System.Collections.Generic;
+using System.Globalization;
 using System.Text;
 using System.Xml;
 using System.Xml.XPath;
 using System.IO;
+using System.Security.Cryptography;
 using vxlapi_NET;
+using WTM.Protocols;
 
 namespace WTM.XL
 {
     static class FibexParser
     {
+        /// <summary>
+        /// Parsed FIBEX files by SHA-256 of content
+        /// </summary>
+        static readonly Dictionary<string, FibexConfig> _loaded = new Dictionary<string, FibexConfig>();
+
         /// <summary>
         /// Loads the application settings from a FIBEX file and returns the values in a class
         /// according to the XL API .NET Wrapper
@@ -29,9 +37,16 @@ namespace WTM.XL
         {
             frConfig = new XLClass.xl_fr_cluster_configuration();
             desc = new FibexDescription();
-            XmlDocument doc = new XmlDocument();
-            XmlNodeList nodeList;
-            doc.Load(fileName);
+            FibexConfig config;
+            try
+            {
+                config = Load(fileName);
+            }
+            catch (XmlException e)
+            {
+                return new Exception("Invalid FIBEX file! " + e.Message);
+            }
+            desc = config.Description;
 
             // Unused API parameters
             frConfig.busGuardianEnable = 0;
@@ -46,86 +61,59 @@ namespace WTM.XL
             try
             {
                 // Read CLUSTER section of the config
-                nodeList = doc.GetElementsByTagName("fx:SPEED");
-                frConfig.baudrate = Convert.ToUInt32(nodeList[0].InnerText);
+                frConfig.baudrate = Convert.ToUInt32(config.Value("fx:SPEED"));
 
-                nodeList = doc.GetElementsByTagName("flexray:COLD-START-ATTEMPTS");
-                frConfig.gColdStartAttempts = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gColdStartAttempts = Convert.ToUInt16(config.Value("flexray:COLD-START-ATTEMPTS"));
 
-                nodeList = doc.GetElementsByTagName("flexray:LISTEN-NOISE");
-                frConfig.gListenNoise = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gListenNoise = Convert.ToUInt16(config.Value("flexray:LISTEN-NOISE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MACRO-PER-CYCLE");
-                frConfig.gMacroPerCycle = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gMacroPerCycle = Convert.ToUInt16(config.Value("flexray:MACRO-PER-CYCLE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MAX-WITHOUT-CLOCK-CORRECTION-FATAL");
-                frConfig.gMaxWithoutClockCorrectionFatal = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gMaxWithoutClockCorrectionFatal = Convert.ToUInt16(config.Value("flexray:MAX-WITHOUT-CLOCK-CORRECTION-FATAL"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MAX-WITHOUT-CLOCK-CORRECTION-PASSIVE");
-                frConfig.gMaxWithoutClockCorrectionPassive = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gMaxWithoutClockCorrectionPassive = Convert.ToUInt16(config.Value("flexray:MAX-WITHOUT-CLOCK-CORRECTION-PASSIVE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:NETWORK-MANAGEMENT-VECTOR-LENGTH");
-                frConfig.gNetworkManagementVectorLength = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gNetworkManagementVectorLength = Convert.ToUInt16(config.Value("flexray:NETWORK-MANAGEMENT-VECTOR-LENGTH"));
 
-                nodeList = doc.GetElementsByTagName("flexray:NUMBER-OF-MINISLOTS");
-                frConfig.gNumberOfMinislots = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gNumberOfMinislots = Convert.ToUInt16(config.Value("flexray:NUMBER-OF-MINISLOTS"));
 
-                nodeList = doc.GetElementsByTagName("flexray:NUMBER-OF-STATIC-SLOTS");
-                frConfig.gNumberOfStaticSlots = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gNumberOfStaticSlots = Convert.ToUInt16(config.Value("flexray:NUMBER-OF-STATIC-SLOTS"));
 
-                nodeList = doc.GetElementsByTagName("flexray:OFFSET-CORRECTION-START");
-                frConfig.gOffsetCorrectionStart = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gOffsetCorrectionStart = Convert.ToUInt16(config.Value("flexray:OFFSET-CORRECTION-START"));
 
-                nodeList = doc.GetElementsByTagName("flexray:PAYLOAD-LENGTH-STATIC");
-                frConfig.gPayloadLengthStatic = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gPayloadLengthStatic = Convert.ToUInt16(config.Value("flexray:PAYLOAD-LENGTH-STATIC"));
 
-                nodeList = doc.GetElementsByTagName("flexray:SYNC-NODE-MAX");
-                frConfig.gSyncNodeMax = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gSyncNodeMax = Convert.ToUInt16(config.Value("flexray:SYNC-NODE-MAX"));
 
-                nodeList = doc.GetElementsByTagName("flexray:ACTION-POINT-OFFSET");
-                frConfig.gdActionPointOffset = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdActionPointOffset = Convert.ToUInt16(config.Value("flexray:ACTION-POINT-OFFSET"));
 
-                nodeList = doc.GetElementsByTagName("flexray:DYNAMIC-SLOT-IDLE-PHASE");
-                frConfig.gdDynamicSlotIdlePhase = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdDynamicSlotIdlePhase = Convert.ToUInt16(config.Value("flexray:DYNAMIC-SLOT-IDLE-PHASE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MINISLOT");
-                frConfig.gdMinislot = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdMinislot = Convert.ToUInt16(config.Value("flexray:MINISLOT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MINISLOT-ACTION-POINT-OFFSET");
-                frConfig.gdMiniSlotActionPointOffset = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdMiniSlotActionPointOffset = Convert.ToUInt16(config.Value("flexray:MINISLOT-ACTION-POINT-OFFSET"));
 
-                nodeList = doc.GetElementsByTagName("flexray:N-I-T");
-                frConfig.gdNIT = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdNIT = Convert.ToUInt16(config.Value("flexray:N-I-T"));
 
-                nodeList = doc.GetElementsByTagName("flexray:STATIC-SLOT");
-                frConfig.gdStaticSlot = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdStaticSlot = Convert.ToUInt16(config.Value("flexray:STATIC-SLOT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:SYMBOL-WINDOW");
-                frConfig.gdSymbolWindow = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdSymbolWindow = Convert.ToUInt16(config.Value("flexray:SYMBOL-WINDOW"));
 
-                nodeList = doc.GetElementsByTagName("flexray:T-S-S-TRANSMITTER");
-                frConfig.gdTSSTransmitter = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdTSSTransmitter = Convert.ToUInt16(config.Value("flexray:T-S-S-TRANSMITTER"));
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-SYMBOL-RX-IDLE");
-                frConfig.gdWakeupSymbolRxIdle = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdWakeupSymbolRxIdle = Convert.ToUInt16(config.Value("flexray:WAKE-UP-SYMBOL-RX-IDLE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-SYMBOL-RX-LOW");
-                frConfig.gdWakeupSymbolRxLow = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdWakeupSymbolRxLow = Convert.ToUInt16(config.Value("flexray:WAKE-UP-SYMBOL-RX-LOW"));
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-SYMBOL-RX-WINDOW");
-                frConfig.gdWakeupSymbolRxWindow = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdWakeupSymbolRxWindow = Convert.ToUInt16(config.Value("flexray:WAKE-UP-SYMBOL-RX-WINDOW"));
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-SYMBOL-TX-IDLE");
-                frConfig.gdWakeupSymbolTxIdle = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdWakeupSymbolTxIdle = Convert.ToUInt16(config.Value("flexray:WAKE-UP-SYMBOL-TX-IDLE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-SYMBOL-TX-LOW");
-                frConfig.gdWakeupSymbolTxLow = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdWakeupSymbolTxLow = Convert.ToUInt16(config.Value("flexray:WAKE-UP-SYMBOL-TX-LOW"));
 
-                nodeList = doc.GetElementsByTagName("flexray:CAS-RX-LOW-MAX");
-                frConfig.gdCASRxLowMax = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.gdCASRxLowMax = Convert.ToUInt16(config.Value("flexray:CAS-RX-LOW-MAX"));
 
-                nodeList = doc.GetElementsByTagName("flexray:CLUSTER-DRIFT-DAMPING");
-                frConfig.pClusterDriftDamping = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pClusterDriftDamping = Convert.ToUInt16(config.Value("flexray:CLUSTER-DRIFT-DAMPING"));
 
                 //nodeList = doc.GetElementsByTagName("flexray:MACROTICK");
                 // calculated by API
@@ -137,53 +125,37 @@ namespace WTM.XL
 
 
                 // Read CONTROLLER section of the config
-                nodeList = doc.GetElementsByTagName("flexray:CLUSTER-DRIFT-DAMPING");
-                frConfig.pClusterDriftDamping = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pClusterDriftDamping = Convert.ToUInt16(config.Value("flexray:CLUSTER-DRIFT-DAMPING"));
 
-                nodeList = doc.GetElementsByTagName("flexray:DECODING-CORRECTION");
-                frConfig.pDecodingCorrection = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pDecodingCorrection = Convert.ToUInt16(config.Value("flexray:DECODING-CORRECTION"));
 
-                nodeList = doc.GetElementsByTagName("flexray:DELAY-COMPENSATION-A");
-                frConfig.pDelayCompensationA = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pDelayCompensationA = Convert.ToUInt16(config.Value("flexray:DELAY-COMPENSATION-A"));
 
-                nodeList = doc.GetElementsByTagName("flexray:DELAY-COMPENSATION-B");
-                frConfig.pDelayCompensationB = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pDelayCompensationB = Convert.ToUInt16(config.Value("flexray:DELAY-COMPENSATION-B"));
 
-                nodeList = doc.GetElementsByTagName("flexray:EXTERN-OFFSET-CORRECTION");
-                frConfig.pExternOffsetCorrection = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pExternOffsetCorrection = Convert.ToUInt16(config.Value("flexray:EXTERN-OFFSET-CORRECTION"));
 
-                nodeList = doc.GetElementsByTagName("flexray:EXTERN-RATE-CORRECTION");
-                frConfig.pExternRateCorrection = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pExternRateCorrection = Convert.ToUInt16(config.Value("flexray:EXTERN-RATE-CORRECTION"));
 
-                nodeList = doc.GetElementsByTagName("flexray:LATEST-TX");
-                frConfig.pLatestTx = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pLatestTx = Convert.ToUInt16(config.Value("flexray:LATEST-TX"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MACRO-INITIAL-OFFSET-A");
-                frConfig.pMacroInitialOffsetA = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pMacroInitialOffsetA = Convert.ToUInt16(config.Value("flexray:MACRO-INITIAL-OFFSET-A"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MACRO-INITIAL-OFFSET-B");
-                frConfig.pMacroInitialOffsetB = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pMacroInitialOffsetB = Convert.ToUInt16(config.Value("flexray:MACRO-INITIAL-OFFSET-B"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MICRO-INITIAL-OFFSET-A");
-                frConfig.pMicroInitialOffsetA = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pMicroInitialOffsetA = Convert.ToUInt16(config.Value("flexray:MICRO-INITIAL-OFFSET-A"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MICRO-INITIAL-OFFSET-B");
-                frConfig.pMicroInitialOffsetB = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pMicroInitialOffsetB = Convert.ToUInt16(config.Value("flexray:MICRO-INITIAL-OFFSET-B"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MICRO-PER-CYCLE");
-                frConfig.pMicroPerCycle = Convert.ToUInt32(nodeList[0].InnerText);
+                frConfig.pMicroPerCycle = Convert.ToUInt32(config.Value("flexray:MICRO-PER-CYCLE"));
 
-                nodeList = doc.GetElementsByTagName("flexray:OFFSET-CORRECTION-OUT");
-                frConfig.pOffsetCorrectionOut = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pOffsetCorrectionOut = Convert.ToUInt16(config.Value("flexray:OFFSET-CORRECTION-OUT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:RATE-CORRECTION-OUT");
-                frConfig.pRateCorrectionOut = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pRateCorrectionOut = Convert.ToUInt16(config.Value("flexray:RATE-CORRECTION-OUT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:SAMPLES-PER-MICROTICK");
-                frConfig.pSamplesPerMicrotick = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pSamplesPerMicrotick = Convert.ToUInt16(config.Value("flexray:SAMPLES-PER-MICROTICK"));
 
-                nodeList = doc.GetElementsByTagName("flexray:SINGLE-SLOT-ENABLED");
-                if (nodeList[0].InnerText == "true")
+                if (config.Value("flexray:SINGLE-SLOT-ENABLED") == "true")
                 {
                     frConfig.pSingleSlotEnabled = 1;
                 }
@@ -192,11 +164,9 @@ namespace WTM.XL
                     frConfig.pSingleSlotEnabled = 0;
                 }
 
-                nodeList = doc.GetElementsByTagName("flexray:WAKE-UP-PATTERN");
-                frConfig.pWakeupPattern = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pWakeupPattern = Convert.ToUInt16(config.Value("flexray:WAKE-UP-PATTERN"));
 
-                nodeList = doc.GetElementsByTagName("flexray:ALLOW-HALT-DUE-TO-CLOCK");
-                if (nodeList[0].InnerText == "true")
+                if (config.Value("flexray:ALLOW-HALT-DUE-TO-CLOCK") == "true")
                 {
                     frConfig.pAllowHaltDueToClock = 1;
                 }
@@ -205,58 +175,391 @@ namespace WTM.XL
                     frConfig.pAllowHaltDueToClock = 0;
                 }
 
-                nodeList = doc.GetElementsByTagName("flexray:ALLOW-PASSIVE-TO-ACTIVE");
-                frConfig.pAllowPassiveToActive = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pAllowPassiveToActive = Convert.ToUInt16(config.Value("flexray:ALLOW-PASSIVE-TO-ACTIVE"));
+
+                frConfig.pdAcceptedStartupRange = Convert.ToUInt16(config.Value("flexray:ACCEPTED-STARTUP-RANGE"));
+
+                frConfig.pdListenTimeout = Convert.ToUInt32(config.Value("flexray:LISTEN-TIMEOUT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:ACCEPTED-STARTUP-RANGE");
-                frConfig.pdAcceptedStartupRange = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pdMaxDrift = Convert.ToUInt16(config.Value("flexray:MAX-DRIFT"));
 
-                nodeList = doc.GetElementsByTagName("flexray:LISTEN-TIMEOUT");
-                frConfig.pdListenTimeout = Convert.ToUInt32(nodeList[0].InnerText);
+                frConfig.pMaxPayloadLengthDynamic = Convert.ToUInt16(config.Value("flexray:MAX-DYNAMIC-PAYLOAD-LENGTH"));
 
-                nodeList = doc.GetElementsByTagName("flexray:MAX-DRIFT");
-                frConfig.pdMaxDrift = Convert.ToUInt16(nodeList[0].InnerText);
 
-                nodeList = doc.GetElementsByTagName("flexray:MAX-DYNAMIC-PAYLOAD-LENGTH");
-                frConfig.pMaxPayloadLengthDynamic = Convert.ToUInt16(nodeList[0].InnerText);
+                frConfig.pChannels = config.Channels;
+
+                frConfig.pWakeupChannel = XLDefine.XL_FlexRay_FlagsChip.XL_FR_CHANNEL_A;
+            }
+
+            catch (Exception e)
+            {
+                return new Exception("Keyword not found! " + e.Message);
+            }
+            return null;
+        }
 
+        /// <summary>
+        /// Loads frame triggerings (slot, base cycle, cycle repetition) and PDU instances of their frames from a FIBEX file.
+        /// Update bit is taken from PDU-INSTANCE (UPDATE-INDICATION-BIT-POSITION or PDU-UPDATE-BIT-POSITION).
+        /// </summary>
+        //--------------------------------------------------------------------------------------------------------
+        public static Exception GetPduLayout(string fileName, out List<FlexRayFrameTriggering> triggerings)
+        {
+            triggerings = null;
+            try
+            {
+                triggerings = Load(fileName).Triggerings;
+            }
+            catch (XmlException e)
+            {
+                return new Exception("Invalid FIBEX file! " + e.Message);
+            }
+            return null;
+        }
 
-                nodeList = doc.GetElementsByTagName("fx:CHANNEL");
-                frConfig.pChannels = 0;
-                foreach (XmlNode child in nodeList)
+        /// <summary>
+        /// Content of FIBEX from binary cache in temp folder. FIBEX is parsed only when it has changed since last start.
+        /// Result is kept in memory, so GetConfig and GetPduLayout read file only once.
+        /// </summary>
+        static FibexConfig Load(string fileName)
+        {
+            byte[] hash;
+            using (SHA256 sha = SHA256.Create())
+            using (FileStream fs = File.OpenRead(fileName))
+            {
+                hash = sha.ComputeHash(fs);
+            }
+            string key = BitConverter.ToString(hash).Replace("-", string.Empty);
+            lock (_loaded)
+            {
+                FibexConfig config;
+                if (_loaded.TryGetValue(key, out config))
+                {
+                    return config;
+                }
+                string cacheFile = Path.Combine(Path.GetTempPath(), "WTM", key + ".fibex");
+                config = FibexConfig.Load(cacheFile, hash);
+                if (config == null)
                 {
-                    string value = child["ho:SHORT-NAME"].InnerText;
-                    if (value.Equals("Channel_A"))
+                    config = Parse(fileName);
+                    try
                     {
-                        frConfig.pChannels |= 1;
+                        Directory.CreateDirectory(Path.GetDirectoryName(cacheFile));
+                        config.Save(cacheFile, hash);
                     }
-                    else if (value.Equals("Channel_B"))
+                    catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
                     {
-                        frConfig.pChannels |= 2;
+                        Console.WriteLine($"Cannot cache FIBEX into {cacheFile}: {ex.Message}");
                     }
                 }
+                _loaded[key] = config;
+                return config;
+            }
+        }
 
-                frConfig.pWakeupChannel = XLDefine.XL_FlexRay_FlagsChip.XL_FR_CHANNEL_A;
+        /// <summary>
+        /// One forward pass over FIBEX. Cluster and controller parameters are taken from their first occurrence,
+        /// frame triggerings of channels are resolved into PDU layouts when whole file was read.
+        /// </summary>
+        static FibexConfig Parse(string fileName)
+        {
+            FibexConfig config = new FibexConfig();
+            //Open elements, text belongs to the last one
+            List<string> path = new List<string>();
+            //PDU ID -> index, name and length
+            Dictionary<string, FlexRayPduLayout> pdus = new Dictionary<string, FlexRayPduLayout>();
+            //FRAME ID -> name and PDU instances
+            Dictionary<string, FibexFrame> frames = new Dictionary<string, FibexFrame>();
+            List<FibexTriggering> channelTriggerings = new List<FibexTriggering>();
+            List<FibexTriggering> triggerings = new List<FibexTriggering>();
+            FibexTriggering triggering = null;
+            FibexFrame frame = null;
+            FibexPduInstance instance = null;
+            FlexRayPduLayout pdu = null;
+            string channelName = null;
+            int[] timing = new int[3];
+            bool descFirst = true;
+            StringBuilder desc = null;
+
+            XmlReaderSettings settings = new XmlReaderSettings();
+            settings.IgnoreWhitespace = true;
+            settings.IgnoreComments = true;
+            settings.DtdProcessing = DtdProcessing.Ignore;
+            using (XmlReader reader = XmlReader.Create(fileName, settings))
+            {
+                while (reader.Read())
+                {
+                    switch (reader.NodeType)
+                    {
+                        case XmlNodeType.Element:
+                            string name = reader.Name;
+                            switch (name)
+                            {
+                                case "fx:CHANNEL":
+                                    channelName = null;
+                                    channelTriggerings.Clear();
+                                    break;
+                                case "fx:FRAME-TRIGGERING":
+                                    triggering = new FibexTriggering();
+                                    triggering.Id = reader.GetAttribute("ID");
+                                    break;
+                                case "fx:FRAME-REF":
+                                    if (triggering != null)
+                                    {
+                                        triggering.FrameRef = reader.GetAttribute("ID-REF");
+                                    }
+                                    break;
+                                case "fx:ABSOLUTELY-SCHEDULED-TIMING":
+                                    timing[0] = timing[1] = timing[2] = -1;
+                                    break;
+                                case "fx:FRAME":
+                                    frame = new FibexFrame();
+                                    frames[reader.GetAttribute("ID") ?? string.Empty] = frame;
+                                    break;
+                                case "fx:PDU-INSTANCE":
+                                    instance = new FibexPduInstance();
+                                    frame?.Instances.Add(instance);
+                                    break;
+                                case "fx:PDU-REF":
+                                    if (instance != null)
+                                    {
+                                        instance.PduRef = reader.GetAttribute("ID-REF");
+                                    }
+                                    break;
+                                case "fx:PDU":
+                                    pdu = new FlexRayPduLayout();
+                                    pdu.Id = pdus.Count;
+                                    pdu.Name = reader.GetAttribute("ID");
+                                    pdus[pdu.Name ?? string.Empty] = pdu;
+                                    break;
+                                case "ho:DESC":
+                                    if (descFirst)
+                                    {
+                                        desc = new StringBuilder();
+                                    }
+                                    break;
+                            }
+                            if (!reader.IsEmptyElement)
+                            {
+                                path.Add(name);
+                            }
+                            break;
+                        case XmlNodeType.EndElement:
+                            path.RemoveAt(path.Count - 1);
+                            switch (reader.Name)
+                            {
+                                case "fx:CHANNEL":
+                                    FlexRayChannel channel = FlexRayChannel.A;
+                                    if (channelName == "Channel_A")
+                                    {
+                                        config.Channels |= 1;
+                                    }
+                                    else if (channelName == "Channel_B")
+                                    {
+                                        config.Channels |= 2;
+                                        channel = FlexRayChannel.B;
+                                    }
+                                    foreach (FibexTriggering ft in channelTriggerings)
+                                    {
+                                        ft.Channel = channel;
+                                        triggerings.Add(ft);
+                                    }
+                                    channelTriggerings.Clear();
+                                    break;
+                                case "fx:FRAME-TRIGGERING":
+                                    if (triggering != null)
+                                    {
+                                        channelTriggerings.Add(triggering);
+                                    }
+                                    triggering = null;
+                                    break;
+                                case "fx:ABSOLUTELY-SCHEDULED-TIMING":
+                                    if (triggering != null)
+                                    {
+                                        //Timing by other means (i.e. CYCLE-COUNTER) is not supported, cluster parameters do not depend on it
+                                        if (timing[0] < 0 || timing[1] < 0 || timing[2] < 0)
+                                        {
+                                            Console.WriteLine($"FIBEX: Timing of frame triggering {triggering.Id} is incomplete, skipped");
+                                        }
+                                        else
+                                        {
+                                            //FRAME-REF can follow TIMINGS, frame is resolved at the end
+                                            triggering.Timings.Add(new int[] { timing[0], timing[1], timing[2] });
+                                        }
+                                    }
+                                    break;
+                                case "fx:FRAME":
+                                    frame = null;
+                                    break;
+                                case "fx:PDU-INSTANCE":
+                                    instance = null;
+                                    break;
+                                case "fx:PDU":
+                                    pdu = null;
+                                    break;
+                                case "ho:DESC":
+                                    if (desc != null && descFirst)
+                                    {
+                                        config.Description.Description = desc.ToString();
+                                        descFirst = false;
+                                        desc = null;
+                                    }
+                                    break;
+                            }
+                            break;
+                        case XmlNodeType.Text:
+                        case XmlNodeType.CDATA:
+                            if (path.Count == 0)
+                            {
+                                break;
+                            }
+                            string owner = path[path.Count - 1];
+                            string parent = path.Count > 1 ? path[path.Count - 2] : string.Empty;
+                            string value = reader.Value;
+                            if (desc != null)
+                            {
+                                //DESC can contain formatting elements, take all text as XmlNode.InnerText
+                                desc.Append(value);
+                            }
+                            switch (owner)
+                            {
+                                case "ho:SHORT-NAME":
+                                    if (parent == "fx:CHANNEL")
+                                    {
+                                        channelName = value;
+                                    }
+                                    else if (parent == "fx:FRAME" && frame != null)
+                                    {
+                                        frame.Name = value;
+                                    }
+                                    else if (parent == "fx:PDU" && pdu != null)
+                                    {
+                                        pdu.Name = value;
+                                    }
+                                    break;
+                                case "fx:SLOT-ID":
+                                    timing[0] = LayoutValue(value);
+                                    break;
+                                case "fx:BASE-CYCLE":
+                                    timing[1] = LayoutValue(value);
+                                    break;
+                                case "fx:CYCLE-REPETITION":
+                                    timing[2] = LayoutValue(value);
+                                    break;
+                                case "fx:BIT-POSITION":
+                                    if (parent == "fx:PDU-INSTANCE" && instance != null)
+                                    {
+                                        instance.BitPosition = LayoutValue(value);
+                                    }
+                                    break;
+                                case "fx:UPDATE-INDICATION-BIT-POSITION":
+                                case "fx:PDU-UPDATE-BIT-POSITION":
+                                    if (parent == "fx:PDU-INSTANCE" && instance != null)
+                                    {
+                                        instance.UpdateBit = LayoutValue(value);
+                                    }
+                                    break;
+                                case "fx:BYTE-LENGTH":
+                                    if (parent == "fx:PDU" && pdu != null)
+                                    {
+                                        pdu.Length = LayoutValue(value);
+                                    }
+                                    break;
+                                case "ho:LONG-NAME":
+                                    if (string.IsNullOrEmpty(config.Description.Name))
+                                    {
+                                        config.Description.Name = value;
+                                    }
+                                    break;
+                                default:
+                                    if ((owner == "fx:SPEED" || owner.StartsWith("flexray:")) && !config.Values.ContainsKey(owner))
+                                    {
+                                        config.Values[owner] = value;
+                                    }
+                                    break;
+                            }
+                            break;
+                    }
+                }
             }
 
-            catch (Exception e)
+            foreach (FibexTriggering ft in triggerings)
             {
-                return new Exception("Keyword not found! " + e.Message);
+                FibexFrame fr;
+                if (ft.FrameRef == null || !frames.TryGetValue(ft.FrameRef, out fr))
+                {
+                    continue;
+                }
+                foreach (int[] t in ft.Timings)
+                {
+                    FlexRayFrameTriggering frt = new FlexRayFrameTriggering();
+                    frt.Channel = ft.Channel;
+                    frt.FrameName = fr.Name ?? ft.FrameRef;
+                    frt.Slot = t[0];
+                    frt.BaseCycle = t[1];
+                    frt.CycleRepetition = t[2];
+                    AddPduInstances(frt, fr, pdus);
+                    config.Triggerings.Add(frt);
+                }
             }
+            return config;
+        }
 
-            //FibexDescription extraction
-            try
+        /// <summary>
+        /// Number of frame or PDU layout, -1 if it is not a number. Malformed layout skips only affected frame or PDU.
+        /// </summary>
+        private static int LayoutValue(string value)
+        {
+            int result;
+            if (!int.TryParse(value.Trim(), NumberStyles.Integer, CultureInfo.InvariantCulture, out result) || result < 0)
             {
-                nodeList = doc.GetElementsByTagName("ho:LONG-NAME");
-                desc.Name = nodeList[0].InnerText;
-                nodeList = doc.GetElementsByTagName("ho:DESC");
-                desc.Description = nodeList[0].InnerText;
+                return -1;
             }
-            catch
+            return result;
+        }
+
+        private static void AddPduInstances(FlexRayFrameTriggering frt, FibexFrame fr, Dictionary<string, FlexRayPduLayout> pdus)
+        {
+            foreach (FibexPduInstance pi in fr.Instances)
             {
-                //Not important
+                FlexRayPduLayout pdu;
+                if (pi.PduRef == null || pi.BitPosition < 0 || !pdus.TryGetValue(pi.PduRef, out pdu) || pdu.Length < 0)
+                {
+                    continue;
+                }
+                //Every instance has own position, PDU itself keeps only ID, name and length
+                FlexRayPduLayout layout = new FlexRayPduLayout();
+                layout.Id = pdu.Id;
+                layout.Name = pdu.Name;
+                layout.Length = pdu.Length;
+                layout.Offset = pi.BitPosition / 8;
+                layout.UpdateBit = pi.UpdateBit;
+                frt.Pdus.Add(layout);
             }
-            return null;
+        }
+
+        class FibexTriggering
+        {
+            public string Id;
+            public FlexRayChannel Channel;
+            public string FrameRef;
+            /// <summary>
+            /// Slot, base cycle, cycle repetition
+            /// </summary>
+            public List<int[]> Timings = new List<int[]>();
+        }
+
+        class FibexFrame
+        {
+            public string Name;
+            public List<FibexPduInstance> Instances = new List<FibexPduInstance>();
+        }
+
+        class FibexPduInstance
+        {
+            public string PduRef;
+            public int BitPosition = -1;
+            public int UpdateBit = FlexRayPduLayout.NO_UPDATE_BIT;
         }
     }
 
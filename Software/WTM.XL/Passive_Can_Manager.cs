@@ -11,10 +11,60 @@ namespace WTM.XL
 {
     internal class Passive_Can_Manager : A_Passive_Can_Manager
     {
-        public void Start(int baudarate, string pathCanIds)
+        XL_FlexRayIf _fr;
+        Passive_FlexRay_Pdu _pfrpdu;
+        Wireshark_FlexRay _ws_fr;
+
+        /// <param name="canFd">Receive CAN FD, classic CAN is received in batches otherwise</param>
+        /// <param name="pathFibex">Optional FIBEX, FlexRay channel is received only when it is set</param>
+        public void Start(int baudarate, string pathCanIds, Pcapng_Spool spool, bool canFd = false, string pathFibex = null)
+        {
+            ICanIf can = new XL_CanIf(baudarate, canFd);
+            Start(can, pathCanIds, spool);
+            if (!string.IsNullOrEmpty(pathFibex))
+            {
+                StartFlexRay(pathFibex);
+            }
+        }
+
+        void StartFlexRay(string pathFibex)
+        {
+            List<FlexRayFrameTriggering> triggerings;
+            Exception ex = FibexParser.GetPduLayout(pathFibex, out triggerings);
+            if (ex != null)
+            {
+                Console.WriteLine("FIBEX: " + ex.Message);
+                return;
+            }
+            _ws_fr = new Wireshark_FlexRay();
+            //FlexRay frames are split into PDUs and sent as datagrams next to CAN transport protocols
+            _pfrpdu = new Passive_FlexRay_Pdu(triggerings);
+            _pfrpdu.OnRawFrame += _pfrpdu_OnRawFrame;
+            _fr = new XL_FlexRayIf(pathFibex);
+            _fr.OnReceiveFlexRayFrame += _fr_OnReceiveFlexRayFrame;
+        }
+
+        private void _pfrpdu_OnRawFrame(object sender, RawMessage e)
+        {
+            AddRawFrame(e);
+        }
+
+        private void _fr_OnReceiveFlexRayFrame(object sender, FlexRayMessage e)
+        {
+            _ws_fr.Add(e);
+            AddFlexRayFrame(e);
+            _pfrpdu.Parse(e);
+        }
+
+        public override void Dispose()
         {
-            ICanIf can = new XL_CanIf(baudarate);
-            Start(can, pathCanIds);
+            if (_fr != null)
+            {
+                _fr.Dispose();
+                _ws_fr.Dispose();
+                Console.WriteLine($"FlexRay PDUs without update bit: {_pfrpdu.NotUpdated}");
+            }
+            base.Dispose();
         }
     }
 }
@@ -4,6 +4,7 @@ using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using WTM.Shared;
+using WTM.Wireshark;
 
 namespace WTM.XL
 {
@@ -14,10 +15,11 @@ namespace WTM.XL
             var pargs = Arguments.Parse(args);
             if (pargs != null)
             {
+                Wireshark_Server.Configure(pargs);
                 if (!pargs.ContainsKey(ArgumentTypes.Baudrate))
                 {
                     Console.WriteLine("Missing Baudrate. Aborting.");
-                    Console.WriteLine("Usage: -b 500000 [-f canId.xml]");
+                    Console.WriteLine("Usage: -b 500000 [-db 2000000] [-f canId.xml] [-fibex cluster.xml] [-w captureFolder [-wsize MB] [-wtime min] [-gz]] [-history s] [-hsize MB] [-slow drop|disconnect]");
                 }
                 else
                 {
@@ -26,8 +28,15 @@ namespace WTM.XL
                     {
                         pathCanIds = pargs[ArgumentTypes.CanIdsFile] as string;
                     }
+                    string pathFibex = null;
+                    if (pargs.ContainsKey(ArgumentTypes.FibexFile))
+                    {
+                        pathFibex = pargs[ArgumentTypes.FibexFile] as string;
+                    }
+                    //Bitrate of data phase is taken from Vector Hardware Config, argument only selects CAN FD port
+                    bool canFd = pargs.ContainsKey(ArgumentTypes.DataBaudrate);
                     Passive_Can_Manager pcm = new Passive_Can_Manager();
-                    pcm.Start((int)pargs[ArgumentTypes.Baudrate], pathCanIds);
+                    pcm.Start((int)pargs[ArgumentTypes.Baudrate], pathCanIds, Pcapng_Spool.FromArguments(pargs), canFd, pathFibex);
                     WaitEsc();
                     pcm.Dispose();
                     return 0;
@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Runtime.InteropServices;
 using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
@@ -26,11 +27,22 @@ namespace WTM.XL
         private UInt64 _accessMask = 0;
         private UInt64 _permissionMask = 0;
         private UInt64 _txMask = 0;
+        // Port is opened with interface version V4, events are CAN FD events received by XL_CanReceive one by one.
+        // Classic port is used unless CAN FD was requested, its events are read in batches by xlReceive.
+        private bool _canFd = false;
 
         // RX thread
+        /// <summary>
+        /// Events received by one call of xlReceive
+        /// </summary>
+        const int RX_BATCH = 256;
         private Thread _rxThread;
-        private bool _killRxThread;
+        private volatile bool _killRxThread;
+        private int _rateCount;
+        private int _rateStart;
         AutoResetEvent _mutexWaitOnInit;
+        //XL timestamps are in nanoseconds
+        ClockDomain _clock = new ClockDomain(1000000000);
 
         public int Baudrate { get; }
 
@@ -38,8 +50,24 @@ namespace WTM.XL
 
         public XLDefine.XL_Status Status { get; set; }
 
-        public XL_CanIf(int baudrate)
+        /// <summary>
+        /// Amount of received CAN frames
+        /// </summary>
+        public long Received { get; private set; }
+        /// <summary>
+        /// Received frames per second, updated every second
+        /// </summary>
+        public int Rate { get; private set; }
+        public int MaxRate { get; private set; }
+        /// <summary>
+        /// Calls of driver which have returned at least one event, Received / ReceiveCalls is the average batch
+        /// </summary>
+        public long ReceiveCalls { get; private set; }
+
+        /// <param name="canFd">Open CAN FD port (V4), data phase bitrate is set in Vector Hardware Config</param>
+        public XL_CanIf(int baudrate, bool canFd = false)
         {
+            _canFd = canFd;
             Baudrate = 0; //TODO - Figure out how to change baudrate for Vector via API instead of HW Config
             Status = XLDefine.XL_Status.XL_ERROR; //Default setup
             _mutexWaitOnInit = new AutoResetEvent(false);
@@ -107,8 +135,18 @@ namespace WTM.XL
 
                 _permissionMask = _accessMask;
 
-                // Open port 
-                Status = _canDriver.XL_OpenPort(ref _portHandle, _appName, _accessMask, ref _permissionMask, 1024, XLDefine.XL_InterfaceVersion.XL_INTERFACE_VERSION, XLDefine.XL_BusTypes.XL_BUS_TYPE_CAN);
+                // Open port, CAN FD interface (V4) if requested, otherwise or if device does not support it classic CAN
+                if (_canFd)
+                {
+                    Status = _canDriver.XL_OpenPort(ref _portHandle, _appName, _accessMask, ref _permissionMask, 16384, XLDefine.XL_InterfaceVersion.XL_INTERFACE_VERSION_V4, XLDefine.XL_BusTypes.XL_BUS_TYPE_CAN);
+                    _canFd = Status == XLDefine.XL_Status.XL_SUCCESS;
+                }
+                if (!_canFd)
+                {
+                    _permissionMask = _accessMask;
+                    Status = _canDriver.XL_OpenPort(ref _portHandle, _appName, _accessMask, ref _permissionMask, 1024, XLDefine.XL_InterfaceVersion.XL_INTERFACE_VERSION, XLDefine.XL_BusTypes.XL_BUS_TYPE_CAN);
+                }
+                Console.WriteLine($"Vector: {(_canFd ? "CAN FD" : "CAN")} port");
                 if (Status != XLDefine.XL_Status.XL_SUCCESS)
                 {
                     Console.WriteLine("XL_OpenPort: " + Status);
@@ -153,7 +191,11 @@ namespace WTM.XL
         public void Dispose()
         {
             _killRxThread = true;
+            //Thread wakes up every 10 ms, port is closed when it ends
+            _rxThread?.Join();
             _rxThread = null;
+            double batch = ReceiveCalls == 0 ? 0 : (double)Received / ReceiveCalls;
+            Console.WriteLine($"Vector received {Received} frames, max {MaxRate} frames/s, {batch:F1} frames per driver call");
         }
 
         /// <summary>
@@ -165,6 +207,139 @@ namespace WTM.XL
             _canDriver.XL_PopupHwConfig();
         }
 
+        /// <summary>
+        /// Read all CAN FD events from queue of V4 port
+        /// </summary>
+        private void ReceiveCanFd()
+        {
+            XLClass.XLcanRxEvent rxEvent = new XLClass.XLcanRxEvent();
+            while (!_killRxThread && _canDriver.XL_CanReceive(_portHandle, ref rxEvent) == XLDefine.XL_Status.XL_SUCCESS)
+            {
+                if (rxEvent.tag != XLDefine.XL_CANFD_RX_EventTags.XL_CAN_EV_TAG_RX_OK)
+                {
+                    continue;
+                }
+                XLDefine.XL_CANFD_RX_MessageFlags msgFlags = rxEvent.tagData.canRxOkMsg.msgFlags;
+                if ((msgFlags & XLDefine.XL_CANFD_RX_MessageFlags.XL_CAN_RXMSG_FLAG_RTR) != 0)
+                {
+                    Console.WriteLine("REMOTE FRAME");
+                    continue;
+                }
+                if ((msgFlags & XLDefine.XL_CANFD_RX_MessageFlags.XL_CAN_RXMSG_FLAG_EF) != 0)
+                {
+                    Console.WriteLine("ERROR FRAME");
+                    continue;
+                }
+
+                CanFdFlags flags = CanFdFlags.None;
+                if ((msgFlags & XLDefine.XL_CANFD_RX_MessageFlags.XL_CAN_RXMSG_FLAG_EDL) != 0)
+                {
+                    flags |= CanFdFlags.Fd;
+                    if ((msgFlags & XLDefine.XL_CANFD_RX_MessageFlags.XL_CAN_RXMSG_FLAG_BRS) != 0)
+                    {
+                        flags |= CanFdFlags.Brs;
+                    }
+                    if ((msgFlags & XLDefine.XL_CANFD_RX_MessageFlags.XL_CAN_RXMSG_FLAG_ESI) != 0)
+                    {
+                        flags |= CanFdFlags.Esi;
+                    }
+                }
+                //DLC of classic CAN frame can be 9 - 15 too, but it carries only 8 bytes
+                int length = CanMessage.DlcToLength((int)rxEvent.tagData.canRxOkMsg.dlc);
+                if (flags == CanFdFlags.None)
+                {
+                    length = Math.Min(length, CanMessage.MAX_LENGTH_CAN);
+                }
+                byte[] data = new byte[length];
+                Buffer.BlockCopy(rxEvent.tagData.canRxOkMsg.data, 0, data, 0, length);
+                int id = (int)rxEvent.tagData.canRxOkMsg.canId & 0x1FFFFFFF;
+
+                CanMessage frame = new CanMessage(data, id, flags);
+                frame.Timestamp = _clock.ToUnixNs((long)rxEvent.timeStamp);
+                OnReceiveCanFrame?.Invoke(this, frame);
+                ReceiveCalls++;
+                UpdateRate(1);
+            }
+        }
+
+        /// <summary>
+        /// Read all classic CAN events from queue, up to RX_BATCH events per driver call
+        /// </summary>
+        private void ReceiveCan(XL_Native.XLevent[] events, IntPtr buffer)
+        {
+            while (!_killRxThread)
+            {
+                uint count = (uint)events.Length;
+                XLDefine.XL_Status xlStatus = XL_Native.Receive(_portHandle, ref count, buffer);
+                if (xlStatus == XLDefine.XL_Status.XL_ERR_QUEUE_IS_EMPTY)
+                {
+                    return;
+                }
+                if (xlStatus != XLDefine.XL_Status.XL_SUCCESS)
+                {
+                    Console.WriteLine("xlReceive: " + xlStatus);
+                    return;
+                }
+                ReceiveCalls++;
+                int received = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    if ((events[i].flags & (byte)XLDefine.XL_MessageFlags.XL_EVENT_FLAG_OVERRUN) != 0)
+                    {
+                        Console.WriteLine("XL_EVENT_FLAG_OVERRUN");
+                    }
+                    if (events[i].tag != XLDefine.XL_EventTags.XL_RECEIVE_MSG)
+                    {
+                        continue;
+                    }
+                    XLDefine.XL_MessageFlags msgFlags = events[i].msgFlags;
+                    if ((msgFlags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_OVERRUN) != 0)
+                    {
+                        Console.WriteLine("XL_CAN_MSG_FLAG_OVERRUN");
+                    }
+                    if ((msgFlags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_ERROR_FRAME) != 0)
+                    {
+                        Console.WriteLine("ERROR FRAME");
+                        continue;
+                    }
+                    if ((msgFlags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_REMOTE_FRAME) != 0)
+                    {
+                        Console.WriteLine("REMOTE FRAME");
+                        continue;
+                    }
+
+                    ulong raw = events[i].data;
+                    byte[] data = new byte[Math.Min((int)events[i].dlc, CanMessage.MAX_LENGTH_CAN)];
+                    for (int b = 0; b < data.Length; b++)
+                    {
+                        data[b] = (byte)(raw >> (b * 8));
+                    }
+                    int id = (int)events[i].id & 0x1FFFFFFF;
+
+                    CanMessage frame = new CanMessage(data, id);
+                    //Timestamp value is in nanoseconds, generated with 8us precision per XL Driver Library
+                    frame.Timestamp = _clock.ToUnixNs((long)events[i].timeStamp);
+                    OnReceiveCanFrame?.Invoke(this, frame);
+                    received++;
+                }
+                UpdateRate(received);
+            }
+        }
+
+        private void UpdateRate(int count)
+        {
+            Received += count;
+            _rateCount += count;
+            int elapsed = Environment.TickCount - _rateStart;
+            if (elapsed >= 1000)
+            {
+                Rate = (int)(_rateCount * 1000L / elapsed);
+                MaxRate = Math.Max(MaxRate, Rate);
+                _rateCount = 0;
+                _rateStart = Environment.TickCount;
+            }
+        }
+
         /// <summary>
         /// RX thread waits for Vector interface events and displays filtered CAN messages.
         /// </summary>
@@ -181,85 +356,35 @@ namespace WTM.XL
             }
 
             _killRxThread = false;
-            // Create new object containing received data 
-            XLClass.xl_event receivedEvent = new XLClass.xl_event();
-
-            // Result of XL Driver function calls
-            XLDefine.XL_Status xlStatus = XLDefine.XL_Status.XL_SUCCESS;
-
-            // Result values of WaitForSingleObject 
-            XLDefine.WaitResults waitResult = new XLDefine.WaitResults();
+            _rateStart = Environment.TickCount;
 
             int handle = 0;
             _canDriver.XL_SetNotification(_portHandle, ref handle, 1);
 
-            while (!_killRxThread)
+            while (!_killRxThread && _canFd)
             {
-                // Wait for hardware events
-                waitResult = _canDriver.XL_WaitForSingleObject(handle, 10);
-
-                // If event occurred...
-                if (waitResult != XLDefine.WaitResults.WAIT_TIMEOUT)
+                if (_canDriver.XL_WaitForSingleObject(handle, 10) != XLDefine.WaitResults.WAIT_TIMEOUT)
                 {
-                    // ...init xlStatus first
-                    xlStatus = XLDefine.XL_Status.XL_SUCCESS;
+                    ReceiveCanFd();
+                }
+            }
 
-                    // afterwards: while hw queue is not empty...
-                    while (xlStatus != XLDefine.XL_Status.XL_ERR_QUEUE_IS_EMPTY)
+            //Driver writes events directly into pinned array, nothing is marshalled per event
+            XL_Native.XLevent[] events = new XL_Native.XLevent[RX_BATCH];
+            GCHandle pinned = GCHandle.Alloc(events, GCHandleType.Pinned);
+            try
+            {
+                while (!_killRxThread && !_canFd)
+                {
+                    if (_canDriver.XL_WaitForSingleObject(handle, 10) != XLDefine.WaitResults.WAIT_TIMEOUT)
                     {
-                        // ...receive data from hardware.
-                        xlStatus = _canDriver.XL_Receive(_portHandle, ref receivedEvent);
-
-                        //  If receiving succeed....
-                        if (xlStatus == XLDefine.XL_Status.XL_SUCCESS)
-                        {
-                            if ((receivedEvent.flags & XLDefine.XL_MessageFlags.XL_EVENT_FLAG_OVERRUN) != 0)
-                            {
-                                Console.WriteLine("XL_EVENT_FLAG_OVERRUN");
-                            }
-
-                            // ...and data is a Rx msg...
-                            if (receivedEvent.tag == XLDefine.XL_EventTags.XL_RECEIVE_MSG)
-                            {
-                                if ((receivedEvent.tagData.can_Msg.flags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_OVERRUN) != 0)
-                                {
-                                    Console.WriteLine("XL_CAN_MSG_FLAG_OVERRUN");
-                                }
-
-                                // ...check various flags
-                                if ((receivedEvent.tagData.can_Msg.flags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_ERROR_FRAME)
-                                    == XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_ERROR_FRAME)
-                                {
-                                    Console.WriteLine("ERROR FRAME");
-                                }
-
-                                else if ((receivedEvent.tagData.can_Msg.flags & XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_REMOTE_FRAME)
-                                    == XLDefine.XL_MessageFlags.XL_CAN_MSG_FLAG_REMOTE_FRAME)
-                                {
-                                    Console.WriteLine("REMOTE FRAME");
-                                }
-
-                                else
-                                {                                    
-                                    byte[] data = receivedEvent.tagData.can_Msg.data.Take(receivedEvent.tagData.can_Msg.dlc).ToArray();
-                                    int id = (int)receivedEvent.tagData.can_Msg.id & 0x1FFFFFFF;
-
-                                    CanMessage frame = new CanMessage(data, id);
-                                    //Timestamp value is in nanoseconds, generated with 8us precision per XL Driver Library
-                                    frame.Timestamp = (long)(receivedEvent.timeStamp / 1000000);
-                                    OnReceiveCanFrame?.Invoke(this, frame);
-                                }
-                            }
-                        }
-
-                        //Leave thread when requested
-                        if (_killRxThread)
-                        {
-                            break;
-                        }
+                        ReceiveCan(events, pinned.AddrOfPinnedObject());
                     }
                 }
-                // No event occurred
+            }
+            finally
+            {
+                pinned.Free();
             }
 
             //Close communication with device
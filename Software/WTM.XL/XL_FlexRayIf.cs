@@ -2,11 +2,259 @@
 using System.Collections.Generic;
 using System.Linq;
 using System.Text;
+using System.Threading;
 using System.Threading.Tasks;
+using vxlapi_NET;
 
 namespace WTM.XL
 {
-    internal class XL_FlexRayIf
+    /// <summary>
+    /// Passive FlexRay input of Vector device. Channel is assigned as "wstrafficmon FR1" in Vector Hardware Config.
+    /// Cluster parameters are loaded from FIBEX, controller is started in asynchronous spy mode if device supports it,
+    /// otherwise it integrates into cluster as a node without own slots.
+    /// </summary>
+    internal class XL_FlexRayIf : IDisposable
     {
+        // Driver access through XLDriver (wrapper)
+        private XLDriver _frDriver = new XLDriver();
+        private String _appName = "wstrafficmon";
+        private string _fibexPath;
+
+        // Driver configuration
+        private XLClass.xl_driver_config driverConfig = new XLClass.xl_driver_config();
+
+        // Variables required by XLDriver
+        private XLDefine.XL_HardwareType _hwType = XLDefine.XL_HardwareType.XL_HWTYPE_NONE;
+        private uint _hwIndex = 0;
+        private uint _hwChannel = 0;
+        private int _portHandle = -1;
+        private UInt64 _accessMask = 0;
+        private UInt64 _permissionMask = 0;
+        // Frames are received as XL_FR_SPY_FRAME events with frame CRC
+        private bool _spy = false;
+
+        // RX thread
+        private Thread _rxThread;
+        private volatile bool _killRxThread;
+        AutoResetEvent _mutexWaitOnInit;
+        //XL timestamps are in nanoseconds
+        ClockDomain _clock = new ClockDomain(1000000000);
+
+        public event EventHandler<FlexRayMessage> OnReceiveFlexRayFrame;
+
+        public XLDefine.XL_Status Status { get; set; }
+
+        /// <summary>
+        /// Amount of received FlexRay frames
+        /// </summary>
+        public long Received { get; private set; }
+        /// <summary>
+        /// Frames received by spy with frame error, those are sent further with invalid CRC
+        /// </summary>
+        public long Errors { get; private set; }
+
+        /// <param name="fibexPath">FIBEX with cluster parameters, see FibexParser.GetConfig</param>
+        public XL_FlexRayIf(string fibexPath)
+        {
+            _fibexPath = fibexPath;
+            Status = XLDefine.XL_Status.XL_ERROR; //Default setup
+            _mutexWaitOnInit = new AutoResetEvent(false);
+
+            _rxThread = new Thread(RXThread);
+            _mutexWaitOnInit.Reset();
+            _rxThread.Start();
+            if (!_mutexWaitOnInit.WaitOne(1000))
+            {
+                Console.WriteLine("Vector: Unable to init FlexRay and start receiving");
+            }
+        }
+
+        bool InitFlexRay()
+        {
+            XLClass.xl_fr_cluster_configuration frConfig;
+            FibexDescription desc;
+            Exception ex = FibexParser.GetConfig(_fibexPath, out frConfig, out desc);
+            if (ex != null)
+            {
+                Console.WriteLine("FIBEX: " + ex.Message);
+                return false;
+            }
+            Console.WriteLine($"FIBEX: {desc.Name} {desc.Description}");
+
+            // Open XL Driver
+            Status = _frDriver.XL_OpenDriver();
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_OpenDriver: " + Status);
+                return false;
+            }
+
+            // Get XL Driver configuration
+            Status = _frDriver.XL_GetDriverConfig(ref driverConfig);
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_GetDriverConfig: " + Status);
+                return false;
+            }
+
+            // If the application name cannot be found in VCANCONF, create the item and let user assign FlexRay channel
+            if (_frDriver.XL_GetApplConfig(_appName, 0, ref _hwType, ref _hwIndex, ref _hwChannel, XLDefine.XL_BusTypes.XL_BUS_TYPE_FLEXRAY) != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                _frDriver.XL_SetApplConfig(_appName, 0, XLDefine.XL_HardwareType.XL_HWTYPE_NONE, 0, 0, XLDefine.XL_BusTypes.XL_BUS_TYPE_FLEXRAY);
+                _frDriver.XL_PopupHwConfig();
+                return false;
+            }
+            if (_hwType == XLDefine.XL_HardwareType.XL_HWTYPE_NONE)
+            {
+                _frDriver.XL_PopupHwConfig();
+                return false;
+            }
+
+            _accessMask = _frDriver.XL_GetChannelMask(_hwType, (int)_hwIndex, (int)_hwChannel);
+            _permissionMask = _accessMask;
+            Status = _frDriver.XL_OpenPort(ref _portHandle, _appName, _accessMask, ref _permissionMask, 16384, XLDefine.XL_InterfaceVersion.XL_INTERFACE_VERSION_V3, XLDefine.XL_BusTypes.XL_BUS_TYPE_FLEXRAY);
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_OpenPort: " + Status);
+                return false;
+            }
+
+            // Without init access the channel is already configured by other application, only listen
+            if (_permissionMask == _accessMask)
+            {
+                Status = _frDriver.XL_FrSetConfiguration(_portHandle, _accessMask, ref frConfig);
+                if (Status != XLDefine.XL_Status.XL_SUCCESS)
+                {
+                    Console.WriteLine("XL_FrSetConfiguration: " + Status);
+                    return false;
+                }
+
+                _spy = _frDriver.XL_FrActivateSpy(_portHandle, _accessMask, XLDefine.XL_FlexRay_SpyMode.XL_FR_SPY_MODE_ASYNCHRONOUS) == XLDefine.XL_Status.XL_SUCCESS;
+                if (!_spy)
+                {
+                    XLClass.xl_fr_set_modes modes = new XLClass.xl_fr_set_modes();
+                    modes.frMode = XLDefine.XL_FlexRay_Mode.XL_FR_MODE_NORMAL;
+                    Status = _frDriver.XL_FrSetMode(_portHandle, _accessMask, modes);
+                    if (Status != XLDefine.XL_Status.XL_SUCCESS)
+                    {
+                        Console.WriteLine("XL_FrSetMode: " + Status);
+                        return false;
+                    }
+                }
+            }
+            Console.WriteLine($"Vector: FlexRay {(_spy ? "spy" : "node")} @ {frConfig.baudrate}");
+
+            // Activate channel
+            Status = _frDriver.XL_ActivateChannel(_portHandle, _accessMask, XLDefine.XL_BusTypes.XL_BUS_TYPE_FLEXRAY, XLDefine.XL_AC_Flags.XL_ACTIVATE_NONE);
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_ActivateChannel: " + Status);
+                return false;
+            }
+            return true;
+        }
+
+        public void Dispose()
+        {
+            _killRxThread = true;
+            //Thread wakes up every 10 ms, port is closed when it ends
+            _rxThread?.Join();
+            _rxThread = null;
+            Console.WriteLine($"Vector received {Received} FlexRay frames, {Errors} with frame error");
+        }
+
+        /// <summary>
+        /// Read all FlexRay events from queue
+        /// </summary>
+        private void ReceiveFlexRay()
+        {
+            XLClass.xl_fr_event frEvent = new XLClass.xl_fr_event();
+            while (!_killRxThread && _frDriver.XL_FrReceive(_portHandle, ref frEvent) == XLDefine.XL_Status.XL_SUCCESS)
+            {
+                if ((frEvent.flagsChip & XLDefine.XL_FlexRay_FlagsChip.XL_FR_QUEUE_OVERFLOW) != 0)
+                {
+                    Console.WriteLine("XL_FR_QUEUE_OVERFLOW");
+                }
+
+                FlexRayMessage frame;
+                if (frEvent.tag == XLDefine.XL_FlexRay_EventTags.XL_FR_RX_FRAME)
+                {
+                    XLClass.xl_fr_rx_frame rx = frEvent.tagData.frRxFrame;
+                    frame = CreateFrame(rx.flags, rx.slotID, rx.payloadLength, rx.headerCRC, rx.cycleCount, rx.data);
+                    frame.Channel = (frEvent.flagsChip & XLDefine.XL_FlexRay_FlagsChip.XL_FR_CHANNEL_B) != 0 ? FlexRayChannel.B : FlexRayChannel.A;
+                    //Controller passes only frames with valid CRC, but does not report it
+                    frame.Crc = FlexRayCrc.Frame(frame.GetHeader(), frame.Data, frame.Channel == FlexRayChannel.B);
+                }
+                else if (frEvent.tag == XLDefine.XL_FlexRay_EventTags.XL_FR_SPY_FRAME)
+                {
+                    XLClass.xl_fr_spy_frame spy = frEvent.tagData.frSpyFrame;
+                    frame = CreateFrame(spy.headerFlags, spy.slotID, spy.payloadLength, spy.headerCRC, spy.cycleCount, spy.data);
+                    frame.Channel = (frEvent.flagsChip & XLDefine.XL_FlexRay_FlagsChip.XL_FR_SPY_CHANNEL_B) != 0 ? FlexRayChannel.B : FlexRayChannel.A;
+                    frame.Crc = (int)(spy.frameCRC & 0xFFFFFF);
+                    if (spy.frameError != 0)
+                    {
+                        Errors++;
+                    }
+                }
+                else
+                {
+                    continue;
+                }
+                frame.Timestamp = _clock.ToUnixNs((long)frEvent.timeStamp);
+                Received++;
+                OnReceiveFlexRayFrame?.Invoke(this, frame);
+            }
+        }
+
+        private static FlexRayMessage CreateFrame(XLDefine.XL_FlexRay_FrameFlags flags, int slotId, int payloadLength, int headerCrc, int cycleCount, byte[] payload)
+        {
+            FlexRayMessage frame = new FlexRayMessage();
+            //Lower 5 bits are the same as indicators in header
+            frame.Flags = (FlexRayFlags)((int)flags & 0x1F);
+            frame.FrameId = slotId & 0x7FF;
+            frame.PayloadLength = payloadLength & 0x7F;
+            frame.HeaderCrc = headerCrc & 0x7FF;
+            frame.CycleCount = cycleCount & 0x3F;
+            byte[] data = new byte[Math.Min(frame.PayloadLength * 2, payload.Length)];
+            Buffer.BlockCopy(payload, 0, data, 0, data.Length);
+            frame.Data = data;
+            return frame;
+        }
+
+        /// <summary>
+        /// RX thread waits for Vector interface events and passes FlexRay frames further.
+        /// </summary>
+        private void RXThread()
+        {
+            if (!InitFlexRay())
+            {
+                return;
+            }
+            //Provide validation that thread is ready and running
+            _mutexWaitOnInit.Set();
+
+            int handle = 0;
+            _frDriver.XL_SetNotification(_portHandle, ref handle, 1);
+
+            while (!_killRxThread)
+            {
+                if (_frDriver.XL_WaitForSingleObject(handle, 10) != XLDefine.WaitResults.WAIT_TIMEOUT)
+                {
+                    ReceiveFlexRay();
+                }
+            }
+
+            //Close communication with device
+            Status = _frDriver.XL_ClosePort(_portHandle);
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_ClosePort failed");
+            }
+            Status = _frDriver.XL_CloseDriver();
+            if (Status != XLDefine.XL_Status.XL_SUCCESS)
+            {
+                Console.WriteLine("XL_CloseDriver failed");
+            }
+        }
     }
 }
@@ -0,0 +1,70 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using vxlapi_NET;
+
+namespace WTM.XL
+{
+    /// <summary>
+    /// Direct access to XL driver library for functions which XLDriver wrapper marshals event by event.
+    /// Uses the same vxlapi.dll / vxlapi64.dll as the wrapper, so port handles of XLDriver are valid here.
+    /// </summary>
+    internal static class XL_Native
+    {
+        /// <summary>
+        /// s_xl_event from vxlapi.h with tagData as s_xl_can_msg, 48 bytes
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct XLevent
+        {
+            public XLDefine.XL_EventTags tag;
+            public byte chanIndex;
+            public ushort transId;
+            public ushort portHandle;
+            /// <summary>
+            /// XL_EVENT_FLAG_OVERRUN
+            /// </summary>
+            public byte flags;
+            public byte reserved;
+            /// <summary>
+            /// [ns]
+            /// </summary>
+            public ulong timeStamp;
+            public uint id;
+            public XLDefine.XL_MessageFlags msgFlags;
+            public ushort dlc;
+            public ulong res1;
+            /// <summary>
+            /// data[0] is in the lowest byte
+            /// </summary>
+            public ulong data;
+            public ulong res2;
+        }
+
+        static class Native32
+        {
+            [DllImport("vxlapi.dll", EntryPoint = "xlReceive")]
+            public static extern XLDefine.XL_Status Receive(int portHandle, ref uint eventCount, IntPtr events);
+        }
+
+        static class Native64
+        {
+            [DllImport("vxlapi64.dll", EntryPoint = "xlReceive")]
+            public static extern XLDefine.XL_Status Receive(int portHandle, ref uint eventCount, IntPtr events);
+        }
+
+        /// <summary>
+        /// Receive up to eventCount events in one call
+        /// </summary>
+        /// <param name="eventCount">Size of buffer, on return amount of received events</param>
+        /// <param name="events">Pinned array of XLevent</param>
+        /// <returns>XL_ERR_QUEUE_IS_EMPTY if nothing was received</returns>
+        public static XLDefine.XL_Status Receive(int portHandle, ref uint eventCount, IntPtr events)
+        {
+            if (Environment.Is64BitProcess)
+            {
+                return Native64.Receive(portHandle, ref eventCount, events);
+            }
+            return Native32.Receive(portHandle, ref eventCount, events);
+        }
+    }
+}